@@ -0,0 +1,245 @@
+// Notice
+// ------
+//
+// This file is part of the Mezzo SoundFont2 Sampling Based Synthesizer:
+//
+//     https://github.com/turgu1/mezzo
+//
+// Simplified BSD License
+// ----------------------
+//
+// Copyright (c) 2018, Guy Turcotte
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// The views and conclusions contained in the software and documentation are those
+// of the authors and should not be interpreted as representing official policies,
+// either expressed or implied, of the FreeBSD Project.
+//
+
+// Convolution reverb check
+// ------------------------
+//
+// Feeds test signals through the convolution reverb, with a short impulse
+// response generated for each channel, and compares the wet signal with a
+// direct convolution in the time domain, computed in double precision.
+// This verifies the FFT, the partitioning of the impulse response, and the
+// indexing of the frequency domain delay line and of the tails computed by
+// the worker thread. The check waits for the worker after each buffer:
+// no tail is left out, and the result does not depend on the machine load.
+//
+//   impulse   A single impulse, in the middle of the first buffer: the
+//             output is the impulse response
+//   noise     Random samples over several buffers, different on each
+//             channel
+//
+// The width is set to 1.0, such that each channel of the output only
+// depends on the same channel of the input. One CSV line is written per
+// signal:
+//
+//   revision    Source revision the check was built from
+//   signal      Input signal
+//   buffers     Buffers processed
+//   max_error   Largest difference with the direct convolution, relative
+//               to the peak of the direct convolution
+//   late_tails  Tails counted as late in the metrics, none expected as the
+//               check waits for the worker thread
+//
+// The exit status is 1 if a signal fails.
+//
+// Usage: mezzo_convolution_check
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+
+#include "mezzo.h"
+
+#ifndef BENCH_REVISION
+  #define BENCH_REVISION "unknown"
+#endif
+
+#define CHECK_IR_LENGTH     (5 * BUFFER_FRAME_COUNT + 37)  ///< 6 partitions, 4 of them in the tail
+#define CHECK_INPUT_BUFFERS 4
+#define CHECK_BUFFER_COUNT  (CHECK_INPUT_BUFFERS + 8)
+#define CHECK_MAX_ERROR     1e-4
+
+enum checkSignal { IMPULSE = 0, NOISE = 1, CHECK_SIGNAL_COUNT = 2 };
+
+PRIVATE const char * signalNames[CHECK_SIGNAL_COUNT] = { "impulse", "noise" };
+
+//---- nextRandom() ----
+//
+// A fixed generator, such that the signals are the same on every system:
+// values between -1 and 1.
+
+PRIVATE float nextRandom(uint32_t & state)
+{
+  state = state * 1664525u + 1013904223u;
+  return ((int32_t) state) / 2147483648.0f;
+}
+
+//---- buildImpulse() ----
+//
+// Decaying noise, as the impulse response of a room.
+
+PRIVATE void buildImpulse(std::vector<float> & ir, uint32_t seed)
+{
+  ir.resize(CHECK_IR_LENGTH);
+
+  for (int i = 0; i < CHECK_IR_LENGTH; i++) {
+    ir[i] = nextRandom(seed) * expf(-3.0f * i / CHECK_IR_LENGTH);
+  }
+}
+
+//---- buildSignal() ----
+
+PRIVATE void buildSignal(checkSignal signal, std::vector<float> & left, std::vector<float> & right)
+{
+  int      length = CHECK_BUFFER_COUNT * BUFFER_FRAME_COUNT;
+  uint32_t seed   = 12345;
+
+  left.assign(length, 0.0f);
+  right.assign(length, 0.0f);
+
+  if (signal == IMPULSE) {
+    left [BUFFER_FRAME_COUNT / 2] = 0.5f;
+    right[BUFFER_FRAME_COUNT / 2] = 0.5f;
+  }
+  else {
+    for (int i = 0; i < CHECK_INPUT_BUFFERS * BUFFER_FRAME_COUNT; i++) {
+      left [i] = 0.5f * nextRandom(seed);
+      right[i] = 0.5f * nextRandom(seed);
+    }
+  }
+}
+
+//---- convolve() ----
+//
+// The reference. The impulse response is normalized the way the reverb
+// does it: unit energy on its strongest channel, times the output gain.
+
+PRIVATE void convolve(const std::vector<float> & in,
+                      const std::vector<float> & ir,
+                      double                     scale,
+                      std::vector<double>      & out)
+{
+  out.assign(in.size(), 0.0);
+
+  for (size_t t = 0; t < in.size(); t++) {
+    double sum = 0.0;
+    for (size_t k = 0; (k < ir.size()) && (k <= t); k++) sum += (double) in[t - k] * ir[k];
+    out[t] = sum * scale;
+  }
+}
+
+//---- check() ----
+
+PRIVATE bool check(checkSignal                signal,
+                   const std::vector<float> & irLeft,
+                   const std::vector<float> & irRight)
+{
+  std::vector<float>  inLeft, inRight;
+  std::vector<double> refLeft, refRight;
+
+  buildSignal(signal, inLeft, inRight);
+
+  double energy[2] = { 0.0, 0.0 };
+  for (int i = 0; i < CHECK_IR_LENGTH; i++) {
+    energy[0] += (double) irLeft[i]  * irLeft[i];
+    energy[1] += (double) irRight[i] * irRight[i];
+  }
+  double scale = CONV_OUTPUT_GAIN / sqrt(MAX(energy[0], energy[1]));
+
+  convolve(inLeft,  irLeft,  scale, refLeft);
+  convolve(inRight, irRight, scale, refRight);
+
+  std::vector<float> left(irLeft), right(irRight);
+  ConvolutionReverb * conv = new ConvolutionReverb(left, right);
+
+  metrics.clear();
+
+  frameRecord send, buff;
+  double      peak     = 0.0;
+  double      maxError = 0.0;
+
+  for (int b = 0; b < CHECK_BUFFER_COUNT; b++) {
+    for (int fr = 0; fr < BUFFER_FRAME_COUNT; fr++) {
+      send[fr].left  = inLeft [b * BUFFER_FRAME_COUNT + fr];
+      send[fr].right = inRight[b * BUFFER_FRAME_COUNT + fr];
+      buff[fr].left  = buff[fr].right = 0.0f;
+    }
+
+    conv->process(buff, &send);
+    while (!conv->isWorkerIdle()) sched_yield();
+
+    for (int fr = 0; fr < BUFFER_FRAME_COUNT; fr++) {
+      int t = b * BUFFER_FRAME_COUNT + fr;
+
+      peak     = MAX(peak, MAX(fabs(refLeft[t]), fabs(refRight[t])));
+      maxError = MAX(maxError, MAX(fabs(buff[fr].left  - refLeft[t]),
+                                   fabs(buff[fr].right - refRight[t])));
+    }
+  }
+
+  delete conv;
+
+  double   error     = (peak > 0.0) ? (maxError / peak) : maxError;
+  uint32_t lateTails = metrics.getLateReverbTails();
+  bool     passed    = (error <= CHECK_MAX_ERROR) && (lateTails == 0);
+
+  printf("%s,%s,%d,%.3g,%u,%s\n",
+         BENCH_REVISION, signalNames[signal], CHECK_BUFFER_COUNT, error, lateTails,
+         passed ? "pass" : "fail");
+  fflush(stdout);
+
+  return passed;
+}
+
+//---- main() ----
+
+int main()
+{
+  Scheduling::flushDenormals();  // As the audio thread, see main.cpp
+
+  keepRunning         = true;
+  config.silent       = true;
+  config.samplingRate = 44100;
+  config.reverbDryWet = 0.0f;    // Wet signal only
+  config.reverbWidth  = 1.0f;    // No mix of the channels
+
+  std::vector<float> irLeft, irRight;
+
+  buildImpulse(irLeft,  1);
+  buildImpulse(irRight, 2);
+
+  bool failed = false;
+
+  printf("revision,signal,buffers,max_error,late_tails,result\n");
+
+  for (int s = 0; s < CHECK_SIGNAL_COUNT; s++) {
+    if (!check((checkSignal) s, irLeft, irRight)) failed = true;
+  }
+
+  return failed ? 1 : 0;
+}
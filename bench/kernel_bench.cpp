@@ -0,0 +1,887 @@
+// Notice
+// ------
+//
+// This file is part of the Mezzo SoundFont2 Sampling Based Synthesizer:
+//
+//     https://github.com/turgu1/mezzo
+//
+// Simplified BSD License
+// ----------------------
+//
+// Copyright (c) 2018, Guy Turcotte
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// The views and conclusions contained in the software and documentation are those
+// of the authors and should not be interpreted as representing official policies,
+// either expressed or implied, of the FreeBSD Project.
+//
+
+// DSP kernels micro-benchmark
+// ---------------------------
+//
+// Times the vectorized routines of the engine: Synthesizer::toStereoAndMix
+// (through transformAndMix), Synthesizer::applyEnvelopeAndGain,
+// Envelope::getAmplitudes, Utils::clip, Utils::shortToFloatNormalize,
+// Reverb::process (FreeVerb and FDN engines) and Equalizer::process.
+// The kernels of simd.h are also timed directly, for every backend
+// available on the processor (named kernel_backend, e.g. clip_avx2).
+//
+// The SIMD path of these routines is selected at compile time through
+// USE_NEON_INTRINSICS. The Makefile builds this benchmark twice: with
+// USE_NEON_INTRINSICS=0 (mezzo_kernel_bench_scalar, all objects compiled
+// in scalar mode) and normally (mezzo_kernel_bench, NEON on ARM, NEON
+// translated to SSE by neon_2_sse.h on x86). The scalar run writes the
+// output of every kernel for a deterministic input in a reference file
+// (-w). The SIMD run compares its own output to it (-c) and fails if the
+// difference is above KERNEL_TOLERANCE. The engine routines use the
+// automatic SIMD backend (the scalar one in the scalar build), and every
+// backend of a simd.h kernel is compared to its scalar backend output.
+//
+// Each kernel is run for KERNEL_WARMUP_CALLS calls, then timed by batches
+// of KERNEL_BATCH_CALLS calls, its state being reset between batches, until
+// KERNEL_MIN_TIME nanoseconds have been measured. Kernels working in place
+// are given back their input before each call; the copy is part of the
+// time of both variants. One CSV line is written per kernel and block size:
+//
+//   revision             Source revision the benchmark was built from
+//   variant              scalar, neon or neon_2_sse
+//   kernel, block        Kernel name and samples (frames) per call
+//   ns_per_call
+//   ns_per_sample
+//   ticks_per_sample     Time stamp counter ticks on x86, 0 elsewhere
+//   max_error            Largest difference with the reference output,
+//                        empty when not compared
+//
+// Usage: mezzo_kernel_bench [-n] [-w reference | -c reference]
+//
+//   -n  Do not write the CSV header line
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+#include <map>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+  #include <x86intrin.h>
+  #define readTicks() __rdtsc()
+#else
+  #define readTicks() 0ULL
+#endif
+
+#include "mezzo.h"
+
+#ifndef BENCH_REVISION
+  #define BENCH_REVISION "unknown"
+#endif
+
+#if !USE_NEON_INTRINSICS
+  #define KERNEL_VARIANT "scalar"
+#elif __ARM_FEATURE_DSP
+  #define KERNEL_VARIANT "neon"
+#else
+  #define KERNEL_VARIANT "neon_2_sse"
+#endif
+
+#define KERNEL_WARMUP_CALLS   1000
+#define KERNEL_BATCH_CALLS    1000
+#define KERNEL_MIN_TIME   50000000L  ///< nsec of measurement per kernel and block size
+#define KERNEL_CHECK_CALLS       4   ///< Consecutive calls of the correctness check
+#define KERNEL_TOLERANCE      1e-4f
+#define KERNEL_LONG_BLOCK    65536
+
+/// Deterministic pseudo random values between -1.0 and 1.0
+PRIVATE float noise(uint32_t & seed)
+{
+  seed = (seed * 1664525) + 1013904223;
+  return ((int32_t) seed) / 2147483648.0f;
+}
+
+PRIVATE void fillFrames(frameRecord & buff, uint32_t seed, float level)
+{
+  for (auto & frame : buff) {
+    frame.left  = noise(seed) * level;
+    frame.right = noise(seed) * level;
+  }
+}
+
+//---- Kernel ----
+//
+// setup() prepares the state and the input of a batch of calls. run()
+// does one call. output() appends the result of the last call.
+
+class Kernel {
+ protected:
+  int block;
+
+ public:
+  virtual ~Kernel() { }
+
+  virtual const char * getName() = 0;
+  virtual std::string  getKey() { return getName(); }  ///< Name in the reference file
+  virtual bool         isReference() { return true; }  ///< Its output goes to the reference file
+  virtual std::vector<int> getBlocks() { return { 32, 64, 128, BUFFER_SAMPLE_COUNT }; }
+
+  virtual void setup(int blk) { block = blk; }
+  virtual void run() = 0;
+  virtual void output(std::vector<float> & out) = 0;
+};
+
+//---- Synthesizer kernels ----
+//
+// The synthesizer is prepared once from a generated sample, with a long
+// volume envelope decay. setup() starts again from this state.
+
+class SynthKernel : public Kernel {
+ protected:
+  static Synthesizer * proto;
+  Synthesizer synth;
+  sampleRecord src, input;
+
+ public:
+  SynthKernel()
+  {
+    if (proto == NULL) {
+      static int16_t data[1024] = { 0 };
+      sfSample info;
+
+      memset(&info, 0, sizeof(info));
+      strcpy(info.achSampleName, "Kernel");
+      info.dwEnd           = 1024;
+      info.dwSampleRate    = 44100;
+      info.byOriginalPitch = 60;
+      info.sfSampleType    = monoSample;
+
+      static Sample sample(info, data);
+      static sfGenList gens[4];
+
+      gens[0].sfGenOper = sfGenOper_attackVolEnv;  gens[0].genAmount.shAmount = -12000;
+      gens[1].sfGenOper = sfGenOper_decayVolEnv;   gens[1].genAmount.shAmount =   8000;
+      gens[2].sfGenOper = sfGenOper_sustainVolEnv; gens[2].genAmount.shAmount =   1440;
+      gens[3].sfGenOper = sfGenOper_pan;           gens[3].genAmount.shAmount =    150;
+
+      proto = new Synthesizer;
+      proto->setDefaults(&sample);
+      proto->initGens(gens, 4);
+      proto->completeParams(60);
+    }
+  }
+
+  void setup(int blk)
+  {
+    Kernel::setup(blk);
+    synth = *proto;
+
+    uint32_t seed = 1;
+    for (auto & s : input) s = noise(seed) * 0.5f;
+    src = input;
+  }
+};
+
+Synthesizer * SynthKernel::proto = NULL;
+
+class ToStereoAndMix : public SynthKernel {
+  frameRecord dst;
+
+ public:
+  const char * getName() { return "toStereoAndMix"; }
+
+  void setup(int blk) { SynthKernel::setup(blk); fillFrames(dst, 2, 0.1f); }
+  void run()          { synth.transformAndMix(dst, NULL, NULL, src, block); }
+  void output(std::vector<float> & out)
+  {
+    out.insert(out.end(), &dst[0].left, &dst[0].left + (2 * block));
+  }
+};
+
+class ApplyEnvelopeAndGain : public SynthKernel {
+ public:
+  const char * getName() { return "applyEnvelopeAndGain"; }
+
+  void run()
+  {
+    memcpy(&src[0], &input[0], block * sizeof(sample_t));
+    synth.applyEnvelopeAndGain(src, block, 0.8f);
+  }
+  void output(std::vector<float> & out) { out.insert(out.end(), &src[0], &src[block]); }
+};
+
+class GetAmplitudes : public SynthKernel {
+  sampleRecord amps;
+
+ public:
+  const char * getName() { return "getAmplitudes"; }
+
+  void run()    { synth.getVolEnvelope()->getAmplitudes(amps, block); }
+  void output(std::vector<float> & out) { out.insert(out.end(), &amps[0], &amps[block]); }
+};
+
+//---- Utils kernels ----
+
+class Clip : public Kernel {
+  frameRecord   buff;
+  float         dst[2 * BUFFER_FRAME_COUNT];
+
+ public:
+  const char * getName() { return "clip"; }
+  std::vector<int> getBlocks() { return { BUFFER_FRAME_COUNT }; }
+
+  void setup(int blk) { Kernel::setup(blk); fillFrames(buff, 3, 1.5f); }
+  void run()          { Utils::clip(dst, buff); }
+  void output(std::vector<float> & out) { out.insert(out.end(), dst, dst + (2 * BUFFER_FRAME_COUNT)); }
+};
+
+class ShortToFloatNormalize : public Kernel {
+  std::vector<int16_t> src;
+  std::vector<float>   dst;
+
+ public:
+  const char * getName() { return "shortToFloatNormalize"; }
+  std::vector<int> getBlocks() { return { BUFFER_SAMPLE_COUNT, 4096, KERNEL_LONG_BLOCK }; }
+
+  void setup(int blk)
+  {
+    Kernel::setup(blk);
+
+    uint32_t seed = 4;
+    src.resize(blk + 4);
+    dst.resize(blk + 4);
+    for (auto & s : src) s = noise(seed) * 32767.0f;
+  }
+  void run() { Utils::shortToFloatNormalize(&dst[0], &src[0], block); }
+  void output(std::vector<float> & out) { out.insert(out.end(), dst.begin(), dst.begin() + block); }
+};
+
+//---- Effects kernels ----
+
+class ReverbProcess : public Kernel {
+  const char * engine;
+  std::string  name;
+  Reverb     * reverb;
+  frameRecord  buff, input, send;
+
+ public:
+  ReverbProcess(const char * eng) : engine(eng), name(std::string("reverb_") + eng), reverb(NULL) { }
+ ~ReverbProcess() { if (reverb) delete reverb; }
+
+  const char * getName() { return name.c_str(); }
+  std::vector<int> getBlocks() { return { BUFFER_FRAME_COUNT }; }
+
+  void setup(int blk)
+  {
+    Kernel::setup(blk);
+
+    if (reverb) delete reverb;
+    reverb = Reverb::create(engine);
+
+    fillFrames(input, 5, 0.5f);
+    fillFrames(send,  6, 0.2f);
+  }
+  void run()
+  {
+    buff = input;
+    reverb->process(buff, &send);
+  }
+  void output(std::vector<float> & out) { out.insert(out.end(), &buff[0].left, &buff[0].left + (2 * BUFFER_FRAME_COUNT)); }
+};
+
+class EqualizerProcess : public Kernel {
+  Equalizer  * equalizer;
+  frameRecord  buff, input;
+
+ public:
+  EqualizerProcess() : equalizer(NULL) { }
+ ~EqualizerProcess() { if (equalizer) delete equalizer; }
+
+  const char * getName() { return "equalizer"; }
+  std::vector<int> getBlocks() { return { BUFFER_FRAME_COUNT }; }
+
+  void setup(int blk)
+  {
+    Kernel::setup(blk);
+
+    if (equalizer) delete equalizer;
+    equalizer = new Equalizer();
+
+    fillFrames(input, 7, 0.5f);
+  }
+  void run()
+  {
+    buff = input;
+    equalizer->process(buff);
+  }
+  void output(std::vector<float> & out) { out.insert(out.end(), &buff[0].left, &buff[0].left + (2 * BUFFER_FRAME_COUNT)); }
+};
+
+//---- SIMD backend kernels ----
+
+class SimdKernel : public Kernel {
+ protected:
+  const SimdKernels * backend;
+  std::string         kernel, name;
+  float               dst[2 * BUFFER_SAMPLE_COUNT];
+  float               src[2 * BUFFER_SAMPLE_COUNT];
+  float               input[2 * BUFFER_SAMPLE_COUNT];
+
+ public:
+  SimdKernel(const SimdKernels * b, const char * k) :
+    backend(b), kernel(k), name(std::string(k) + "_" + b->name) { }
+
+  const char * getName() { return name.c_str(); }
+  std::string  getKey()  { return "simd_" + kernel; }
+  bool isReference()     { return strcmp(backend->name, "scalar") == 0; }
+
+  // An odd block size to go through the tail of the vector loops
+  std::vector<int> getBlocks() { return { 31, 64, 128, BUFFER_SAMPLE_COUNT }; }
+
+  void setup(int blk)
+  {
+    Kernel::setup(blk);
+
+    uint32_t seed = 8;
+    for (int i = 0; i < (2 * BUFFER_SAMPLE_COUNT); i++) {
+      src[i]   = noise(seed) * 1.5f;
+      input[i] = noise(seed) * 0.5f;
+      dst[i]   = input[i];
+    }
+  }
+};
+
+class SimdMixToStereo : public SimdKernel {
+ public:
+  SimdMixToStereo(const SimdKernels * b) : SimdKernel(b, "mixToStereo") { }
+
+  void run() { backend->mixToStereo(dst, src, block, 0.6f, 0.4f); }
+  void output(std::vector<float> & out) { out.insert(out.end(), dst, dst + (2 * block)); }
+};
+
+class SimdMultiplyScaled : public SimdKernel {
+ public:
+  SimdMultiplyScaled(const SimdKernels * b) : SimdKernel(b, "multiplyScaled") { }
+
+  void run()
+  {
+    memcpy(dst, input, block * sizeof(float));
+    backend->multiplyScaled(dst, src, 0.8f, block);
+  }
+  void output(std::vector<float> & out) { out.insert(out.end(), dst, dst + block); }
+};
+
+class SimdClip : public SimdKernel {
+ public:
+  SimdClip(const SimdKernels * b) : SimdKernel(b, "clip") { }
+
+  void run() { backend->clip(dst, src, 2 * block); }
+  void output(std::vector<float> & out) { out.insert(out.end(), dst, dst + (2 * block)); }
+};
+
+class SimdMixDryWet : public SimdKernel {
+  float peak;
+
+ public:
+  SimdMixDryWet(const SimdKernels * b) : SimdKernel(b, "mixDryWet"), peak(0.0f) { }
+
+  void run()
+  {
+    memcpy(dst, input, 2 * block * sizeof(float));
+    peak = backend->mixDryWet(dst, src, 2 * block, 0.7f, 0.3f);
+  }
+  void output(std::vector<float> & out)
+  {
+    out.insert(out.end(), dst, dst + (2 * block));
+    out.push_back(peak);
+  }
+};
+
+// The lanes kernels work on multiples of 4 samples
+
+class SimdFilterBank : public SimdKernel {
+  SimdBankLanes lanes;
+  float         voices[SIMD_BANK_LANES][BUFFER_SAMPLE_COUNT];
+  float         amps[SIMD_BANK_LANES][BUFFER_SAMPLE_COUNT];
+  float         gains[SIMD_BANK_LANES];
+
+ public:
+  SimdFilterBank(const SimdKernels * b) : SimdKernel(b, "filterBank") { }
+
+  std::vector<int> getBlocks() { return { 32, 64, 128, BUFFER_SAMPLE_COUNT }; }
+
+  void setup(int blk)
+  {
+    SimdKernel::setup(blk);
+
+    for (int l = 0; l < SIMD_BANK_LANES; l++) {
+      lanes.b0[l] = 0.02f + (0.01f * l);
+      lanes.a1[l] = -1.6f + (0.1f * l);
+      lanes.a2[l] = 0.7f;
+      lanes.x1[l] = lanes.x2[l] = lanes.y1[l] = lanes.y2[l] = 0.0f;
+      gains[l]    = 0.8f - (0.2f * l);
+
+      memcpy(amps[l], &input[l * 64], BUFFER_SAMPLE_COUNT * sizeof(float));
+    }
+  }
+  void run()
+  {
+    float       * ptrs[SIMD_BANK_LANES];
+    const float * amp[SIMD_BANK_LANES];
+
+    for (int l = 0; l < SIMD_BANK_LANES; l++) {
+      memcpy(voices[l], &src[l * 64], block * sizeof(float));
+      ptrs[l] = voices[l];
+      amp[l]  = amps[l];
+    }
+    backend->filterBank(lanes, ptrs, amp, gains, 0, block);
+  }
+  void output(std::vector<float> & out)
+  {
+    for (int l = 0; l < SIMD_BANK_LANES; l++) out.insert(out.end(), voices[l], voices[l] + block);
+  }
+};
+
+class SimdFilterCascade : public SimdKernel {
+  SimdCascade      coefs;
+  SimdCascadeState state;
+
+ public:
+  SimdFilterCascade(const SimdKernels * b) : SimdKernel(b, "filterCascade") { }
+
+  void setup(int blk)
+  {
+    SimdKernel::setup(blk);
+
+    for (int j = 0; j < SIMD_CASCADE_LANES; j++) {
+      coefs.b0[j] = (j <= SIMD_CASCADE_OUTPUT) ? 0.9f + (0.02f * j) : 1.0f;
+      coefs.b1[j] = coefs.a1[j] = (j <= SIMD_CASCADE_OUTPUT) ? -1.6f + (0.05f * j) : 0.0f;
+      coefs.b2[j] = (j <= SIMD_CASCADE_OUTPUT) ? 0.7f : 0.0f;
+      coefs.a2[j] = (j <= SIMD_CASCADE_OUTPUT) ? 0.65f : 0.0f;
+    }
+    memset(&state, 0, sizeof(state));
+  }
+  void run()
+  {
+    memcpy(dst, input, 2 * block * sizeof(float));
+    backend->filterCascade(dst,     block, 2, coefs, state);
+    backend->filterCascade(dst + 1, block, 2, coefs, state);
+  }
+  void output(std::vector<float> & out) { out.insert(out.end(), dst, dst + (2 * block)); }
+};
+
+class SimdFilterRows : public SimdKernel {
+  float rows[8][BUFFER_SAMPLE_COUNT];
+  float state[8];
+  float gains[8];
+
+ public:
+  SimdFilterRows(const SimdKernels * b) : SimdKernel(b, "filterRows") { }
+
+  std::vector<int> getBlocks() { return { 32, 64, 128, BUFFER_SAMPLE_COUNT }; }
+
+  void setup(int blk)
+  {
+    SimdKernel::setup(blk);
+
+    for (int r = 0; r < 8; r++) {
+      state[r] = 0.0f;
+      gains[r] = 0.3f + (0.08f * r);
+    }
+  }
+  void run()
+  {
+    float * ptrs[8];
+
+    for (int r = 0; r < 8; r++) {
+      memcpy(rows[r], &src[r * 32], block * sizeof(float));
+      ptrs[r] = rows[r];
+    }
+
+    // With a common input for the first rows, without for the last ones
+
+    backend->filterRows(ptrs,     4, state,     gains,     input, 0.6f, 0.35f, block);
+    backend->filterRows(ptrs + 4, 4, state + 4, gains + 4, NULL,  0.6f, 0.35f, block);
+  }
+  void output(std::vector<float> & out)
+  {
+    for (int r = 0; r < 8; r++) out.insert(out.end(), rows[r], rows[r] + block);
+  }
+};
+
+class SimdAllpass : public SimdKernel {
+  float line[BUFFER_SAMPLE_COUNT];
+
+ public:
+  SimdAllpass(const SimdKernels * b) : SimdKernel(b, "allpass") { }
+
+  void setup(int blk)
+  {
+    SimdKernel::setup(blk);
+    memset(line, 0, sizeof(line));
+  }
+  void run()
+  {
+    memcpy(dst, src, block * sizeof(float));
+    backend->allpass(dst, line, block, 0.5f, 1.5f, 1.0f);
+  }
+  void output(std::vector<float> & out) { out.insert(out.end(), dst, dst + block); }
+};
+
+class SimdSumRows : public SimdKernel {
+ public:
+  SimdSumRows(const SimdKernels * b) : SimdKernel(b, "sumRows") { }
+
+  void run()
+  {
+    const float * rows[8];
+
+    for (int r = 0; r < 8; r++) rows[r] = &src[r * 32];
+    backend->sumRows(dst, rows, 8, block);
+  }
+  void output(std::vector<float> & out) { out.insert(out.end(), dst, dst + block); }
+};
+
+class SimdHadamard8 : public SimdKernel {
+  float rows[8][BUFFER_SAMPLE_COUNT];
+
+ public:
+  SimdHadamard8(const SimdKernels * b) : SimdKernel(b, "hadamard8") { }
+
+  void run()
+  {
+    float * ptrs[8];
+
+    for (int r = 0; r < 8; r++) {
+      memcpy(rows[r], &src[r * 32], block * sizeof(float));
+      ptrs[r] = rows[r];
+    }
+    backend->hadamard8(ptrs, input, input + BUFFER_SAMPLE_COUNT, dst, dst + BUFFER_SAMPLE_COUNT, block);
+  }
+  void output(std::vector<float> & out)
+  {
+    out.insert(out.end(), dst, dst + block);
+    out.insert(out.end(), dst + BUFFER_SAMPLE_COUNT, dst + BUFFER_SAMPLE_COUNT + block);
+    for (int r = 0; r < 8; r++) out.insert(out.end(), rows[r], rows[r] + block);
+  }
+};
+
+class SimdMixWidth : public SimdKernel {
+ public:
+  SimdMixWidth(const SimdKernels * b) : SimdKernel(b, "mixWidth") { }
+
+  void run() { backend->mixWidth(dst, src, input, block, 0.7f, 0.3f); }
+  void output(std::vector<float> & out) { out.insert(out.end(), dst, dst + (2 * block)); }
+};
+
+class SimdDeinterleave : public SimdKernel {
+ public:
+  SimdDeinterleave(const SimdKernels * b) : SimdKernel(b, "deinterleave") { }
+
+  void run() { backend->deinterleave(dst, dst + BUFFER_SAMPLE_COUNT, src, block, 0.5f); }
+  void output(std::vector<float> & out)
+  {
+    out.insert(out.end(), dst, dst + block);
+    out.insert(out.end(), dst + BUFFER_SAMPLE_COUNT, dst + BUFFER_SAMPLE_COUNT + block);
+  }
+};
+
+class SimdComplexMultiplyAdd : public SimdKernel {
+ public:
+  SimdComplexMultiplyAdd(const SimdKernels * b) : SimdKernel(b, "complexMultiplyAdd") { }
+
+  void run()
+  {
+    memcpy(dst, input, 2 * block * sizeof(float));
+    backend->complexMultiplyAdd(dst, dst + BUFFER_SAMPLE_COUNT, src, src + BUFFER_SAMPLE_COUNT,
+                                input, input + BUFFER_SAMPLE_COUNT, block);
+  }
+  void output(std::vector<float> & out)
+  {
+    out.insert(out.end(), dst, dst + block);
+    out.insert(out.end(), dst + BUFFER_SAMPLE_COUNT, dst + BUFFER_SAMPLE_COUNT + block);
+  }
+};
+
+// A whole Stockham transform of the block size, with the stages of FFT:
+// the first radix 4 stage, the others along the sub-transforms, and the
+// radix 2 stage of the sizes that are not powers of 4. The output is
+// normalized to stay within the tolerance.
+
+class SimdFft : public SimdKernel {
+  struct stage {
+    int n, s;
+    std::vector<float> w;
+  };
+
+  std::vector<stage> stages;
+  float re[2][2 * BUFFER_SAMPLE_COUNT];
+  float im[2][2 * BUFFER_SAMPLE_COUNT];
+  int   result;
+
+ public:
+  SimdFft(const SimdKernels * b) : SimdKernel(b, "fft"), result(0) { }
+
+  std::vector<int> getBlocks() { return { 64, 128, BUFFER_SAMPLE_COUNT, 2 * BUFFER_SAMPLE_COUNT }; }
+
+  void setup(int blk)
+  {
+    SimdKernel::setup(blk);
+
+    stages.clear();
+    for (int n = blk, s = 1; n > 1; ) {
+      stage st = { n, s, std::vector<float>() };
+
+      if (n >= 4) {
+        int m = n / 4;
+
+        st.w.resize(6 * m);
+        for (int p = 0; p < m; p++) {
+          for (int k = 1; k <= 3; k++) {
+            double theta = -2.0 * M_PI * k * p / n;
+            st.w[(2 * (k - 1)    ) * m + p] = cos(theta);
+            st.w[(2 * (k - 1) + 1) * m + p] = sin(theta);
+          }
+        }
+        n /= 4; s *= 4;
+      }
+      else {
+        n /= 2; s *= 2;
+      }
+      stages.push_back(st);
+    }
+  }
+  void run()
+  {
+    memcpy(re[0], src,   block * sizeof(float));
+    memcpy(im[0], input, block * sizeof(float));
+
+    int x = 0;
+    for (auto & st : stages) {
+      if (st.n >= 4) backend->fftRadix4(st.n, st.s, &st.w[0], re[x], im[x], re[1 - x], im[1 - x]);
+      else           backend->fftRadix2(st.s, re[x], im[x], re[1 - x], im[1 - x]);
+      x = 1 - x;
+    }
+    result = x;
+  }
+  void output(std::vector<float> & out)
+  {
+    for (int i = 0; i < block; i++) out.push_back(re[result][i] / block);
+    for (int i = 0; i < block; i++) out.push_back(im[result][i] / block);
+  }
+};
+
+//---- Reference file ----
+//
+// A sequence of records: key length, key (kernel:block), value count and
+// values.
+
+typedef std::map<std::string, std::vector<float>> referenceMap;
+
+PRIVATE bool readReference(const char * filename, referenceMap & refs)
+{
+  FILE * f = fopen(filename, "rb");
+  if (f == NULL) return false;
+
+  uint32_t len;
+  while (fread(&len, sizeof(len), 1, f) == 1) {
+    std::string key(len, ' ');
+    uint32_t    count;
+    if ((fread(&key[0], 1, len, f) != len) || (fread(&count, sizeof(count), 1, f) != 1)) break;
+
+    std::vector<float> & values = refs[key];
+    values.resize(count);
+    if (fread(&values[0], sizeof(float), count, f) != count) break;
+  }
+  fclose(f);
+
+  return true;
+}
+
+PRIVATE void writeReference(FILE * f, const std::string & key, std::vector<float> & values)
+{
+  uint32_t len   = key.size();
+  uint32_t count = values.size();
+
+  fwrite(&len,       sizeof(len),   1,     f);
+  fwrite(key.data(), 1,             len,   f);
+  fwrite(&count,     sizeof(count), 1,     f);
+  fwrite(&values[0], sizeof(float), count, f);
+}
+
+//---- measure() ----
+
+PRIVATE void measure(Kernel & kernel, int block, double & nsPerCall, double & ticksPerCall)
+{
+  kernel.setup(block);
+  for (int i = 0; i < KERNEL_WARMUP_CALLS; i++) kernel.run();
+
+  long     elapse = 0;
+  uint64_t ticks  = 0;
+  long     calls  = 0;
+
+  while (elapse < KERNEL_MIN_TIME) {
+    kernel.setup(block);
+
+    Duration duration;
+    uint64_t start = readTicks();
+
+    for (int i = 0; i < KERNEL_BATCH_CALLS; i++) kernel.run();
+
+    ticks  += readTicks() - start;
+    elapse += duration.getElapse();
+    calls  += KERNEL_BATCH_CALLS;
+  }
+
+  nsPerCall    = (double) elapse / calls;
+  ticksPerCall = (double) ticks  / calls;
+}
+
+//---- main() ----
+
+int main(int argc, char ** argv)
+{
+  const char * refWrite = NULL;
+  const char * refCheck = NULL;
+  bool         header   = true;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "nw:c:")) != -1) {
+    switch (opt) {
+      case 'n': header   = false;  break;
+      case 'w': refWrite = optarg; break;
+      case 'c': refCheck = optarg; break;
+      default:
+        fprintf(stderr, "Usage: %s [-n] [-w reference | -c reference]\n", argv[0]);
+        return 1;
+    }
+  }
+
+  keepRunning           = true;
+  config.silent         = true;
+  config.samplingRate   = 44100;
+  config.reverbRoomSize = 0.93f;
+  config.reverbDamping  = 0.2f;
+  config.reverbWidth    = 0.4f;
+  config.reverbDryWet   = 0.75f;
+  config.reverbApGain   = 0.5f;
+
+  config.equalizer_v60    =  0.5f;
+  config.equalizer_v150   =  0.2f;
+  config.equalizer_v400   = -0.3f;
+  config.equalizer_v1000  =  0.1f;
+  config.equalizer_v2400  = -0.2f;
+  config.equalizer_v6000  =  0.4f;
+  config.equalizer_v15000 = -0.5f;
+
+  referenceMap refs;
+  if ((refCheck != NULL) && !readReference(refCheck, refs)) {
+    fprintf(stderr, "Unable to read %s\n", refCheck);
+    return 1;
+  }
+
+  FILE * refFile = NULL;
+  if ((refWrite != NULL) && ((refFile = fopen(refWrite, "wb")) == NULL)) {
+    fprintf(stderr, "Unable to write %s\n", refWrite);
+    return 1;
+  }
+
+  std::vector<Kernel *> kernels = {
+    new ToStereoAndMix,
+    new ApplyEnvelopeAndGain,
+    new GetAmplitudes,
+    new Clip,
+    new ShortToFloatNormalize,
+    new ReverbProcess("freeverb"),
+    new ReverbProcess("fdn"),
+    new EqualizerProcess
+  };
+
+  for (const SimdKernels * const * backend = Simd::getAvailable(); *backend != NULL; backend++) {
+    kernels.push_back(new SimdMixToStereo(*backend));
+    kernels.push_back(new SimdMultiplyScaled(*backend));
+    kernels.push_back(new SimdClip(*backend));
+    kernels.push_back(new SimdMixDryWet(*backend));
+    kernels.push_back(new SimdFilterBank(*backend));
+    kernels.push_back(new SimdFilterCascade(*backend));
+    kernels.push_back(new SimdFilterRows(*backend));
+    kernels.push_back(new SimdAllpass(*backend));
+    kernels.push_back(new SimdSumRows(*backend));
+    kernels.push_back(new SimdHadamard8(*backend));
+    kernels.push_back(new SimdMixWidth(*backend));
+    kernels.push_back(new SimdDeinterleave(*backend));
+    kernels.push_back(new SimdComplexMultiplyAdd(*backend));
+    kernels.push_back(new SimdFft(*backend));
+  }
+
+  bool failed = false;
+
+  if (header) printf("revision,variant,kernel,block,ns_per_call,ns_per_sample,ticks_per_sample,max_error\n");
+
+  for (auto kernel : kernels) {
+    for (int block : kernel->getBlocks()) {
+
+      // Correctness first, from a fresh state
+
+      std::vector<float> values;
+      kernel->setup(block);
+      for (int i = 0; i < KERNEL_CHECK_CALLS; i++) {
+        kernel->run();
+        kernel->output(values);
+      }
+
+      std::string key = kernel->getKey() + ":" + std::to_string(block);
+      char error[32] = "";
+
+      if ((refFile != NULL) && kernel->isReference()) writeReference(refFile, key, values);
+
+      if (refCheck != NULL) {
+        referenceMap::iterator ref = refs.find(key);
+        float maxError = INFINITY;
+
+        if ((ref != refs.end()) && (ref->second.size() == values.size())) {
+          maxError = 0.0f;
+          for (unsigned i = 0; i < values.size(); i++) {
+            maxError = fmaxf(maxError, fabsf(values[i] - ref->second[i]));
+          }
+        }
+        if (!(maxError <= KERNEL_TOLERANCE)) {
+          fprintf(stderr, "%s:%d: output differs from the reference (%g)\n", kernel->getName(), block, maxError);
+          failed = true;
+        }
+        snprintf(error, sizeof(error), "%g", maxError);
+      }
+
+      double nsPerCall, ticksPerCall;
+      measure(*kernel, block, nsPerCall, ticksPerCall);
+
+      printf("%s,%s,%s,%d,%.3f,%.4f,%.4f,%s\n",
+             BENCH_REVISION, KERNEL_VARIANT, kernel->getName(), block,
+             nsPerCall, nsPerCall / block, ticksPerCall / block, error);
+      fflush(stdout);
+    }
+  }
+
+  if (refFile != NULL) fclose(refFile);
+
+  for (auto kernel : kernels) delete kernel;
+
+  return failed ? 1 : 0;
+}
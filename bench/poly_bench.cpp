@@ -0,0 +1,249 @@
+// Notice
+// ------
+//
+// This file is part of the Mezzo SoundFont2 Sampling Based Synthesizer:
+//
+//     https://github.com/turgu1/mezzo
+//
+// Simplified BSD License
+// ----------------------
+//
+// Copyright (c) 2018, Guy Turcotte
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// The views and conclusions contained in the software and documentation are those
+// of the authors and should not be interpreted as representing official policies,
+// either expressed or implied, of the FreeBSD Project.
+//
+
+// Synthetic polyphony benchmark
+// -----------------------------
+//
+// Drives Poly, Voice and Synthesizer the way the voice feeder threads and
+// the sound callback are doing, but on a single thread and without audio or
+// MIDI hardware. A sound font is generated in a temporary file: one sample
+// (a 441 Hz sawtooth with a loop) and one preset for each combination of the
+// loop, filter, vibrato and volume envelope features. The program number of
+// a preset is the bit mask of its features (benchFeature).
+//
+// For each feature combination, pitch ratio and voice count, the voices are
+// started on the same key, some buffers are rendered for warmup, then
+// <buffers> buffers are timed. One CSV line is written per measurement:
+//
+//   revision           Source revision the benchmark was built from
+//   voices, ratio      Active voices and resampling ratio
+//   loop, filter,
+//   vibrato, envelope  Features of the preset (0/1)
+//   kernel             Interpolation kernel of the resampler
+//   ns_per_voice_sample
+//                      Rendering and mixing time per voice and per sample
+//   buffer_us          Time to produce one buffer
+//   deadline_us        Time covered by one buffer at the sampling rate
+//   max_voices         Voices that would fit in the deadline on one core,
+//                      extrapolated from the measurement
+//
+// Usage: mezzo_poly_bench [-b buffers] [-v voices[,voices...]]
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <unistd.h>
+
+#include "mezzo.h"
+#include "sound_font_writer.h"
+
+#ifndef BENCH_REVISION
+  #define BENCH_REVISION "unknown"
+#endif
+
+#define BENCH_LOOP_START       44100
+#define BENCH_LOOP_LENGTH  (100 * TEST_PERIOD)
+#define BENCH_WARMUP_BUFFERS      16
+#define BENCH_DEFAULT_BUFFERS    200
+
+enum benchFeature {
+  BENCH_LOOP          = 1,
+  BENCH_FILTER        = 2,
+  BENCH_VIBRATO       = 4,
+  BENCH_ENVELOPE      = 8,
+  BENCH_FEATURE_COUNT = 16      ///< Number of feature combinations
+};
+
+// The resampler has a single interpolation kernel. The column is kept in the
+// output such that the results remain comparable if others are added.
+
+PRIVATE const char * kernelName = "linear";
+
+/// Notes played relative to the root key of the sample, giving resampling
+/// ratios of 0.5, 1.0, 1.5 and 2.0
+PRIVATE const int noteOffsets[] = { -12, 0, 7, 12 };
+
+//---- buildSoundFont() ----
+//
+// The sample is long enough for a one shot voice to stay alive for the
+// whole measurement at the highest ratio.
+
+PRIVATE void buildSoundFont(SoundFontBuilder & builder, int bufferCount)
+{
+  int length = (BENCH_WARMUP_BUFFERS + bufferCount + 1) * BUFFER_FRAME_COUNT * 2;
+  if (length < (BENCH_LOOP_START + BENCH_LOOP_LENGTH)) length = BENCH_LOOP_START + BENCH_LOOP_LENGTH;
+
+  builder.setSawtooth(length, BENCH_LOOP_START, BENCH_LOOP_START + BENCH_LOOP_LENGTH);
+
+  for (int p = 0; p < BENCH_FEATURE_COUNT; p++) {
+    std::string igen;
+    char        name[20];
+
+    addGen(igen, sfGenOper_sampleModes, (p & BENCH_LOOP) ? 1 : 0);
+    if (p & BENCH_FILTER) {
+      addGen(igen, sfGenOper_initialFilterFc, 7000);
+      addGen(igen, sfGenOper_initialFilterQ,   120);
+    }
+    if (p & BENCH_VIBRATO) {
+      addGen(igen, sfGenOper_vibLfoToPitch, 50);
+      addGen(igen, sfGenOper_freqVibLFO,     0);
+    }
+    if (p & BENCH_ENVELOPE) {
+      addGen(igen, sfGenOper_attackVolEnv, -7973);  // 10 msec
+      addGen(igen, sfGenOper_decayVolEnv,      0);  //  1 sec
+      addGen(igen, sfGenOper_sustainVolEnv,  100);  // 10 dB
+      addGen(igen, sfGenOper_releaseVolEnv, -2400); // 250 msec
+    }
+
+    snprintf(name, sizeof(name), "Bench %d", p);
+    builder.addPreset(name, igen);
+  }
+}
+
+//---- renderBuffer() ----
+//
+// Same sequence as a voices feeder pass followed by the mix of the sound
+// callback.
+
+PRIVATE void renderBuffer(VoiceBank & bank)
+{
+  static frameRecord buff, reverbBuff, chorusBuff;
+
+  for (voicep v = poly->firstVoice(); v != NULL; v = poly->nextVoice(v)) poly->feedVoice(v, bank);
+  bank.process();
+
+  poly->mixer(buff, &reverbBuff, &chorusBuff);
+}
+
+//---- measure() ----
+
+PRIVATE void measure(int features, int noteOffset, int voiceCount, int bufferCount)
+{
+  Channel & channel = channels[0];
+  VoiceBank bank;
+
+  channel.programChange(features);
+
+  for (int i = 0; i < voiceCount; i++) channel.noteOn(TEST_ROOT_KEY + noteOffset, 127);
+
+  for (int b = 0; b < BENCH_WARMUP_BUFFERS; b++) renderBuffer(bank);
+
+  Duration duration;
+  for (int b = 0; b < bufferCount; b++) renderBuffer(bank);
+  long elapse = duration.getElapse();
+
+  int    voices   = poly->getVoiceCount();
+  double bufferNs = (double) elapse / bufferCount;
+  double deadline = 1e9 * BUFFER_FRAME_COUNT / config.samplingRate;
+
+  printf("%s,%d,%.3f,%d,%d,%d,%d,%s,%d,%.3f,%.3f,%.3f,%d\n",
+         BENCH_REVISION,
+         voices,
+         pow(2.0, noteOffset / 12.0),
+         (features & BENCH_LOOP)     ? 1 : 0,
+         (features & BENCH_FILTER)   ? 1 : 0,
+         (features & BENCH_VIBRATO)  ? 1 : 0,
+         (features & BENCH_ENVELOPE) ? 1 : 0,
+         kernelName,
+         bufferCount,
+         bufferNs / ((double) voiceCount * BUFFER_FRAME_COUNT),
+         bufferNs / 1000.0,
+         deadline / 1000.0,
+         (int) (voiceCount * deadline / bufferNs));
+  fflush(stdout);
+
+  poly->allSoundOff(channel);
+}
+
+//---- main() ----
+
+int main(int argc, char ** argv)
+{
+  int bufferCount = BENCH_DEFAULT_BUFFERS;
+  std::vector<int> voiceCounts;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "b:v:")) != -1) {
+    switch (opt) {
+      case 'b':
+        bufferCount = atoi(optarg);
+        break;
+      case 'v':
+        for (char * s = strtok(optarg, ","); s != NULL; s = strtok(NULL, ",")) {
+          int count = atoi(s);
+          if ((count > 0) && (count <= MAX_VOICES)) voiceCounts.push_back(count);
+        }
+        break;
+      default:
+        fprintf(stderr, "Usage: %s [-b buffers] [-v voices[,voices...]]\n", argv[0]);
+        return 1;
+    }
+  }
+
+  if (bufferCount <= 0) bufferCount = BENCH_DEFAULT_BUFFERS;
+  if (voiceCounts.empty()) voiceCounts = { 16, 64, 256 };
+
+  Scheduling::flushDenormals();  // As the audio thread, see main.cpp
+
+  SoundFontBuilder builder;
+  buildSoundFont(builder, bufferCount);
+
+  if (!loadSoundFont(builder, "mezzo_poly_bench")) return 1;
+
+  channels = new Channel[MIDI_CHANNEL_COUNT];
+  poly     = new Poly();
+
+  Midi::setupChannels();
+
+  printf("revision,voices,ratio,loop,filter,vibrato,envelope,kernel,buffers,"
+         "ns_per_voice_sample,buffer_us,deadline_us,max_voices\n");
+
+  for (int features = 0; features < BENCH_FEATURE_COUNT; features++) {
+    for (unsigned r = 0; r < sizeof(noteOffsets) / sizeof(noteOffsets[0]); r++) {
+      for (unsigned v = 0; v < voiceCounts.size(); v++) {
+        measure(features, noteOffsets[r], voiceCounts[v], bufferCount);
+      }
+    }
+  }
+
+  delete library;
+  delete poly;
+  delete [] channels;
+
+  return 0;
+}
@@ -0,0 +1,546 @@
+// Notice
+// ------
+//
+// This file is part of the Mezzo SoundFont2 Sampling Based Synthesizer:
+//
+//     https://github.com/turgu1/mezzo
+//
+// Simplified BSD License
+// ----------------------
+//
+// Copyright (c) 2018, Guy Turcotte
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// The views and conclusions contained in the software and documentation are those
+// of the authors and should not be interpreted as representing official policies,
+// either expressed or implied, of the FreeBSD Project.
+//
+
+// Render regression check
+// -----------------------
+//
+// Renders scripted note sequences through the complete chain (channels,
+// voices, mixer, chorus, reverb, equalizer and output clipping) and
+// compares the result with golden renderings kept in bench/golden. It
+// needs no audio or MIDI device: the events are applied to the channels
+// between buffers, the way the MIDI callback does, and the voices are fed
+// on the calling thread, the way the voice feeder threads do. Every
+// scenario starts from a fresh state, such that the result is the same
+// from one run to the other and does not depend on the scenarios order.
+//
+// The sound font is generated: a looped 441 Hz sawtooth, played by a
+// "keys" preset (short attack, sustain, reverb and chorus sends), a "pad"
+// preset (slow attack, modulated low-pass filter, vibrato, tremolo) and
+// "loop" presets, each with a loop of its own over the sample (more loops
+// than can be prepared for a sample, the last one ending after the
+// sample).
+//
+// The golden files are 16 bit stereo WAV files, one per scenario. A
+// rendering passes if all of the following are under their limit:
+//
+//   rms_error     RMS of the difference, full scale being 1.0
+//   peak_error    Largest difference of a single sample
+//   spectral_db   Largest difference of the magnitude spectra of a
+//                 Hann windowed analysis frame, relative to the golden
+//                 spectrum (dB). Silent frames are not considered.
+//
+// One CSV line is written per scenario. The exit status is 1 if a scenario
+// fails or has no golden file.
+//
+// Usage: mezzo_render_check [-o folder] (-w folder | -c folder)
+//
+//   -w  Write the golden files in the folder
+//   -c  Compare with the golden files of the folder
+//   -o  Also write the renderings in the folder, to listen to them
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+#include <unistd.h>
+
+#include "mezzo.h"
+#include "sound_font_writer.h"
+
+#ifndef BENCH_REVISION
+  #define BENCH_REVISION "unknown"
+#endif
+
+#define CHECK_LOOP_START        4400
+#define CHECK_LOOP_LENGTH  (100 * TEST_PERIOD)
+#define CHECK_LOOP_PRESETS      6     ///< More than MAX_SAMPLE_LOOPS, with the loop of the other presets
+
+#define CHECK_MAX_RMS_ERROR     1e-4  ///< -80 dBFS
+#define CHECK_MAX_PEAK_ERROR    1e-3  ///< -60 dBFS
+#define CHECK_MAX_SPECTRAL_DB  -40.0
+#define CHECK_FFT_SIZE          2048
+#define CHECK_SILENCE           1e-3  ///< RMS under which an analysis frame is not compared (-60 dBFS)
+
+enum checkPreset { KEYS = 0, PAD = 1, LOOPS = 2 };  ///< In the order they are added by buildSoundFont()
+
+//---- Scenarios ----
+
+enum eventType { NOTE_ON, NOTE_OFF, CONTROL, PITCH_BEND, PROGRAM };
+
+struct checkEvent {
+  int       buffer;   ///< Applied before the rendering of this buffer
+  eventType type;
+  uint8_t   channel;
+  int       data1;
+  int       data2;
+};
+
+struct checkScenario {
+  const char *            name;
+  int                     bufferCount;
+  std::vector<checkEvent> events;
+};
+
+PRIVATE std::vector<checkScenario> buildScenarios()
+{
+  std::vector<checkScenario> scenarios;
+
+  // Three chords, the next one starting as the previous one is released
+
+  checkScenario chords = { "chords", 160, { } };
+  const int chordNotes[3][3] = { { 60, 64, 67 }, { 65, 69, 72 }, { 67, 71, 74 } };
+  for (int c = 0; c < 3; c++) {
+    for (int n = 0; n < 3; n++) {
+      chords.events.push_back({ 40 * c,      NOTE_ON,  0, chordNotes[c][n], 80 + (10 * n) });
+      chords.events.push_back({ 40 * c + 40, NOTE_OFF, 0, chordNotes[c][n], 0 });
+    }
+  }
+  scenarios.push_back(chords);
+
+  // The same key struck again every 3 buffers (17 msec) with rising
+  // velocities, each note being retriggered before its release ends
+
+  checkScenario repeats = { "repeats", 120, { } };
+  for (int i = 0; i < 30; i++) {
+    repeats.events.push_back({ 3 * i,     NOTE_ON,  0, 72, 40 + (3 * i) });
+    repeats.events.push_back({ 3 * i + 2, NOTE_OFF, 0, 72, 0 });
+  }
+  scenarios.push_back(repeats);
+
+  // Notes released while the sustain pedal is down, sounding until it is
+  // lifted
+
+  checkScenario sustain = { "sustain", 150, {
+    {  0, CONTROL,  0, 64, 127 },
+    {  0, NOTE_ON,  0, 60, 100 },
+    {  5, NOTE_ON,  0, 64,  90 },
+    { 10, NOTE_ON,  0, 67,  80 },
+    { 20, NOTE_OFF, 0, 60,   0 },
+    { 20, NOTE_OFF, 0, 64,   0 },
+    { 20, NOTE_OFF, 0, 67,   0 },
+    { 90, CONTROL,  0, 64,   0 }
+  } };
+  scenarios.push_back(sustain);
+
+  // Pad notes held for many passes in the sample loop, with the
+  // modulation wheel moving
+
+  checkScenario loop = { "long_loop", 220, {
+    {   0, PROGRAM,  0, PAD,  0 },
+    {   0, NOTE_ON,  0, 57, 100 },
+    {   0, NOTE_ON,  0, 64, 100 },
+    {  60, CONTROL,  0,  1, 127 },
+    { 120, CONTROL,  0,  1,   0 },
+    { 180, NOTE_OFF, 0, 57,   0 },
+    { 180, NOTE_OFF, 0, 64,   0 }
+  } };
+  scenarios.push_back(loop);
+
+  // Lowest and highest piano keys, bent to both ends of the range, while
+  // a second channel plays panned to the left
+
+  checkScenario extremes = { "pitch_extremes", 150, {
+    {   0, NOTE_ON,    0,  21, 127 },
+    {   0, NOTE_ON,    0, 108, 127 },
+    {   0, PROGRAM,    1, PAD,   0 },
+    {   0, CONTROL,    1,  10,   0 },
+    {   0, NOTE_ON,    1,  45,  90 },
+    {  30, PITCH_BEND, 0,  8191, 0 },
+    {  60, PITCH_BEND, 0, -8192, 0 },
+    {  90, PITCH_BEND, 0,     0, 0 },
+    { 110, NOTE_OFF,   0,  21,   0 },
+    { 110, NOTE_OFF,   0, 108,   0 },
+    { 110, NOTE_OFF,   1,  45,   0 }
+  } };
+  scenarios.push_back(extremes);
+
+  // One note per loop preset, on its own channel, held for several passes
+  // in each loop
+
+  checkScenario loops = { "many_loops", 160, { } };
+  for (int i = 0; i < CHECK_LOOP_PRESETS; i++) {
+    loops.events.push_back({ 0, PROGRAM, (uint8_t) i, LOOPS + i, 0 });
+  }
+  for (int i = 0; i < CHECK_LOOP_PRESETS; i++) {
+    loops.events.push_back({ 2 * i, NOTE_ON, (uint8_t) i, 72 + (2 * i), 90 });
+  }
+  for (int i = 0; i < CHECK_LOOP_PRESETS; i++) {
+    loops.events.push_back({ 120, NOTE_OFF, (uint8_t) i, 72 + (2 * i), 0 });
+  }
+  scenarios.push_back(loops);
+
+  return scenarios;
+}
+
+//---- buildSoundFont() ----
+
+PRIVATE void buildSoundFont(SoundFontBuilder & builder)
+{
+  builder.setSawtooth(CHECK_LOOP_START + CHECK_LOOP_LENGTH + 1000,
+                      CHECK_LOOP_START,
+                      CHECK_LOOP_START + CHECK_LOOP_LENGTH);
+
+  std::string keys, pad;
+
+  addGen(keys, sfGenOper_sampleModes,          1);
+  addGen(keys, sfGenOper_attackVolEnv,     -7973);  // 10 msec
+  addGen(keys, sfGenOper_decayVolEnv,          0);  //  1 sec
+  addGen(keys, sfGenOper_sustainVolEnv,      100);  // 10 dB
+  addGen(keys, sfGenOper_releaseVolEnv,    -2400);  // 250 msec
+  addGen(keys, sfGenOper_reverbEffectsSend,  250);
+  addGen(keys, sfGenOper_chorusEffectsSend,  150);
+  builder.addPreset("Keys", keys);
+
+  addGen(pad, sfGenOper_sampleModes,           1);
+  addGen(pad, sfGenOper_attackVolEnv,      -1200);  // 500 msec
+  addGen(pad, sfGenOper_releaseVolEnv,     -1200);  // 500 msec
+  addGen(pad, sfGenOper_initialFilterFc,    6000);
+  addGen(pad, sfGenOper_initialFilterQ,       80);
+  addGen(pad, sfGenOper_attackModEnv,      -3600);  // 125 msec
+  addGen(pad, sfGenOper_decayModEnv,       -1200);  // 500 msec
+  addGen(pad, sfGenOper_sustainModEnv,       500);
+  addGen(pad, sfGenOper_modEnvToFilterFc,   2400);
+  addGen(pad, sfGenOper_vibLfoToPitch,        30);
+  addGen(pad, sfGenOper_freqVibLFO,            0);
+  addGen(pad, sfGenOper_modLfoToVolume,       20);
+  addGen(pad, sfGenOper_reverbEffectsSend,   400);
+  addGen(pad, sfGenOper_chorusEffectsSend,   500);
+  builder.addPreset("Pad", pad);
+
+  // Loops of 10 periods and more, moving by one period from a preset to
+  // the next. The last one is clamped at the end of the sample.
+
+  for (int i = 0; i < CHECK_LOOP_PRESETS; i++) {
+    std::string loop;
+    char        name[20];
+    int         start = i * TEST_PERIOD;
+    int         end   = (i < (CHECK_LOOP_PRESETS - 1)) ? start + ((10 + i) * TEST_PERIOD) - CHECK_LOOP_LENGTH :
+                                                         2000;
+
+    addGen(loop, sfGenOper_sampleModes,          1);
+    addGen(loop, sfGenOper_startloopAddrsOffset, start);
+    addGen(loop, sfGenOper_endloopAddrsOffset,   end);
+    addGen(loop, sfGenOper_attackVolEnv,     -7973);  // 10 msec
+    addGen(loop, sfGenOper_releaseVolEnv,    -2400);  // 250 msec
+    snprintf(name, sizeof(name), "Loop %d", i + 1);
+    builder.addPreset(name, loop);
+  }
+}
+
+//---- render() ----
+//
+// The channels, the voices and the effects are built again for each
+// scenario.
+
+PRIVATE void render(const checkScenario & scenario, std::vector<float> & out)
+{
+  channels  = new Channel[MIDI_CHANNEL_COUNT];
+  poly      = new Poly();
+  reverb    = Reverb::create(config.reverbEngine);
+  chorus    = new Chorus();
+  equalizer = new Equalizer();
+
+  Midi::setupChannels();
+
+  VoiceBank   bank;
+  frameRecord buff;
+  unsigned    next = 0;
+
+  out.resize(scenario.bufferCount * BUFFER_FRAME_COUNT * 2);
+
+  for (int b = 0; b < scenario.bufferCount; b++) {
+
+    for (; (next < scenario.events.size()) && (scenario.events[next].buffer <= b); next++) {
+      const checkEvent & event   = scenario.events[next];
+      Channel &          channel = channels[event.channel];
+
+      switch (event.type) {
+        case NOTE_ON:    channel.noteOn(event.data1, event.data2);     break;
+        case NOTE_OFF:   channel.noteOff(event.data1);                 break;
+        case CONTROL:    channel.setController(event.data1, event.data2); break;
+        case PITCH_BEND: channel.setPitchBend(event.data1);            break;
+        case PROGRAM:
+          poly->allSoundOff(channel);
+          channel.programChange(event.data1);
+          break;
+      }
+    }
+
+    for (voicep v = poly->firstVoice(); v != NULL; v = poly->nextVoice(v)) poly->feedVoice(v, bank);
+    bank.process();
+
+    Sound::mix(buff);
+    Utils::clip(&out[b * BUFFER_FRAME_COUNT * 2], buff);
+  }
+
+  delete equalizer;
+  delete chorus;
+  delete reverb;
+  delete poly;
+  delete [] channels;
+
+  equalizer = NULL; chorus = NULL; reverb = NULL; poly = NULL; channels = NULL;
+}
+
+//---- WAV files ----
+//
+// The renderings are compared once quantized the way the golden files
+// are stored, such that the 16 bit rounding does not count as an error.
+
+PRIVATE inline int16_t quantize(float value) { return lrintf(value * 32767.0f); }
+
+struct wavHeader {
+  char     riff[4];
+  uint32_t riffSize;
+  char     wave[4];
+  char     fmt[4];
+  uint32_t fmtSize;
+  uint16_t formatTag;
+  uint16_t channels;
+  uint32_t samplesPerSec;
+  uint32_t avgBytesPerSec;
+  uint16_t blockAlign;
+  uint16_t bitsPerSample;
+  char     data[4];
+  uint32_t dataSize;
+};
+
+PRIVATE bool writeWav(const std::string & filename, const std::vector<float> & samples)
+{
+  std::vector<int16_t> data(samples.size());
+  for (unsigned i = 0; i < samples.size(); i++) data[i] = quantize(samples[i]);
+
+  wavHeader header = {
+    { 'R', 'I', 'F', 'F' }, (uint32_t) (36 + (2 * data.size())), { 'W', 'A', 'V', 'E' },
+    { 'f', 'm', 't', ' ' }, 16, 1, 2, (uint32_t) config.samplingRate,
+    (uint32_t) (4 * config.samplingRate), 4, 16,
+    { 'd', 'a', 't', 'a' }, (uint32_t) (2 * data.size())
+  };
+
+  FILE * f = fopen(filename.c_str(), "wb");
+  if (f == NULL) return false;
+  bool ok = (fwrite(&header, sizeof(header), 1, f) == 1) &&
+            (fwrite(&data[0], sizeof(int16_t), data.size(), f) == data.size());
+  fclose(f);
+
+  return ok;
+}
+
+/// Only reads back the format written by writeWav()
+PRIVATE bool readWav(const std::string & filename, std::vector<float> & samples)
+{
+  FILE * f = fopen(filename.c_str(), "rb");
+  if (f == NULL) return false;
+
+  wavHeader header;
+  bool ok = (fread(&header, sizeof(header), 1, f) == 1) &&
+            (memcmp(header.riff, "RIFF", 4) == 0) &&
+            (memcmp(header.data, "data", 4) == 0) &&
+            (header.formatTag == 1) && (header.channels == 2) && (header.bitsPerSample == 16) &&
+            (header.samplesPerSec == (uint32_t) config.samplingRate);
+
+  if (ok) {
+    std::vector<int16_t> data(header.dataSize / 2);
+    ok = fread(&data[0], sizeof(int16_t), data.size(), f) == data.size();
+
+    samples.resize(data.size());
+    for (unsigned i = 0; i < data.size(); i++) samples[i] = data[i] / 32767.0f;
+  }
+  fclose(f);
+
+  return ok;
+}
+
+//---- spectralDifference() ----
+//
+// Frames of CHECK_FFT_SIZE frames, half overlapped, each channel being
+// analyzed separately. Returns the largest difference found, in dB.
+
+PRIVATE double spectralDifference(const std::vector<float> & out, const std::vector<float> & golden)
+{
+  static FFT fft(CHECK_FFT_SIZE);
+
+  std::vector<float> window(CHECK_FFT_SIZE);
+  for (int i = 0; i < CHECK_FFT_SIZE; i++) window[i] = 0.5f - 0.5f * cosf(2.0f * M_PI * i / CHECK_FFT_SIZE);
+
+  float  outRe[CHECK_FFT_SIZE], outIm[CHECK_FFT_SIZE];
+  float  refRe[CHECK_FFT_SIZE], refIm[CHECK_FFT_SIZE];
+  double result    = -INFINITY;
+  int    frameCount = out.size() / 2;
+
+  for (int start = 0; (start + CHECK_FFT_SIZE) <= frameCount; start += CHECK_FFT_SIZE / 2) {
+    for (int ch = 0; ch < 2; ch++) {
+      double energy = 0.0;
+
+      for (int i = 0; i < CHECK_FFT_SIZE; i++) {
+        float ref = golden[2 * (start + i) + ch];
+        energy  += ref * ref;
+        outRe[i] = out[2 * (start + i) + ch] * window[i];
+        refRe[i] = ref * window[i];
+        outIm[i] = refIm[i] = 0.0f;
+      }
+
+      if (sqrt(energy / CHECK_FFT_SIZE) < CHECK_SILENCE) continue;
+
+      fft.forward(outRe, outIm);
+      fft.forward(refRe, refIm);
+
+      double diff = 0.0, ref = 0.0;
+      for (int i = 0; i <= (CHECK_FFT_SIZE / 2); i++) {
+        double a = hypot(outRe[i], outIm[i]);
+        double b = hypot(refRe[i], refIm[i]);
+        diff += (a - b) * (a - b);
+        ref  += b * b;
+      }
+
+      double db = (diff > 0.0) ? 10.0 * log10(diff / ref) : -200.0;
+      if (db > result) result = db;
+    }
+  }
+
+  return (result == -INFINITY) ? -200.0 : result;
+}
+
+//---- main() ----
+
+int main(int argc, char ** argv)
+{
+  const char * writeFolder  = NULL;
+  const char * checkFolder  = NULL;
+  const char * outputFolder = NULL;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "w:c:o:")) != -1) {
+    switch (opt) {
+      case 'w': writeFolder  = optarg; break;
+      case 'c': checkFolder  = optarg; break;
+      case 'o': outputFolder = optarg; break;
+      default:
+        writeFolder = checkFolder = NULL;
+        break;
+    }
+  }
+
+  if ((writeFolder == NULL) == (checkFolder == NULL)) {
+    fprintf(stderr, "Usage: %s [-o folder] (-w folder | -c folder)\n", argv[0]);
+    return 1;
+  }
+
+  Scheduling::flushDenormals();  // As the audio thread, see main.cpp
+
+  SoundFontBuilder builder;
+  buildSoundFont(builder);
+
+  if (!loadSoundFont(builder, "mezzo_render_check")) return 1;
+
+  config.reverbEngine   = "freeverb";
+  config.reverbRoomSize = 0.93f;
+  config.reverbDamping  = 0.2f;
+  config.reverbWidth    = 0.4f;
+  config.reverbDryWet   = 0.75f;
+  config.reverbApGain   = 0.5f;
+
+  config.chorusLevel    = 0.5f;
+  config.chorusRate     = 0.1f;
+  config.chorusDepth    = 0.4f;
+  config.chorusFeedback = 0.0f;
+  config.chorusWidth    = 0.8f;
+
+  config.equalizer_v60    =  0.2f;
+  config.equalizer_v150   =  0.0f;
+  config.equalizer_v400   = -0.2f;
+  config.equalizer_v1000  =  0.0f;
+  config.equalizer_v2400  =  0.1f;
+  config.equalizer_v6000  =  0.0f;
+  config.equalizer_v15000 = -0.3f;
+
+  bool failed = false;
+
+  printf("revision,scenario,buffers,rms_error,peak_error,spectral_db,result\n");
+
+  for (auto & scenario : buildScenarios()) {
+    std::vector<float> out;
+    render(scenario, out);
+
+    std::string wav = std::string("/") + scenario.name + ".wav";
+
+    if ((outputFolder != NULL) && !writeWav(outputFolder + wav, out)) {
+      fprintf(stderr, "Unable to write %s%s\n", outputFolder, wav.c_str());
+    }
+
+    if (writeFolder != NULL) {
+      bool ok = writeWav(writeFolder + wav, out);
+      printf("%s,%s,%d,,,,%s\n", BENCH_REVISION, scenario.name, scenario.bufferCount, ok ? "written" : "write error");
+      if (!ok) failed = true;
+      continue;
+    }
+
+    for (auto & value : out) value = quantize(value) / 32767.0f;
+
+    std::vector<float> golden;
+    if (!readWav(checkFolder + wav, golden) || (golden.size() != out.size())) {
+      printf("%s,%s,%d,,,,no golden\n", BENCH_REVISION, scenario.name, scenario.bufferCount);
+      failed = true;
+      continue;
+    }
+
+    double sum = 0.0, peak = 0.0;
+    for (unsigned i = 0; i < out.size(); i++) {
+      double diff = fabs(out[i] - golden[i]);
+      sum += diff * diff;
+      if (diff > peak) peak = diff;
+    }
+
+    double rms      = sqrt(sum / out.size());
+    double spectral = spectralDifference(out, golden);
+    bool   passed   = (rms      <= CHECK_MAX_RMS_ERROR)  &&
+                      (peak     <= CHECK_MAX_PEAK_ERROR) &&
+                      (spectral <= CHECK_MAX_SPECTRAL_DB);
+
+    printf("%s,%s,%d,%.3g,%.3g,%.1f,%s\n",
+           BENCH_REVISION, scenario.name, scenario.bufferCount, rms, peak, spectral,
+           passed ? "pass" : "FAIL");
+    fflush(stdout);
+
+    if (!passed) failed = true;
+  }
+
+  delete library;
+
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,287 @@
+// Notice
+// ------
+//
+// This file is part of the Mezzo SoundFont2 Sampling Based Synthesizer:
+//
+//     https://github.com/turgu1/mezzo
+//
+// Simplified BSD License
+// ----------------------
+//
+// Copyright (c) 2018, Guy Turcotte
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// The views and conclusions contained in the software and documentation are those
+// of the authors and should not be interpreted as representing official policies,
+// either expressed or implied, of the FreeBSD Project.
+//
+
+// Sound font generation for the benchmarks
+// ----------------------------------------
+//
+// Helpers to build a small SF2 file in memory from the structures of
+// sf2.h, such that the benchmarks and the render check do not depend on
+// a sound font library being installed.
+//
+// The sound fonts of the benchmarks all have a single sample, a 441 Hz
+// sawtooth, and presets with a single instrument playing it. They are
+// built with SoundFontBuilder and loaded with loadSoundFont(), that also
+// sets the configuration common to all the benchmarks.
+
+#ifndef _SOUND_FONT_WRITER_
+#define _SOUND_FONT_WRITER_
+
+#include <cstdio>
+#include <cmath>
+#include <unistd.h>
+
+#define TEST_SAMPLE_RATE   44100
+#define TEST_ROOT_KEY         69
+#define TEST_PERIOD          100  ///< Samples per period of the test wave (441 Hz)
+
+//---- RIFF chunks ----
+
+PRIVATE void addChunk(std::string & out, const char * id, const std::string & data)
+{
+  uint32_t len = data.size();
+
+  out.append(id, 4);
+  out.append((const char *) &len, 4);
+  out.append(data);
+  if (len & 1) out.push_back('\0');
+}
+
+PRIVATE std::string list(const char * name, const std::string & chunks)
+{
+  std::string out;
+  addChunk(out, "LIST", std::string(name, 4) + chunks);
+  return out;
+}
+
+template <class T> PRIVATE void add(std::string & out, const T & rec)
+{
+  out.append((const char *) &rec, sizeof(T));
+}
+
+PRIVATE void addGen(std::string & out, SFGenerator oper, int16_t amount)
+{
+  sfGenList gen;
+
+  gen.sfGenOper           = oper;
+  gen.genAmount.shAmount  = amount;
+  add(out, gen);
+}
+
+//---- writeSoundFont() ----
+//
+// Assemble the INFO, sdta and pdta lists of a sound font and write it.
+// The pdta chunks are given in the order required by the specification.
+
+PRIVATE bool writeSoundFont(const char *        filename,
+                            const char *        name,
+                            const std::string & smpl,
+                            const std::string   pdtaChunks[9])
+{
+  static const char * pdtaIds[9] = {
+    "phdr", "pbag", "pmod", "pgen", "inst", "ibag", "imod", "igen", "shdr"
+  };
+
+  std::string ifil, inam(name, strlen(name) + 1);
+  add(ifil, (uint16_t) 2); add(ifil, (uint16_t) 1);
+
+  std::string info, sdta, pdta;
+  addChunk(info, "ifil", ifil);
+  addChunk(info, "INAM", inam);
+  addChunk(sdta, "smpl", smpl);
+  for (int i = 0; i < 9; i++) addChunk(pdta, pdtaIds[i], pdtaChunks[i]);
+
+  std::string file;
+  addChunk(file, "RIFF", std::string("sfbk") + list("INFO", info) + list("sdta", sdta) + list("pdta", pdta));
+
+  FILE * f = fopen(filename, "wb");
+  if (f == NULL) return false;
+  bool ok = fwrite(file.data(), 1, file.size(), f) == file.size();
+  fclose(f);
+
+  return ok;
+}
+
+//---- SoundFontBuilder ----
+//
+// Preset and instrument numbers are given in the order of the addPreset()
+// calls, starting at 0.
+
+class SoundFontBuilder {
+
+ private:
+  std::string smpl, phdr, pbag, pgen, inst, ibag, igen;
+  sfSample    sample;
+  uint16_t    presetCount;
+
+ public:
+  SoundFontBuilder()
+  {
+    memset(&sample, 0, sizeof(sample));
+    presetCount = 0;
+  }
+
+  /// Set the sample of the sound font: length samples of a sawtooth made
+  /// of its first 8 harmonics, looping from loopStart to loopEnd.
+  void setSawtooth(int length, int loopStart, int loopEnd)
+  {
+    smpl.clear();
+    for (int i = 0; i < length + 46; i++) {
+      float value = 0.0f;
+      if (i < length) {
+        for (int h = 1; h <= 8; h++) value += sinf(2.0f * M_PI * h * (i % TEST_PERIOD) / TEST_PERIOD) / h;
+      }
+      add(smpl, (int16_t) (value * 6000.0f));
+    }
+
+    strcpy(sample.achSampleName, "Saw");
+    sample.dwEnd           = length;
+    sample.dwStartloop     = loopStart;
+    sample.dwEndloop       = loopEnd;
+    sample.dwSampleRate    = TEST_SAMPLE_RATE;
+    sample.byOriginalPitch = TEST_ROOT_KEY;
+    sample.sfSampleType    = monoSample;
+  }
+
+  /// Add a preset and its instrument, both with the given name. The
+  /// instrument has a single zone with the generators (see addGen()),
+  /// playing the sample.
+  void addPreset(const char * name, const std::string & generators)
+  {
+    sfPresetHeader preset;
+    sfInst         instrument;
+    sfBag          bag;
+
+    memset(&preset, 0, sizeof(preset));
+    snprintf(preset.achPresetName, sizeof(preset.achPresetName), "%s", name);
+    preset.wPreset       = presetCount;
+    preset.wPresetBagNdx = presetCount;
+    add(phdr, preset);
+
+    bag.wGenNdx = presetCount;
+    bag.wModNdx = 0;
+    add(pbag, bag);
+    addGen(pgen, sfGenOper_instrumentID, presetCount);
+
+    memset(&instrument, 0, sizeof(instrument));
+    snprintf(instrument.achInstName, sizeof(instrument.achInstName), "%s", name);
+    instrument.wInstBagNdx = presetCount;
+    add(inst, instrument);
+
+    bag.wGenNdx = igen.size() / sizeof(sfGenList);
+    add(ibag, bag);
+    igen.append(generators);
+    addGen(igen, sfGenOper_sampleID, 0);
+
+    presetCount++;
+  }
+
+  /// Add the terminal records and write the sound font.
+  bool write(const char * filename, const char * name)
+  {
+    std::string tphdr(phdr), tpbag(pbag), tpgen(pgen), tinst(inst), tibag(ibag), tigen(igen), shdr;
+    std::string pmod(sizeof(sfModList), '\0'), imod(sizeof(sfModList), '\0');
+    sfPresetHeader preset;
+    sfInst         instrument;
+    sfBag          bag;
+    sfSample       eos;
+
+    memset(&preset, 0, sizeof(preset));
+    strcpy(preset.achPresetName, "EOP");
+    preset.wPresetBagNdx = presetCount;
+    add(tphdr, preset);
+
+    bag.wGenNdx = presetCount;
+    bag.wModNdx = 0;
+    add(tpbag, bag);
+    addGen(tpgen, sfGenOper_startAddrsOffset, 0);
+
+    memset(&instrument, 0, sizeof(instrument));
+    strcpy(instrument.achInstName, "EOI");
+    instrument.wInstBagNdx = presetCount;
+    add(tinst, instrument);
+
+    bag.wGenNdx = igen.size() / sizeof(sfGenList);
+    add(tibag, bag);
+    addGen(tigen, sfGenOper_startAddrsOffset, 0);
+
+    memset(&eos, 0, sizeof(eos));
+    strcpy(eos.achSampleName, "EOS");
+    add(shdr, sample);
+    add(shdr, eos);
+
+    const std::string pdta[9] = { tphdr, tpbag, pmod, tpgen, tinst, tibag, imod, tigen, shdr };
+
+    return writeSoundFont(filename, name, smpl, pdta);
+  }
+};
+
+//---- loadSoundFont() ----
+//
+// Write the sound font in a temporary file, set the configuration common
+// to the benchmarks and load the library from the file, that is removed
+// once loaded. The program name is used in the messages.
+
+PRIVATE bool loadSoundFont(SoundFontBuilder & builder, const char * program)
+{
+  char filename[] = "/tmp/mezzo_bench_XXXXXX.sf2";
+  int  fd = mkstemps(filename, 4);
+  if (fd < 0) {
+    perror(program);
+    return false;
+  }
+  close(fd);
+
+  if (!builder.write(filename, program)) {
+    fprintf(stderr, "Unable to write %s\n", filename);
+    unlink(filename);
+    return false;
+  }
+
+  keepRunning                = true;
+  config.silent              = true;
+  config.sf2IndexEnabled     = false;
+  config.samplingRate        = TEST_SAMPLE_RATE;
+  config.masterVolume        = 0.5f;
+  config.midiDrumChannel     = 0;
+  config.midiSustainTreshold = 64;
+
+  std::vector<std::string> filenames = { filename };
+  std::vector<int>         offsets;
+
+  library = new Library(filenames, offsets);
+  unlink(filename);
+
+  if (!library->isLoaded()) {
+    fprintf(stderr, "Unable to load the generated sound font\n");
+    return false;
+  }
+
+  return true;
+}
+
+#endif
@@ -0,0 +1,403 @@
+// Notice
+// ------
+//
+// This file is part of the Mezzo SoundFont2 Sampling Based Synthesizer:
+//
+//     https://github.com/turgu1/mezzo
+//
+// Simplified BSD License
+// ----------------------
+//
+// Copyright (c) 2018, Guy Turcotte
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// The views and conclusions contained in the software and documentation are those
+// of the authors and should not be interpreted as representing official policies,
+// either expressed or implied, of the FreeBSD Project.
+//
+
+// Silent tail check
+// -----------------
+//
+// Verifies that the sound dies out cleanly once the notes are over. When
+// a note is released, its voice, the filter of the voice, the reverb
+// feedback, the chorus and the equalizer histories decay towards zero.
+// Without flush-to-zero, they go through the subnormal floating point
+// range, that is many times slower to compute on x86 and on some ARM
+// processors, and the audio thread spikes in the middle of a silence.
+//
+// For each scenario and reverb engine, the complete chain is run the way
+// the sound callback does. The check itself only relies on results that
+// do not depend on the machine load:
+//
+//   voices_end_s  Time when the last voice has ended, from the first
+//                 note (the voices must end before the end of the
+//                 scenario, and while the key is held for the decay)
+//   subnormals    Subnormal numbers found in the voice buffers, in the
+//                 reverb and chorus sends, and in the output (must be 0)
+//
+// The duration of every buffer is also measured, to see the cost of the
+// tails:
+//
+//   idle_us       Median buffer duration before any note is played
+//   active_us     Median duration while the voices are sounding
+//   tail_us       Median buffer duration over windows of one second,
+//                 once the last voice has ended: the median of the
+//                 windows medians, the typical cost of the tail
+//   peak_us       Highest of the windows medians
+//
+// The reverb and the chorus tails keep being computed for a while once
+// the voices have ended. With -t, a scenario also fails if tail_us is
+// more than CHECK_MAX_TAIL_RATIO times idle_us (plus CHECK_TAIL_SLACK_US
+// for the timing noise), or if peak_us is more than active_us. These
+// limits are only meaningful on an otherwise idle machine: they are
+// checked by "make bench-tail", not by "make test". One CSV line is
+// written per scenario. The exit status is 1 if a scenario fails.
+//
+// Usage: mezzo_tail_check [-t] [-d]
+//
+//   -t  Also check the timings
+//   -d  Leave the subnormal numbers enabled (x86 only), to see the cost of
+//       the tails without flush-to-zero. The check is then expected to fail.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+  #include <xmmintrin.h>
+#endif
+
+#include "mezzo.h"
+#include "sound_font_writer.h"
+
+#ifndef BENCH_REVISION
+  #define BENCH_REVISION "unknown"
+#endif
+
+#define CHECK_LENGTH       (100 * TEST_PERIOD)
+#define CHECK_IDLE_BUFFERS       200
+#define CHECK_WINDOW             172  ///< Buffers in one second
+#define CHECK_MAX_TAIL_RATIO     2.0
+#define CHECK_TAIL_SLACK_US      5.0
+
+enum checkPreset { RELEASE = 0, DECAY = 1, DECAY_UNFILTERED = 2, CHECK_PRESET_COUNT = 3 };
+
+PRIVATE const char * presetNames[] = { "Release", "Decay", "Decay unfiltered" };
+
+struct checkScenario {
+  const char * name;
+  checkPreset  preset;
+  int          velocity;
+  int          holdBuffers;   ///< Buffers before the keys are released
+  int          bufferCount;   ///< Buffers after the first note
+  int          endBuffer;     ///< Buffer before which the voices must have ended
+};
+
+// release   A chord with a filter, sent to the reverb and the chorus, with
+//           a two seconds release. The voices end with their envelope.
+//
+// decay     A chord decaying to silence in two seconds (sustain at full
+//           attenuation) while the keys stay down: the voices have to be
+//           ended as soon as they cannot be heard.
+//
+// decay_unfiltered
+//           Same as decay, without the filter: the voices are not
+//           processed by the voice bank. They are played at full velocity,
+//           as the default velocity to filter cutoff modulator keeps the
+//           filter in use under it.
+
+PRIVATE const checkScenario scenarios[] = {
+  { "release",          RELEASE,          100, 172,      172 * 20, 172 * 4 },
+  { "decay",            DECAY,            100, 172 * 20, 172 * 20, 172 * 4 },
+  { "decay_unfiltered", DECAY_UNFILTERED, 127, 172 * 20, 172 * 20, 172 * 4 }
+};
+
+PRIVATE const char * engines[] = { "freeverb", "fdn" };
+
+PRIVATE const int chordNotes[] = { 57, 64, 69, 73 };
+
+//---- buildSoundFont() ----
+
+PRIVATE void buildSoundFont(SoundFontBuilder & builder)
+{
+  builder.setSawtooth(CHECK_LENGTH, 0, CHECK_LENGTH);
+
+  for (int p = 0; p < CHECK_PRESET_COUNT; p++) {
+    std::string igen;
+
+    addGen(igen, sfGenOper_sampleModes,       1);
+    addGen(igen, sfGenOper_attackVolEnv,  -7973);  // 10 msec
+    if (p == RELEASE) {
+      addGen(igen, sfGenOper_releaseVolEnv, 1200);  // 2 sec
+    }
+    else {
+      addGen(igen, sfGenOper_decayVolEnv,   1200);  // 2 sec
+      addGen(igen, sfGenOper_sustainVolEnv, 1000);  // Full attenuation
+    }
+    if (p != DECAY_UNFILTERED) {
+      addGen(igen, sfGenOper_initialFilterFc, 6000);
+      addGen(igen, sfGenOper_initialFilterQ,   100);
+    }
+    addGen(igen, sfGenOper_reverbEffectsSend,  500);
+    addGen(igen, sfGenOper_chorusEffectsSend,  500);
+
+    builder.addPreset(presetNames[p], igen);
+  }
+}
+
+//---- median() ----
+
+PRIVATE double median(std::vector<long> durations, size_t from, size_t to)
+{
+  if (from >= to) return 0.0;
+
+  std::vector<long>::iterator mid = durations.begin() + from + ((to - from) / 2);
+  std::nth_element(durations.begin() + from, mid, durations.begin() + to);
+
+  return *mid / 1000.0;
+}
+
+//---- countSubnormals() ----
+
+PRIVATE int countSubnormals(const float * values, int count)
+{
+  int found = 0;
+
+  for (int i = 0; i < count; i++) {
+    if (std::fpclassify(values[i]) == FP_SUBNORMAL) found++;
+  }
+  return found;
+}
+
+PRIVATE int countSubnormals(const frameRecord & buff)
+{
+  return countSubnormals(&buff[0].left, BUFFER_SAMPLE_COUNT);
+}
+
+//---- renderBuffer() ----
+//
+// Same sequence as a voices feeder pass followed by Sound::mix() and the
+// output clipping of the sound callback. The mix is done step by step,
+// such that the reverb and chorus sends can be verified. Only the
+// rendering is timed, not the verifications.
+
+PRIVATE long renderBuffer(VoiceBank & bank, int & subnormals)
+{
+  static frameRecord buff, reverbBuff, chorusBuff;
+  static float       out[BUFFER_FRAME_COUNT * 2];
+
+  Duration feedDuration;
+
+  for (voicep v = poly->firstVoice(); v != NULL; v = poly->nextVoice(v)) poly->feedVoice(v, bank);
+  bank.process();
+
+  long elapse = feedDuration.getElapse();
+
+  for (voicep v = poly->firstVoice(); v != NULL; v = poly->nextVoice(v)) {
+    int16_t count;
+    sampleRecord & buffer = v->getBuffer(&count);
+    if (count > 0) subnormals += countSubnormals(buffer.data(), count);
+  }
+
+  Duration mixDuration;
+
+  poly->mixer(buff, &reverbBuff, &chorusBuff);
+
+  bool reverbUsed = poly->isReverbBusUsed();
+  bool chorusUsed = poly->isChorusBusUsed();
+
+  chorus->process(buff, chorusUsed ? &chorusBuff : NULL);
+  reverb->process(buff, reverbUsed ? &reverbBuff : NULL);
+  equalizer->process(buff);
+  Utils::clip(out, buff);
+
+  elapse += mixDuration.getElapse();
+
+  if (reverbUsed) subnormals += countSubnormals(reverbBuff);
+  if (chorusUsed) subnormals += countSubnormals(chorusBuff);
+  subnormals += countSubnormals(buff);
+  subnormals += countSubnormals(out, BUFFER_FRAME_COUNT * 2);
+
+  return elapse;
+}
+
+//---- check() ----
+
+PRIVATE bool check(const checkScenario & scenario, const char * engine, bool checkTimings)
+{
+  config.reverbEngine = engine;
+
+  channels  = new Channel[MIDI_CHANNEL_COUNT];
+  poly      = new Poly();
+  reverb    = Reverb::create(config.reverbEngine);
+  chorus    = new Chorus();
+  equalizer = new Equalizer();
+
+  Midi::setupChannels();
+
+  Channel & channel = channels[0];
+  channel.programChange(scenario.preset);
+
+  VoiceBank         bank;
+  std::vector<long> idle, durations;
+  int               endBuffer  = -1;
+  int               subnormals = 0;
+
+  for (int b = 0; b < CHECK_IDLE_BUFFERS; b++) idle.push_back(renderBuffer(bank, subnormals));
+
+  for (int b = 0; b < scenario.bufferCount; b++) {
+
+    if (b == 0) {
+      for (int note : chordNotes) channel.noteOn(note, scenario.velocity);
+    }
+    else if (b == scenario.holdBuffers) {
+      for (int note : chordNotes) channel.noteOff(note);
+    }
+
+    durations.push_back(renderBuffer(bank, subnormals));
+
+    if ((endBuffer < 0) && (poly->getVoiceCount() == 0)) endBuffer = b + 1;
+  }
+
+  double idleUs   = median(idle, 0, idle.size());
+  double activeUs = median(durations, 0, (endBuffer > 0) ? endBuffer : durations.size());
+  double tailUs   = 0.0;
+  double peakUs   = 0.0;
+
+  if (endBuffer > 0) {
+    std::vector<long> windows;
+
+    for (size_t w = endBuffer; (w + CHECK_WINDOW) <= durations.size(); w += CHECK_WINDOW) {
+      windows.push_back(lrint(1000.0 * median(durations, w, w + CHECK_WINDOW)));
+    }
+
+    tailUs = median(windows, 0, windows.size());
+    peakUs = windows.empty() ? 0.0 : (*std::max_element(windows.begin(), windows.end()) / 1000.0);
+  }
+
+  bool ended  = (endBuffer > 0) && (endBuffer <= scenario.endBuffer);
+  bool passed = ended && (subnormals == 0);
+
+  if (checkTimings) {
+    passed = passed &&
+             (tailUs <= ((CHECK_MAX_TAIL_RATIO * idleUs) + CHECK_TAIL_SLACK_US)) &&
+             (peakUs <= activeUs);
+  }
+
+  char endTime[16] = "never";
+  if (endBuffer > 0) {
+    snprintf(endTime, sizeof(endTime), "%.2f", (double) endBuffer * BUFFER_FRAME_COUNT / config.samplingRate);
+  }
+
+  printf("%s,%s,%s,%s,%d,%.1f,%.1f,%.1f,%.1f,%s\n",
+         BENCH_REVISION, scenario.name, engine,
+         endTime, subnormals,
+         idleUs, activeUs, tailUs, peakUs,
+         passed ? "pass" : "fail");
+  fflush(stdout);
+
+  delete equalizer;
+  delete chorus;
+  delete reverb;
+  delete poly;
+  delete [] channels;
+
+  equalizer = NULL; chorus = NULL; reverb = NULL; poly = NULL; channels = NULL;
+
+  return passed;
+}
+
+//---- main() ----
+
+int main(int argc, char ** argv)
+{
+  bool keepDenormals = false;
+  bool checkTimings  = false;
+  int  opt;
+
+  while ((opt = getopt(argc, argv, "td")) != -1) {
+    switch (opt) {
+      case 't':
+        checkTimings = true;
+        break;
+      case 'd':
+        keepDenormals = true;
+        break;
+      default:
+        fprintf(stderr, "Usage: %s [-t] [-d]\n", argv[0]);
+        return 1;
+    }
+  }
+
+  if (!keepDenormals) {
+    Scheduling::flushDenormals();  // As the audio thread, see main.cpp
+  }
+  else {
+    #if defined(__x86_64__) || defined(__i386__)
+      _mm_setcsr(_mm_getcsr() & ~0x8040);
+    #endif
+  }
+
+  SoundFontBuilder builder;
+  buildSoundFont(builder);
+
+  if (!loadSoundFont(builder, "mezzo_tail_check")) return 1;
+
+  config.reverbRoomSize = 0.93f;
+  config.reverbDamping  = 0.2f;
+  config.reverbWidth    = 0.4f;
+  config.reverbDryWet   = 0.75f;
+  config.reverbApGain   = 0.5f;
+
+  config.chorusLevel    = 0.5f;
+  config.chorusRate     = 0.1f;
+  config.chorusDepth    = 0.4f;
+  config.chorusFeedback = 0.5f;
+  config.chorusWidth    = 0.8f;
+
+  config.equalizer_v60    =  0.3f;
+  config.equalizer_v150   =  0.0f;
+  config.equalizer_v400   = -0.2f;
+  config.equalizer_v1000  =  0.0f;
+  config.equalizer_v2400  =  0.1f;
+  config.equalizer_v6000  =  0.0f;
+  config.equalizer_v15000 = -0.3f;
+
+  bool failed = false;
+
+  printf("revision,scenario,engine,voices_end_s,subnormals,idle_us,active_us,tail_us,peak_us,result\n");
+
+  for (const checkScenario & scenario : scenarios) {
+    for (const char * engine : engines) {
+      if (!check(scenario, engine, checkTimings)) failed = true;
+    }
+  }
+
+  delete library;
+
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,316 @@
+// Notice
+// ------
+//
+// This file is part of the Mezzo SoundFont2 Sampling Based Synthesizer:
+//
+//     https://github.com/turgu1/mezzo
+//
+// Simplified BSD License
+// ----------------------
+//
+// Copyright (c) 2018, Guy Turcotte
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// The views and conclusions contained in the software and documentation are those
+// of the authors and should not be interpreted as representing official policies,
+// either expressed or implied, of the FreeBSD Project.
+//
+
+// Voice layout benchmark
+// ----------------------
+//
+// Measures the costs that depend on how the voices are laid out in memory,
+// rather than on the DSP kernels (see poly_bench.cpp for those):
+//
+//   scan_mixer       Walk of the active voices by the mixer (firstVoice() /
+//                    nextVoice()), through the whole voice list
+//   scan_feeder      Walk of a voices feeder thread, selecting its voices
+//                    on the sequence number parity
+//   scan_available   Search of a free voice at note on, after the active
+//                    voices
+//   render           Feed and mix of the active voices on a single thread
+//   render_threads   Same, with the voices fed by the two feeder threads
+//                    while this thread mixes them, as the sound callback
+//
+// The scans are measured with warm caches and, for the "_cold" variants,
+// after the caches have been flushed by a walk through a large buffer, as
+// it is the case when the sound callback runs after the other threads.
+// With render_threads, the mixer and the feeders share the voices: the
+// result depends on the cache lines written by both sides, and on the
+// number of processors. One CSV line is written per measurement:
+//
+//   revision         Source revision the benchmark was built from
+//   test, voices     Measurement and active voices
+//   passes           Timed passes (scans) or buffers (renders)
+//   ns_per_pass      Time of one pass
+//   ns_per_voice     Same, divided by the active voices
+//
+// Results from different revisions are compared with the revision column.
+//
+// Usage: mezzo_voice_layout_bench [-p passes] [-v voices[,voices...]]
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "mezzo.h"
+#include "sound_font_writer.h"
+
+#ifndef BENCH_REVISION
+  #define BENCH_REVISION "unknown"
+#endif
+
+#define BENCH_LENGTH        (100 * TEST_PERIOD)
+#define BENCH_DEFAULT_PASSES    2000
+#define BENCH_COLD_PASSES         50
+#define BENCH_RENDER_BUFFERS     200
+#define BENCH_FLUSH_SIZE  (32 * 1024 * 1024)  ///< Larger than the last level cache
+
+PRIVATE uint8_t * flushBuffer = NULL;
+PRIVATE volatile uint32_t sink;
+
+//---- buildSoundFont() ----
+//
+// A single preset playing a looped sawtooth: the voices never end.
+
+PRIVATE void buildSoundFont(SoundFontBuilder & builder)
+{
+  std::string igen;
+
+  builder.setSawtooth(BENCH_LENGTH, 0, BENCH_LENGTH);
+
+  addGen(igen, sfGenOper_sampleModes, 1);
+  builder.addPreset("Layout", igen);
+}
+
+//---- flushCaches() ----
+
+PRIVATE void flushCaches()
+{
+  uint32_t sum = 0;
+
+  for (int i = 0; i < BENCH_FLUSH_SIZE; i += 64) {
+    flushBuffer[i]++;
+    sum += flushBuffer[i];
+  }
+  sink = sum;
+}
+
+//---- Scans ----
+//
+// Each returns the number of voices seen, such that the walk cannot be
+// optimized out.
+
+PRIVATE int scanMixer()
+{
+  int count = 0;
+  for (voicep v = poly->firstVoice(); v != NULL; v = poly->nextVoice(v)) count++;
+  return count;
+}
+
+PRIVATE int scanFeeder()
+{
+  int count = 0;
+  for (voicep v = poly->getVoices(); v != NULL; v = v->getNext()) {
+    if (((v->getSeq() & 0x01) == 0) && v->isActive()) count++;
+  }
+  return count;
+}
+
+PRIVATE int scanAvailable()
+{
+  return (poly->nextAvailable() != NULL) ? 1 : 0;
+}
+
+//---- report() ----
+
+PRIVATE void report(const char * test, int voiceCount, int passes, long elapse)
+{
+  double passNs = (double) elapse / passes;
+
+  printf("%s,%s,%d,%d,%.1f,%.2f\n",
+         BENCH_REVISION, test, voiceCount, passes, passNs, passNs / voiceCount);
+  fflush(stdout);
+}
+
+//---- measureScan() ----
+
+PRIVATE void measureScan(const char * test, int (*scan)(), int voiceCount, int passes, bool cold)
+{
+  int  sum    = 0;
+  long elapse = 0;
+
+  for (int p = 0; p < 10; p++) sum += scan();
+
+  if (cold) {
+    for (int p = 0; p < BENCH_COLD_PASSES; p++) {
+      flushCaches();
+      Duration duration;
+      sum    += scan();
+      elapse += duration.getElapse();
+    }
+    passes = BENCH_COLD_PASSES;
+  }
+  else {
+    Duration duration;
+    for (int p = 0; p < passes; p++) sum += scan();
+    elapse = duration.getElapse();
+  }
+
+  sink = sum;
+
+  char name[32];
+  snprintf(name, sizeof(name), cold ? "%s_cold" : "%s", test);
+  report(name, voiceCount, passes, elapse);
+}
+
+//---- allReady() ----
+
+PRIVATE bool allReady()
+{
+  for (voicep v = poly->firstVoice(); v != NULL; v = poly->nextVoice(v)) {
+    int16_t count;
+    v->getBuffer(&count);
+    if (count < 0) return false;
+  }
+  return true;
+}
+
+//---- measureRender() ----
+
+PRIVATE void measureRender(int voiceCount, int buffers)
+{
+  static frameRecord buff, reverbBuff, chorusBuff;
+  VoiceBank bank;
+
+  Duration duration;
+  for (int b = 0; b < buffers; b++) {
+    for (voicep v = poly->firstVoice(); v != NULL; v = poly->nextVoice(v)) poly->feedVoice(v, bank);
+    bank.process();
+    poly->mixer(buff, &reverbBuff, &chorusBuff);
+  }
+  report("render", voiceCount, buffers, duration.getElapse());
+}
+
+//---- measureRenderThreads() ----
+
+PRIVATE void measureRenderThreads(int voiceCount, int buffers)
+{
+  static frameRecord buff, reverbBuff, chorusBuff;
+  pthread_t feeder1, feeder2;
+
+  keepRunning = true;
+
+  if (pthread_create(&feeder1, NULL, voicesFeeder1, NULL) ||
+      pthread_create(&feeder2, NULL, voicesFeeder2, NULL)) {
+    fprintf(stderr, "Unable to start the feeder threads\n");
+    exit(1);
+  }
+
+  poly->UnblockVoiceThreads();
+
+  Duration duration;
+  for (int b = 0; b < buffers; b++) {
+    while (!allReady()) sched_yield();
+    poly->mixer(buff, &reverbBuff, &chorusBuff);
+  }
+  long elapse = duration.getElapse();
+
+  stopThreads();
+  pthread_join(feeder1, NULL);
+  pthread_join(feeder2, NULL);
+
+  report("render_threads", voiceCount, buffers, elapse);
+}
+
+//---- main() ----
+
+int main(int argc, char ** argv)
+{
+  int passes = BENCH_DEFAULT_PASSES;
+  std::vector<int> voiceCounts;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "p:v:")) != -1) {
+    switch (opt) {
+      case 'p':
+        passes = atoi(optarg);
+        break;
+      case 'v':
+        for (char * s = strtok(optarg, ","); s != NULL; s = strtok(NULL, ",")) {
+          int count = atoi(s);
+          if ((count > 0) && (count < MAX_VOICES)) voiceCounts.push_back(count);
+        }
+        break;
+      default:
+        fprintf(stderr, "Usage: %s [-p passes] [-v voices[,voices...]]\n", argv[0]);
+        return 1;
+    }
+  }
+
+  if (passes <= 0) passes = BENCH_DEFAULT_PASSES;
+  if (voiceCounts.empty()) voiceCounts = { 16, 64, 256 };
+
+  SoundFontBuilder builder;
+  buildSoundFont(builder);
+
+  if (!loadSoundFont(builder, "mezzo_voice_layout_bench")) return 1;
+
+  channels = new Channel[MIDI_CHANNEL_COUNT];
+  poly     = new Poly();
+
+  Midi::setupChannels();
+
+  flushBuffer = new uint8_t[BENCH_FLUSH_SIZE]();
+
+  printf("revision,test,voices,passes,ns_per_pass,ns_per_voice\n");
+
+  Channel & channel = channels[0];
+  channel.programChange(0);
+
+  for (unsigned v = 0; v < voiceCounts.size(); v++) {
+    int voiceCount = voiceCounts[v];
+
+    for (int i = 0; i < voiceCount; i++) channel.noteOn(TEST_ROOT_KEY, 127);
+
+    for (int cold = 0; cold <= 1; cold++) {
+      measureScan("scan_mixer",     scanMixer,     voiceCount, passes, cold);
+      measureScan("scan_feeder",    scanFeeder,    voiceCount, passes, cold);
+      measureScan("scan_available", scanAvailable, voiceCount, passes, cold);
+    }
+
+    measureRender(voiceCount, BENCH_RENDER_BUFFERS);
+    measureRenderThreads(voiceCount, BENCH_RENDER_BUFFERS);
+
+    poly->allSoundOff(channel);
+  }
+
+  delete [] flushBuffer;
+  delete library;
+  delete poly;
+  delete [] channels;
+
+  return 0;
+}
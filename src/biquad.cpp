@@ -38,100 +38,207 @@
 
 #include "mezzo.h"
 
-bool BiQuad::allActive = true;
+bool  BiQuad::allActive  = true;
+bool  BiQuad::tableReady = false;
+float BiQuad::sinTable[FILTER_TABLE_SIZE];
+float BiQuad::cosTable[FILTER_TABLE_SIZE];
+
+//---- buildTable() ----
+//
+// The cutoff frequency is limited to 45% of the sampling rate.
+
+void BiQuad::buildTable()
+{
+  for (int i = 0; i < FILTER_TABLE_SIZE; i++) {
+    float freq  = centsToFreq(FILTER_MIN_CENTS + (i * FILTER_TABLE_STEP));
+    float theta = 2.0 * M_PI * fminf(freq, config.samplingRate * 0.45f) / config.samplingRate;
+
+    sinTable[i] = sin(theta);
+    cosTable[i] = cos(theta);
+  }
+
+  tableReady = true;
+}
+
+//---- computeQ() ----
+//
+// The Q value is the resonance height less 3.01 dB, such that a 0 cB
+// resonance gives a flat (Butterworth) response. The filter is not used
+// when it would let everything through.
+
+void BiQuad::computeQ()
+{
+  float q = centibelToRatio(initialQ + modQ - 30.1f);
+
+  invTwoQ = 0.5f / q;
+  gain    = (q > 1.0f) ? (1.0f / sqrtf(q)) : 1.0f;
+
+  active  = (initialFc + modFc < FILTER_MAX_CENTS) || (initialQ + modQ > 0) ||
+            (modEnvToFc != 0) || (modLfoToFc != 0);
+
+  currentIdx = -1;
+}
+
+//---- setup() ----
 
 void BiQuad::setup()
 {
-  // 3.01 DB attenuation
-  initialQ = centibelToRatio(initialQ - 30.1);
+  if (!tableReady) buildTable();
+
+  modFc = modQ = 0;
+  computeQ();
+
+  x1 = x2 = y1 = y2 = 0.0f;
+
+  update(0.0f, 0.0f);
 }
 
-void BiQuad::computeParams(float freq, float Q)
+//---- update() ----
+
+void BiQuad::update(float modEnv, float modLfo)
 {
-  float theta = 2. * M_PI * centsToFreq(freq) / config.samplingRate;
+  float cents = initialFc + modFc + (modEnv * modEnvToFc) + (modLfo * modLfoToFc);
+  int   idx   = (cents - FILTER_MIN_CENTS) * (1.0f / FILTER_TABLE_STEP);
 
-  if (Q == 0) {
-    active = false;
-  }
-  else {
-    float d = 1. / initialQ;
-    float dTmp = d * Utils::highSin(theta) / 2.;
-    if (dTmp == -1) {
-      active = false;
-    }
-    else {
-      active = true;
-      float  beta = 0.5 * (1. - dTmp) / (1. + dTmp);
-      float gamma = (0.5 + beta) * Utils::highCos(theta);
-      b0 = (0.5 + beta - gamma) / 2.;
-      b1 = 2. * b0;
-      b2 = b0;
-      a1 = -2. * gamma;
-      a2 =  2. * beta;
-    }
+  if (idx < 0) idx = 0;
+  else if (idx >= FILTER_TABLE_SIZE) idx = FILTER_TABLE_SIZE - 1;
+
+  if (idx == currentIdx) return;
+  currentIdx = idx;
+
+  float cosinus = cosTable[idx];
+  float alpha   = sinTable[idx] * invTwoQ;
+  float a0Inv   = 1.0f / (1.0f + alpha);
+
+  b0 = (1.0f - cosinus) * 0.5f * a0Inv * gain;
+  a1 = -2.0f * cosinus * a0Inv;
+  a2 = (1.0f - alpha) * a0Inv;
+
+  // Impulse response and responses to the previous outputs, for four samples
+
+  float r[4];
+  r[0] = 1.0f;
+  r[1] = -a1;
+  r[2] = (-a1 * r[1]) - a2;
+  r[3] = (-a1 * r[2]) - (a2 * r[1]);
+
+  for (int k = 0; k < 4; k++) {
+    for (int n = 0; n < 4; n++) h[k][n] = (n >= k) ? r[n - k] : 0.0f;
   }
+
+  g1[0] = -a1;
+  g1[1] = (-a1 * g1[0]) - a2;
+  g1[2] = (-a1 * g1[1]) - (a2 * g1[0]);
+  g1[3] = (-a1 * g1[2]) - (a2 * g1[1]);
+
+  g2[0] = -a2;
+  g2[1] = -a1 * g2[0];
+  g2[2] = (-a1 * g2[1]) - (a2 * g2[0]);
+  g2[3] = (-a1 * g2[2]) - (a2 * g2[1]);
+}
+
+//---- setModulation() ----
+//
+// The coefficients are recomputed at the next update(). A filter that
+// becomes active starts from a clean state.
+
+void BiQuad::setModulation(int16_t fc, int16_t q)
+{
+  if ((fc == modFc) && (q == modQ)) return;
+
+  bool wasActive = active;
+
+  modFc = fc;
+  modQ  = q;
+  computeQ();
+
+  if (active && !wasActive) x1 = x2 = y1 = y2 = 0.0f;
 }
 
-  // if ((initialQ == 0.0f) || (initialFc < 1500) || (initialFc > 13500)) {
-  //   active = false;
-  // }
-  // else {
-  //   float omega, sinus, cosinus, alpha, a0;
- 
-  //   omega   = 2 * M_PI * (centsToFreq(initialFc) / config.samplingRate);
-  //   sinus   = Utils::highSin(omega);
-  //   cosinus = Utils::highCos(omega);
-  //   alpha   = sinus / (2 * centibelToRatio(initialQ)); 
-
-  //   a0 = 1 + alpha;
- 
-  //   a1 = (-2 * cosinus) / a0;
-  //   a2 = ( 1 -   alpha) / a0;
-  //   b0 = ( 1 - cosinus) / (2 * a0);
-  //   b1 = ( 1 - cosinus) / a0;
-
-  //   // b2 = ( 1 - cosinus) / (2 * a0);  <-- Similar to b0
-  // }
-
-  // x1 = x2 = y1 = y2 = 0.0f;
-
-  // gain = 1.0f / sqrt(initialQ);
-// }
-
-void BiQuad::filter(sampleRecord & src, uint16_t length) 
+//---- filter() ----
+//
+//   v[n] = b0 * (x[n] + 2 x[n-1] + x[n-2])
+//   y[n] = v[n] - a1 y[n-1] - a2 y[n-2]
+//
+// With vectors, the four outputs are computed from the four values of v
+// and the last two outputs.
+
+void BiQuad::filter(buffp src, uint16_t length)
 {
-  assert(length <= src.size());
+#if USE_NEON_INTRINSICS
 
-  if (allActive && active) {
-    for (int i = 0; i < length; i++) {
+  assert((length & 0x03) == 0);
 
-      // y[n] = (b0/a0)*x[n] + (b1/a0)*x[n-1] + (b2/a0)*x[n-2]
-      //                     - (a1/a0)*y[n-1] - (a2/a0)*y[n-2]
+  float32x4_t h0 = vld1q_f32(h[0]);
+  float32x4_t h1 = vld1q_f32(h[1]);
+  float32x4_t h2 = vld1q_f32(h[2]);
+  float32x4_t h3 = vld1q_f32(h[3]);
+  float32x4_t vg1 = vld1q_f32(g1);
+  float32x4_t vg2 = vld1q_f32(g2);
 
-      float val = (b0 * src[i]) + (b1 * x1) + (b2 * x2) - (a1 * y1) - (a2 * y2);
+  float32x4_t prev = vcombine_f32(vdup_n_f32(0.0f), vset_lane_f32(x1, vdup_n_f32(x2), 1));
+  float32x4_t y    = vcombine_f32(vdup_n_f32(0.0f), vset_lane_f32(y1, vdup_n_f32(y2), 1));
 
-      x2 = x1; x1 = src[i];
-      y2 = y1; y1 =  val;
+  for (int i = 0; i < length; i += 4) {
+    float32x4_t x   = vld1q_f32(&src[i]);
+    float32x4_t xm1 = vextq_f32(prev, x, 3);
+    float32x4_t xm2 = vextq_f32(prev, x, 2);
 
-      src[i] = val * gain;
-    }
+    float32x4_t v = vmulq_n_f32(vaddq_f32(vaddq_f32(x, xm2), vaddq_f32(xm1, xm1)), b0);
+
+    float32x2_t vLow  = vget_low_f32(v);
+    float32x2_t vHigh = vget_high_f32(v);
+    float32x2_t yHigh = vget_high_f32(y);
+
+    float32x4_t out = vmulq_lane_f32(vg1, yHigh, 1);
+    out = vmlaq_lane_f32(out, vg2, yHigh, 0);
+    out = vmlaq_lane_f32(out, h0,  vLow,  0);
+    out = vmlaq_lane_f32(out, h1,  vLow,  1);
+    out = vmlaq_lane_f32(out, h2,  vHigh, 0);
+    out = vmlaq_lane_f32(out, h3,  vHigh, 1);
+
+    vst1q_f32(&src[i], out);
+
+    prev = x;
+    y    = out;
   }
+
+  x1 = vgetq_lane_f32(prev, 3);
+  x2 = vgetq_lane_f32(prev, 2);
+  y1 = vgetq_lane_f32(y, 3);
+  y2 = vgetq_lane_f32(y, 2);
+
+#else
+
+  for (int i = 0; i < length; i++) {
+    float x   = src[i];
+    float val = (b0 * (x + (2.0f * x1) + x2)) - (a1 * y1) - (a2 * y2);
+
+    x2 = x1; x1 = x;
+    y2 = y1; y1 = val;
+
+    src[i] = val;
+  }
+
+#endif
 }
 
+//---- showStatus() ----
+
 void BiQuad::showStatus(int spaces)
 {
   using namespace std;
 
   cout << setw(spaces) << ' '
-       << "BiQuad: "    << ((allActive && active) ? "Active" : "Inactive")
-       << " [Fc:"       << initialFc 
-       << ", Q:"        << initialQ
+       << "BiQuad: "    << (isActive() ? "Active" : "Inactive")
+       << " [Fc:"       << initialFc + modFc
+       << ", Q:"        << initialQ + modQ
+       << ", EnvToFc:"  << modEnvToFc
+       << ", LfoToFc:"  << modLfoToFc
+       << ", b0/a0:"    << b0
        << ", a1/a0:"    << a1
-       << ", a2/a0:"    << a2 
-       << ", b0_2/a0:"  << b0 
-       << ", b1/a0:"    << b1 
-       << ", b2/a0:"    << b2
+       << ", a2/a0:"    << a2
        << ", gain:"     << gain
        << "]"
        << endl;
-}
\ No newline at end of file
+}
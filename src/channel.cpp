@@ -0,0 +1,273 @@
+// Notice
+// ------
+//
+// This file is part of the Mezzo SoundFont2 Sampling Based Synthesizer:
+//
+//     https://github.com/turgu1/mezzo
+//
+// Simplified BSD License
+// ----------------------
+//
+// Copyright (c) 2018, Guy Turcotte
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// The views and conclusions contained in the software and documentation are those
+// of the authors and should not be interpreted as representing official policies,
+// either expressed or implied, of the FreeBSD Project.
+//
+
+#include <cmath>
+#include <iomanip>
+
+#include "mezzo.h"
+
+//---- Channel() ----
+
+Channel::Channel()
+{
+  setNewHandler(outOfMemory);
+
+  nbr        =     0;
+  preset     =  NULL;
+  percussion = false;
+  voiceCount =     0;
+
+  for (int i = 0; i < 128; i++) controllers[i] = 0;
+
+  controllers[0x07] = 100;   // Volume
+  controllers[0x0A] =  64;   // Pan
+  controllers[0x5B] =  40;   // Reverb depth, as suggested by General MIDI 2
+
+  serial = 0;
+
+  resetControllers();
+}
+
+//---- ~Channel() ----
+
+Channel::~Channel()
+{
+}
+
+//---- outOfMemory() ----
+
+void Channel::outOfMemory()
+{
+  logger.FATAL("Channel: Unable to allocate memory.");
+}
+
+//---- setNbr() ----
+
+void Channel::setNbr(uint8_t n, bool isPercussion)
+{
+  nbr        = n;
+  percussion = isPercussion;
+}
+
+//---- resetControllers() ----
+//
+// Bank select, volume and pan are left untouched as required by RP-015.
+
+void Channel::resetControllers()
+{
+  controllers[0x01] =   0;   // Modulation wheel
+  controllers[0x0B] = 127;   // Expression
+  controllers[0x40] =   0;   // Sustain pedal
+  controllers[0x41] =   0;   // Portamento
+  controllers[0x42] =   0;   // Sostenuto
+  controllers[0x43] =   0;   // Soft pedal
+  controllers[0x62] = 127;   // NRPN LSB
+  controllers[0x63] = 127;   // NRPN MSB
+  controllers[0x64] = 127;   // RPN LSB
+  controllers[0x65] = 127;   // RPN MSB
+
+  pitchBend      = 0;
+  pitchBendRange = 2;
+  pressure       = 0;
+  sustainOn      = false;
+
+  stateChanged();
+}
+
+//---- dataEntry() ----
+//
+// Only the pitch bend sensitivity (RPN 0) is currently supported. The
+// cents part (data entry LSB) is ignored.
+
+void Channel::dataEntry()
+{
+  if ((controllers[0x65] == 0) && (controllers[0x64] == 0)) {
+    pitchBendRange = MIN(controllers[0x06], 24);
+  }
+}
+
+//---- setController() ----
+
+void Channel::setController(uint8_t ctrl, uint8_t value)
+{
+  ctrl &= 0x7F;
+  controllers[ctrl] = value;
+
+  switch (ctrl) {
+    case 0x06:                              // Data entry MSB
+      dataEntry();
+      break;
+    case 0x40:                              // Sustain pedal
+      setSustain(value >= config.midiSustainTreshold);
+      break;
+    case 0x62:                              // NRPN LSB
+    case 0x63:                              // NRPN MSB
+      controllers[0x64] = controllers[0x65] = 127;
+      break;
+    case 0x78:                              // All sound off
+      poly->allSoundOff(*this);
+      break;
+    case 0x79:                              // Reset all controllers
+      resetControllers();
+      poly->voicesSustainOff(*this);
+      break;
+    case 0x7B:                              // All notes off
+    case 0x7C:                              // Omni mode off
+    case 0x7D:                              // Omni mode on
+    case 0x7E:                              // Mono mode on
+    case 0x7F:                              // Poly mode on
+      poly->allNotesOff(*this);
+      break;
+    default:
+      break;
+  }
+
+  // Volume, expression, pan, effect depths and the others are sources of
+  // the voices modulators
+
+  stateChanged();
+}
+
+//---- setPitchBend() ----
+
+void Channel::setPitchBend(int16_t value)
+{
+  pitchBend = value;
+  stateChanged();
+}
+
+//---- setPressure() ----
+
+void Channel::setPressure(uint8_t value)
+{
+  pressure = value;
+  stateChanged();
+}
+
+//---- setSustain() ----
+
+void Channel::setSustain(bool on)
+{
+  if (sustainOn && !on) {
+    sustainOn = false;
+    poly->voicesSustainOff(*this);
+  }
+  else {
+    sustainOn = on;
+  }
+}
+
+//---- setPreset() ----
+//
+// The voices of the channel are stopped before the old preset is released,
+// as they refer to its zones and modulators, that are freed when it is no
+// longer in use.
+
+bool Channel::setPreset(Preset * p)
+{
+  if (p == preset) return true;
+
+  if ((p != NULL) && !library->usePreset(p)) return false;
+  if (preset != NULL) {
+    poly->allSoundOff(*this);
+    library->releasePreset(preset);
+  }
+
+  preset = p;
+  return true;
+}
+
+//---- programChange() ----
+//
+// When the preset is not found in the selected bank, falls back to the
+// same program in bank 0 (or to the standard drum kit on the percussion
+// channel), as most General MIDI players do.
+
+bool Channel::programChange(uint8_t midiNbr)
+{
+  uint16_t bankNbr = getBankNbr();
+  Preset * p = library->findMidiPreset(bankNbr, midiNbr);
+
+  if (p == NULL) {
+    p = percussion ?
+      library->findMidiPreset(bankNbr, 0) :
+      library->findMidiPreset(0, midiNbr);
+  }
+
+  if (p == NULL) {
+    logger.WARNING("Channel %d: Preset %d:%d not found.", nbr + 1, bankNbr, midiNbr);
+    return false;
+  }
+
+  return setPreset(p);
+}
+
+//---- noteOn() ----
+
+void Channel::noteOn(uint8_t note, uint8_t velocity)
+{
+  if (preset) preset->playNote(note, velocity, *this);
+}
+
+//---- noteOff() ----
+
+void Channel::noteOff(uint8_t note)
+{
+  poly->noteOff(note, *this);
+}
+
+//---- showStatus() ----
+
+void Channel::showStatus(int spaces)
+{
+  using namespace std;
+
+  cout << setw(spaces) << ' '
+       << "Channel " << setw(2) << (nbr + 1) << ": "
+       << setw(20) << left << (preset ? preset->getName() : "[none]") << right
+       << " [bank:"    << getBankNbr()
+       << " voices:"   << voiceCount
+       << " vol:"      << +controllers[0x07]
+       << " expr:"     << +controllers[0x0B]
+       << " pan:"      << +controllers[0x0A]
+       << " reverb:"   << +controllers[0x5B]
+       << " chorus:"   << +controllers[0x5D]
+       << " bend:"     << pitchBend
+       << " sustain:"  << (sustainOn ? "on" : "off")
+       << "]" << endl;
+}
@@ -0,0 +1,381 @@
+// Notice
+// ------
+//
+// This file is part of the Mezzo SoundFont2 Sampling Based Synthesizer:
+//
+//     https://github.com/turgu1/mezzo
+//
+// Simplified BSD License
+// ----------------------
+//
+// Copyright (c) 2018, Guy Turcotte
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// The views and conclusions contained in the software and documentation are those
+// of the authors and should not be interpreted as representing official policies,
+// either expressed or implied, of the FreeBSD Project.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <unistd.h>
+#include <termios.h>
+#include <iomanip>
+
+#include "mezzo.h"
+
+// Center delay of each tap, in seconds. They are different such that the
+// taps are not modulated around the same point.
+
+const float Chorus::centerDelays[CHORUS_TAP_COUNT] = {
+  0.0100f, 0.0119f, 0.0087f, 0.0131f
+};
+
+#define CHORUS_MAX_DELAY      0.0200f  ///< Longest delay (seconds), modulation included
+#define CHORUS_MAX_DEPTH      0.0050f  ///< Delay modulation amplitude (seconds) when depth is 1.0
+#define CHORUS_MIN_RATE       0.1f     ///< LFO frequency (Hz) when rate is 0.0
+#define CHORUS_MAX_RATE       5.0f     ///< LFO frequency (Hz) when rate is 1.0
+#define CHORUS_MAX_FEEDBACK   0.7f     ///< Feedback gain when feedback is 1.0
+
+Chorus::Chorus()
+{
+  setNewHandler(outOfMemory);
+
+  int length = 1;
+  while (length < (int)(CHORUS_MAX_DELAY * config.samplingRate) + 2) length <<= 1;
+
+  lineMask = length - 1;
+  writePos = 0;
+  phase    = 0.0f;
+
+  for (int ch = 0; ch < 2; ch++) {
+    channels[ch].buff = RtArena::allocateArray<sample_t>(length);
+    std::fill(channels[ch].buff, channels[ch].buff + length, 0.0f);
+  }
+
+  level    = config.chorusLevel;
+  rate     = config.chorusRate;
+  depth    = config.chorusDepth;
+  feedback = config.chorusFeedback;
+  width    = config.chorusWidth;
+
+  static frame_t zero = { 0.0f, 0.0f };
+  std::fill(std::begin(silence), std::end(silence), zero);
+
+  idle        = true;
+  silentCount = 0;
+}
+
+//---- ~Chorus() ----
+
+Chorus::~Chorus()
+{
+  RtArena::release(channels[0].buff);
+  RtArena::release(channels[1].buff);
+}
+
+//---- outOfMemory() ----
+
+void Chorus::outOfMemory()
+{
+  logger.FATAL("Chorus: Unable to allocate memory.");
+}
+
+//---- clear() ----
+
+void Chorus::clear()
+{
+  for (int ch = 0; ch < 2; ch++) {
+    std::fill(channels[ch].buff, channels[ch].buff + lineMask + 1, 0.0f);
+  }
+}
+
+//---- setupLfos() ----
+//
+// The LFO vectors are recomputed from the phase at the beginning of each
+// buffer, such that rounding errors of the rotations don't accumulate.
+// The taps of a channel are 90 degrees apart and the right channel is 45
+// degrees late on the left one.
+
+void Chorus::setupLfos(float increment)
+{
+  for (int ch = 0; ch < 2; ch++) {
+    for (int i = 0; i < CHORUS_TAP_COUNT; i++) {
+      float angle = phase + (i * (M_PI / 2.0f)) + (ch * (M_PI / 4.0f));
+      channels[ch].sinv[i] = sinf(angle);
+      channels[ch].cosv[i] = cosf(angle);
+    }
+  }
+
+  phase += increment * BUFFER_FRAME_COUNT;
+  if (phase >= (2.0f * M_PI)) phase -= (2.0f * M_PI);
+}
+
+//---- processChannel() ----
+//
+// Compute the chorus of one channel in ret. Returns the peak level of the
+// result.
+
+float Chorus::processChannel(channelState & chan, frameRecord & send, bool right, float increment)
+{
+  float cw     = cosf(increment);
+  float sw     = sinf(increment);
+  float modAmp = depth * CHORUS_MAX_DEPTH * config.samplingRate;
+  float fb     = feedback * CHORUS_MAX_FEEDBACK;
+  float peak   = 0.0f;
+  int   pos    = writePos;
+  buffp line   = chan.buff;
+
+#if USE_NEON_INTRINSICS
+
+  float32x4_t centers = vmulq_n_f32(vld1q_f32(centerDelays), (float) config.samplingRate);
+  float32x4_t sinv    = vld1q_f32(chan.sinv);
+  float32x4_t cosv    = vld1q_f32(chan.cosv);
+
+  for (int fr = 0; fr < BUFFER_FRAME_COUNT; fr++) {
+
+    // Read positions of the four taps, split in integer and fractional
+    // parts. The line length is added to stay positive.
+
+    float32x4_t delays = vmlaq_n_f32(centers, sinv, modAmp);
+    float32x4_t rdPos  = vsubq_f32(vdupq_n_f32((float)(pos + lineMask + 1)), delays);
+    int32x4_t   iPos   = vcvtq_s32_f32(rdPos);
+    float32x4_t frac   = vsubq_f32(rdPos, vcvtq_f32_s32(iPos));
+
+    int32_t idx[CHORUS_TAP_COUNT];
+    float   a[CHORUS_TAP_COUNT], b[CHORUS_TAP_COUNT];
+
+    vst1q_s32(idx, iPos);
+    for (int i = 0; i < CHORUS_TAP_COUNT; i++) {
+      a[i] = line[ idx[i]      & lineMask];
+      b[i] = line[(idx[i] + 1) & lineMask];
+    }
+
+    float32x4_t va = vld1q_f32(a);
+    float32x4_t vb = vld1q_f32(b);
+    float32x4_t v  = vmlaq_f32(va, vsubq_f32(vb, va), frac);
+
+    float32x2_t s  = vadd_f32(vget_low_f32(v), vget_high_f32(v));
+    float out      = vget_lane_f32(vpadd_f32(s, s), 0) * (1.0f / CHORUS_TAP_COUNT);
+
+    // LFOs rotation
+
+    float32x4_t sinNext = vmlaq_n_f32(vmulq_n_f32(sinv, cw), cosv, sw);
+    cosv = vmlsq_n_f32(vmulq_n_f32(cosv, cw), sinv, sw);
+    sinv = sinNext;
+
+    float in  = right ? send[fr].right : send[fr].left;
+    line[pos] = in + (out * fb);
+    pos       = (pos + 1) & lineMask;
+
+    if (right) ret[fr].right = out; else ret[fr].left = out;
+    peak = fmaxf(peak, fabsf(out));
+  }
+
+#else
+
+  float sinv[CHORUS_TAP_COUNT], cosv[CHORUS_TAP_COUNT];
+
+  for (int i = 0; i < CHORUS_TAP_COUNT; i++) {
+    sinv[i] = chan.sinv[i];
+    cosv[i] = chan.cosv[i];
+  }
+
+  for (int fr = 0; fr < BUFFER_FRAME_COUNT; fr++) {
+    float out = 0.0f;
+
+    for (int i = 0; i < CHORUS_TAP_COUNT; i++) {
+      float rdPos = (pos + lineMask + 1) - ((centerDelays[i] * config.samplingRate) + (sinv[i] * modAmp));
+      int   iPos  = (int) rdPos;
+      float frac  = rdPos - iPos;
+      float a     = line[ iPos      & lineMask];
+      float b     = line[(iPos + 1) & lineMask];
+
+      out += a + ((b - a) * frac);
+
+      float sinNext = (sinv[i] * cw) + (cosv[i] * sw);
+      cosv[i] = (cosv[i] * cw) - (sinv[i] * sw);
+      sinv[i] = sinNext;
+    }
+    out *= (1.0f / CHORUS_TAP_COUNT);
+
+    float in  = right ? send[fr].right : send[fr].left;
+    line[pos] = in + (out * fb);
+    pos       = (pos + 1) & lineMask;
+
+    if (right) ret[fr].right = out; else ret[fr].left = out;
+    peak = fmaxf(peak, fabsf(out));
+  }
+
+#endif
+
+  return peak;
+}
+
+//---- process() ----
+
+void Chorus::process(frameRecord & buff, frameRecord * send)
+{
+  if (send == NULL) {
+    if (idle) return;
+    send = &silence;
+  }
+
+  Duration duration;
+
+  float increment = (2.0f * M_PI * (CHORUS_MIN_RATE + (rate * (CHORUS_MAX_RATE - CHORUS_MIN_RATE)))) /
+                    config.samplingRate;
+
+  setupLfos(increment);
+
+  float peak = fmaxf(processChannel(channels[0], *send, false, increment),
+                     processChannel(channels[1], *send, true,  increment));
+
+  writePos = (writePos + BUFFER_FRAME_COUNT) & lineMask;
+
+  float wet1 = level * (1.0f + width) * 0.5f;
+  float wet2 = level * (1.0f - width) * 0.5f;
+
+#if USE_NEON_INTRINSICS
+
+  buffp b = &buff[0].left;
+  buffp r = &ret[0].left;
+
+  for (int fr = 0; fr < BUFFER_FRAME_COUNT; fr += 4, b += 8, r += 8) {
+    float32x4x2_t bb = vld2q_f32(b);
+    float32x4x2_t rr = vld2q_f32(r);
+
+    bb.val[0] = vmlaq_n_f32(vmlaq_n_f32(bb.val[0], rr.val[0], wet1), rr.val[1], wet2);
+    bb.val[1] = vmlaq_n_f32(vmlaq_n_f32(bb.val[1], rr.val[1], wet1), rr.val[0], wet2);
+
+    vst2q_f32(b, bb);
+  }
+
+#else
+
+  for (int fr = 0; fr < BUFFER_FRAME_COUNT; fr++) {
+    buff[fr].left  += (ret[fr].left  * wet1) + (ret[fr].right * wet2);
+    buff[fr].right += (ret[fr].right * wet1) + (ret[fr].left  * wet2);
+  }
+
+#endif
+
+  // Same as for the reverb: the chorus becomes idle when nothing has been
+  // sent to it for long enough for the delay lines to be silent.
+
+  if ((send == &silence) && (peak < CHORUS_SILENCE)) {
+    if (++silentCount >= CHORUS_IDLE_BUFFERS) {
+      idle = true;
+      clear();
+    }
+  }
+  else {
+    silentCount = 0;
+    idle = false;
+  }
+
+  metrics.record(METRIC_CHORUS, duration.getElapse());
+}
+
+//---- adjustValue() ----
+
+void Chorus::adjustValue(char ch)
+{
+  switch (ch) {
+  case 'q':
+  case 'a':
+    level += ch == 'q' ? 0.05f : -0.05f;
+    level = MIN(MAX(level, 0.0f), 1.0f);
+    break;
+  case 'w':
+  case 's':
+    rate += ch == 'w' ? 0.05f : -0.05f;
+    rate = MIN(MAX(rate, 0.0f), 1.0f);
+    break;
+  case 'e':
+  case 'd':
+    depth += ch == 'e' ? 0.05f : -0.05f;
+    depth = MIN(MAX(depth, 0.0f), 1.0f);
+    break;
+  case 'r':
+  case 'f':
+    feedback += ch == 'r' ? 0.05f : -0.05f;
+    feedback = MIN(MAX(feedback, 0.0f), 1.0f);
+    break;
+  case 't':
+  case 'g':
+    width += ch == 't' ? 0.05f : -0.05f;
+    width = MIN(MAX(width, 0.0f), 1.0f);
+    break;
+  }
+}
+
+//---- interactiveAdjust() ----
+
+void Chorus::interactiveAdjust()
+{
+ // Setup unbuffered nonechoed character input for stdin
+  struct termios old_tio, new_tio;
+  tcgetattr(STDIN_FILENO, &old_tio);
+  new_tio = old_tio;
+  new_tio.c_lflag &= (~ICANON & ~ECHO);
+  tcsetattr(STDIN_FILENO, TCSANOW, &new_tio);
+
+  using namespace std;
+
+  cout.precision(2);
+  cout.setf(ios::showpoint);
+
+  cout << endl << endl;
+  cout << "CHORUS ADJUSTMENTS."               << endl;
+  cout << "Values must be between 0 and 1.0"  << endl;
+  cout << "Please use the following keys:"    << endl << endl;
+  cout << "For 0.05 increment steps: qwert"   << endl;
+  cout << "For 0.05 decrement steps: asdfg"   << endl;
+  cout << "                 To exit: x"       << endl;
+  cout << endl;
+  cout << "[    Level     Rate    Depth Feedback    Width ]" << endl;
+
+  while (keepRunning) {
+    cout << "[";
+    cout << setw(9) << level;
+    cout << setw(9) << rate;
+    cout << setw(9) << depth;
+    cout << setw(9) << feedback;
+    cout << setw(9) << width;
+    cout << " ]    \r";
+
+    char ch = getchar();
+    if (ch == 'x') break;
+
+    adjustValue(ch);
+  }
+
+  cout << endl << endl;
+
+  // Restore buffered echoed character input for stdin
+  tcsetattr(STDIN_FILENO, TCSANOW, &old_tio);
+}
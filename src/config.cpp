@@ -122,6 +122,14 @@ bool Configuration::loadConfig(int argc, char **argv)
                                   "keep last part of song for replay")
       ("sf2-folder,d",            po::value<std::string>(&sf2Folder),
                                   "set folder to find sf2 libraries")
+      ("sf2-bank-offset",         po::value<std::vector<int>>(&sf2BankOffsets)->composing(),
+                                  "bank offset of each sf2 library, in order")
+      ("sf2-index",               po::value<bool>(&sf2IndexEnabled)->default_value(true),
+                                  "use a sidecar index to speedup sf2 libraries loading")
+      ("sf2-index-folder",        po::value<std::string>(&sf2IndexFolder)->default_value(""),
+                                  "alternate folder for sf2 indexes")
+      ("sample-loader-threads",   po::value<int>(&sampleLoaderThreads)->default_value(0),
+                                  "threads preparing samples of a preset or 0 for one per core")
       ("pcm-device-name",         po::value<std::string>(&pcmDeviceName),
                                   "PCM Output Device Name")
       ("lcd-keypad-device-name",  po::value<std::string>(&lcdKeypadDeviceName)->default_value(""),
@@ -140,6 +148,12 @@ bool Configuration::loadConfig(int argc, char **argv)
                                   "Midi Sustain Treshold")
       ("midi-transpose",          po::value<int>(&midiTranspose),
                                   "Midi Transpose")
+      ("midi-drum-channel",       po::value<int>(&midiDrumChannel)->default_value(10),
+                                  "Midi Percussion Channel (1..16) or 0 for none")
+      ("reverb-engine",           po::value<std::string>(&reverbEngine)->default_value("freeverb"),
+                                  "Reverb Engine (freeverb, fdn or convolution)")
+      ("reverb-ir-file",          po::value<std::string>(&reverbIrFile)->default_value(""),
+                                  "Impulse response WAV file of the convolution reverb")
       ("reverb-room-size",        po::value<float>(&reverbRoomSize),
                                   "Reverb Room Size")
       ("reverb-damping",          po::value<float>(&reverbDamping),
@@ -150,6 +164,16 @@ bool Configuration::loadConfig(int argc, char **argv)
                                   "Reverb Dry / Wet")
       ("reverb-ap-gain",          po::value<float>(&reverbApGain),
                                   "Reverb Ap Gain")
+      ("chorus-level",            po::value<float>(&chorusLevel)->default_value(0.5f),
+                                  "Chorus Level")
+      ("chorus-rate",             po::value<float>(&chorusRate)->default_value(0.1f),
+                                  "Chorus Rate")
+      ("chorus-depth",            po::value<float>(&chorusDepth)->default_value(0.4f),
+                                  "Chorus Depth")
+      ("chorus-feedback",         po::value<float>(&chorusFeedback)->default_value(0.0f),
+                                  "Chorus Feedback")
+      ("chorus-width",            po::value<float>(&chorusWidth)->default_value(0.8f),
+                                  "Chorus Width")
       ("equalizer-60",            po::value<float>(&equalizer_v60),
                                   "Equalizer  60 Hz")
       ("equalizer-150",           po::value<float>(&equalizer_v150),
@@ -164,10 +188,38 @@ bool Configuration::loadConfig(int argc, char **argv)
                                   "Equalizer   6 kHz")
       ("equalizer-15000",         po::value<float>(&equalizer_v15000),
                                   "Equalizer  15 kHz")
+      ("metrics-port",            po::value<int>(&metricsPort)->default_value(0),
+                                  "localhost port serving the metrics or 0 for none")
+      ("metrics-socket",          po::value<std::string>(&metricsSocket)->default_value(""),
+                                  "Unix socket path serving the metrics")
+      ("simd-backend",            po::value<std::string>(&simdBackend)->default_value("auto"),
+                                  "Vector kernels (auto, scalar, sse4.1, avx2 or neon)")
+      ("audio-cpus",              po::value<std::string>(&audioCpus)->default_value(""),
+                                  "Processors of the audio thread (e.g. 3 or 2-3), empty for all")
+      ("render-cpus",             po::value<std::string>(&renderCpus)->default_value(""),
+                                  "Processors of the voices rendering threads")
+      ("midi-cpus",               po::value<std::string>(&midiCpus)->default_value(""),
+                                  "Processors of the MIDI thread")
+      ("io-cpus",                 po::value<std::string>(&ioCpus)->default_value(""),
+                                  "Processors of the sample loading and metrics threads")
+      ("ui-cpus",                 po::value<std::string>(&uiCpus)->default_value(""),
+                                  "Processors of the main (user interface) thread")
+      ("audio-priority",          po::value<int>(&audioPriority)->default_value(0),
+                                  "SCHED_FIFO priority (1..99) of the audio thread, 0 for none")
+      ("render-priority",         po::value<int>(&renderPriority)->default_value(0),
+                                  "SCHED_FIFO priority of the voices rendering threads")
+      ("midi-priority",           po::value<int>(&midiPriority)->default_value(0),
+                                  "SCHED_FIFO priority of the MIDI thread")
+      ("io-priority",             po::value<int>(&ioPriority)->default_value(0),
+                                  "SCHED_FIFO priority of the sample loading and metrics threads")
+      ("ui-priority",             po::value<int>(&uiPriority)->default_value(0),
+                                  "SCHED_FIFO priority of the main thread")
+      ("lock-memory",             po::value<bool>(&lockMemory)->default_value(false),
+                                  "Lock all memory, such that the audio path never page-faults")
     ;
 
     hidden.add_options()
-      ("input-sf2", po::value<std::string>(&inputSf2), "input sf2 library ")
+      ("input-sf2", po::value<std::vector<std::string>>(&inputSf2)->composing(), "input sf2 libraries")
     ;
 
     visible.add(gen).add(conf);
@@ -232,19 +284,25 @@ bool Configuration::loadConfig(int argc, char **argv)
       return false;
     }
     else {
-      filename[0] = '\0';
-      if ((strchr(inputSf2.c_str(), '/') == NULL) &&
-          configMap.count("sf2-folder")) {
-        strncpy(filename, sf2Folder.c_str(), 255);
-        strncat(filename, "/", 255);
+      soundFontFilenames.clear();
+      for (unsigned i = 0; i < inputSf2.size(); i++) {
+        filename[0] = '\0';
+        if ((strchr(inputSf2[i].c_str(), '/') == NULL) &&
+            configMap.count("sf2-folder")) {
+          strncpy(filename, sf2Folder.c_str(), 255);
+          strncat(filename, "/", 255);
+        }
+        strncat(filename, inputSf2[i].c_str(), 255);
+        if (Utils::fileExists(filename)) {
+          soundFontFilenames.push_back(filename);
+        }
+        else {
+          logger.ERROR("File does not exists: %s", filename);
+          return false;
+        }
       }
-      strncat(filename, inputSf2.c_str(), 255);
-      if (Utils::fileExists(filename)) {
-        soundFontFilename = filename;
-      }
-      else {
-        logger.ERROR("File does not exists: %s", filename);
-        return false;
+      if (sf2BankOffsets.size() > soundFontFilenames.size()) {
+        logger.WARNING("More sf2-bank-offset entries than sound font files.");
       }
     }
     
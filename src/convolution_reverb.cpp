@@ -0,0 +1,575 @@
+// Notice
+// ------
+//
+// This file is part of the Mezzo SoundFont2 Sampling Based Synthesizer:
+//
+//     https://github.com/turgu1/mezzo
+//
+// Simplified BSD License
+// ----------------------
+//
+// Copyright (c) 2018, Guy Turcotte
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// The views and conclusions contained in the software and documentation are those
+// of the authors and should not be interpreted as representing official policies,
+// either expressed or implied, of the FreeBSD Project.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <boost/iostreams/device/mapped_file.hpp>
+
+#include "mezzo.h"
+
+#pragma pack(push,1)
+
+/// Content of the fmt chunk of a WAV file. The fields after
+/// bitsPerSample are only present with the extensible format.
+
+struct wavFormat {
+  uint16_t formatTag;
+  uint16_t channels;
+  uint32_t samplesPerSec;
+  uint32_t avgBytesPerSec;
+  uint16_t blockAlign;
+  uint16_t bitsPerSample;
+  uint16_t extensionSize;
+  uint16_t validBitsPerSample;
+  uint32_t channelMask;
+  uint16_t subFormat;        ///< First two bytes of the sub format GUID
+};
+
+#pragma pack(pop)
+
+#define WAVE_FORMAT_PCM         0x0001
+#define WAVE_FORMAT_IEEE_FLOAT  0x0003
+#define WAVE_FORMAT_EXTENSIBLE  0xFFFE
+
+ConvolutionReverb::ConvolutionReverb(std::vector<float> & left, std::vector<float> & right)
+{
+  fft = new FFT(CONV_FFT_SIZE);
+
+  partitionCount = (left.size() + BUFFER_FRAME_COUNT - 1) / BUFFER_FRAME_COUNT;
+
+  filters = RtArena::allocateArray<spectrum>(partitionCount);
+  inputs  = RtArena::allocateArray<spectrum>(partitionCount);
+
+  // The impulse response is normalized to a unit energy on its strongest
+  // channel. The scaling of the inverse FFT and the halving of the input
+  // spectra (see toSpectrum()) are folded into the filters.
+
+  double energy[2] = { 0.0, 0.0 };
+  for (unsigned i = 0; i < left.size(); i++) {
+    energy[0] += left[i]  * left[i];
+    energy[1] += right[i] * right[i];
+  }
+
+  float scale = CONV_OUTPUT_GAIN / sqrt(MAX(MAX(energy[0], energy[1]), 1.0e-20)) /
+                (4.0f * CONV_FFT_SIZE);
+
+  for (int p = 0; p < partitionCount; p++) {
+    int start = p * BUFFER_FRAME_COUNT;
+    int count = MIN((int) left.size() - start, BUFFER_FRAME_COUNT);
+
+    std::fill(timeRe, timeRe + CONV_FFT_SIZE, 0.0f);
+    std::fill(timeIm, timeIm + CONV_FFT_SIZE, 0.0f);
+    std::copy(left.begin()  + start, left.begin()  + start + count, timeRe);
+    std::copy(right.begin() + start, right.begin() + start + count, timeIm);
+
+    fft->forward(timeRe, timeIm);
+    toSpectrum(filters[p], scale);
+  }
+
+  // Buffers are numbered such that no tail is expected from job 0, that
+  // is never started
+
+  stopping      = false;
+  threadStarted = false;
+  bufferNbr     = CONV_HEAD_PARTITIONS + 1;
+  jobRequested  = 0;
+  jobDone       = 0;
+
+  for (int i = 0; i < CONV_TAIL_SLOTS; i++) tailJobs[i] = 0;
+
+  sem_init(&workReady, 0, 0);
+
+  clear();
+
+  if (partitionCount > CONV_HEAD_PARTITIONS) {
+    if (Scheduling::createThread(&thread, ROLE_RENDER, "convolution", worker, this)) {
+      logger.ERROR("Convolution reverb: Unable to start worker thread. "
+                   "The tail will be computed by the audio thread.");
+    }
+    else {
+      threadStarted = true;
+    }
+  }
+
+  logger.DEBUG("Convolution reverb: %d partitions.", partitionCount);
+}
+
+//---- create() ----
+
+Reverb * ConvolutionReverb::create()
+{
+  std::vector<float> left, right;
+
+  if (!loadImpulse(config.reverbIrFile, left, right)) return NULL;
+
+  return new ConvolutionReverb(left, right);
+}
+
+//---- ~ConvolutionReverb() ----
+
+ConvolutionReverb::~ConvolutionReverb()
+{
+  if (threadStarted) {
+    stopping = true;
+    sem_post(&workReady);
+
+    pthread_join(thread, NULL);
+  }
+
+  sem_destroy(&workReady);
+
+  RtArena::release(inputs);
+  RtArena::release(filters);
+  delete fft;
+}
+
+//---- readSample() ----
+
+PRIVATE float readSample(const uint8_t * data, int bits, bool isFloat)
+{
+  if (isFloat) {
+    float value;
+    memcpy(&value, data, sizeof(float));
+    return value;
+  }
+
+  switch (bits) {
+    case 16:
+      return (int16_t)(data[0] | (data[1] << 8)) / 32768.0f;
+    case 24:
+      return ((int32_t)((data[0] << 8) | (data[1] << 16) | ((uint32_t) data[2] << 24)) >> 8) /
+             8388608.0f;
+    default:
+      return (int32_t)(data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t) data[3] << 24)) /
+             2147483648.0f;
+  }
+}
+
+//---- resample() ----
+//
+// Linear interpolation is sufficient here: the high end of an impulse
+// response is mostly noise.
+
+PRIVATE void resample(std::vector<float> & data, float ratio)
+{
+  int count = (int)((data.size() - 1) * ratio) + 1;
+  std::vector<float> result(count);
+
+  for (int i = 0; i < count; i++) {
+    float pos  = i / ratio;
+    int   idx  = (int) pos;
+    float frac = pos - idx;
+
+    result[i] = (idx + 1 < (int) data.size()) ?
+                  data[idx] + (data[idx + 1] - data[idx]) * frac :
+                  data[idx];
+  }
+
+  data.swap(result);
+}
+
+//---- loadImpulse() ----
+//
+// Retrieve the impulse response from a WAV file. It is converted to the
+// sampling rate of the synthesizer, and its trailing silence is removed.
+
+bool ConvolutionReverb::loadImpulse(const std::string & filename,
+                                    std::vector<float> & left,
+                                    std::vector<float> & right)
+{
+  if (filename.empty()) {
+    logger.ERROR("Convolution reverb: No impulse response file (reverb-ir-file).");
+    return false;
+  }
+
+  boost::iostreams::mapped_file_source file;
+
+  try {
+    file.open(filename);
+  }
+  catch (std::exception & e) {
+  }
+
+  if (!file.is_open()) {
+    logger.ERROR("Unable to open file %s.", filename.c_str());
+    return false;
+  }
+
+  const uint8_t * data = (const uint8_t *) file.data();
+  const uint8_t * end  = data + file.size();
+
+  chunkList & main = *(chunkList *) data;
+
+  if ((file.size() < 12) ||
+      (memcmp(main.id,       "RIFF", 4) != 0) ||
+      (memcmp(main.listName, "WAVE", 4) != 0)) {
+    logger.ERROR("Unrecognizable WAV file format: %s", filename.c_str());
+    return false;
+  }
+
+  wavFormat       format;
+  const uint8_t * samples   = NULL;
+  uint32_t        byteCount = 0;
+  bool            formatFound = false;
+
+  const uint8_t * pos = (const uint8_t *) main.chunks;
+
+  while (pos + 8 <= end) {
+    chunk & ck = *(chunk *) pos;
+    uint32_t len = MIN(ck.len, (uint32_t)(end - pos - 8));
+
+    if (memcmp(ck.id, "fmt ", 4) == 0) {
+      memset(&format, 0, sizeof(format));
+      memcpy(&format, ck.data, MIN(len, (uint32_t) sizeof(format)));
+      formatFound = true;
+    }
+    else if (memcmp(ck.id, "data", 4) == 0) {
+      samples   = ck.data;
+      byteCount = len;
+    }
+
+    pos += 8 + len + (len & 1);
+  }
+
+  if (!formatFound || (samples == NULL)) {
+    logger.ERROR("Incomplete WAV file: %s", filename.c_str());
+    return false;
+  }
+
+  int  tag     = (format.formatTag == WAVE_FORMAT_EXTENSIBLE) ? format.subFormat : format.formatTag;
+  int  bits    = format.bitsPerSample;
+  bool isFloat = tag == WAVE_FORMAT_IEEE_FLOAT;
+
+  if (!(((tag == WAVE_FORMAT_PCM) && ((bits == 16) || (bits == 24) || (bits == 32))) ||
+        (isFloat && (bits == 32))) ||
+      (format.channels < 1) ||
+      (format.blockAlign < format.channels * bits / 8)) {
+    logger.ERROR("Unsupported WAV file format (format %d, %d bits, %d channels): %s",
+                 tag, bits, format.channels, filename.c_str());
+    return false;
+  }
+
+  if (format.channels > 2) {
+    logger.WARNING("Only the first two channels of %s are used.", filename.c_str());
+  }
+
+  int frameCount = byteCount / format.blockAlign;
+  int rightPos   = (format.channels > 1) ? bits / 8 : 0;
+
+  left.resize(frameCount);
+  right.resize(frameCount);
+
+  for (int i = 0; i < frameCount; i++) {
+    const uint8_t * frame = samples + i * format.blockAlign;
+    left[i]  = readSample(frame,            bits, isFloat);
+    right[i] = readSample(frame + rightPos, bits, isFloat);
+  }
+
+  if (format.samplesPerSec != config.samplingRate) {
+    logger.INFO("Impulse response resampled from %d to %d Hz.",
+                format.samplesPerSec, config.samplingRate);
+    float ratio = (float) config.samplingRate / format.samplesPerSec;
+    resample(left,  ratio);
+    resample(right, ratio);
+    frameCount = left.size();
+  }
+
+  float peak = 0.0f;
+  for (int i = 0; i < frameCount; i++) {
+    peak = fmaxf(peak, fmaxf(fabsf(left[i]), fabsf(right[i])));
+  }
+
+  int last = frameCount;
+  while ((last > 0) &&
+         (fabsf(left[last - 1])  <= peak * REVERB_SILENCE) &&
+         (fabsf(right[last - 1]) <= peak * REVERB_SILENCE)) last--;
+
+  int maxCount = CONV_MAX_SECONDS * config.samplingRate;
+  if (last > maxCount) {
+    logger.WARNING("Impulse response cut to %d seconds.", CONV_MAX_SECONDS);
+    last = maxCount;
+  }
+
+  if (last == 0) {
+    logger.ERROR("Empty impulse response: %s", filename.c_str());
+    return false;
+  }
+
+  left.resize(last);
+  right.resize(last);
+
+  return true;
+}
+
+//---- clear() ----
+//
+// Called by the audio thread, that can't wait for the worker. Skipping
+// some buffer numbers makes the job of the worker stale, if any: it is
+// given up and its tail is not used. Without the worker, the tails are
+// used without checking the job number and must be emptied. The tails of
+// the buffers before firstJob are not expected.
+
+void ConvolutionReverb::clear()
+{
+  if (threadStarted) bufferNbr += CONV_HEAD_PARTITIONS + 1;
+  firstJob = bufferNbr.load(std::memory_order_relaxed);
+
+  memset(inputs, 0, partitionCount * sizeof(spectrum));
+  if (!threadStarted) memset(tails, 0, sizeof(tails));
+
+  std::fill(lastLeft,  lastLeft  + BUFFER_FRAME_COUNT, 0.0f);
+  std::fill(lastRight, lastRight + BUFFER_FRAME_COUNT, 0.0f);
+
+  position = 0;
+  tailSlot = 0;
+}
+
+//---- toSpectrum() ----
+//
+// Retrieve the half spectra of both channels from the transform Z of
+// (left + i right). For each bin k, with Z[k] = a + ib and
+// Z[N - k] = c + id:
+//
+//   Left[k]  = ((a + c) + i(b - d)) / 2
+//   Right[k] = ((b + d) + i(c - a)) / 2
+//
+// The division by 2 is left to the scale parameter.
+
+void ConvolutionReverb::toSpectrum(spectrum & spec, float scale)
+{
+  for (int k = 0; k <= CONV_FFT_SIZE / 2; k++) {
+    int   j = (CONV_FFT_SIZE - k) & (CONV_FFT_SIZE - 1);
+    float a = timeRe[k], b = timeIm[k];
+    float c = timeRe[j], d = timeIm[j];
+
+    spec.lr[k] = (a + c) * scale;
+    spec.li[k] = (b - d) * scale;
+    spec.rr[k] = (b + d) * scale;
+    spec.ri[k] = (c - a) * scale;
+  }
+
+  for (int k = CONV_FFT_SIZE / 2 + 1; k < CONV_BIN_COUNT; k++) {
+    spec.lr[k] = spec.li[k] = spec.rr[k] = spec.ri[k] = 0.0f;
+  }
+}
+
+//---- fromSpectrum() ----
+//
+// Build the full transform of (left + i right) from the half spectra of
+// both channels. The upper bins are the conjugates of the lower ones.
+
+void ConvolutionReverb::fromSpectrum(spectrum & spec)
+{
+  for (int k = 0; k <= CONV_FFT_SIZE / 2; k++) {
+    timeRe[k] = spec.lr[k] - spec.ri[k];
+    timeIm[k] = spec.li[k] + spec.rr[k];
+  }
+
+  for (int k = CONV_FFT_SIZE / 2 + 1; k < CONV_FFT_SIZE; k++) {
+    int j = CONV_FFT_SIZE - k;
+
+    timeRe[k] = spec.lr[j] + spec.ri[j];
+    timeIm[k] = spec.rr[j] - spec.li[j];
+  }
+}
+
+//---- multiplyAdd() ----
+//
+// dst += x * h, for both channels.
+
+void ConvolutionReverb::multiplyAdd(spectrum & dst, const spectrum & x, const spectrum & h)
+{
+  simd->complexMultiplyAdd(dst.lr, dst.li, x.lr, x.li, h.lr, h.li, CONV_BIN_COUNT);
+  simd->complexMultiplyAdd(dst.rr, dst.ri, x.rr, x.ri, h.rr, h.ri, CONV_BIN_COUNT);
+}
+
+//---- computeTail() ----
+//
+// Compute the tail part of the output spectrum of the buffer that will
+// come CONV_HEAD_PARTITIONS buffers after the one at pos in inputs:
+//
+//   tail = sum(p >= head, inputs[pos + head - p] * filters[p])
+//
+// The worker gives up the job once its buffer has been played: the audio
+// thread is then replacing the oldest inputs it reads, and the tail won't
+// be used anyway.
+
+bool ConvolutionReverb::computeTail(int pos, int slot, uint32_t job)
+{
+  spectrum & tail = tails[slot];
+
+  memset(&tail, 0, sizeof(spectrum));
+
+  for (int p = CONV_HEAD_PARTITIONS; p < partitionCount; p++) {
+    if (threadStarted &&
+        ((bufferNbr.load(std::memory_order_relaxed) - job) > CONV_HEAD_PARTITIONS)) {
+      return false;
+    }
+    multiplyAdd(tail, inputs[pos], filters[p]);
+    if (--pos < 0) pos = partitionCount - 1;
+  }
+
+  return true;
+}
+
+//---- startTail() ----
+//
+// The job is handed to the worker only when it is done with the previous
+// one. Else the tail of the buffer will be left out.
+
+void ConvolutionReverb::startTail(uint32_t job)
+{
+  if (!isWorkerIdle()) return;
+
+  jobPosition = position;
+  jobSlot     = (tailSlot + CONV_HEAD_PARTITIONS) % CONV_TAIL_SLOTS;
+  jobRequested.store(job, std::memory_order_release);
+  sem_post(&workReady);
+}
+
+//---- isTailReady() ----
+//
+// The worker has been given CONV_HEAD_PARTITIONS buffer durations to
+// complete the job, such that it is usually done. The slot of the tail
+// is not written again before the next job for it is started, after it
+// has been used. A tail that is expected but not ready is counted as late.
+
+bool ConvolutionReverb::isTailReady(uint32_t job)
+{
+  if (!threadStarted || (tailJobs[tailSlot].load(std::memory_order_acquire) == job)) return true;
+
+  if ((int32_t) (job - firstJob) >= 0) metrics.lateReverbTail();
+
+  return false;
+}
+
+void * ConvolutionReverb::worker(void * args)
+{
+  metrics.registerWorker("convolution");
+  ((ConvolutionReverb *) args)->work();
+  return NULL;
+}
+
+//---- work() ----
+
+void ConvolutionReverb::work()
+{
+  while (true) {
+    while (sem_wait(&workReady) != 0);   // Interrupted by a signal
+    if (stopping) break;
+
+    uint32_t job = jobRequested.load(std::memory_order_acquire);
+
+    if (computeTail(jobPosition, jobSlot, job)) {
+      tailJobs[jobSlot].store(job, std::memory_order_release);
+    }
+
+    jobDone.store(job, std::memory_order_release);
+  }
+}
+
+//---- processBuffer() ----
+//
+// The next tail is started as soon as the delay line is updated, in
+// parallel with the computation of the head. The tail of the current
+// buffer, started CONV_HEAD_PARTITIONS buffers ago, is left out if the
+// worker is not done with it.
+
+void ConvolutionReverb::processBuffer(frameRecord & send, frameRecord & ret)
+{
+  float wet1 = (1.0f + width) * 0.5f;
+  float wet2 = (1.0f - width) * 0.5f;
+
+  uint32_t nbr = bufferNbr.load(std::memory_order_relaxed);
+
+  // Overlap-save input: the previous send buffer followed by the current one
+
+  memcpy(timeRe, lastLeft,  BUFFER_FRAME_COUNT * sizeof(float));
+  memcpy(timeIm, lastRight, BUFFER_FRAME_COUNT * sizeof(float));
+
+  simd->deinterleave(lastLeft, lastRight, &send[0].left, BUFFER_FRAME_COUNT, 1.0f);
+
+  memcpy(timeRe + BUFFER_FRAME_COUNT, lastLeft,  BUFFER_FRAME_COUNT * sizeof(float));
+  memcpy(timeIm + BUFFER_FRAME_COUNT, lastRight, BUFFER_FRAME_COUNT * sizeof(float));
+
+  fft->forward(timeRe, timeIm);
+
+  toSpectrum(inputs[position], 1.0f);
+
+  if (partitionCount > CONV_HEAD_PARTITIONS) {
+    if (threadStarted) {
+      startTail(nbr);
+    }
+    else {
+      computeTail(position, (tailSlot + CONV_HEAD_PARTITIONS) % CONV_TAIL_SLOTS, nbr);
+    }
+  }
+
+  // Head
+
+  if (isTailReady(nbr - CONV_HEAD_PARTITIONS)) {
+    memcpy(&sum, &tails[tailSlot], sizeof(spectrum));
+  }
+  else {
+    memset(&sum, 0, sizeof(spectrum));
+  }
+
+  int headCount = MIN(partitionCount, CONV_HEAD_PARTITIONS);
+  int pos       = position;
+
+  for (int p = 0; p < headCount; p++) {
+    multiplyAdd(sum, inputs[pos], filters[p]);
+    if (--pos < 0) pos = partitionCount - 1;
+  }
+
+  fromSpectrum(sum);
+  fft->inverse(timeRe, timeIm);
+
+  // The second half of the result is the output for the current buffer
+
+  simd->mixWidth(&ret[0].left, timeRe + BUFFER_FRAME_COUNT, timeIm + BUFFER_FRAME_COUNT,
+                 BUFFER_FRAME_COUNT, wet1, wet2);
+
+  if (++position >= partitionCount) position = 0;
+  if (++tailSlot >= CONV_TAIL_SLOTS) tailSlot = 0;
+
+  bufferNbr.store(nbr + 1, std::memory_order_relaxed);
+}
@@ -37,6 +37,7 @@
 //
 
 #include <stdio.h>
+#include <math.h>
 #include <unistd.h>
 #include <termios.h>
 #include <iomanip>
@@ -44,43 +45,14 @@
 
 #include "mezzo.h"
 
-float Equalizer::gain[BAND_COUNT] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
-
-float Equalizer::leftHist[BAND_COUNT][2] = {
-  { 0.0, 0.0 },
-  { 0.0, 0.0 },
-  { 0.0, 0.0 },
-  { 0.0, 0.0 },
-  { 0.0, 0.0 },
-  { 0.0, 0.0 },
-  { 0.0, 0.0 }
-};
-
-float Equalizer::rightHist[BAND_COUNT][2] = {
-  { 0.0, 0.0 },
-  { 0.0, 0.0 },
-  { 0.0, 0.0 },
-  { 0.0, 0.0 },
-  { 0.0, 0.0 },
-  { 0.0, 0.0 },
-  { 0.0, 0.0 }
-};
-
-// Bandpass filter coefficients for a 44.1 kHz samping rate
-// Center freqs are: 60, 150, 400, 1000, 2400, 6000, 15000
-
-const float Equalizer::bpf[BAND_COUNT][5] = {
-  { 0.0025579741, -1.9948111773, 0.9948840737, 0.0, -1.0 },
-  { 0.0063700872, -1.9868060350, 0.9872598052, 0.0, -1.0 },
-  { 0.0168007612, -1.9632060528, 0.9663984776, 0.0, -1.0 },
-  { 0.0408578217, -1.8988473415, 0.9182843566, 0.0, -1.0 },
-  { 0.0914007276, -1.7119922638, 0.8171985149, 0.0, -1.0 },
-  { 0.1845672876, -1.0703823566, 0.6308654547, 0.0, -1.0 },
-  { 0.3760778010,  0.6695288420, 0.2478443682, 0.0, -1.0 }
+const float Equalizer::freqs[BAND_COUNT] = {
+  60.0f, 150.0f, 400.0f, 1000.0f, 2400.0f, 6000.0f, 15000.0f
 };
 
 Equalizer::Equalizer()
 {
+  setNewHandler(outOfMemory);
+
   gain[0] = config.equalizer_v60   ;
   gain[1] = config.equalizer_v150  ;
   gain[2] = config.equalizer_v400  ;
@@ -88,66 +60,81 @@ Equalizer::Equalizer()
   gain[4] = config.equalizer_v2400 ;
   gain[5] = config.equalizer_v6000 ;
   gain[6] = config.equalizer_v15000;
+
+  memset(state, 0, sizeof(state));
+
+  computeCoefficients();
 }
 
 Equalizer::~Equalizer()
 {
 }
 
-float Equalizer::iirFilter(float input, const float *coef, int n, float *history)
-{
-  const float *coefPtr;
-  float *hist1Ptr, *hist2Ptr;
-  float output, newHist, history1, history2;
-
-  coefPtr = coef;
-
-  hist1Ptr = history;
-  hist2Ptr = hist1Ptr + 1;
-
-  output = input * *coefPtr++;
-
-  for(int i = 0; i < n; i++) {
+//----- outOfMemory() ----
 
-    history1 = *hist1Ptr;
-    history2 = *hist2Ptr;
-
-    output -= history1 * *coefPtr++;
-    newHist = output - history2 * *coefPtr++;
+void Equalizer::outOfMemory()
+{
+  logger.FATAL("Equalizer: Unable to allocate memory.");
+}
 
-    output  = newHist + history1 * *coefPtr++;
-    output += history2 * *coefPtr++;
+//---- computeCoefficients() ----
+//
+// Peaking filter of each band. The last lane is a pass-through. When
+// the equalizer gets bypassed, the state of the filters is cleared for
+// the next time it is used.
 
-    *hist2Ptr++ = *hist1Ptr;
-    *hist1Ptr++ = newHist;
+void Equalizer::computeCoefficients()
+{
+  bypass = true;
+
+  for (int i = 0; i < BAND_COUNT; i++) {
+    currentGain[i] = gain[i];
+    if (gain[i] != 0.0f) bypass = false;
+
+    float g = gain[i];
+    if (g >  1.0f) g =  1.0f;
+    if (g < -1.0f) g = -1.0f;
+
+    float freq  = fminf(freqs[i], config.samplingRate * 0.45f);
+    float A     = powf(10.0f, g * EQ_MAX_DB / 40.0f);
+    float w0    = 2.0f * M_PI * freq / config.samplingRate;
+    float alpha = sinf(w0) / (2.0f * EQ_Q);
+    float a0    = 1.0f + (alpha / A);
+
+    coefs.b0[i] = (1.0f + (alpha * A)) / a0;
+    coefs.b1[i] = (-2.0f * cosf(w0)) / a0;
+    coefs.b2[i] = (1.0f - (alpha * A)) / a0;
+    coefs.a1[i] = coefs.b1[i];
+    coefs.a2[i] = (1.0f - (alpha / A)) / a0;
+  }
 
-    hist1Ptr++;
-    hist2Ptr++;
+  for (int i = BAND_COUNT; i < SIMD_CASCADE_LANES; i++) {
+    coefs.b0[i] = 1.0f;
+    coefs.b1[i] = coefs.b2[i] = coefs.a1[i] = coefs.a2[i] = 0.0f;
   }
 
-  return output;
+  if (bypass) memset(state, 0, sizeof(state));
 }
 
-void Equalizer::process(buffp buff, int frameCount)
-{
-  for (int i = 0; i < frameCount; i++) {
-
-    // Left
-    float sigIn = *buff;
-    float sigOut = sigIn;
-    for (int j = 0; j < BAND_COUNT; j++) {
-      sigOut += gain[j] * iirFilter2(sigIn, bpf[j], leftHist[j]);
-    }
-    *buff++ = sigOut;
+//---- process() ----
+//
+// The channels are processed one after the other. For each frame, the
+// input of the first band is the new frame and the input of the other
+// bands is the output of the preceding band for the previous frame.
 
-    // Right
-    sigIn = *buff;
-    sigOut = sigIn;
-    for (int j = 0; j < BAND_COUNT; j++) {
-      sigOut += gain[j] * iirFilter2(sigIn, bpf[j], rightHist[j]);
+void Equalizer::process(frameRecord & buff)
+{
+  for (int i = 0; i < BAND_COUNT; i++) {
+    if (gain[i] != currentGain[i]) {
+      computeCoefficients();
+      break;
     }
-    *buff++ = sigOut;
   }
+
+  if (bypass) return;
+
+  simd->filterCascade(&buff[0].left,  BUFFER_FRAME_COUNT, 2, coefs, state[0]);
+  simd->filterCascade(&buff[0].right, BUFFER_FRAME_COUNT, 2, coefs, state[1]);
 }
 
 //---- adjustGain(char c) ----
@@ -159,10 +146,10 @@ void Equalizer::adjustGain(char c)
 
   char *pos;
   if ((pos = strchr(up, c)) != NULL) {
-    gain[pos - up] += 0.05f;
+    gain[pos - up] = fminf(gain[pos - up] + 0.05f, 1.0f);
   }
   else if ((pos = strchr(down, c)) != NULL) {
-    gain[pos - down] -= 0.05f;
+    gain[pos - down] = fmaxf(gain[pos - down] - 0.05f, -1.0f);
   }
 }
 
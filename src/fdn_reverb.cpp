@@ -0,0 +1,237 @@
+// Notice
+// ------
+//
+// This file is part of the Mezzo SoundFont2 Sampling Based Synthesizer:
+//
+//     https://github.com/turgu1/mezzo
+//
+// Simplified BSD License
+// ----------------------
+//
+// Copyright (c) 2018, Guy Turcotte
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// The views and conclusions contained in the software and documentation are those
+// of the authors and should not be interpreted as representing official policies,
+// either expressed or implied, of the FreeBSD Project.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "mezzo.h"
+
+// Lengths of the delay lines at 44100 Hz. They are prime numbers to
+// minimize the coincidence of echoes between lines.
+
+const int FdnReverb::line_m[FDN_LINE_COUNT] = {
+  1031, 1327, 1523, 1871, 2053, 2311, 2539, 2789
+};
+
+const int FdnReverb::diffuser_m[2][FDN_DIFFUSER_COUNT] = {
+  { 142, 379 },
+  { 163, 401 }
+};
+
+// Length of a FreeVerb comb at 44100 Hz for which the gain of the loop
+// is equal to roomSize.
+
+#define FDN_REFERENCE_LENGTH 1400.0f
+
+#define FDN_INPUT_GAIN       0.5f
+#define FDN_OUTPUT_GAIN      2.0f
+#define FDN_DAMPING_SCALE    0.6f
+#define FDN_MAX_ROOM_SIZE    0.999f
+
+FdnReverb::FdnReverb()
+{
+  float ratio = config.samplingRate / 44100.0f;
+
+  for (int i = 0; i < FDN_LINE_COUNT; i++) {
+    int frameCount = MAX((int)(line_m[i] * ratio), BUFFER_FRAME_COUNT);
+
+    lines[i].buff   = RtArena::allocateArray<sample_t>(frameCount);
+    lines[i].length = frameCount;
+    lines[i].pos    = 0;
+    std::fill(lines[i].buff, lines[i].buff + frameCount, 0.0f);
+
+    lineLast[i] = 0.0f;
+  }
+
+  for (int ch = 0; ch < 2; ch++) {
+    for (int i = 0; i < FDN_DIFFUSER_COUNT; i++) {
+      int frameCount = MAX((int)(diffuser_m[ch][i] * ratio), 1);
+
+      diffusers[ch][i].buff   = RtArena::allocateArray<sample_t>(frameCount);
+      diffusers[ch][i].length = frameCount;
+      diffusers[ch][i].pos    = 0;
+      std::fill(diffusers[ch][i].buff, diffusers[ch][i].buff + frameCount, 0.0f);
+    }
+  }
+
+  computeGains();
+}
+
+//---- create() ----
+
+Reverb * FdnReverb::create()
+{
+  return new FdnReverb;
+}
+
+//---- ~FdnReverb() ----
+
+FdnReverb::~FdnReverb()
+{
+  for (int i = 0; i < FDN_LINE_COUNT; i++) {
+    RtArena::release(lines[i].buff);
+  }
+  for (int ch = 0; ch < 2; ch++) {
+    for (int i = 0; i < FDN_DIFFUSER_COUNT; i++) {
+      RtArena::release(diffusers[ch][i].buff);
+    }
+  }
+}
+
+//---- clear() ----
+
+void FdnReverb::clear()
+{
+  for (int i = 0; i < FDN_LINE_COUNT; i++) {
+    std::fill(lines[i].buff, lines[i].buff + lines[i].length, 0.0f);
+    lineLast[i] = 0.0f;
+  }
+  for (int ch = 0; ch < 2; ch++) {
+    for (int i = 0; i < FDN_DIFFUSER_COUNT; i++) {
+      std::fill(diffusers[ch][i].buff, diffusers[ch][i].buff + diffusers[ch][i].length, 0.0f);
+    }
+  }
+}
+
+//---- computeGains() ----
+//
+// The gain of each line is computed such that all lines decay at the
+// same rate: gain = roomSize ^ (length / reference length). The
+// normalization factor of the Hadamard matrix (1 / sqrt(8)) is folded
+// into the gains.
+
+void FdnReverb::computeGains()
+{
+  currentRoomSize = roomSize;
+  currentDamping  = damping;
+
+  float size  = roomSize > FDN_MAX_ROOM_SIZE ? FDN_MAX_ROOM_SIZE : roomSize;
+  float ratio = config.samplingRate / 44100.0f;
+
+  for (int i = 0; i < FDN_LINE_COUNT; i++) {
+    lineGain[i] = powf(size, lines[i].length / (FDN_REFERENCE_LENGTH * ratio)) /
+                  sqrtf(FDN_LINE_COUNT);
+  }
+
+  lowpassCoef = 1.0f - (damping * FDN_DAMPING_SCALE);
+}
+
+//---- readLines() ----
+//
+// Retrieve the output of each line for the whole buffer. As lines are
+// longer than a buffer, their output has been computed by previous
+// buffers processing.
+
+void FdnReverb::readLines()
+{
+  for (int i = 0; i < FDN_LINE_COUNT; i++) readLine(lines[i], block[i]);
+}
+
+//---- writeLines() ----
+//
+// Put the input of each line for the whole buffer at the place its
+// output was retrieved by readLines().
+
+void FdnReverb::writeLines()
+{
+  for (int i = 0; i < FDN_LINE_COUNT; i++) writeLine(lines[i], block[i]);
+}
+
+//---- filterLines() ----
+//
+// Apply the damping filter and the decay gain to the output of each
+// line. The filters are recursive: the lines are processed in parallel,
+// using one vector lane per line (filterRows kernel):
+//
+//   last = coef * x + (1 - coef) * last,  x = last * gain
+
+void FdnReverb::filterLines()
+{
+  float * rows[FDN_LINE_COUNT];
+
+  for (int i = 0; i < FDN_LINE_COUNT; i++) rows[i] = block[i];
+
+  simd->filterRows(rows, FDN_LINE_COUNT, lineLast, lineGain, NULL,
+                   lowpassCoef, 1.0f - lowpassCoef, BUFFER_FRAME_COUNT);
+}
+
+//---- mixLines() ----
+//
+// Retrieve the reverb output from the lines (even lines on the left,
+// odd lines on the right), feed them back through the Hadamard
+// matrix and add the diffused input signal.
+
+void FdnReverb::mixLines()
+{
+  float * rows[FDN_LINE_COUNT];
+
+  for (int i = 0; i < FDN_LINE_COUNT; i++) rows[i] = block[i];
+
+  simd->hadamard8(rows, inl, inr, outl, outr, BUFFER_FRAME_COUNT);
+}
+
+//---- processBuffer() ----
+
+void FdnReverb::processBuffer(frameRecord & send, frameRecord & ret)
+{
+  if ((roomSize != currentRoomSize) || (damping != currentDamping)) computeGains();
+
+  float wet1 = FDN_OUTPUT_GAIN * (1.0f + width) * 0.5f;
+  float wet2 = FDN_OUTPUT_GAIN * (1.0f - width) * 0.5f;
+
+  // Input diffusion, each allpass filter running over the whole buffer
+  // before the next one:
+  //
+  //   v = in + g * line,  in = line - g * v,  line = v
+
+  simd->deinterleave(inl, inr, &send[0].left, BUFFER_FRAME_COUNT, FDN_INPUT_GAIN);
+
+  for (int i = 0; i < FDN_DIFFUSER_COUNT; i++) {
+    allpassLine(diffusers[0][i], inl, apGain, 1.0f, apGain);
+    allpassLine(diffusers[1][i], inr, apGain, 1.0f, apGain);
+  }
+
+  readLines();
+  filterLines();
+  mixLines();
+  writeLines();
+
+  simd->mixWidth(&ret[0].left, outl, outr, BUFFER_FRAME_COUNT, wet1, wet2);
+}
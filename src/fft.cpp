@@ -0,0 +1,173 @@
+// Notice
+// ------
+//
+// This file is part of the Mezzo SoundFont2 Sampling Based Synthesizer:
+//
+//     https://github.com/turgu1/mezzo
+//
+// Simplified BSD License
+// ----------------------
+//
+// Copyright (c) 2018, Guy Turcotte
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// The views and conclusions contained in the software and documentation are those
+// of the authors and should not be interpreted as representing official policies,
+// either expressed or implied, of the FreeBSD Project.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "mezzo.h"
+
+FFT::FFT(int fftSize)
+{
+  setNewHandler(outOfMemory);
+
+  assert((fftSize >= 16) && ((fftSize & (fftSize - 1)) == 0));
+
+  size = fftSize;
+
+  stageCount = 0;
+  for (int n = size; n > 1; n = (n >= 4) ? n / 4 : n / 2) stageCount++;
+
+  stages = RtArena::allocateArray<stageDesc>(stageCount);
+
+  int n = size;
+  int s = 1;
+
+  for (int i = 0; i < stageCount; i++) {
+    stageDesc & st = stages[i];
+
+    st.n = n;
+    st.s = s;
+
+    if (n >= 4) {
+      int m = n / 4;
+
+      st.radix = 4;
+      st.w     = RtArena::allocateArray<float>(6 * m);
+
+      for (int p = 0; p < m; p++) {
+        for (int k = 1; k <= 3; k++) {
+          double theta = -2.0 * M_PI * k * p / n;
+          st.w[(2 * (k - 1)    ) * m + p] = cos(theta);
+          st.w[(2 * (k - 1) + 1) * m + p] = sin(theta);
+        }
+      }
+
+      n /= 4;
+      s *= 4;
+    }
+    else {
+      st.radix = 2;
+      st.w     = NULL;
+
+      n /= 2;
+      s *= 2;
+    }
+  }
+
+  workRe = RtArena::allocateArray<float>(size);
+  workIm = RtArena::allocateArray<float>(size);
+}
+
+//---- ~FFT() ----
+
+FFT::~FFT()
+{
+  for (int i = 0; i < stageCount; i++) {
+    if (stages[i].w != NULL) RtArena::release(stages[i].w);
+  }
+
+  RtArena::release(stages);
+  RtArena::release(workRe);
+  RtArena::release(workIm);
+}
+
+//----- outOfMemory() ----
+
+void FFT::outOfMemory()
+{
+  logger.FATAL("FFT: Unable to allocate memory.");
+}
+
+//---- radix4() ----
+//
+// One radix 4 stage of the Stockham algorithm. For each of the n / 4
+// twiddle positions p and each of the s sub-transforms q:
+//
+//   a = x[q + s * p],  b = x[q + s * (p + m)], ...
+//   y[q + s * (4p + k)] = w^(k * p) * Xk
+//
+// The fftRadix4 kernel loads its vectors along q when s is at least a
+// vector wide. For the first stage (s = 1) they are loaded along p: the
+// four results of each butterfly are then consecutive in y and are
+// interleaved when stored.
+
+void FFT::radix4(const stageDesc & st, const float * xr, const float * xi, float * yr, float * yi)
+{
+  simd->fftRadix4(st.n, st.s, st.w, xr, xi, yr, yi);
+}
+
+//---- radix2() ----
+//
+// Last stage when the size is not a power of 4. There is only one
+// twiddle position and its twiddle is 1.
+
+void FFT::radix2(const stageDesc & st, const float * xr, const float * xi, float * yr, float * yi)
+{
+  simd->fftRadix2(st.s, xr, xi, yr, yi);
+}
+
+//---- forward() ----
+//
+// Each stage reads from one buffer and writes to the other. The result
+// is copied back to the caller's arrays if it ends up in the work
+// buffers.
+
+void FFT::forward(float * re, float * im)
+{
+  float * xr = re,     * xi = im;
+  float * yr = workRe, * yi = workIm;
+
+  for (int i = 0; i < stageCount; i++) {
+    if (stages[i].radix == 4) {
+      radix4(stages[i], xr, xi, yr, yi);
+    }
+    else {
+      radix2(stages[i], xr, xi, yr, yi);
+    }
+
+    std::swap(xr, yr);
+    std::swap(xi, yi);
+  }
+
+  if (xr != re) {
+    memcpy(re, xr, size * sizeof(float));
+    memcpy(im, xi, size * sizeof(float));
+  }
+}
@@ -0,0 +1,159 @@
+// Notice
+// ------
+//
+// This file is part of the Mezzo SoundFont2 Sampling Based Synthesizer:
+//
+//     https://github.com/turgu1/mezzo
+//
+// Simplified BSD License
+// ----------------------
+//
+// Copyright (c) 2018, Guy Turcotte
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// The views and conclusions contained in the software and documentation are those
+// of the authors and should not be interpreted as representing official policies,
+// either expressed or implied, of the FreeBSD Project.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mezzo.h"
+
+const int FreeVerb::comb_m[REVERB_COMB_COUNT] = {
+  1557, 1617, 1491, 1422, 1277, 1356, 1188, 1116
+};
+
+const int FreeVerb::ap_m[REVERB_AP_COUNT] = {
+  225, 556, 441, 341
+};
+
+FreeVerb::FreeVerb()
+{
+  for (int i = 0; i < 2 * REVERB_COMB_COUNT; i++) {
+
+    // The right combs are 23 frames longer
+
+    int frameCount = comb_m[i % REVERB_COMB_COUNT] + ((i < REVERB_COMB_COUNT) ? 0 : 23);
+
+    combs[i].buff   = RtArena::allocateArray<sample_t>(frameCount);
+    combs[i].length = frameCount;
+    combs[i].pos    = 0;
+    std::fill(combs[i].buff, combs[i].buff + frameCount, 0.0f);
+
+    combLast[i] = 0.0f;
+    combGain[i] = 1.0f;
+  }
+
+  for (int ch = 0; ch < 2; ch++) {
+    for (int i = 0; i < REVERB_AP_COUNT; i++) {
+
+      int frameCount = ap_m[i];
+
+      aps[ch][i].buff   = RtArena::allocateArray<sample_t>(frameCount);
+      aps[ch][i].length = frameCount;
+      aps[ch][i].pos    = 0;
+      std::fill(aps[ch][i].buff, aps[ch][i].buff + frameCount, 0.0f);
+    }
+  }
+}
+
+//---- create() ----
+
+Reverb * FreeVerb::create()
+{
+  return new FreeVerb;
+}
+
+//---- ~FreeVerb() ----
+
+FreeVerb::~FreeVerb()
+{
+  for (int i = 0; i < 2 * REVERB_COMB_COUNT; i++) {
+    RtArena::release(combs[i].buff);
+  }
+  for (int ch = 0; ch < 2; ch++) {
+    for (int i = 0; i < REVERB_AP_COUNT; i++) {
+      RtArena::release(aps[ch][i].buff);
+    }
+  }
+}
+
+//---- clear() ----
+
+void FreeVerb::clear()
+{
+  for (int i = 0; i < 2 * REVERB_COMB_COUNT; i++) {
+    std::fill(combs[i].buff, combs[i].buff + combs[i].length, 0.0f);
+    combLast[i] = 0.0f;
+  }
+  for (int ch = 0; ch < 2; ch++) {
+    for (int i = 0; i < REVERB_AP_COUNT; i++) {
+      std::fill(aps[ch][i].buff, aps[ch][i].buff + aps[ch][i].length, 0.0f);
+    }
+  }
+}
+
+//---- processBuffer() ----
+//
+// The comb filters (filterRows kernel), the same input going to all of
+// them:
+//
+//   yn = input + roomSize * (yn_m - damping * (yn_m - last))
+//      = input + roomSize * (1 - damping) * yn_m + roomSize * damping * last
+//
+// The sum of the combs of each channel then goes through its allpass
+// filters:
+//
+//   vn = out + apGain * vn_m,  out = (1 + apGain) * vn_m - vn
+
+void FreeVerb::processBuffer(frameRecord & send, frameRecord & ret)
+{
+  float * rows[2 * REVERB_COMB_COUNT];
+
+  for (int fr = 0; fr < BUFFER_FRAME_COUNT; fr++) {
+    input[fr] = (send[fr].left + send[fr].right) * 0.015f;
+  }
+
+  for (int i = 0; i < 2 * REVERB_COMB_COUNT; i++) {
+    readLine(combs[i], block[i]);
+    rows[i] = block[i];
+  }
+
+  simd->filterRows(rows, 2 * REVERB_COMB_COUNT, combLast, combGain, input,
+                   roomSize * (1.0f - damping), roomSize * damping, BUFFER_FRAME_COUNT);
+
+  for (int i = 0; i < 2 * REVERB_COMB_COUNT; i++) writeLine(combs[i], block[i]);
+
+  simd->sumRows(outl, rows,                     REVERB_COMB_COUNT, BUFFER_FRAME_COUNT);
+  simd->sumRows(outr, rows + REVERB_COMB_COUNT, REVERB_COMB_COUNT, BUFFER_FRAME_COUNT);
+
+  for (int i = 0; i < REVERB_AP_COUNT; i++) {
+    allpassLine(aps[0][i], outl, apGain, 1.0f + apGain, 1.0f);
+    allpassLine(aps[1][i], outr, apGain, 1.0f + apGain, 1.0f);
+  }
+
+  simd->mixWidth(&ret[0].left, outl, outr, BUFFER_FRAME_COUNT, 1.0f, 0.0f);
+}
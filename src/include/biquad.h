@@ -41,55 +41,117 @@
 
 #include "mezzo.h"
 
-// The algorithm come from the following url:
+// The per voice resonant low-pass filter, as defined by the SF2
+// specification. The algorithm come from the following url:
 //
 //    http://www.musicdsp.org/files/Audio-EQ-Cookbook.txt
 //
-// Two biQuad IIR parameters have been used:
-// 1. The biQuad parameters computation as a by-product of the following:
+// The cutoff frequency is the initialFilterFc generator, modulated by the
+// modulation envelope and the modulation LFO. It is updated once every
+// CONTROL_BLOCK_SIZE samples. As the cutoff is expressed in cents, the
+// sine and cosine of the corresponding angular frequency are taken from a
+// table built at startup, with an entry every FILTER_TABLE_STEP cents.
 //
-//   http://www.earlevel.com/main/2012/11/26/biquad-c-source-code/
+// The resonance (initialFilterQ) is the height of the peak at the cutoff
+// frequency, in centibels above the DC gain. The output is attenuated by
+// the same amount to keep the voice level.
 //
-// 2. The Butterworth parameters computation comes from the book "The Audio
-// Programming Book" by Richard Boulanger and Al., table 6.1
-//
-// Not sure if the end-state of it is the right one. Seems to be
-// similar to the one used in the Polyphone program.
+// The recursion of the filter is computed four samples at a time: the
+// four outputs are a linear combination of the four inputs (through the
+// filter's impulse response) and of the last two outputs. The
+// corresponding vectors are computed with the coefficients.
+
+#define FILTER_MIN_CENTS   1500
+#define FILTER_MAX_CENTS  13500
+#define FILTER_TABLE_STEP    10
+#define FILTER_TABLE_SIZE  (((FILTER_MAX_CENTS - FILTER_MIN_CENTS) / FILTER_TABLE_STEP) + 1)
 
 class BiQuad
 {
 private:
-  bool active;              // This instance
-  static bool allActive;  // For all instances
+  static bool  allActive;   // For all instances
+  static bool  tableReady;
+  static float sinTable[FILTER_TABLE_SIZE];
+  static float cosTable[FILTER_TABLE_SIZE];
+
+  int16_t initialFc;        // cents
+  int16_t initialQ;         // cB
+  int16_t modEnvToFc;       // cents at the envelope peak
+  int16_t modLfoToFc;       // cents at the LFO peak
+  int16_t modFc;            // Variations from the modulators since the note-on
+  int16_t modQ;
+
+  bool    active;           // This instance
+  int     currentIdx;       // Table entry of the current coefficients
+  float   invTwoQ;
+  float   gain;
 
-  float initialFc;
-  float initialQ;
-  float a1, a2, b0, b1, b2;
-  float x1, x2, y1, y2;
-  float gain;
+  float   b0, a1, a2;       // Normalized on a0. b1 = 2 * b0, b2 = b0
+  float   h[4][4];          // Impulse response, shifted by 0 to 3 samples
+  float   g1[4];            // Response to the last output
+  float   g2[4];            // Response to the output before last
+  float   x1, x2, y1, y2;
+
+  static void buildTable();
+  void computeQ();
 
 public:
   BiQuad()
   {
-    // initialFc = centsToRatio(13500) / config.samplingRate;
-    initialFc = 13500;
-    initialQ  =  0.0f;
-    active    = false;
-    gain      =  1.3f;
+    initialFc  = FILTER_MAX_CENTS;
+    initialQ   = 0;
+    modEnvToFc = 0;
+    modLfoToFc = 0;
+    modFc      = 0;
+    modQ       = 0;
+    active     = false;
   }
 
-  inline void setInitialFc  (int16_t fc) { initialFc  = fc; }
-  inline void addToInitialFc(int16_t fc) { initialFc += fc; }
-  inline void setInitialQ   (int16_t  q) { initialQ   =  q; }
-  inline void addToInitialQ (int16_t  q) { initialQ  +=  q; }
+  inline void setInitialFc   (int16_t fc) { initialFc   = fc; }
+  inline void addToInitialFc (int16_t fc) { initialFc  += fc; }
+  inline void setInitialQ    (int16_t  q) { initialQ    =  q; }
+  inline void addToInitialQ  (int16_t  q) { initialQ   +=  q; }
+  inline void setModEnvToFc  (int16_t fc) { modEnvToFc  = fc; }
+  inline void addToModEnvToFc(int16_t fc) { modEnvToFc += fc; }
+  inline void setModLfoToFc  (int16_t fc) { modLfoToFc  = fc; }
+  inline void addToModLfoToFc(int16_t fc) { modLfoToFc += fc; }
 
   static bool toggleAllActive() { return allActive = !allActive; }
   static bool areAllActive   () { return allActive;              }
 
+  inline bool isActive()      { return allActive && active; }
+  inline bool usesModEnv()    { return modEnvToFc != 0;     }
+  inline bool usesModLfo()    { return modLfoToFc != 0;     }
+
+  /// Prepare the filter for a new note.
   void setup();
-  void        computeParams (float freq, float Q);
-  void filter(sampleRecord & src, uint16_t length);
+
+  /// Set the cutoff frequency from the modulation envelope (0 .. 1) and
+  /// LFO (-1 .. 1) values.
+  void update(float modEnv, float modLfo);
+
+  /// Cutoff (cents) and resonance (cB) variations from the modulators
+  /// while the note is sounding.
+  void setModulation(int16_t fc, int16_t q);
+
+  /// Coefficients and state, for the voice bank that runs the filters
+  /// of four voices at a time.
+  inline float getB0() { return b0; }
+  inline float getA1() { return a1; }
+  inline float getA2() { return a2; }
+
+  inline void getState(float & _x1, float & _x2, float & _y1, float & _y2) {
+    _x1 = x1; _x2 = x2; _y1 = y1; _y2 = y2;
+  }
+  inline void setState(float _x1, float _x2, float _y1, float _y2) {
+    x1 = _x1; x2 = _x2; y1 = _y1; y2 = _y2;
+  }
+
+  /// Filter length samples in place. With NEON intrinsics, length must be
+  /// a multiple of 4.
+  void filter(buffp src, uint16_t length);
+
   void showStatus(int spaces);
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,129 @@
+// Notice
+// ------
+//
+// This file is part of the Mezzo SoundFont2 Sampling Based Synthesizer:
+//
+//     https://github.com/turgu1/mezzo
+//
+// Simplified BSD License
+// ----------------------
+//
+// Copyright (c) 2018, Guy Turcotte
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// The views and conclusions contained in the software and documentation are those
+// of the authors and should not be interpreted as representing official policies,
+// either expressed or implied, of the FreeBSD Project.
+//
+
+#ifndef _CHANNEL_
+#define _CHANNEL_
+
+#include <atomic>
+
+#define MIDI_CHANNEL_COUNT 16   ///< Number of MIDI channels managed by the engine
+
+/// A Channel keeps the state of a single MIDI channel: the preset that
+/// is playing on it, its controllers, the sustain pedal and the pitch
+/// bend. All channels are sharing the voices pool of the Poly class.
+/// Voices keep a pointer on the channel that started them such that
+/// controller changes are followed while the notes are sounding.
+
+class Channel : public RtArenaSupport<Channel> {
+
+ private:
+  uint8_t   nbr;                ///< Channel number (0..15)
+  Preset  * preset;             ///< The preset selected for this channel
+  uint8_t   controllers[128];   ///< Last value received for each controller
+  int16_t   pitchBend;          ///< Pitch wheel position (-8192..8191)
+  uint8_t   pitchBendRange;     ///< Pitch wheel sensitivity in semitones (RPN 0)
+  uint8_t   pressure;           ///< Channel aftertouch
+  bool      sustainOn;          ///< True if the sustain pedal is depressed
+  bool      percussion;         ///< True if this is the General MIDI drum channel
+
+  volatile uint32_t serial;     ///< Incremented when a source of the voices modulators changes
+
+  std::atomic<int> voiceCount;  ///< Number of active voices started on this channel
+
+  inline void stateChanged() { serial = serial + 1; }
+
+  void dataEntry();
+
+  static void  outOfMemory();  ///< New operation handler when out of memory occurs
+
+ public:
+   Channel();
+  ~Channel();
+
+  /// Put the channel controllers back to their power-up state, as
+  /// described in MIDI Recommended Practice RP-015.
+  void resetControllers();
+
+  void setNbr(uint8_t n, bool isPercussion);
+
+  /// Select the preset to be played on this channel. The preset is
+  /// loaded if not already in use by another channel and the previous one is
+  /// released.
+  bool setPreset(Preset * p);
+
+  /// Process a MIDI program change, using the currently selected bank.
+  bool programChange(uint8_t midiNbr);
+
+  void setController(uint8_t ctrl, uint8_t value);
+  void setPitchBend(int16_t value);
+  void setSustain(bool on);
+
+  void noteOn(uint8_t note, uint8_t velocity);
+  void noteOff(uint8_t note);
+
+  void showStatus(int spaces);
+
+  inline uint8_t  getNbr()            { return nbr;                 }
+  inline Preset * getPreset()         { return preset;              }
+  inline bool     isSustainOn()       { return sustainOn;           }
+  inline bool     isPercussion()      { return percussion;          }
+  inline uint8_t  getController(uint8_t ctrl) { return controllers[ctrl & 0x7F]; }
+  inline int16_t  getPitchBend()      { return pitchBend;           }
+  inline uint8_t  getPressure()       { return pressure;            }
+  inline uint8_t  getPitchBendRange() { return pitchBendRange;      }
+  void            setPressure(uint8_t value);
+
+  /// Voices are following the controllers through their modulators (see
+  /// modulator.h). They evaluate them again when the serial changes.
+  inline uint32_t getSerial()         { return serial;              }
+
+  /// Returns the bank to be used for program changes. Bank select MSB
+  /// (CC 0) is used as most sequencers do. Controllers sending only the
+  /// LSB (CC 32) are supported as before. The percussion channel
+  /// always uses the SF2 percussion bank (128).
+  inline uint16_t getBankNbr() {
+    if (percussion) return 128;
+    return controllers[0x00] ? controllers[0x00] : controllers[0x20];
+  }
+
+  inline int  getVoiceCount()  { return voiceCount; }
+  inline void incVoiceCount()  { voiceCount++;      }
+  inline void decVoiceCount()  { voiceCount--;      }
+};
+
+#endif
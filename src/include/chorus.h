@@ -0,0 +1,123 @@
+// Notice
+// ------
+//
+// This file is part of the Mezzo SoundFont2 Sampling Based Synthesizer:
+//
+//     https://github.com/turgu1/mezzo
+//
+// Simplified BSD License
+// ----------------------
+//
+// Copyright (c) 2018, Guy Turcotte
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// The views and conclusions contained in the software and documentation are those
+// of the authors and should not be interpreted as representing official policies,
+// either expressed or implied, of the FreeBSD Project.
+//
+
+#ifndef _CHORUS_
+#define _CHORUS_
+
+// This module implements a stereo chorus effect. It is fed by the chorus
+// send bus, where voices are mixed as per their SF2 chorus send amount.
+// Its output is added to the dry signal.
+//
+// Each channel has its own delay line, read by four taps. The delay of each
+// tap is modulated by a sine LFO, the four taps being 90 degrees apart. The
+// four taps of a channel are processed in a single vector: delays,
+// fractional positions and linear interpolations are computed for the four
+// taps at once. The LFOs are computed by rotating the (sin, cos) vectors
+// of the taps at each frame, such that no trigonometric function has to be
+// computed in the processing loop.
+//
+// Parameters (all 0 .. 1.0):
+//
+//   level     Level of the chorus signal added to the dry signal
+//   rate      LFO frequency, from 0.1 to 5 Hz
+//   depth     Delay modulation, up to +/- 5 ms around the center delays
+//   feedback  Proportion of the chorus output fed back to the delay lines
+//   width     Stereo separation of the chorus signal
+
+#define CHORUS_TAP_COUNT      4
+#define CHORUS_SILENCE        1.0e-5f  ///< Output level (-100 dB) under which the chorus is silent
+#define CHORUS_IDLE_BUFFERS   8        ///< Silent buffers before idle, longer than the delay lines
+
+class Chorus : public RtArenaSupport<Chorus> {
+
+ private:
+  static const float centerDelays[CHORUS_TAP_COUNT];
+
+  struct channelState {
+    buffp buff;                          // Delay line
+    float sinv[CHORUS_TAP_COUNT];        // LFO of each tap
+    float cosv[CHORUS_TAP_COUNT];
+  };
+
+  channelState channels[2];
+
+  int   lineMask;       // Delay lines length - 1 (a power of 2)
+  int   writePos;       // Next position to write in the delay lines
+  float phase;          // LFO phase of the first tap of the left channel
+
+  float level;          // 0 .. 1.0
+  float rate;           // 0 .. 1.0
+  float depth;          // 0 .. 1.0
+  float feedback;       // 0 .. 1.0
+  float width;          // 0 .. 1.0
+
+  bool  idle;           // True when nothing has been sent for a while
+  int   silentCount;
+
+  frameRecord silence;  // Send bus used to process the end of the sound
+  frameRecord ret;      // Chorus signal
+
+  static void outOfMemory();
+  void adjustValue(char ch);
+  void setupLfos(float increment);
+  void clear();
+  float processChannel(channelState & chan, frameRecord & send, bool right, float increment);
+
+ public:
+   Chorus();
+  ~Chorus();
+
+  inline void  setLevel(float value)    { level    = value; }
+  inline void  setRate(float value)     { rate     = value; }
+  inline void  setDepth(float value)    { depth    = value; }
+  inline void  setFeedback(float value) { feedback = value; }
+  inline void  setWidth(float value)    { width    = value; }
+
+  inline float getLevel()    { return level;    }
+  inline float getRate()     { return rate;     }
+  inline float getDepth()    { return depth;    }
+  inline float getFeedback() { return feedback; }
+  inline float getWidth()    { return width;    }
+
+  /// Add the chorus of the send bus to buff. A NULL send means that no
+  /// voice has been sent to the chorus.
+  void process(frameRecord & buff, frameRecord * send);
+  void interactiveAdjust();
+};
+
+#endif
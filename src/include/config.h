@@ -66,10 +66,14 @@ private:
 public:
   po::variables_map configMap;
   std::string configFile;
-  std::string soundFontFilename;
+  std::vector<std::string> soundFontFilenames;  ///< The sound font files, in priority order
+  std::vector<int>         sf2BankOffsets;      ///< Bank offset of each sound font file
 
   std::string sf2Folder;
-  std::string inputSf2;
+  std::string sf2IndexFolder;
+  bool        sf2IndexEnabled;
+  int         sampleLoaderThreads;
+  std::vector<std::string> inputSf2;
 
   uint32_t samplingRate;
   bool     replayEnabled;
@@ -93,16 +97,37 @@ public:
   int         midiChannel;
   int         midiSustainTreshold;
   int         midiTranspose;
+  int         midiDrumChannel;
 
+  std::string reverbEngine;
+  std::string reverbIrFile;
   float reverbRoomSize;
   float reverbDamping;
   float reverbWidth;
   float reverbDryWet;
   float reverbApGain;
 
+  float chorusLevel;
+  float chorusRate;
+  float chorusDepth;
+  float chorusFeedback;
+  float chorusWidth;
+
   std::string pcmDeviceName;
   std::string lcdKeypadDeviceName;
 
+  int         metricsPort;      ///< localhost TCP port of the metrics exporter, 0 for none
+  std::string metricsSocket;    ///< Unix socket path of the metrics exporter, empty for none
+
+  std::string simdBackend;      ///< Vector kernels backend name (simd.h), "auto" for the best one
+
+  // Real-time setup of the threads per role (scheduling.h): processor list
+  // (empty for all) and SCHED_FIFO priority (0 for the normal scheduling)
+
+  std::string audioCpus,  renderCpus,  midiCpus,  ioCpus,  uiCpus;
+  int         audioPriority, renderPriority, midiPriority, ioPriority, uiPriority;
+  bool        lockMemory;       ///< Lock and fault in all memory of the process
+
   uint16_t    volume;
   float       masterVolume;
 
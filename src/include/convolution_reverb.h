@@ -0,0 +1,164 @@
+// Notice
+// ------
+//
+// This file is part of the Mezzo SoundFont2 Sampling Based Synthesizer:
+//
+//     https://github.com/turgu1/mezzo
+//
+// Simplified BSD License
+// ----------------------
+//
+// Copyright (c) 2018, Guy Turcotte
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// The views and conclusions contained in the software and documentation are those
+// of the authors and should not be interpreted as representing official policies,
+// either expressed or implied, of the FreeBSD Project.
+//
+
+#ifndef _CONVOLUTION_REVERB_
+#define _CONVOLUTION_REVERB_
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <atomic>
+#include <vector>
+
+// This module implements a convolution reverb. The send bus is convolved
+// with the impulse response of a real room, loaded from the WAV file
+// named by the reverb-ir-file configuration parameter. Mono and stereo
+// files are accepted, as 16, 24 or 32 bits integers or 32 bits floats.
+//
+// The convolution is done in the frequency domain with a uniformly
+// partitioned overlap-save algorithm. The impulse response is cut in
+// partitions of a frame buffer length, each being transformed once at
+// load time. The spectrum of each send buffer is kept in a frequency
+// domain delay line and the output spectrum is the sum of the products
+// of the last spectra by the corresponding partitions. A good
+// documentation on this algorithm is available at the following link:
+//
+//    http://www.ericbattenberg.com/school/partconvDAFx2011.pdf
+//
+// The left channel is put in the real part and the right channel in the
+// imaginary part of the signal, such that one complex FFT gives the
+// spectra of both channels, and one inverse FFT gives both outputs.
+//
+// Only the head (the first CONV_HEAD_PARTITIONS partitions) is computed
+// by the audio thread. The remaining of the output spectrum of a buffer
+// only depends on send buffers that are at least CONV_HEAD_PARTITIONS
+// buffers older. It is computed by a worker thread while the previous
+// buffers are being played, and is usually ready when required. The
+// audio thread never waits for the worker: the jobs are numbered by
+// buffer, and a tail that is not ready on time is left out of the output
+// of its buffer. No job is started while the worker is busy. The tails
+// left out are counted in the metrics.
+//
+// Parameters are mapped as follow:
+//
+//   width     Stereo separation of the wet signal.
+//   dryWet    Proportion of the dry vs wet signal.
+//
+// The other parameters are defined by the impulse response.
+
+#define CONV_HEAD_PARTITIONS  2
+#define CONV_FFT_SIZE         (2 * BUFFER_FRAME_COUNT)
+#define CONV_BIN_COUNT        (BUFFER_FRAME_COUNT + 4)  ///< N / 2 + 1 bins, rounded to a vector
+#define CONV_TAIL_SLOTS       (CONV_HEAD_PARTITIONS + 1)
+#define CONV_MAX_SECONDS      10                        ///< Impulse responses are cut at this length
+#define CONV_OUTPUT_GAIN      1.2f                      ///< Gain of an impulse response of unit energy
+
+class ConvolutionReverb : public Reverb {
+
+ private:
+
+  /// Half spectrum of both channels. Only the first N / 2 + 1 bins are
+  /// kept, as the signals are real.
+  struct spectrum {
+    float lr[CONV_BIN_COUNT];
+    float li[CONV_BIN_COUNT];
+    float rr[CONV_BIN_COUNT];
+    float ri[CONV_BIN_COUNT];
+  };
+
+  FFT      * fft;
+  int        partitionCount;
+  spectrum * filters;                   // Spectra of the impulse response partitions
+  spectrum * inputs;                    // Frequency domain delay line, one entry per partition
+  int        position;                  // Entry of the current buffer in inputs
+  spectrum   tails[CONV_TAIL_SLOTS];    // Tail part of the output spectra, from the worker
+  int        tailSlot;                  // Entry of the current buffer in tails
+  spectrum   sum;
+
+  float timeRe[CONV_FFT_SIZE];
+  float timeIm[CONV_FFT_SIZE];
+  float lastLeft[BUFFER_FRAME_COUNT];   // Previous send buffer, for the overlap
+  float lastRight[BUFFER_FRAME_COUNT];
+
+  pthread_t       thread;
+  bool            threadStarted;
+  sem_t           workReady;            // Posted by the audio thread for each job
+  std::atomic<bool>     stopping;
+  std::atomic<uint32_t> bufferNbr;      // Number of the current buffer
+  std::atomic<uint32_t> jobRequested;   // Buffer number of the last job started
+  std::atomic<uint32_t> jobDone;        // Buffer number of the last job completed
+  std::atomic<uint32_t> tailJobs[CONV_TAIL_SLOTS]; // Buffer number of the job that filled each tail
+  int             jobPosition;          // Set before jobRequested, when the worker is idle
+  int             jobSlot;
+  uint32_t        firstJob;             // First buffer number since clear(), whose tail is expected
+
+  static bool loadImpulse(const std::string & filename,
+                          std::vector<float> & left,
+                          std::vector<float> & right);
+
+  void toSpectrum(spectrum & spec, float scale);
+  void fromSpectrum(spectrum & spec);
+  static void multiplyAdd(spectrum & dst, const spectrum & x, const spectrum & h);
+  bool computeTail(int pos, int slot, uint32_t job);
+  void startTail(uint32_t job);
+  bool isTailReady(uint32_t job);
+
+  static void * worker(void * args);
+  void work();
+
+ protected:
+  void processBuffer(frameRecord & send, frameRecord & ret);
+  void clear();
+
+ public:
+   ConvolutionReverb(std::vector<float> & left, std::vector<float> & right);
+  ~ConvolutionReverb();
+
+  /// Return a new convolution reverb, or NULL if the impulse response
+  /// cannot be loaded.
+  static Reverb * create();
+
+  const char * getName() { return "Convolution"; }
+
+  /// True when the worker thread has no job in progress. Used by the
+  /// checks, to wait for every tail.
+  inline bool isWorkerIdle() {
+    return jobDone.load(std::memory_order_acquire) == jobRequested.load(std::memory_order_relaxed);
+  }
+};
+
+#endif
@@ -69,6 +69,10 @@ private:
   float amplitude;
   float sustain;
 
+  bool  blockReady;       // blockCoef and blockBase are valid for the current state
+  float blockCoef;        // coef and base for a whole control block
+  float blockBase;
+
   volatile bool keyReleased;
 
 public:
@@ -94,6 +98,7 @@ public:
     release       = centsToSampleCount(-3600);
 
     state         = START;
+    blockReady    = false;
   }
 
   static bool toggleAllActive() { return allActive = !allActive; }
@@ -156,6 +161,20 @@ public:
     }
   }
 
+  // The sustain level of the modulation envelope is expressed in 0.1% of
+  // decrease from full level.
+
+  inline void setLinearSustain(int32_t s)
+  {
+    sustain = 1.0f - (Utils::checkRange(s, 0, 1000, 0) / 1000.0f);
+  }
+
+  inline void addToLinearSustain(int32_t s)
+  {
+    sustain -= s / 1000.0f;
+    if (sustain < 0.0f) sustain = 0.0f; else if (sustain > 1.0f) sustain = 1.0f;
+  }
+
   inline float computeCoef(float ratio, uint32_t ticks)
   {
     return exp(-log((1.0f + ratio) / ratio) / ticks);
@@ -170,6 +189,13 @@ public:
 
   inline bool keyIsReleased() { return keyReleased; }
 
+  /// True if the level is under the given one and cannot rise anymore:
+  /// from the decay on, the level is only going down.
+  inline bool isFadedUnder(float level)
+  {
+    return allActive && (state >= DECAY) && (amplitude < level);
+  }
+
   /// When the key has been released by the player, prepare for the
   /// release portion of the envelope. A quick release means a shortened
   /// period to go to a 0 amplitude. If the envelope is inactive (as requested
@@ -184,8 +210,21 @@ public:
     return false;
   }
 
+  inline void startRelease()
+  {
+    state = release == 0 ? OFF : RELEASE;
+    ticks = release;
+    ratio = 0.0001;
+    coef  = computeCoef(ratio, ticks);
+    base  = (- ratio) * (1.0f - coef);
+
+    blockReady = false;
+  }
+
   inline void nextState()
   {
+    blockReady = false;
+
     switch (++state) {
       case DELAY:
         if (delay > 0) {
@@ -259,12 +298,7 @@ public:
     if (state >= OFF) return true;
 
     if (keyReleased && (state < RELEASE)) {
-      state = release == 0 ? OFF : RELEASE;
-      ticks = release;
-      ratio = 0.0001;
-      coef  = computeCoef(ratio, ticks);
-      base  = (- ratio) * (1.0f - coef);
-
+      startRelease();
       if (state >= OFF) return true;
     }
 
@@ -277,35 +311,31 @@ public:
       static const float zero = 0.0f;
       static const float one  = 1.0f;
 
-      coefs[0] = coef;
-      coefs[1] = coef * coef;
-      coefs[2] = coefs[1] * coef;
-      coefs[3] = coefs[2] * coef;
-
-      bases[0] = base;
-      bases[1] = base + (base * coef);
-      bases[2] = bases[1] + (base * coefs[1]);
-      bases[3] = bases[2] + (base * coefs[2]);
-
-      float32x4_t vcoefs = vld1q_f32(coefs);
-      float32x4_t vbases = vld1q_f32(bases);
-
       float32x4_t vzeros = vld1q_dup_f32(&zero);
       float32x4_t vones  = vld1q_dup_f32(&one);
 
-      for (int i = 0; i < length; i += 4) {
+      // Computed at the first group of four samples (stateChanged)
+      float32x4_t vcoefs = vzeros;
+      float32x4_t vbases = vzeros;
 
-        float32x4_t vamplitudes = vld1q_dup_f32(&amplitude);
-        float32x4_t vres        = vmlaq_f32(vbases, vamplitudes, vcoefs);
-        vres                    = vminq_f32(vres, vones);
-        vres                    = vmaxq_f32(vres, vzeros);
+      bool stateChanged = true;
 
-        vst1q_f32(&amps[i], vres);
-        amplitude = amps[i + 3];
+      for (int i = 0; i < length; i += 4) {
 
-        if (ticks <= 4) {
-          nextState();
+        // A state change inside these four samples: they are computed one
+        // at a time, as the scalar version does, for the change to happen
+        // on the exact sample.
+
+        if (ticks < 4) {
+          for (int j = i; j < (i + 4); j++) {
+            if (ticks-- == 0) nextState();
+            amps[j] = amplitude = MAX(MIN(1.0f, base + amplitude * coef), 0.0f);
+          }
+          stateChanged = true;
+          continue;
+        }
 
+        if (stateChanged) {
           coefs[0] = coef;
           coefs[1] = coef     * coef;
           coefs[2] = coefs[1] * coef;
@@ -318,10 +348,19 @@ public:
 
           vcoefs = vld1q_f32(coefs);
           vbases = vld1q_f32(bases);
+
+          stateChanged = false;
         }
-        else {
-          ticks -= 4;
-        }
+
+        float32x4_t vamplitudes = vld1q_dup_f32(&amplitude);
+        float32x4_t vres        = vmlaq_f32(vbases, vamplitudes, vcoefs);
+        vres                    = vminq_f32(vres, vones);
+        vres                    = vmaxq_f32(vres, vzeros);
+
+        vst1q_f32(&amps[i], vres);
+        amplitude = amps[i + 3];
+
+        ticks -= 4;
       }
     #else
       for (int i = 0; i < length; i++) {
@@ -334,6 +373,40 @@ public:
     return state == OFF;
   }
 
+  // Advance the envelope by a control block and return its level. State
+  // changes are taken at the control block boundaries. Used for the
+  // modulation envelope, whose level is only needed at control rate.
+  //
+  // After n samples, amplitude = amplitude * coef^n + base * (1 - coef^n) / (1 - coef).
+  inline float nextControlValue()
+  {
+    if (!allActive) return 0.0f;
+
+    if (keyReleased && (state < RELEASE)) startRelease();
+
+    if (state >= OFF) return 0.0f;
+
+    if (ticks <= CONTROL_BLOCK_SIZE) {
+      nextState();
+      if (state >= OFF) return 0.0f;
+    }
+    else {
+      ticks -= CONTROL_BLOCK_SIZE;
+    }
+
+    if (!blockReady) {
+      blockCoef  = powf(coef, CONTROL_BLOCK_SIZE);
+      blockBase  = (coef == 1.0f) ? (base * CONTROL_BLOCK_SIZE) :
+                                    (base * (1.0f - blockCoef) / (1.0f - coef));
+      blockReady = true;
+    }
+
+    amplitude = blockBase + (amplitude * blockCoef);
+    if (amplitude < 0.0f) amplitude = 0.0f; else if (amplitude > 1.0f) amplitude = 1.0f;
+
+    return amplitude;
+  }
+
   void showStatus(int spaces) ;
 };
 
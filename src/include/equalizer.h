@@ -39,61 +39,50 @@
 #ifndef _EQUALIZER_
 #define _EQUALIZER_
 
-// A very simple form of a 7 bands equalizer. 
-// IIR Filter algorithm and equalizer coefficients from the following book:
+// A 7 bands parametric equalizer. Each band is a peaking filter, whose
+// coefficients come from the following url:
 //
-// Paul M. Embree, C Algorithms for Real-Time DSP, 1995
+//    http://www.musicdsp.org/files/Audio-EQ-Cookbook.txt
 //
-// TODO: Neon Intrinsics Optimization
+// The bands are applied in cascade. To compute the cascade with vector
+// instructions, each band is given a vector lane: at each frame, the
+// output of a band from the previous frame is shifted to the lane of the
+// next band, such that all bands are computed at once. This is the
+// filterCascade kernel of the selected SIMD backend (see simd.h), whose
+// SIMD_CASCADE_LANES lanes hold the 7 bands (the eighth lane is unused).
+// The output is then delayed by 6 frames, the time for a frame to go
+// through the cascade.
+//
+// Gains are between -1.0 and 1.0, mapped to -EQ_MAX_DB .. EQ_MAX_DB. The
+// coefficients are recomputed when a gain is changed. When all gains
+// are 0, the equalizer is not run.
 
-#define BAND_COUNT 7
+#define BAND_COUNT (SIMD_CASCADE_OUTPUT + 1)
+#define EQ_MAX_DB  12.0f
+#define EQ_Q       1.0f  ///< About 1.3 octave bandwidth, the distance between bands
 
-class Equalizer {
+class Equalizer : public RtArenaSupport<Equalizer> {
 
  private:
-  static float  leftHist[BAND_COUNT][2];
-  static float rightHist[BAND_COUNT][2];
-  static float      gain[BAND_COUNT];
-
-  static const float bpf[BAND_COUNT][5];  // Bandpass Filter Coefficients
-
-  float  iirFilter(float input, const float *coef, int n, float *history);
-  void adjustGain(char c);
+  static const float freqs[BAND_COUNT];
 
-  // Optimized version (when n == 1 and coefficients 4 and 5 are 0 and -1)
-  inline float iirFilter2(float input, const float *coef, float *history)
-  {
-    const float *coefPtr;
-    float *hist1Ptr, *hist2Ptr;
-    float output, newHist, history1, history2;
-  
-    coefPtr = coef;
+  float gain[BAND_COUNT];
+  float currentGain[BAND_COUNT];   // Gains used to compute the coefficients
+  bool  bypass;
 
-    hist1Ptr = history;
-    hist2Ptr = hist1Ptr + 1;
+  SimdCascade      coefs;      // Coefficients per lane, normalized on a0
+  SimdCascadeState state[2];   // Filters state per channel
 
-    output = input * *coefPtr++;
+  static void outOfMemory();
 
-    history1 = *hist1Ptr;
-    history2 = *hist2Ptr;
-    
-    output -= history1 * *coefPtr++;
-    newHist = output - history2 * *coefPtr;
-
-    output  = newHist;
-    output -= history2;
-
-    *hist2Ptr = *hist1Ptr;
-    *hist1Ptr = newHist;
-
-    return output;
-  }
+  void computeCoefficients();
+  void adjustGain(char c);
 
  public:
    Equalizer();
   ~Equalizer();
 
-  void process(buffp buff, int frameCount);
+  void process(frameRecord & buff);
   void interactiveAdjust();
 };
 
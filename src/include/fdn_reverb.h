@@ -0,0 +1,120 @@
+// Notice
+// ------
+//
+// This file is part of the Mezzo SoundFont2 Sampling Based Synthesizer:
+//
+//     https://github.com/turgu1/mezzo
+//
+// Simplified BSD License
+// ----------------------
+//
+// Copyright (c) 2018, Guy Turcotte
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// The views and conclusions contained in the software and documentation are those
+// of the authors and should not be interpreted as representing official policies,
+// either expressed or implied, of the FreeBSD Project.
+//
+
+#ifndef _FDN_REVERB_
+#define _FDN_REVERB_
+
+// This module implements a Feedback Delay Network (FDN) reverb. Eight
+// delay lines are fed back to themselves through an 8x8 Hadamard matrix.
+// As this matrix is orthogonal, the network is lossless and the decay
+// time is only controlled by the gain applied at the output of each
+// line. A one pole lowpass filter on each line simulates the absorption
+// of high frequencies by the room. A short chain of allpass filters on
+// each input channel densifies the initial echoes.
+//
+// A good documentation on FDN reverbs is available at the following link:
+//
+//    https://ccrma.stanford.edu/~jos/pasp/FDN_Reverberation.html
+//
+// All delay lines are longer than a frame buffer. The content of the lines
+// for a complete buffer is then known before processing it, allowing for
+// the computation to be done in blocks:
+//
+//   - The damping filters are computed with one vector lane per line
+//   - The Hadamard matrix is computed as three butterfly stages on vectors
+//     of consecutive frames, using only additions and subtractions.
+//
+// These are kernels of the selected SIMD backend (see simd.h), as are the
+// input diffusers, computed over the whole buffer one after the other.
+//
+// Parameters are mapped as follow:
+//
+//   roomSize  Gain of a loop of the reference length, as for FreeVerb. The
+//             gain of each line is adjusted to its length to get the
+//             same decay time for all lines.
+//   damping   Lowpass coefficient of the lines.
+//   width     Stereo separation of the wet signal.
+//   dryWet    Proportion of the dry vs wet signal.
+//   apGain    Gain of the input diffusion allpass filters.
+
+#define FDN_LINE_COUNT      8
+#define FDN_DIFFUSER_COUNT  2
+
+class FdnReverb : public Reverb {
+
+ private:
+
+  static const int line_m[FDN_LINE_COUNT];
+  static const int diffuser_m[2][FDN_DIFFUSER_COUNT];
+
+  delayLine lines[FDN_LINE_COUNT];
+  delayLine diffusers[2][FDN_DIFFUSER_COUNT];
+
+  float block[FDN_LINE_COUNT][BUFFER_FRAME_COUNT];
+  float   inl[BUFFER_FRAME_COUNT];
+  float   inr[BUFFER_FRAME_COUNT];
+  float  outl[BUFFER_FRAME_COUNT];
+  float  outr[BUFFER_FRAME_COUNT];
+
+  float lineGain[FDN_LINE_COUNT];
+  float lineLast[FDN_LINE_COUNT];   // damping filters state
+
+  float currentRoomSize;            // values used to compute lineGain
+  float currentDamping;
+  float lowpassCoef;
+
+  void computeGains();
+  void readLines();
+  void writeLines();
+  void filterLines();
+  void mixLines();
+
+ protected:
+  void processBuffer(frameRecord & send, frameRecord & ret);
+  void clear();
+
+ public:
+   FdnReverb();
+  ~FdnReverb();
+
+  static Reverb * create();
+
+  const char * getName() { return "FDN"; }
+};
+
+#endif
@@ -0,0 +1,93 @@
+// Notice
+// ------
+//
+// This file is part of the Mezzo SoundFont2 Sampling Based Synthesizer:
+//
+//     https://github.com/turgu1/mezzo
+//
+// Simplified BSD License
+// ----------------------
+//
+// Copyright (c) 2018, Guy Turcotte
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// The views and conclusions contained in the software and documentation are those
+// of the authors and should not be interpreted as representing official policies,
+// either expressed or implied, of the FreeBSD Project.
+//
+
+#ifndef _FFT_
+#define _FFT_
+
+// This module implements a complex Fast Fourier Transform for sizes that
+// are powers of 2. The Stockham autosort algorithm is used: there is no
+// bit reversal step and each stage reads and writes contiguous data,
+// which suits vector instructions. Stages are radix 4, with a last radix
+// 2 stage when the size is not a power of 4.
+//
+// Data is kept in two separate arrays for the real and imaginary parts.
+// The inverse transform is the forward transform with both arrays
+// swapped. It is not scaled: the result is size times the original.
+//
+// A good documentation on the Stockham algorithm is available at the
+// following link:
+//
+//    http://wwwa.pikara.ne.jp/okojisan/otfft-en/stockham3.html
+
+class FFT : public RtArenaSupport<FFT> {
+
+ private:
+
+  struct stageDesc {
+    int     n;          // Size of the sub-transforms at this stage
+    int     s;          // Stride (number of sub-transforms)
+    int     radix;      // 4 or 2
+    float * w;          // Twiddles: w1r, w1i, w2r, w2i, w3r, w3i (n / 4 entries each)
+  };
+
+  int         size;
+  int         stageCount;
+  stageDesc * stages;
+  float     * workRe;
+  float     * workIm;
+
+  static void outOfMemory();
+
+  void radix4(const stageDesc & st, const float * xr, const float * xi, float * yr, float * yi);
+  void radix2(const stageDesc & st, const float * xr, const float * xi, float * yr, float * yi);
+
+ public:
+  /// size must be a power of 2, at least 16.
+   FFT(int size);
+  ~FFT();
+
+  inline int getSize() { return size; }
+
+  /// In place forward transform.
+  void forward(float * re, float * im);
+
+  /// In place inverse transform, not scaled.
+  inline void inverse(float * re, float * im) { forward(im, re); }
+};
+
+#endif
@@ -0,0 +1,93 @@
+// Notice
+// ------
+//
+// This file is part of the Mezzo SoundFont2 Sampling Based Synthesizer:
+//
+//     https://github.com/turgu1/mezzo
+//
+// Simplified BSD License
+// ----------------------
+//
+// Copyright (c) 2018, Guy Turcotte
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// The views and conclusions contained in the software and documentation are those
+// of the authors and should not be interpreted as representing official policies,
+// either expressed or implied, of the FreeBSD Project.
+//
+
+#ifndef _FREEVERB_
+#define _FREEVERB_
+
+// This module implements the FreeVerb reverb algorithm.
+//
+// A C++ version of  FreeVerb algorithm is available at the following link:
+//
+//    https://github.com/gburlet/FreeVerb
+//
+// A good documentation on the FreeVerb algorithm is available at the following link.
+// This implementation is based on this documentation:
+//
+//    https://ccrma.stanford.edu/~jos/pasp/Freeverb.html
+//
+// The combs are longer than a frame buffer: as for the FDN reverb, their
+// content for a complete buffer is known before processing it. The comb
+// filters of both channels are computed with one vector lane per comb,
+// and the allpass filters over the whole buffer one after the other,
+// with the kernels of the selected SIMD backend (see simd.h).
+
+#define REVERB_COMB_COUNT 8
+#define REVERB_AP_COUNT   4
+
+class FreeVerb : public Reverb {
+
+ private:
+
+  static const int comb_m[REVERB_COMB_COUNT];
+  static const int   ap_m[REVERB_AP_COUNT];
+
+  delayLine combs[2 * REVERB_COMB_COUNT];    // Left combs, then right ones
+  delayLine    aps[2][REVERB_AP_COUNT];
+
+  float combLast[2 * REVERB_COMB_COUNT];     // damping filters state
+  float combGain[2 * REVERB_COMB_COUNT];
+
+  float block[2 * REVERB_COMB_COUNT][BUFFER_FRAME_COUNT];
+  float input[BUFFER_FRAME_COUNT];
+  float  outl[BUFFER_FRAME_COUNT];
+  float  outr[BUFFER_FRAME_COUNT];
+
+ protected:
+  void processBuffer(frameRecord & send, frameRecord & ret);
+  void clear();
+
+ public:
+   FreeVerb();
+  ~FreeVerb();
+
+  static Reverb * create();
+
+  const char * getName() { return "FreeVerb"; }
+};
+
+#endif
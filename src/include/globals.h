@@ -51,6 +51,7 @@
 
 #include "log.h"
 #include "config.h"
+#include "metrics.h"
 
 #ifdef GLOBALS
 # define PUBLIC
@@ -62,12 +63,16 @@
 // Compiling on an Intel x86 processor is possible using the translation from NEON to SSE probivided
 // by the neon_2_sse.h include file. See https://github.com/intel/ARM_NEON_2_x86_SSE
 
-#if __ARM_FEATURE_DSP
+#ifndef USE_NEON_INTRINSICS
   #define USE_NEON_INTRINSICS 1
-  #include <arm_neon.h>
-#else
-  #define USE_NEON_INTRINSICS 1
-  #include <neon_2_sse.h>
+#endif
+
+#if USE_NEON_INTRINSICS
+  #if __ARM_FEATURE_DSP
+    #include <arm_neon.h>
+  #else
+    #include <neon_2_sse.h>
+  #endif
 #endif
 
 // if you ever wants to not used DSP intrinsics, the float32_t definition is required
@@ -85,12 +90,18 @@
 
 class Mezzo;
 class SoundFont2;
+class Library;
+class SampleLoader;
 class Sound;
 class Reverb;
+class Chorus;
 class Equalizer;
 class Poly;
 class Midi;
 class Metronome;
+class Channel;
+class MetricsExporter;
+struct SimdKernels;
 
 #define MEZZO_VERSION  "MEZZO Version 1.1 - SF2 Sampling Synthesizer"
 
@@ -114,6 +125,8 @@ typedef struct {
 #define BUFFER_FRAME_COUNT  256                               ///< Number of frame in a frame buffer
 #define BUFFER_SAMPLE_COUNT BUFFER_FRAME_COUNT                ///< Number of samples in a sample buffer
 #define SAMPLE_BLOCK_SIZE   (32 * 1024)                       ///< How many samples are loaded from the SF2 file each time
+#define CONTROL_BLOCK_SIZE  32                                ///< Samples between two updates of the voice modulations
+#define CONTROL_BLOCK_COUNT (BUFFER_SAMPLE_COUNT / CONTROL_BLOCK_SIZE) ///< Control blocks in a sample buffer
 
 typedef std::array<sample_t, BUFFER_SAMPLE_COUNT> sampleRecord;
 typedef std::array<frame_t,  BUFFER_FRAME_COUNT > frameRecord;
@@ -124,19 +137,23 @@ PUBLIC std::atomic<bool> keepRunning;
 // Statistics
 
 PUBLIC int      maxVoicesMixed;     ///< Maximum number of voices that have been mixed simultaneously
-PUBLIC long     mixerDuration;      ///< Maximum duration of the mixer function during play (nanoseconds)
-PUBLIC long     reverbMinDuration;  ///< Minimum duration of the reverb process
-PUBLIC long     reverbMaxDuration;  ///< Maximim duration of the reverb process
 PUBLIC sample_t maxVolume;          ///< Maximum gain used un mixing voices
-
-PUBLIC Mezzo      * mezzo;
-PUBLIC SoundFont2 * soundFont;
-PUBLIC Sound      * sound;
-PUBLIC Equalizer  * equalizer;
-PUBLIC Reverb     * reverb;
-PUBLIC Poly       * poly;
-PUBLIC Midi       * midi;
-PUBLIC Metronome  * metronome;
+PUBLIC Metrics  metrics;            ///< Durations of the processing stages (metrics.h)
+
+PUBLIC const SimdKernels * simd;    ///< The vector kernels selected for this processor (simd.h)
+
+PUBLIC Mezzo        * mezzo;
+PUBLIC Library      * library;      ///< All sound font files and their merged preset map
+PUBLIC SampleLoader * sampleLoader;
+PUBLIC Sound        * sound;
+PUBLIC Equalizer    * equalizer;
+PUBLIC Reverb       * reverb;
+PUBLIC Chorus       * chorus;
+PUBLIC Poly         * poly;
+PUBLIC Midi         * midi;
+PUBLIC Metronome    * metronome;
+PUBLIC Channel      * channels;     ///< The MIDI channels state (MIDI_CHANNEL_COUNT entries)
+PUBLIC MetricsExporter * metricsExporter;
 
 PUBLIC Log logger;
 
@@ -52,6 +52,7 @@ private:
     sfModList   * modulators;
     uint8_t       genCount;
     uint8_t       modCount;
+    modulatorList compiledMods;
     Synthesizer   synth;
   };
 
@@ -62,14 +63,16 @@ private:
     uint8_t      modCount;
   };
 
-  uint16_t      bagIdx, bagCount;
+  uint32_t      zoneRecordIdx;   ///< First zone record in the sound font tables
+  uint16_t      zoneRecordCount; ///< Number of zone records, without the global one
+  bool          globalZoneRecord;///< True if the first zone record is the global zone
 
   std::string   name;         ///< The name of the instrument
+  SoundFont2  * soundFont;    ///< The sound font file this instrument comes from
   aGlobalZone   globalZone;   ///< The global zone
   aZone       * zones;
   uint16_t      keys[128];    ///< Shortcuts to the first zone related to a key
-  sfGenList   * gens;
-  sfModList   * mods;
+  modOperation * modOps;      ///< The compiled modulators of all zones
   int           zoneCount;
   bool          globalZonePresent;
 
@@ -85,28 +88,34 @@ private:
   static void  outOfMemory();  ///< New operation handler when out of memory occurs
 
 public:
-  Instrument(char * instrumentName, uint16_t bagIndex, uint16_t bagQty);
+  Instrument(char * instrumentName, sf2ZoneSet & zoneSet, SoundFont2 * sf2);
  ~Instrument();
 
   /// Returns true if the instrument has been loaded in memory
   bool isLoaded() { return loaded; }
 
-  /// Loads / Unloads the instrument information in memory.
-  bool load(sfBag      * bags,
+  /// Loads / Unloads the instrument information in memory. The zones
+  /// generators and modulators stay in the sound font tables.
+  bool load(sf2Zone    * zoneRecords,
             sfGenList  * generators,
             sfModList  * modulators,
-            rangesType & keysToLoad);
+            rangesType & keysToLoad,
+            sampleBatch & batch);
 
   bool unload();
   void showZone(uint16_t zIdx);
   void showZones();
 
-  void playNote(uint8_t note, uint8_t velocity, Preset & preset, uint16_t presetZoneIdx);
+  void playNote(uint8_t note, uint8_t velocity, Preset & preset, uint16_t presetZoneIdx,
+                Channel & channel);
   void stopNote(uint8_t note);
 
   /// Returns the name of the instrument
   std::string & getName() { return name; }
 
+  /// Returns the sound font file this instrument comes from
+  SoundFont2 * getSoundFont() { return soundFont; }
+
   sfGenList * getGlobalGens()     { return globalZone.generators; }
   uint8_t     getGlobalGenCount() { return globalZone.genCount; }
 
@@ -79,7 +79,7 @@ public:
   };
 
   LcdKeypad(std::string & devName);
- ~LcdKeypad() {}
+ ~LcdKeypad();
 
   void process();
 
@@ -106,6 +106,13 @@ private:
   int           prmLocation;
   int         voiceLocation;
 
+  std::atomic<bool> refresh;     ///< The monitor must be redrawn completely
+
+  static LcdKeypad * instance;   ///< Receiver of the samples loading progress
+
+  static void loadProgress(int done, int total);
+  void showProgress(int done, int total);
+
   void initMenu();
   void getCurrentValue();
   void setCurrentValue();
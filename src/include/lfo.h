@@ -44,36 +44,45 @@
 
 #include "mezzo.h"
 
+// A sine oscillator evaluated at control rate, once per CONTROL_BLOCK_SIZE
+// samples. The (cos, sin) pair is rotated by the phase increment of a
+// control block with a complex multiplication, without calling any sine
+// function. A first order correction keeps the vector on the unit circle.
+
 class Lfo
 {
 private:
   float frequency;
-  float phase;
-  float currentPhase;
-  float increment;
-
-  void setup() { increment    = (frequency * 2 * M_PI) / config.samplingRate;
-                 currentPhase = phase; }
+  float cosinus, sinus;       // Current phase, on the unit circle
+  float cosInc,  sinInc;      // Rotation for a control block
 
 public:
-  Lfo() { frequency = 0.0f; phase = 0.0f; }
-  
-  Lfo(float _frequency, float _phase) { frequency = _frequency; 
-                                        phase     = _phase; 
-                                        setup(); }
+  Lfo() { frequency = 0.0f; cosinus = 1.0f; sinus = 0.0f; cosInc = 1.0f; sinInc = 0.0f; }
 
-  inline void setFrequency(float f) { frequency = f; }
-  inline void setPhase    (float p) { phase     = p; }
+  /// Prepare the oscillator to start at phase 0 (value 0, going up)
+  inline void setup(float _frequency)
+  {
+    frequency = _frequency;
 
-  float nextValue()
+    float increment = (frequency * 2 * M_PI * CONTROL_BLOCK_SIZE) / config.samplingRate;
+
+    cosInc  = cosf(increment);
+    sinInc  = sinf(increment);
+    cosinus = 1.0f;
+    sinus   = 0.0f;
+  }
+
+  inline float nextControlValue()
   {
-    if (frequency == 0.0f) return 0.0f;
+    float value = sinus;
+
+    float c = (cosinus * cosInc) - (sinus * sinInc);
+    float s = (sinus * cosInc) + (cosinus * sinInc);
+    float k = 1.5f - (0.5f * ((c * c) + (s * s)));
 
-    float value = Utils::lowSin(currentPhase);
-    currentPhase += increment;
-    if (currentPhase >= (M_PI * 2)) currentPhase -= (M_PI * 2);
+    cosinus = c * k;
+    sinus   = s * k;
 
-    assert((value >= -1.0f) && (value <= 1.0f));
     return value;
   }
 
@@ -84,10 +93,65 @@ public:
     cout
       << setw(spaces) << ' '
       << "Lfo:"
-      << "[Freq:"      << frequency
-      << " Phase:"     << phase
-      << " CurrPhase:" << currentPhase
-      << " Incr:"      << increment
+      << "[Freq:"   << frequency
+      << " Cos:"    << cosinus
+      << " Sin:"    << sinus
+      << "]" << endl;
+  }
+};
+
+// The modulation LFO of the SF2 specification: a triangle wave starting
+// at 0 and going up, after a delay. Its value is only required at control
+// rate, once per CONTROL_BLOCK_SIZE samples.
+
+class ModLfo
+{
+private:
+  float    frequency;
+  uint32_t delay;
+  uint32_t pos;
+  float    phase;       // 0 .. 1, a quarter period ahead
+  float    increment;   // Phase increment for a control block
+
+public:
+  ModLfo() { frequency = 8.176f; delay = centsToSampleCount(-12000); }
+
+  inline void setup() {
+    pos       = 0;
+    phase     = 0.25f;
+    increment = frequency * CONTROL_BLOCK_SIZE / config.samplingRate;
+  }
+
+  inline void setDelay(int16_t d)     { delay      = (d == -32768) ? 0 : centsToSampleCount(d); }
+  inline void addToDelay(int16_t d)   { delay     *= (d == -32768) ? 1 : centsToRatio(d); }
+
+  inline void setFrequency(float f)   { frequency  = centsToFreq(f); }
+  inline void addToFrequency(float f) { frequency *= centsToRatio(f); }
+
+  inline float nextControlValue()
+  {
+    if (pos < delay) {
+      pos += CONTROL_BLOCK_SIZE;
+      return 0.0f;
+    }
+
+    float value = 1.0f - (4.0f * fabsf(phase - 0.5f));
+
+    phase += increment;
+    if (phase >= 1.0f) phase -= 1.0f;
+
+    return value;
+  }
+
+  void showStatus(int spaces)
+  {
+    using namespace std;
+
+    cout
+      << setw(spaces) << ' '
+      << "ModLfo:"
+      << "[Freq:"   << frequency
+      << " Delay:"  << delay
       << "]" << endl;
   }
 };
@@ -0,0 +1,102 @@
+// Notice
+// ------
+//
+// This file is part of the Mezzo SoundFont2 Sampling Based Synthesizer:
+//
+//     https://github.com/turgu1/mezzo
+//
+// Simplified BSD License
+// ----------------------
+//
+// Copyright (c) 2018, Guy Turcotte
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// The views and conclusions contained in the software and documentation are those
+// of the authors and should not be interpreted as representing official policies,
+// either expressed or implied, of the FreeBSD Project.
+//
+#ifndef _LIBRARY_
+#define _LIBRARY_
+
+#include <string>
+#include <vector>
+
+/// A Library groups all the sound font files opened at startup. The
+/// presets of every file are merged into a single bank/program map
+/// used to process MIDI program changes. Each file can receive a bank
+/// offset such that its presets are moved out of the way of the others.
+/// When two files are offering the same bank/program pair, the one
+/// that comes first in the list of files is used.
+
+class Library : public NewHandlerSupport<Library> {
+
+private:
+  std::vector<SoundFont2 *> soundFonts;
+
+  Preset * currentPreset;       ///< Last preset selected through the user interface
+  Preset * firstMidiPreset;     ///< Head of the bank/program sorted preset list
+
+  /// Insert the preset in the sorted list. Returns false if the
+  /// bank/program pair is already taken by a previous file.
+  bool addPresetToMidiList(Preset * preset);
+
+  static void  outOfMemory();  ///< New operation handler when out of memory occurs
+
+public:
+  /// Open all sound font files. The bank offsets are associated with
+  /// the files in the same order. Missing offsets are set to 0.
+  Library(std::vector<std::string> & sf2Filenames,
+          std::vector<int>         & bankOffsets);
+  ~Library();
+
+  /// Returns true if at least one sound font file has been loaded
+  inline bool isLoaded() { return !soundFonts.empty(); }
+
+  inline std::vector<SoundFont2 *> & getSoundFonts() { return soundFonts; }
+
+  Preset * findMidiPreset(uint16_t bankNbr, uint16_t midiNbr);
+
+  /// Select a preset for all channels (but the percussion one)
+  bool loadPreset(Preset * preset);
+  bool loadPreset(std::string & presetName);
+  bool loadMidiPreset(uint16_t bankNbr, uint16_t midiNbr);
+  bool loadFirstPreset();
+  bool loadNextPreset();
+  bool loadPreviousPreset();
+
+  /// Retrieve the preset content from its file if not already done and
+  /// account for a new channel using it.
+  bool usePreset(Preset * preset);
+
+  /// A channel is not using the preset anymore. The preset is
+  /// unloaded when not in use anywhere else.
+  void releasePreset(Preset * preset);
+
+  /// Show the list of presets on the console, sorted by bank and
+  /// program numbers. Returns the presets in the order shown.
+  std::vector<Preset *> showMidiPresetList();
+
+  inline Preset * getCurrentPreset() { return currentPreset; }
+};
+
+#endif
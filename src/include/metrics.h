@@ -0,0 +1,193 @@
+// Notice
+// ------
+//
+// This file is part of the Mezzo SoundFont2 Sampling Based Synthesizer:
+//
+//     https://github.com/turgu1/mezzo
+//
+// Simplified BSD License
+// ----------------------
+//
+// Copyright (c) 2018, Guy Turcotte
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// The views and conclusions contained in the software and documentation are those
+// of the authors and should not be interpreted as representing official policies,
+// either expressed or implied, of the FreeBSD Project.
+//
+
+#ifndef _METRICS_
+#define _METRICS_
+
+#include <atomic>
+#include <cstdint>
+#include <pthread.h>
+
+// Real-time metrics.
+//
+// The duration of each processing stage is recorded, in nanoseconds, in a
+// histogram with a logarithmic scale: every power of two is divided in
+// METRICS_SUB_BUCKETS buckets, giving a resolution of 12.5% over the
+// whole range. Recording a value is a few relaxed atomic operations on
+// preallocated counters: it is safe from the audio callback, the feeder
+// threads and the MIDI thread at the same time, without any lock or
+// allocation. The percentiles are computed on demand by the reader.
+//
+// The audio callback also counts the deadline misses (a callback taking
+// longer than the duration of the buffer it produces), the output
+// underflows reported by PortAudio and the voice buffers that were not
+// ready in time for the mix: the render underruns of the engine, the voice
+// being silent for that buffer. The convolution reverb counts the tails
+// its worker thread did not compute in time, that are left out of the
+// reverberation.
+//
+// The rendering threads register themselves, such that their CPU time
+// can be retrieved.
+
+#define METRICS_SUB_BITS        3
+#define METRICS_SUB_BUCKETS     (1 << METRICS_SUB_BITS)
+#define METRICS_BUCKET_COUNT    256   ///< Up to 2^33 nsec (8.5 seconds)
+#define METRICS_MAX_WORKERS       8
+
+enum metricStage {
+  METRIC_MIDI,        ///< MIDI event processing (MIDI thread)
+  METRIC_VOICE,       ///< Rendering of a voice buffer (feeder threads)
+  METRIC_VOICE_BANK,  ///< Filtering of up to four voices (feeder threads)
+  METRIC_MIX,         ///< Mixing of the voices (audio callback)
+  METRIC_CHORUS,
+  METRIC_REVERB,
+  METRIC_EQUALIZER,
+  METRIC_OUTPUT,      ///< Conversion to the output buffer
+  METRIC_CALLBACK,    ///< The whole audio callback
+  METRIC_STAGE_COUNT
+};
+
+class Histogram {
+
+ private:
+  std::atomic<uint32_t> counts[METRICS_BUCKET_COUNT];
+  std::atomic<uint64_t> count;
+  std::atomic<uint64_t> sum;
+  std::atomic<int64_t>  maximum;
+
+ public:
+  Histogram() { clear(); }
+
+  void clear();
+
+  static inline int bucketOf(int64_t nsec) {
+    if (nsec < METRICS_SUB_BUCKETS) return (nsec < 0) ? 0 : nsec;
+
+    int shift = (63 - __builtin_clzll(nsec)) - METRICS_SUB_BITS;
+    int idx   = ((shift + 1) << METRICS_SUB_BITS) + ((nsec >> shift) - METRICS_SUB_BUCKETS);
+
+    return (idx < METRICS_BUCKET_COUNT) ? idx : (METRICS_BUCKET_COUNT - 1);
+  }
+
+  /// Highest value that falls in bucket idx
+  static int64_t bucketLimit(int idx);
+
+  inline void record(int64_t nsec) {
+    counts[bucketOf(nsec)].fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+    sum.fetch_add(nsec, std::memory_order_relaxed);
+
+    int64_t max = maximum.load(std::memory_order_relaxed);
+    while ((nsec > max) &&
+           !maximum.compare_exchange_weak(max, nsec, std::memory_order_relaxed));
+  }
+
+  /// The value under which fraction (0 .. 1) of the recorded values
+  /// are, at the resolution of the buckets.
+  int64_t percentile(double fraction);
+
+  inline uint64_t getCount()   { return count.load(std::memory_order_relaxed);   }
+  inline uint64_t getSum()     { return sum.load(std::memory_order_relaxed);     }
+  inline int64_t  getMax()     { return maximum.load(std::memory_order_relaxed); }
+  inline uint32_t getBucket(int idx) { return counts[idx].load(std::memory_order_relaxed); }
+  inline int64_t  getMean()    { uint64_t c = getCount(); return (c == 0) ? 0 : (getSum() / c); }
+};
+
+class Metrics {
+
+ private:
+  static const char * stageNames[METRIC_STAGE_COUNT];
+
+  Histogram stages[METRIC_STAGE_COUNT];
+
+  std::atomic<uint32_t> deadlineMisses;
+  std::atomic<uint32_t> underflows;
+  std::atomic<uint32_t> lateVoiceBuffers;
+  std::atomic<uint32_t> lateReverbTails;
+
+  pthread_t             workers[METRICS_MAX_WORKERS];
+  const char          * workerNames[METRICS_MAX_WORKERS];
+  std::atomic<int>      workerCount;
+
+ public:
+  Metrics() { deadlineMisses = 0; underflows = 0; lateVoiceBuffers = 0; lateReverbTails = 0; workerCount = 0; }
+
+  inline void record(metricStage stage, int64_t nsec) { stages[stage].record(nsec); }
+
+  /// Record the duration of an audio callback and check it against the
+  /// duration of the buffer produced.
+  inline void recordCallback(int64_t nsec, int64_t deadline) {
+    stages[METRIC_CALLBACK].record(nsec);
+    if (nsec > deadline) deadlineMisses.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  inline void underflow() { underflows.fetch_add(1, std::memory_order_relaxed); }
+
+  /// A voice buffer was not ready when the mixer needed it
+  inline void lateVoiceBuffer() { lateVoiceBuffers.fetch_add(1, std::memory_order_relaxed); }
+
+  /// A convolution reverb tail was left out, its worker being late
+  inline void lateReverbTail() { lateReverbTails.fetch_add(1, std::memory_order_relaxed); }
+
+  inline Histogram & getStage(metricStage stage)    { return stages[stage]; }
+  static const char * getStageName(metricStage stage) { return stageNames[stage]; }
+
+  inline uint32_t getDeadlineMisses() { return deadlineMisses.load(std::memory_order_relaxed); }
+  inline uint32_t getUnderflows()     { return underflows.load(std::memory_order_relaxed);     }
+  inline uint32_t getLateVoiceBuffers() { return lateVoiceBuffers.load(std::memory_order_relaxed); }
+  inline uint32_t getLateReverbTails()  { return lateReverbTails.load(std::memory_order_relaxed);  }
+
+  /// Called by a rendering thread when it starts
+  void registerWorker(const char * name);
+
+  inline int          getWorkerCount()      { return workerCount.load(std::memory_order_acquire); }
+  inline const char * getWorkerName(int idx) { return workerNames[idx]; }
+
+  /// CPU time consumed by a registered thread, in nanoseconds
+  int64_t getWorkerCpuTime(int idx);
+
+  void clear();
+
+  /// Show a table of the stages on the console
+  void showStatus();
+
+  /// Log a summary, at the end of the run
+  void logSummary();
+};
+
+#endif
@@ -0,0 +1,81 @@
+// Notice
+// ------
+//
+// This file is part of the Mezzo SoundFont2 Sampling Based Synthesizer:
+//
+//     https://github.com/turgu1/mezzo
+//
+// Simplified BSD License
+// ----------------------
+//
+// Copyright (c) 2018, Guy Turcotte
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// The views and conclusions contained in the software and documentation are those
+// of the authors and should not be interpreted as representing official policies,
+// either expressed or implied, of the FreeBSD Project.
+//
+
+#ifndef _METRICS_EXPORTER_
+#define _METRICS_EXPORTER_
+
+#include <string>
+#include <sstream>
+#include <pthread.h>
+
+// Serves the metrics (metrics.h), the voice counts and the memory used by
+// the samples in the Prometheus text format. A thread of its own waits for
+// connections on a localhost TCP port (metrics-port) and / or on a Unix
+// domain socket (metrics-socket). Every request gets the whole set of
+// metrics in an HTTP response, such that it can be scraped directly by
+// Prometheus, or through curl --unix-socket.
+//
+// Nothing is done by the audio callback: the values are collected when a
+// request is received.
+
+class MetricsExporter : public NewHandlerSupport<MetricsExporter> {
+
+ private:
+  int       tcpSocket;
+  int       unixSocket;
+  pthread_t thread;
+  bool      running;
+  volatile bool stopping;
+
+  std::string unixPath;
+
+  static void * server(void * args);
+  void serve();
+  void answer(int fd);
+  void collect(std::ostringstream & out);
+
+  static void outOfMemory();
+
+ public:
+  MetricsExporter(int port, const std::string & socketPath);
+ ~MetricsExporter();
+
+  inline bool isRunning() { return running; }
+};
+
+#endif
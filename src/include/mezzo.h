@@ -40,9 +40,11 @@
 #define _MEZZO_
 
 #include "globals.h"
+#include "simd.h"
 #include "utils.h"
 
 #include "new_handler_support.h"
+#include "rt_arena.h"
 #include "sf2.h"
 
 #include "lfo.h"
@@ -52,19 +54,32 @@
 #include "fifo.h"
 #include "metronome.h"
 #include "sample.h"
+#include "sample_loader.h"
+#include "modulator.h"
 #include "synthesizer.h"
+#include "soundfont2_index.h"
 #include "preset.h"
 #include "instrument.h"
 #include "soundfont2.h"
+#include "library.h"
+#include "channel.h"
 #include "midi.h"
 #include "reverb.h"
 #include "sound.h"
 #include "voice.h"
+#include "voice_bank.h"
 #include "poly.h"
 #include "equalizer.h"
+#include "fft.h"
 #include "reverb.h"
+#include "freeverb.h"
+#include "fdn_reverb.h"
+#include "convolution_reverb.h"
+#include "chorus.h"
 #include "interactive_mode.h"
 #include "duration.h"
+#include "metrics_exporter.h"
+#include "scheduling.h"
 
 class Mezzo   : public NewHandlerSupport<Mezzo> {
 
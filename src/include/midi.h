@@ -72,17 +72,22 @@ class Midi {
   RtMidiIn * midiPort;  ///< RTMidiIn instance
   std::string completeMidiPortName;
   bool monitoring;      ///< True if monitoring midi in interactive mode
-  bool sustainOn;       ///< True if the sustain pedal is depressed by the user
   int  channelMask;     ///< Mask of channels being listened by Midi
 
   void showDevices(int devCount);
 
-  void setNoteOn(char note, char velocity);  ///< Process a noteOn MIDI command
-  void setNoteOff(char note, char velocity); ///< Process a noteOff MIDI command
-  void setSustainOn();
-  void setSustainOff();
+  void setNoteOn(Channel & channel, char note, char velocity);  ///< Process a noteOn MIDI command
+  void setNoteOff(Channel & channel, char note, char velocity); ///< Process a noteOff MIDI command
+  void setControl(Channel & channel, uint8_t ctrl, uint8_t value);
+  void setProgram(Channel & channel, uint8_t midiNbr);
 
-  bool sustainIsOn() { return sustainOn; };
+ public:
+  /// Initial preset selection for all channels. The percussion channel
+  /// gets the first drum kit, if any is present in the library.
+  static void setupChannels();
+
+  /// Show the state of all MIDI channels (interactive mode)
+  void showChannels();
 };
 
 #endif
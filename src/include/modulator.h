@@ -0,0 +1,149 @@
+// Notice
+// ------
+//
+// This file is part of the Mezzo SoundFont2 Sampling Based Synthesizer:
+//
+//     https://github.com/turgu1/mezzo
+//
+// Simplified BSD License
+// ----------------------
+//
+// Copyright (c) 2018, Guy Turcotte
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// The views and conclusions contained in the software and documentation are those
+// of the authors and should not be interpreted as representing official policies,
+// either expressed or implied, of the FreeBSD Project.
+//
+
+#ifndef _MODULATOR_
+#define _MODULATOR_
+
+#include "mezzo.h"
+
+// The SF2 modulators.
+//
+// The modulators of each zone are compiled when the instrument or the
+// preset is loaded, into a flat list of operations: the SF2 2.04 default
+// modulators (instrument zones only), then those of the global zone and
+// those of the zone itself. A modulator replaces an identical one (same
+// sources and destination) found before it in the list. Modulators that
+// cannot be evaluated (linked modulators, unknown sources, destinations
+// that are not real-time generators) are dropped.
+//
+// A voice evaluates the operations of its instrument zone and of its
+// preset zone at note-on, and the results are added to its generators.
+// The operations whose sources can change while the note is sounding
+// (MIDI controllers, pitch wheel, channel pressure) are evaluated again
+// when the state of the channel changes, if their sources did change.
+// The resulting variations are followed for the attenuation, the pan,
+// the effect sends, the pitch, the vibrato depth and the filter. Other
+// destinations keep their note-on value.
+//
+// The pitch wheel default modulator targets the initial pitch, which is
+// not a generator. As other synthesizers are doing, the unused generator
+// number 59 is used to hold it.
+
+#define MOD_SRC_NONE                     0
+#define MOD_SRC_VELOCITY                 2
+#define MOD_SRC_KEY                      3
+#define MOD_SRC_POLY_PRESSURE           10
+#define MOD_SRC_CHANNEL_PRESSURE        13
+#define MOD_SRC_PITCH_WHEEL             14
+#define MOD_SRC_PITCH_WHEEL_SENSITIVITY 16
+
+#define MOD_CURVE_LINEAR   0
+#define MOD_CURVE_CONCAVE  1
+#define MOD_CURVE_CONVEX   2
+#define MOD_CURVE_SWITCH   3
+
+#define MOD_DEST_PITCH     sfGenOper_unused5
+
+#define DEFAULT_MODULATOR_COUNT 10
+#define MAX_ZONE_MODULATORS     32   ///< Operations kept for a zone, default modulators included
+
+struct modOperation {
+  sfModulator source;
+  sfModulator amountSource;
+  uint8_t     destination;
+  bool        absolute;      // Absolute value transform
+  bool        realtime;      // A source can change while the note is sounding
+  int16_t     amount;
+};
+
+struct modulatorList {
+  modOperation * ops;
+  uint8_t        count;
+};
+
+class Modulators {
+
+ private:
+  static const sfModList defaults[DEFAULT_MODULATOR_COUNT];
+
+  modulatorList   lists[2];    // Instrument zone and preset zone operations
+  Channel       * channel;
+  uint8_t         key;
+  uint8_t         velocity;
+  uint32_t        serial;      // Channel state at the last evaluation
+
+  uint32_t raws[2][MAX_ZONE_MODULATORS];     // Last source values of each operation
+  float    values[2][MAX_ZONE_MODULATORS];   // Last value of each operation
+  float    totals[generatorDescriptorCount]; // Sum of the operations for each destination
+  float    deltas[generatorDescriptorCount]; // Variations since the note-on
+
+  uint16_t rawValue(sfModulator src);
+  float    sourceValue(sfModulator src, uint16_t raw);
+  float    evaluate(const modOperation & op, uint32_t raws);
+
+ public:
+
+  /// Compile the modulators of a zone in dst, which must have room for
+  /// roomNeeded() operations. Returns the number of operations.
+  static uint8_t compile(modOperation * dst,
+                         sfModList    * globalMods, uint8_t globalCount,
+                         sfModList    * zoneMods,   uint8_t zoneCount,
+                         bool           withDefaults);
+
+  static inline int roomNeeded(uint8_t globalCount, uint8_t zoneCount, bool withDefaults) {
+    int count = globalCount + zoneCount + (withDefaults ? DEFAULT_MODULATOR_COUNT : 0);
+    return (count > MAX_ZONE_MODULATORS) ? MAX_ZONE_MODULATORS : count;
+  }
+
+  /// Evaluate all the operations for a new note. getTotal() then returns
+  /// the amount to add to each generator.
+  void noteOn(modulatorList & instrumentMods,
+              modulatorList & presetMods,
+              uint8_t         _key,
+              uint8_t         _velocity,
+              Channel       & _channel);
+
+  /// Evaluate the real-time operations if the channel state changed.
+  /// Returns true if a destination changed.
+  bool update();
+
+  inline float getTotal(int dest) { return totals[dest]; }
+  inline float getDelta(int dest) { return deltas[dest]; }
+};
+
+#endif
@@ -39,6 +39,9 @@
 #ifndef NEW_HANDLER_SUPPORT_H
 #define NEW_HANDLER_SUPPORT_H
 
+#include <cstdlib>
+#include <new>
+
 /// The NewHandlerSupport class supplies mixin to simplify memory allocation process when an out of 
 /// memory event occurs. It supplies a modified new operator that manage the C++ new_handler feature.
 /// The class that inherit the mixin must supply it's own outOfMemory static method that will do the
@@ -54,6 +57,11 @@ class NewHandlerSupport {
   /// The new operator replacing the C++ supplied operator
   static void * operator new(size_t size);
 
+  /// Same as the new operator, the memory being aligned on alignment bytes
+  /// (a power of two multiple of sizeof(void *)). It is released with
+  /// free().
+  static void * alignedNew(size_t size, size_t alignment);
+
  private:
   /// Place holder for the class' new_handler
   static std::new_handler currentHandler;
@@ -87,6 +95,23 @@ void * NewHandlerSupport<T>::operator new(size_t size)
   return memory;
 }
 
+template<class T>
+void * NewHandlerSupport<T>::alignedNew(size_t size, size_t alignment)
+{
+  void * memory;
+
+  // As the C++ new operator does, the new_handler is called until the
+  // memory can be obtained or it gives up
+
+  while (posix_memalign(&memory, alignment, (size > 0) ? size : 1) != 0) {
+    std::new_handler handler = (currentHandler != NULL) ? currentHandler : std::get_new_handler();
+    if (handler == NULL) throw std::bad_alloc();
+    handler();
+  }
+
+  return memory;
+}
+
 template<class T>
 std::new_handler NewHandlerSupport<T>::currentHandler;
 
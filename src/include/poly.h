@@ -43,31 +43,48 @@
 
 #include "mezzo.h"
 
-class Poly : public NewHandlerSupport<Poly> {
+class Poly : public RtArenaSupport<Poly> {
 
  private:
   voicep           voices;
+  sampleRecord   * buffers;        ///< Pool of the voice buffers, one per voice
   std::atomic<int> voiceCount;
   std::atomic<int> maxVoiceCount;
+  bool             reverbBusUsed;  ///< True if a voice has been mixed in the reverb bus
+  bool             chorusBusUsed;  ///< True if a voice has been mixed in the chorus bus
 
   static void  outOfMemory();  ///< New operation handler when out of memory occurs
 
+  bool stopVoice(voicep voice);
+
  public:
    Poly();
   ~Poly();
 
-  int mixer(frameRecord & buff);
+  /// Mix all active voices into buff and into the effect send buses. A
+  /// NULL bus is not fed. isReverbBusUsed() and isChorusBusUsed() tell
+  /// if a bus received anything during the last call. The voices at the
+  /// end of their sound are retired, to be stopped by their feeder thread.
+  int mixer(frameRecord & buff, frameRecord * reverbBuff, frameRecord * chorusBuff);
+
+  /// Prepare the next buffer of a voice, or stop it if it has been
+  /// retired by the mixer. Used by the feeder threads.
+  void   feedVoice(voicep voice, VoiceBank & bank);
 
   void   inactivateAllVoices();
   void   showState();
   voicep firstVoice();
   voicep nextVoice(voicep prev);
-  void   addVoice(samplep s, uint8_t note, float gain, Synthesizer & synth,
-                  Preset & preset, uint16_t presetZoneIdx);
+  void   addVoice(samplep s, uint8_t note, uint8_t velocity, Synthesizer & synth,
+                  modulatorList & instrumentMods,
+                  Preset & preset, uint16_t presetZoneIdx, Channel & channel);
 
   voicep nextAvailable();
-  void   noteOff(char note, bool pedal_on);
-  void   voicesSustainOff();
+  voicep stealVoice();
+  void   noteOff(char note, Channel & channel);
+  void   voicesSustainOff(Channel & channel);
+  void   allNotesOff(Channel & channel);
+  void   allSoundOff(Channel & channel);
   voicep removeVoice(voicep v, voicep prev);
   //int    getFrames(voicep v, buffp buff, int count);
   void   monitorCount();
@@ -75,6 +92,8 @@ class Poly : public NewHandlerSupport<Poly> {
   inline voicep getVoices() { return voices; }
   inline void   decVoiceCount() { voiceCount--; }
   inline int    getVoiceCount() { return voiceCount; }
+  inline bool   isReverbBusUsed() { return reverbBusUsed; }
+  inline bool   isChorusBusUsed() { return chorusBusUsed; }
 
   void UnblockVoiceThreads();
 
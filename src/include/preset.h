@@ -57,6 +57,7 @@ private:
     sfModList  * modulators;
     uint8_t      genCount;
     uint8_t      modCount;
+    modulatorList compiledMods;
   };
 
   struct aGlobalZone {
@@ -67,24 +68,28 @@ private:
   };
 
   std::string   name;            ///< The name of the preset
+  SoundFont2  * soundFont;       ///< The sound font file this preset comes from
 
   uint16_t      midiNbr;         ///< The midi number associated with this preset
   uint16_t      bankNbr;         ///< The midi bank number
 
   Preset      * nextMidiPreset;  ///< Midi/Bank number sort ptr
-  uint16_t      bagIdx, bagCount;
+
+  uint32_t      zoneRecordIdx;   ///< First zone record in the sound font tables
+  uint16_t      zoneRecordCount; ///< Number of zone records, without the global one
+  bool          globalZoneRecord;///< True if the first zone record is the global zone
 
   aGlobalZone   globalZone;      ///< The global zone
   aZone       * zones;
   uint16_t      keys[128];       ///< Shortcuts to the first zone related to a key
-  sfGenList   * gens;
-  sfModList   * mods;
+  modOperation * modOps;         ///< The compiled modulators of all zones
   int           zoneCount;
   bool          globalZonePresent;
   bool          keyShortCutPresent;
   bool          velocitiesPresent;
 
   bool          loaded;          ///< True if the preset content has been loaded in memory
+  uint16_t      useCount;        ///< Number of channels using this preset
 
   std::vector<presetInstrument *> instruments;
 
@@ -101,28 +106,38 @@ public:
   Preset(char * presetName,
          uint16_t midi,
          uint16_t bank,
-         uint16_t bagIndex,
-         uint16_t bagQty);
+         sf2ZoneSet & zoneSet,
+         SoundFont2 * sf2);
   ~Preset();
 
   /// Returns true if the preset has been loaded in memory
   bool is_loaded() { return loaded; };
 
   /// Loads / Unloads the preset information in memory. That will include the
-  /// loading / unloading of associated instruments and samples.
-  bool load(sfBag     * bags,
+  /// loading / unloading of associated instruments and samples. The zones
+  /// generators and modulators stay in the sound font tables. The preset
+  /// is not loaded if some of its samples can't be prepared.
+  bool load(sf2Zone   * zoneRecords,
             sfGenList * generators,
             sfModList * modulators);
   bool unload();
   void showZone(uint16_t zIdx);
   void showZones();
 
-  void playNote(uint8_t note, uint8_t velocity);
+  void playNote(uint8_t note, uint8_t velocity, Channel & channel);
   void stopNote(uint8_t note);
 
+  /// Returns true if one of the preset zones is using the instrument
+  bool usesInstrument(int16_t instrumentIndex);
+
+  uint16_t    getUseCount() { return useCount;   }
+  void       incUseCount() { useCount++;        }
+  uint16_t   decUseCount() { return --useCount; }
+
   std::string &         getName() { return name;           }
   uint16_t           getMidiNbr() { return midiNbr;        }
   uint16_t           getBankNbr() { return bankNbr;        }
+  SoundFont2 *     getSoundFont() { return soundFont;      }
   Preset *    getNextMidiPreset() { return nextMidiPreset; }
   
   sfGenList *     getGlobalGens() { return globalZone.generators; }
@@ -131,6 +146,8 @@ public:
   sfGenList *     getZoneGens(uint16_t idx) { return zones[idx].generators; }
   uint8_t     getZoneGenCount(uint16_t idx) { return zones[idx].genCount;   }
 
+  modulatorList & getZoneModulators(uint16_t idx) { return zones[idx].compiledMods; }
+
   std::vector<presetInstrument *> & getInstrumentsList() { return instruments; };  
 
   void     setNextMidiPreset(Preset * p) { nextMidiPreset = p; };
@@ -39,144 +39,89 @@
 #ifndef _REVERB_
 #define _REVERB_
 
-// This module implements the FreeVerb reverb algorithm with optimization for
-//  ARM NEON Vector instructions
+// This module defines the interface common to all reverb engines. The
+// engine in use is selected at startup through the reverb-engine
+// configuration parameter:
 //
-// A C++ version of  FreeVerb algorithm is available at the following link:
+//    freeverb     The FreeVerb algorithm (see freeverb.h)
+//    fdn          An 8 lines Feedback Delay Network (see fdn_reverb.h)
+//    convolution  The impulse response of a real room (see convolution_reverb.h)
 //
-//    https://github.com/gburlet/FreeVerb
+// All engines share the same set of parameters, as they are adjusted
+// the same way from the configuration file, the MIDI controller and
+// the interactive mode. Each engine maps them to its own algorithm.
 //
-// A good documentation on the FreeVerb algorithm is available at the following link.
-// This implementation is based on this documentation:
-//
-//    https://ccrma.stanford.edu/~jos/pasp/Freeverb.html
-//
-//
-
-#if USE_NEON_INTRINSICS
-  // PADDING is extra space used at the end of each history vectors to simplify
-  // loading data in NEON vectors.
-  #define PADDING 4
-#else
-  #define PADDING 0
-#endif
-
-#define REVERB_COMB_COUNT 8
-#define REVERB_AP_COUNT   4
+// The reverb is fed by the reverb send bus, where voices are mixed as
+// per their SF2 reverb send amount. The wet signal is then mixed with
+// the dry signal. When nothing is sent to the bus and the tail of the
+// reverb has died out, the engine is not run anymore.
 
-class Reverb : public NewHandlerSupport<Reverb> {
-
- private:
-
-  static const int comb_m[REVERB_COMB_COUNT];
-  static const int   ap_m[REVERB_AP_COUNT];
-
-  // The following structures implement FIFO (First In, First Out) to
-  // compile Z^-n values in use by the reverb algorithm, supplying delayed
-  // access to fitered data from previous algorithm execution
-
-  struct fifo_struct {
-    buffp buff;
-    buffp head;
-    buffp tail;
-    buffp end;
-  };
+#define REVERB_SILENCE      1.0e-5f  ///< Return level (-100 dB) under which the reverb is silent
+#define REVERB_IDLE_BUFFERS 32       ///< Silent buffers before idle, longer than any delay line
 
-  typedef struct fifo_struct fifo_t;
-  typedef fifo_t * fifop;
-
-  #if USE_NEON_INTRINSICS
-
-    // Those are the ARM NEON SIMD vectorized version of PUT and GET.
-    // PUTv insure that if data is put after the end of the buffer space,
-    // it is copied back to the beginning of the array. The redundancy of
-    // data insure proper working conditions for vector based instructions
-    // to quickly get access to 4 data entries in a row.
-    //
-    // Here is the non-optimized data copy version:
-    //
-    /*
-      #define PUTv(ptr,v) vst1q_f32(ptr->tail, v);                 \
-                          if (ptr->tail == ptr->buff) vst1q_f32(ptr->end, v); \
-                          if ((ptr->tail += 4) >= ptr->end) {    \
-                            int k = ptr->tail - ptr->end;         \
-                            if (k > 0) memcpy(ptr->buff, ptr->tail - k, k << 2); \
-                            ptr->tail = ptr->buff + k;         \
-                          }
-    */
-    // Here is the optimized version (memcpy replaced with SIMD instructions):
-
-    inline void PUTv(fifop ptr, float32x4_t v) {
-      vst1q_f32(ptr->tail, v);
-      if (ptr->tail == ptr->buff) vst1q_f32(ptr->end, v);
-      if ((ptr->tail += 4) >= ptr->end) {
-        int k = ptr->tail - ptr->end;
-        if (k > 0)
-          vst1q_f32((ptr)->buff,
-                    k == 1 ? vextq_f32(vld1q_f32(ptr->tail - 4),
-                                       vld1q_f32(ptr->buff + 1),
-                                       3) :
-                    k == 2 ? vextq_f32(vld1q_f32(ptr->tail - 4),
-                                       vld1q_f32(ptr->buff + 2),
-                                       2) :
-                    vextq_f32(vld1q_f32(ptr->tail - 4),
-                              vld1q_f32(ptr->buff + 3),
-                              1));
-        ptr->tail = ptr->buff + k;
-      }
-    }
-
-    inline void GETv(fifop ptr, float32x4_t &v) {
-      v = vld1q_f32(ptr->head);
-      if ((ptr->head += 4) >= ptr->end)
-        ptr->head = ptr->buff + (ptr->head - ptr->end);
-    }
-
-  #else
-
-    // The following inline methods are used to get and put values in FIFO arrays
-    // in used with the reverb algorithm. These arrays are strored inside ap_sruct
-    // and comb_struct.
-
-    inline void PUT(fifop ptr, float v) {
-      *(ptr->tail++) = v;
-      if (ptr->tail >= ptr->end) ptr->tail = ptr->buff;
-    }
-
-    inline void GET(fifop ptr, float &v) {
-      v = *(ptr->head++);
-      if (ptr->head >= ptr->end) ptr->head = ptr->buff;
-    }
-
-  #endif
-
-  fifo_t  leftCombs[REVERB_COMB_COUNT];
-  fifo_t rightCombs[REVERB_COMB_COUNT];
-  fifo_t     leftAp[REVERB_AP_COUNT];
-  fifo_t    rightAp[REVERB_AP_COUNT];
-
-  float    leftLast[REVERB_COMB_COUNT];
-  float   rightLast[REVERB_COMB_COUNT];
+class Reverb : public RtArenaSupport<Reverb> {
 
+ protected:
   float dryWet;    // proportion of dry vs wet mix (0 .. 1.0)
   float roomSize;  // 0 .. 1.0 Nothing usefull below 7.0
   float damping;   // 0 .. 1.0
   float width;     // 0 .. 1.0
   float apGain;    // 0 .. 1.0
 
+  bool        idle;     // True when the tail has died out
+  int         silentCount;
+  frameRecord silence;  // Send bus used to process the tail
+  frameRecord ret;      // Wet signal returned by the engine
+
+  // Delay line in a ring buffer. pos is the place of the next frame to
+  // get out of the line, which is also where the next frame gets in.
+
+  struct delayLine {
+    buffp buff;
+    int   length;
+    int   pos;
+  };
+
   static void outOfMemory();
   void adjustValue(char ch);
 
+  /// Copy in dst the output of a line at least a buffer long, for the
+  /// whole buffer.
+  static void readLine(const delayLine & line, float * dst);
+
+  /// Put the input of the line for the whole buffer at the place its
+  /// output was read by readLine(), then advance the line.
+  static void writeLine(delayLine & line, const float * src);
+
+  /// Run the allpass filter of a line of any length over the whole
+  /// buffer x (see SimdKernels::allpass()).
+  static void allpassLine(delayLine & line, float * x, float gain, float delayed, float direct);
+
+  /// Compute in ret the reverberated signal of send.
+  virtual void processBuffer(frameRecord & send, frameRecord & ret) = 0;
+
+  /// Empty the delay lines of the engine.
+  virtual void clear() = 0;
+
  public:
-   Reverb();
-  ~Reverb();
+  Reverb();
+  virtual ~Reverb();
+
+  /// Return a new reverb engine as selected by the engineName. If the
+  /// name is unknown or the engine cannot be initialized, an error is
+  /// logged and FreeVerb is used.
+  static Reverb * create(const std::string & engineName);
+
+  virtual const char * getName() = 0;
 
   inline void setRoomSize(float value) { roomSize = value; }
   inline void setDamping(float value)  { damping = value;  }
   inline void setWidth(float value)    { width = value;    }
   inline void setDryWet(float value)   { dryWet = value;   }
 
-  void process(frameRecord & buff);
+  /// Mix the reverberated send bus with buff. A NULL send means that
+  /// no voice has been sent to the reverb.
+  void process(frameRecord & buff, frameRecord * send);
   void interactiveAdjust();
 };
 
@@ -0,0 +1,125 @@
+// Notice
+// ------
+//
+// This file is part of the Mezzo SoundFont2 Sampling Based Synthesizer:
+//
+//     https://github.com/turgu1/mezzo
+//
+// Simplified BSD License
+// ----------------------
+//
+// Copyright (c) 2018, Guy Turcotte
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// The views and conclusions contained in the software and documentation are those
+// of the authors and should not be interpreted as representing official policies,
+// either expressed or implied, of the FreeBSD Project.
+//
+
+#ifndef _RT_ARENA_
+#define _RT_ARENA_
+
+#include <pthread.h>
+
+// Memory arena for the objects used by the audio path: the voices, the
+// mixer, the effects and their buffers. They are all allocated once at
+// startup and kept until the end, so the arena is a simple bump
+// allocator: memory is never given back before the application exits.
+//
+// The arena is made of chunks of RT_ARENA_CHUNK_SIZE bytes (or more for
+// a larger request), mapped at a huge page boundary. Explicit huge pages
+// (MAP_HUGETLB) are used when the system has some reserved, otherwise
+// transparent huge pages are requested with madvise(). Each chunk is
+// locked in memory and pre-touched when it is mapped, so that the audio
+// path never waits on a page fault, whatever the lock-memory setting.
+//
+// All allocations are aligned on a cache line. When a chunk cannot be
+// mapped, the general allocator is used instead and a warning is logged:
+// the memory then comes from posix_memalign(), still aligned on a cache
+// line, and is released with free().
+
+#define CACHE_LINE_SIZE     64
+#define RT_ARENA_PAGE_SIZE  (2 * 1024 * 1024)  ///< Huge page size and chunk alignment
+#define RT_ARENA_CHUNK_SIZE (4 * 1024 * 1024)
+
+class RtArena {
+
+ private:
+  struct chunk {
+    chunk  * next;
+    size_t   size;
+    size_t   used;
+    bool     hugeTlb;   ///< Explicit huge pages
+    int      lockError; ///< errno of mlock(), 0 when locked
+  };
+
+  static chunk *         chunks;        ///< Most recent first
+  static pthread_mutex_t mutex;
+  static size_t          fallbackSize;  ///< Bytes obtained from the general allocator
+
+  static chunk * mapChunk(size_t size);
+
+ public:
+  /// Return size bytes from the arena, aligned on a cache line and
+  /// zeroed, or NULL if no chunk can be mapped.
+  static void * tryAllocate(size_t size);
+
+  /// Same as above, falling back to the general allocator.
+  static void * allocate(size_t size);
+
+  template<class T>
+  static T * allocateArray(size_t count) {
+    return static_cast<T *>(allocate(count * sizeof(T)));
+  }
+
+  /// Memory from the arena is only released at exit. Memory that came
+  /// from the general allocator is given back.
+  static void release(void * ptr);
+
+  static bool contains(const void * ptr);
+
+  /// Log the size of the arena and how its chunks are backed.
+  static void report();
+};
+
+/// Mixin allocating the objects of a class in the real-time arena. When
+/// the arena cannot grow, NewHandlerSupport::alignedNew() is used, with the
+/// outOfMemory() handler of the class: the objects stay aligned on a cache
+/// line, as the alignas() groups of their members expect.
+
+template<class T>
+class RtArenaSupport : public NewHandlerSupport<T> {
+
+ public:
+  static void * operator new(size_t size) {
+    static_assert(alignof(T) <= CACHE_LINE_SIZE, "The arena aligns on a cache line only");
+
+    void * ptr = RtArena::tryAllocate(size);
+    return (ptr != NULL) ? ptr : NewHandlerSupport<T>::alignedNew(size, CACHE_LINE_SIZE);
+  }
+  static void * operator new[](size_t size) { return operator new(size); }
+  static void   operator delete  (void * ptr) { RtArena::release(ptr); }
+  static void   operator delete[](void * ptr) { RtArena::release(ptr); }
+};
+
+#endif
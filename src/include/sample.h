@@ -45,21 +45,43 @@ typedef class Sample * samplep;
 
 class Synthesizer;
 
+/// Number of samples added before and after the data of a sample, and after
+/// the end of each loop, such that the resampler can read the neighbours of
+/// any position without checking for the limits. It covers the widest
+/// interpolation kernel.
+
+#define SAMPLE_GUARD      64
+#define MAX_SAMPLE_LOOPS   4   ///< Distinct loops that can be prepared for a sample
+
 class Sample  : public NewHandlerSupport<Sample> {
 
 private:
   #if loadInMemory
-    buffp samples;
+    buffp samples;           ///< First sample of the data, with SAMPLE_GUARD zeros on each side
+
+    /// A loop is prepared as a copy of the samples from SAMPLE_GUARD before its
+    /// start up to its end, followed by the first SAMPLE_GUARD samples of
+    /// the loop. Looping can then be done without any modulo computation.
+    struct loopRegion {
+      uint32_t           start;
+      uint32_t           end;
+      std::atomic<buffp> data;  ///< Points at the loop start, NULL until prepared
+    };
+
+    loopRegion       loops[MAX_SAMPLE_LOOPS];
+    std::atomic<int> loopCount;
+
+    void prepareLoop(loopRegion & loop);
   #else
     #if samples24bits
-      static int8_t  * data24;
+      int8_t         * data24;   ///< Low 8 bits of the samples data of the owning file
       int8_t         * firstBlock24;
     #endif
     int16_t    * firstBlock;
     uint16_t     sizeFirstBlock;
   #endif
 
-  static int16_t * data;     ///< Pointer on start of all samples data memory
+  int16_t    * data;         ///< Start of the samples data of the owning file
 
   std::string  name;         ///< The name of the sample
   uint32_t     start;        ///< start offset in data
@@ -76,20 +98,23 @@ private:
 
   bool loaded;
 
+  static std::atomic<uint64_t> memoryUsed;   ///< Bytes allocated for the data of all samples
+
   static void  outOfMemory();  ///< New operation handler when out of memory occurs
 
 public:
-  Sample(sfSample & info);
- ~Sample();
-
- /// Debugging method to show the current state of a sample
- void showStatus(int spaces);
+  /// Memory used by the data of the loaded samples, in bytes
+  static uint64_t getMemoryUsed() { return memoryUsed.load(std::memory_order_relaxed); }
 
   #if samples24bits
-    static void setSamplesLocation(int16_t * dta, int8_t * dta24) { data = dta; data24 = dta24; };
+    Sample(sfSample & info, int16_t * dta, int8_t * dta24);
   #else
-    static void setSamplesLocation(int16_t * dta) { data = dta; };
+    Sample(sfSample & info, int16_t * dta);
   #endif
+ ~Sample();
+
+ /// Debugging method to show the current state of a sample
+ void showStatus(int spaces);
 
   bool load();
 
@@ -100,8 +125,35 @@ public:
   /// Maximum size that can be loaded: 65535.
 
   uint16_t getData(sampleRecord & buff, uint32_t pos, Synthesizer & synth);
-  buffp getData2(uint32_t & count, uint32_t pos, Synthesizer & synth);
 
+  #if loadInMemory
+    /// Returns the first sample of the data. Positions from -SAMPLE_GUARD
+    /// to getSize() + SAMPLE_GUARD are valid.
+    inline buffp getBuffer() { return samples; }
+
+    /// Ask for a loop (positions relative to the start of the sample) to be
+    /// prepared. It is prepared with the sample data at load time, or
+    /// immediately if the sample is already loaded. The loop points are
+    /// clamped with clampLoop(). Returns false if the loop is empty, or if
+    /// MAX_SAMPLE_LOOPS loops are already prepared: getLoop() then reads
+    /// it from the sample data.
+    bool addLoop(uint32_t loopStart, uint32_t loopEnd);
+
+    /// Returns the loop data, pointing at the start of the loop, for loop
+    /// points clamped with clampLoop(). Positions from -SAMPLE_GUARD to
+    /// (loopEnd - loopStart) + SAMPLE_GUARD are valid. A loop that was not
+    /// prepared is read from the sample data: the samples after its end are
+    /// then the ones of the sample instead of the beginning of the loop.
+    /// NULL if the loop is not ready yet.
+    buffp getLoop(uint32_t loopStart, uint32_t loopEnd);
+  #endif
+
+  /// Bring loop points (relative to the start of the sample) inside the
+  /// sample data. Returns false if no loop is left.
+  bool clampLoop(uint32_t & loopStart, uint32_t & loopEnd);
+
+  inline bool         isLoaded() { return loaded;     }
+  inline uint32_t       getSize() { return sizeSample; }
   inline std::string &  getName() { return name;       }
   inline uint8_t       getPitch() { return pitch;      }
   inline uint32_t getSampleRate() { return sampleRate; }
@@ -0,0 +1,97 @@
+// Notice
+// ------
+//
+// This file is part of the Mezzo SoundFont2 Sampling Based Synthesizer:
+//
+//     https://github.com/turgu1/mezzo
+//
+// Simplified BSD License
+// ----------------------
+//
+// Copyright (c) 2018, Guy Turcotte
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// The views and conclusions contained in the software and documentation are those
+// of the authors and should not be interpreted as representing official policies,
+// either expressed or implied, of the FreeBSD Project.
+//
+#ifndef _SAMPLE_LOADER_
+#define _SAMPLE_LOADER_
+
+#include <pthread.h>
+#include <atomic>
+#include <vector>
+
+typedef std::vector<Sample *> sampleBatch;
+
+/// The SampleLoader prepares the samples required by a preset (conversion
+/// to floats, loop padding) as a single batch, using a pool of worker
+/// threads. The pool is started once and the threads are sleeping
+/// between batches.
+///
+/// A progress function can be supplied to be called, from the thread
+/// that requested the batch, as samples are prepared.
+
+class SampleLoader : public NewHandlerSupport<SampleLoader> {
+
+public:
+  typedef void (* progressFunc)(int done, int total);
+
+private:
+  std::vector<pthread_t> workers;
+
+  pthread_mutex_t batchMutex;   ///< Only one batch at a time
+  pthread_mutex_t mutex;        ///< Protects the fields below
+  pthread_cond_t  workReady;
+  pthread_cond_t  workDone;
+
+  sampleBatch     * batch;
+  std::atomic<int>  nextIdx;      ///< Next sample of the batch to be prepared
+  std::atomic<int>  doneCount;    ///< Samples of the batch prepared so far
+  std::atomic<bool> failed;
+  unsigned          generation;   ///< Incremented with each new batch
+  int               activeCount;  ///< Workers currently in the batch
+  bool              stopping;
+
+  progressFunc progress;
+
+  static void * worker(void * args);
+  void work();
+
+  static void  outOfMemory();  ///< New operation handler when out of memory occurs
+
+public:
+  /// Start the worker threads. With a count of 0, there will be one thread
+  /// per processor core.
+   SampleLoader(int threadCount = 0);
+  ~SampleLoader();
+
+  /// Prepare all samples of the batch that are not already loaded. Returns
+  /// when all of them are ready.
+  bool loadSamples(sampleBatch & samples);
+
+  inline void setProgressFunc(progressFunc func) { progress = func; }
+  inline int  getThreadCount() { return workers.size(); }
+};
+
+#endif
@@ -0,0 +1,144 @@
+// Notice
+// ------
+//
+// This file is part of the Mezzo SoundFont2 Sampling Based Synthesizer:
+//
+//     https://github.com/turgu1/mezzo
+//
+// Simplified BSD License
+// ----------------------
+//
+// Copyright (c) 2018, Guy Turcotte
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// The views and conclusions contained in the software and documentation are those
+// of the authors and should not be interpreted as representing official policies,
+// either expressed or implied, of the FreeBSD Project.
+//
+
+#ifndef _SCHEDULING_
+#define _SCHEDULING_
+
+#include <pthread.h>
+#include <atomic>
+
+// Real-time setup of the threads and of the memory. Each thread has a role
+// that gets, from the configuration, the processors it may run on and a
+// SCHED_FIFO priority (0 keeps the normal scheduling):
+//
+//   audio   PortAudio callback thread
+//   render  Voice feeders and convolution reverb tail
+//   midi    RtMidi callback thread
+//   io      Sample loading and metrics exporter
+//   ui      Main thread: interactive mode, LCD keypad, port monitoring
+//
+// The threads created by Mezzo are started with explicit scheduling
+// attributes. The audio and MIDI threads belong to PortAudio and RtMidi:
+// the setup is applied by their callback, the first time it runs on a new
+// thread. The outcome is kept for the startup report, and the settings in
+// effect are read back from the system when it is logged. The callbacks
+// record their outcome without taking a lock: the report may be logging
+// when the first audio callback runs.
+//
+// When memory locking is requested, all pages of the process, present and
+// future, are locked and faulted in. It must be done before the voices,
+// effects and samples are allocated. Freed memory is then kept by malloc,
+// such that no allocation will ever fault in a new page.
+//
+// Every thread started here, and the audio, MIDI and main threads, run
+// with the subnormal floating point numbers flushed to zero. The decaying
+// tails of the envelopes, filters and effects would otherwise go through
+// that range, many times slower to compute on x86 and on some ARM cores.
+
+enum threadRole { ROLE_AUDIO = 0, ROLE_RENDER, ROLE_MIDI, ROLE_IO, ROLE_UI, ROLE_COUNT };
+
+#define SCHEDULING_MAX_THREADS  32
+#define SCHEDULING_NAME_SIZE    16   ///< Includes the terminating null (Linux limit)
+
+class Scheduling {
+
+ private:
+  struct threadRecord {
+    pthread_t    thread;
+    threadRole   role;
+    char         name[SCHEDULING_NAME_SIZE];
+    const char * failed;    ///< Setting that was refused, NULL if none
+    int          error;     ///< errno value of the refusal
+  };
+
+  /// Outcome of applyToThread() for the last thread of a role, written by
+  /// that thread only. The sequence number is odd while the record is
+  /// being written, and 0 until the first one.
+  struct appliedRecord {
+    std::atomic<uint32_t>     seq;
+    std::atomic<pthread_t>    thread;
+    std::atomic<const char *> name;
+    std::atomic<const char *> failed;
+    std::atomic<int>          error;
+  };
+
+  static threadRecord    threads[SCHEDULING_MAX_THREADS];
+  static int             threadCount;
+  static pthread_mutex_t mutex;
+  static appliedRecord   applied[ROLE_COUNT];
+  static int             memoryError;    ///< errno of mlockall(), -1 if not requested
+
+  static void record(pthread_t thread, threadRole role, const char * name,
+                     const char * failed, int error);
+  static void recordApplied(threadRole role, pthread_t thread, const char * name,
+                            const char * failed, int error);
+  static bool readApplied(threadRole role, threadRecord & rec);
+  static void reportThread(threadRecord & rec);
+  static void * threadStart(void * args);
+
+ public:
+  /// Lock all memory of the process if the configuration requests it
+  static void lockMemory();
+
+  /// Flush the subnormal numbers to zero, on input and output of the
+  /// floating point operations of the calling thread (FTZ and DAZ bits of
+  /// MXCSR on x86, FZ bit of FPCR / FPSCR on ARM). Returns false if not
+  /// supported on this processor.
+  static bool flushDenormals();
+
+  /// Start a thread with the affinity and priority of its role. If the
+  /// real-time priority is refused, it is started with the normal
+  /// scheduling. Returns the pthread_create() error code.
+  static int createThread(pthread_t  * thread,
+                          threadRole   role,
+                          const char * name,
+                          void       * (* start)(void *),
+                          void       * arg);
+
+  /// Apply the affinity and priority of its role to the calling thread.
+  /// Not real-time safe: to be called once per thread. Only one thread of
+  /// a role at a time may call it, and the name must be a constant string.
+  static void applyToThread(threadRole role, const char * name);
+
+  /// Log the memory locking outcome and the settings in effect for every
+  /// thread of the role, or of all roles if ROLE_COUNT. Waits a bit for
+  /// the first audio callback such that the audio thread is part of it.
+  static void report(threadRole role = ROLE_COUNT);
+};
+
+#endif
@@ -0,0 +1,170 @@
+// Notice
+// ------
+//
+// This file is part of the Mezzo SoundFont2 Sampling Based Synthesizer:
+//
+//     https://github.com/turgu1/mezzo
+//
+// Simplified BSD License
+// ----------------------
+//
+// Copyright (c) 2018, Guy Turcotte
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// The views and conclusions contained in the software and documentation are those
+// of the authors and should not be interpreted as representing official policies,
+// either expressed or implied, of the FreeBSD Project.
+//
+
+#ifndef _SIMD_
+#define _SIMD_
+
+// Vectorized kernels of the engine, selected at runtime.
+//
+// The kernels are written once (simd_kernels.h) against a small vector
+// abstraction, then compiled for each backend: scalar, SSE4.1 and
+// AVX2 + FMA on x86, NEON on ARM. Each x86 backend is in its own file,
+// compiled with the instruction set extensions it requires. The best
+// backend supported by the processor is selected at startup; the
+// simd-backend configuration parameter can force another one.
+//
+// This header is included by the backend files: it must not pull in
+// anything with inline functions that would then be compiled for an
+// instruction set the processor may not have.
+
+#define SIMD_BANK_LANES      4   ///< Voices filtered at once by the voice bank
+#define SIMD_CASCADE_LANES   8   ///< Stages of a biquad cascade, one per lane
+#define SIMD_CASCADE_OUTPUT  6   ///< Stage giving the output of a cascade
+
+/// Filters of the voice bank, one lane per voice (see VoiceBank):
+///
+///   v[n] = b0 * (x[n] + 2 x[n-1] + x[n-2])
+///   y[n] = v[n] - a1 y[n-1] - a2 y[n-2]
+struct SimdBankLanes {
+  float b0[SIMD_BANK_LANES], a1[SIMD_BANK_LANES], a2[SIMD_BANK_LANES];
+  float x1[SIMD_BANK_LANES], x2[SIMD_BANK_LANES];
+  float y1[SIMD_BANK_LANES], y2[SIMD_BANK_LANES];
+};
+
+/// Coefficients of the stages of a biquad cascade, normalized on a0
+/// (see Equalizer). The unused stages are given b0 = 1, the others 0.
+struct SimdCascade {
+  float b0[SIMD_CASCADE_LANES], b1[SIMD_CASCADE_LANES], b2[SIMD_CASCADE_LANES];
+  float a1[SIMD_CASCADE_LANES], a2[SIMD_CASCADE_LANES];
+};
+
+/// State of the stages of a biquad cascade (transposed direct form II),
+/// and their output for the last sample
+struct SimdCascadeState {
+  float s1[SIMD_CASCADE_LANES], s2[SIMD_CASCADE_LANES], out[SIMD_CASCADE_LANES];
+};
+
+struct SimdKernels {
+  const char * name;
+
+  /// dst[2i] += src[i] * left, dst[2i + 1] += src[i] * right, for count
+  /// frames of the interleaved stereo dst
+  void  (* mixToStereo)(float * dst, const float * src, int count, float left, float right);
+
+  /// dst[i] *= amps[i] * gain
+  void  (* multiplyScaled)(float * dst, const float * amps, float gain, int count);
+
+  /// dst[i] = src[i] limited to -1.0 .. 1.0
+  void  (* clip)(float * dst, const float * src, int count);
+
+  /// dst[i] = dst[i] * dry + src[i] * wet. Returns the peak of src.
+  float (* mixDryWet)(float * dst, const float * src, int count, float dry, float wet);
+
+  /// Filter count samples (a multiple of 4) from start in the buffers of
+  /// the SIMD_BANK_LANES voices of the bank, then multiply them by
+  /// amps[lane] * gains[lane]
+  void  (* filterBank)(SimdBankLanes & lanes, float * const * src, const float * const * amps,
+                       const float * gains, int start, int count);
+
+  /// Run a biquad cascade over count samples, stride floats apart. The
+  /// input of a stage is the output of the preceding one for the previous
+  /// sample: the output of stage SIMD_CASCADE_OUTPUT, that replaces the
+  /// samples, is delayed by SIMD_CASCADE_OUTPUT samples.
+  void  (* filterCascade)(float * data, int count, int stride,
+                          const SimdCascade & coefs, SimdCascadeState & state);
+
+  /// One pole filters over count samples of rowCount rows (both multiples
+  /// of 4), one per row, in place. input is added to all the rows (none
+  /// if NULL):
+  ///
+  ///   state[r]     = input[i] + a * rows[r][i] + b * state[r]
+  ///   rows[r][i]   = state[r] * gains[r]
+  void  (* filterRows)(float * const * rows, int rowCount, float * state, const float * gains,
+                       const float * input, float a, float b, int count);
+
+  /// Allpass filter over count samples of x, count being at most the
+  /// length of the delay line. line holds the delayed values for these
+  /// samples, and receives the new ones:
+  ///
+  ///   v = x[i] + gain * line[i],  x[i] = delayed * line[i] - direct * v,  line[i] = v
+  void  (* allpass)(float * x, float * line, int count, float gain, float delayed, float direct);
+
+  /// dst[i] = rows[0][i] + ... + rows[rowCount - 1][i]
+  void  (* sumRows)(float * dst, const float * const * rows, int rowCount, int count);
+
+  /// Feedback matrix of 8 rows: outl[i] and outr[i] are the sums of the
+  /// even and odd rows, the rows are multiplied by the 8x8 Hadamard
+  /// matrix (not normalized), then inl[i] is added to the even rows and
+  /// inr[i] to the odd ones
+  void  (* hadamard8)(float * const * rows, const float * inl, const float * inr,
+                      float * outl, float * outr, int count);
+
+  /// dst[2i] = left[i] * wet1 + right[i] * wet2, dst[2i + 1] = right[i] * wet1 + left[i] * wet2
+  void  (* mixWidth)(float * dst, const float * left, const float * right, int count,
+                     float wet1, float wet2);
+
+  /// left[i] = src[2i] * gain, right[i] = src[2i + 1] * gain
+  void  (* deinterleave)(float * left, float * right, const float * src, int count, float gain);
+
+  /// (dstRe, dstIm)[i] += (xRe, xIm)[i] * (hRe, hIm)[i]
+  void  (* complexMultiplyAdd)(float * dstRe, float * dstIm, const float * xRe, const float * xIm,
+                               const float * hRe, const float * hIm, int count);
+
+  /// Radix 4 stage of the Stockham FFT (see FFT), for sub-transforms of
+  /// size n (at least 4) with stride s. The twiddles w are w1r, w1i, w2r,
+  /// w2i, w3r and w3i, n / 4 of each.
+  void  (* fftRadix4)(int n, int s, const float * w, const float * xr, const float * xi,
+                      float * yr, float * yi);
+
+  /// Last radix 2 stage of the Stockham FFT, with stride s
+  void  (* fftRadix2)(int s, const float * xr, const float * xi, float * yr, float * yi);
+};
+
+class Simd {
+ public:
+  /// Select the backend by name, or the best one available for "auto".
+  /// Returns false (keeping the current one) if it is unknown or not
+  /// supported by the processor.
+  static bool select(const char * name);
+
+  /// The backends supported by the processor, the scalar one first,
+  /// terminated by NULL.
+  static const SimdKernels * const * getAvailable();
+};
+
+#endif
@@ -0,0 +1,741 @@
+// Notice
+// ------
+//
+// This file is part of the Mezzo SoundFont2 Sampling Based Synthesizer:
+//
+//     https://github.com/turgu1/mezzo
+//
+// Simplified BSD License
+// ----------------------
+//
+// Copyright (c) 2018, Guy Turcotte
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// The views and conclusions contained in the software and documentation are those
+// of the authors and should not be interpreted as representing official policies,
+// either expressed or implied, of the FreeBSD Project.
+//
+
+#ifndef _SIMD_KERNELS_
+#define _SIMD_KERNELS_
+
+// Vector backends and kernels of simd.h. Only to be included by the
+// backend files (simd*.cpp).
+//
+// A backend is a struct giving the vector type (vec) of width floats
+// and the operations used by the kernels:
+//
+//   dup(x)            all lanes set to x
+//   load(p), store    width consecutive floats
+//   load2(p, a, b)    2 * width interleaved floats into the even (a) and
+//   store2(p, a, b)   odd (b) ones, and back
+//   add, sub, mul, min, max, abs
+//   fma(a, b, c)      a + b * c
+//   fnma(a, b, c)     a - b * c
+//   hmax(a)           highest lane
+//
+// The kernels working with one lane per filter (voice bank, cascade, rows
+// filters) and the first stage of the FFT work on four lanes at a time.
+// quad is the backend they use: the backend itself when it is 4 floats
+// wide (or the scalar one), 128 bits vectors for AVX2. A quad backend
+// has also:
+//
+//   transpose(v)      the width x width matrix held in v[0 .. width - 1]
+//   store4(p, a, b, c, d)  4 * width floats, interleaving a, b, c and d
+//   shiftIn(p, a)     the highest lane of p followed by the lower ones of a
+//   lane<i>(a)        lane i
+//
+// Everything is in an anonymous namespace: each backend file has its own
+// copy of the kernels (the scalar ones are used for the tail of the
+// buffers), compiled with its own instruction set.
+
+#if defined(__x86_64__) || defined(__i386__)
+  #include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+  #include <arm_neon.h>
+#endif
+
+#include "simd.h"
+
+namespace {
+
+struct SimdScalar {
+  typedef float      vec;
+  typedef SimdScalar quad;
+  static const int width = 1;
+
+  static inline vec  dup(float x)                      { return x; }
+  static inline vec  load(const float * p)             { return *p; }
+  static inline void store(float * p, vec a)           { *p = a; }
+  static inline void load2(const float * p, vec & a, vec & b) { a = p[0]; b = p[1]; }
+  static inline void store2(float * p, vec a, vec b)   { p[0] = a; p[1] = b; }
+  static inline vec  add(vec a, vec b)                 { return a + b; }
+  static inline vec  sub(vec a, vec b)                 { return a - b; }
+  static inline vec  mul(vec a, vec b)                 { return a * b; }
+  static inline vec  fma(vec a, vec b, vec c)          { return a + (b * c); }
+  static inline vec  fnma(vec a, vec b, vec c)         { return a - (b * c); }
+  static inline vec  min(vec a, vec b)                 { return (a < b) ? a : b; }
+  static inline vec  max(vec a, vec b)                 { return (a > b) ? a : b; }
+  static inline vec  abs(vec a)                        { return (a < 0.0f) ? -a : a; }
+  static inline float hmax(vec a)                      { return a; }
+
+  static inline void transpose(vec * v)                { (void) v; }
+  static inline void store4(float * p, vec a, vec b, vec c, vec d)
+  {
+    p[0] = a; p[1] = b; p[2] = c; p[3] = d;
+  }
+  static inline vec  shiftIn(vec p, vec a)             { (void) a; return p; }
+  template <int i> static inline float lane(vec a)     { return a; }
+};
+
+#ifdef __SSE4_1__
+
+struct SimdSse41 {
+  typedef __m128    vec;
+  typedef SimdSse41 quad;
+  static const int width = 4;
+
+  static inline vec  dup(float x)                      { return _mm_set1_ps(x); }
+  static inline vec  load(const float * p)             { return _mm_loadu_ps(p); }
+  static inline void store(float * p, vec a)           { _mm_storeu_ps(p, a); }
+  static inline void load2(const float * p, vec & a, vec & b)
+  {
+    vec lo = _mm_loadu_ps(p), hi = _mm_loadu_ps(p + 4);
+    a = _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0));
+    b = _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1));
+  }
+  static inline void store2(float * p, vec a, vec b)
+  {
+    _mm_storeu_ps(p,     _mm_unpacklo_ps(a, b));
+    _mm_storeu_ps(p + 4, _mm_unpackhi_ps(a, b));
+  }
+  static inline vec  add(vec a, vec b)                 { return _mm_add_ps(a, b); }
+  static inline vec  sub(vec a, vec b)                 { return _mm_sub_ps(a, b); }
+  static inline vec  mul(vec a, vec b)                 { return _mm_mul_ps(a, b); }
+  static inline vec  fma(vec a, vec b, vec c)          { return _mm_add_ps(a, _mm_mul_ps(b, c)); }
+  static inline vec  fnma(vec a, vec b, vec c)         { return _mm_sub_ps(a, _mm_mul_ps(b, c)); }
+  static inline vec  min(vec a, vec b)                 { return _mm_min_ps(a, b); }
+  static inline vec  max(vec a, vec b)                 { return _mm_max_ps(a, b); }
+  static inline vec  abs(vec a)                        { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+  static inline float hmax(vec a)
+  {
+    a = _mm_max_ps(a, _mm_movehl_ps(a, a));
+    a = _mm_max_ss(a, _mm_shuffle_ps(a, a, 1));
+    return _mm_cvtss_f32(a);
+  }
+
+  static inline void transpose(vec * v)                { _MM_TRANSPOSE4_PS(v[0], v[1], v[2], v[3]); }
+  static inline void store4(float * p, vec a, vec b, vec c, vec d)
+  {
+    _MM_TRANSPOSE4_PS(a, b, c, d);
+    _mm_storeu_ps(p,      a);
+    _mm_storeu_ps(p +  4, b);
+    _mm_storeu_ps(p +  8, c);
+    _mm_storeu_ps(p + 12, d);
+  }
+  static inline vec  shiftIn(vec p, vec a)
+  {
+    return _mm_castsi128_ps(_mm_alignr_epi8(_mm_castps_si128(a), _mm_castps_si128(p), 12));
+  }
+  template <int i> static inline float lane(vec a)
+  {
+    return _mm_cvtss_f32(_mm_shuffle_ps(a, a, _MM_SHUFFLE(i, i, i, i)));
+  }
+};
+
+#endif
+
+#if defined(__AVX2__) && defined(__FMA__)
+
+// The quad backend of AVX2: the SSE4.1 one, with the fused multiply-add
+// instructions.
+
+struct SimdFma128 : public SimdSse41 {
+  typedef SimdFma128 quad;
+
+  static inline vec  fma(vec a, vec b, vec c)          { return _mm_fmadd_ps(b, c, a); }
+  static inline vec  fnma(vec a, vec b, vec c)         { return _mm_fnmadd_ps(b, c, a); }
+};
+
+// The AVX shuffles work inside each 128 bits half: the de-interleaved
+// vectors are put back in order by exchanging their middle 64 bits.
+
+struct SimdAvx2 {
+  typedef __m256     vec;
+  typedef SimdFma128 quad;
+  static const int width = 8;
+
+  static inline vec  middleSwap(vec a)
+  {
+    return _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(a), _MM_SHUFFLE(3, 1, 2, 0)));
+  }
+
+  static inline vec  dup(float x)                      { return _mm256_set1_ps(x); }
+  static inline vec  load(const float * p)             { return _mm256_loadu_ps(p); }
+  static inline void store(float * p, vec a)           { _mm256_storeu_ps(p, a); }
+  static inline void load2(const float * p, vec & a, vec & b)
+  {
+    vec lo = _mm256_loadu_ps(p), hi = _mm256_loadu_ps(p + 8);
+    a = middleSwap(_mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0)));
+    b = middleSwap(_mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1)));
+  }
+  static inline void store2(float * p, vec a, vec b)
+  {
+    a = middleSwap(a);
+    b = middleSwap(b);
+    _mm256_storeu_ps(p,     _mm256_unpacklo_ps(a, b));
+    _mm256_storeu_ps(p + 8, _mm256_unpackhi_ps(a, b));
+  }
+  static inline vec  add(vec a, vec b)                 { return _mm256_add_ps(a, b); }
+  static inline vec  sub(vec a, vec b)                 { return _mm256_sub_ps(a, b); }
+  static inline vec  mul(vec a, vec b)                 { return _mm256_mul_ps(a, b); }
+  static inline vec  fma(vec a, vec b, vec c)          { return _mm256_fmadd_ps(b, c, a); }
+  static inline vec  fnma(vec a, vec b, vec c)         { return _mm256_fnmadd_ps(b, c, a); }
+  static inline vec  min(vec a, vec b)                 { return _mm256_min_ps(a, b); }
+  static inline vec  max(vec a, vec b)                 { return _mm256_max_ps(a, b); }
+  static inline vec  abs(vec a)                        { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+  static inline float hmax(vec a)
+  {
+    return SimdSse41::hmax(_mm_max_ps(_mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1)));
+  }
+};
+
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+
+struct SimdNeon {
+  typedef float32x4_t vec;
+  typedef SimdNeon    quad;
+  static const int width = 4;
+
+  static inline vec  dup(float x)                      { return vdupq_n_f32(x); }
+  static inline vec  load(const float * p)             { return vld1q_f32(p); }
+  static inline void store(float * p, vec a)           { vst1q_f32(p, a); }
+  static inline void load2(const float * p, vec & a, vec & b)
+  {
+    float32x4x2_t v = vld2q_f32(p);
+    a = v.val[0];
+    b = v.val[1];
+  }
+  static inline void store2(float * p, vec a, vec b)
+  {
+    float32x4x2_t v = { { a, b } };
+    vst2q_f32(p, v);
+  }
+  static inline vec  add(vec a, vec b)                 { return vaddq_f32(a, b); }
+  static inline vec  sub(vec a, vec b)                 { return vsubq_f32(a, b); }
+  static inline vec  mul(vec a, vec b)                 { return vmulq_f32(a, b); }
+  static inline vec  fma(vec a, vec b, vec c)          { return vmlaq_f32(a, b, c); }
+  static inline vec  fnma(vec a, vec b, vec c)         { return vmlsq_f32(a, b, c); }
+  static inline vec  min(vec a, vec b)                 { return vminq_f32(a, b); }
+  static inline vec  max(vec a, vec b)                 { return vmaxq_f32(a, b); }
+  static inline vec  abs(vec a)                        { return vabsq_f32(a); }
+  static inline float hmax(vec a)
+  {
+    float32x2_t m = vpmax_f32(vget_low_f32(a), vget_high_f32(a));
+    return vget_lane_f32(vpmax_f32(m, m), 0);
+  }
+
+  static inline void transpose(vec * v)
+  {
+    float32x4x2_t ab = vtrnq_f32(v[0], v[1]);
+    float32x4x2_t cd = vtrnq_f32(v[2], v[3]);
+    v[0] = vcombine_f32(vget_low_f32(ab.val[0]),  vget_low_f32(cd.val[0]));
+    v[1] = vcombine_f32(vget_low_f32(ab.val[1]),  vget_low_f32(cd.val[1]));
+    v[2] = vcombine_f32(vget_high_f32(ab.val[0]), vget_high_f32(cd.val[0]));
+    v[3] = vcombine_f32(vget_high_f32(ab.val[1]), vget_high_f32(cd.val[1]));
+  }
+  static inline void store4(float * p, vec a, vec b, vec c, vec d)
+  {
+    float32x4x4_t v = { { a, b, c, d } };
+    vst4q_f32(p, v);
+  }
+  static inline vec  shiftIn(vec p, vec a)             { return vextq_f32(p, a, 3); }
+  template <int i> static inline float lane(vec a)     { return vgetq_lane_f32(a, i); }
+};
+
+#endif
+
+//---- Kernels ----
+
+template <class S> void mixToStereo(float * dst, const float * src, int count, float left, float right)
+{
+  typename S::vec l = S::dup(left);
+  typename S::vec r = S::dup(right);
+  int i = 0;
+
+  for (; i <= (count - S::width); i += S::width) {
+    typename S::vec a, b, s = S::load(&src[i]);
+    S::load2(&dst[2 * i], a, b);
+    S::store2(&dst[2 * i], S::fma(a, s, l), S::fma(b, s, r));
+  }
+
+  if (S::width > 1) mixToStereo<SimdScalar>(&dst[2 * i], &src[i], count - i, left, right);
+}
+
+template <class S> void multiplyScaled(float * dst, const float * amps, float gain, int count)
+{
+  typename S::vec g = S::dup(gain);
+  int i = 0;
+
+  for (; i <= (count - S::width); i += S::width) {
+    S::store(&dst[i], S::mul(S::load(&dst[i]), S::mul(S::load(&amps[i]), g)));
+  }
+
+  if (S::width > 1) multiplyScaled<SimdScalar>(&dst[i], &amps[i], gain, count - i);
+}
+
+template <class S> void clip(float * dst, const float * src, int count)
+{
+  typename S::vec minusOnes = S::dup(-1.0f);
+  typename S::vec ones      = S::dup( 1.0f);
+  int i = 0;
+
+  for (; i <= (count - S::width); i += S::width) {
+    S::store(&dst[i], S::min(S::max(S::load(&src[i]), minusOnes), ones));
+  }
+
+  if (S::width > 1) clip<SimdScalar>(&dst[i], &src[i], count - i);
+}
+
+template <class S> float mixDryWet(float * dst, const float * src, int count, float dry, float wet)
+{
+  typename S::vec d    = S::dup(dry);
+  typename S::vec w    = S::dup(wet);
+  typename S::vec peak = S::dup(0.0f);
+  int i = 0;
+
+  for (; i <= (count - S::width); i += S::width) {
+    typename S::vec s = S::load(&src[i]);
+    peak = S::max(peak, S::abs(s));
+    S::store(&dst[i], S::fma(S::mul(S::load(&dst[i]), d), s, w));
+  }
+
+  float result = S::hmax(peak);
+
+  if (S::width > 1) {
+    float tail = mixDryWet<SimdScalar>(&dst[i], &src[i], count - i, dry, wet);
+    if (tail > result) result = tail;
+  }
+
+  return result;
+}
+
+// The filters of the voice bank, one voice per lane. Four samples of each
+// voice are transposed at a time, such that each vector holds one sample
+// of the voices.
+
+template <class S> void filterBank(SimdBankLanes & lanes, float * const * src, const float * const * amps,
+                                   const float * gains, int start, int count)
+{
+  typedef typename S::quad      Q;
+  typedef typename Q::vec       vec;
+
+  for (int l = 0; l < SIMD_BANK_LANES; l += Q::width) {
+    vec b0 = Q::load(&lanes.b0[l]), a1 = Q::load(&lanes.a1[l]), a2 = Q::load(&lanes.a2[l]);
+    vec x1 = Q::load(&lanes.x1[l]), x2 = Q::load(&lanes.x2[l]);
+    vec y1 = Q::load(&lanes.y1[l]), y2 = Q::load(&lanes.y2[l]);
+
+    vec g[Q::width];
+    for (int k = 0; k < Q::width; k++) g[k] = Q::dup(gains[l + k]);
+
+    for (int i = start; i < start + count; i += Q::width) {
+      vec s[Q::width];
+
+      for (int k = 0; k < Q::width; k++) s[k] = Q::load(&src[l + k][i]);
+      Q::transpose(s);
+
+      for (int k = 0; k < Q::width; k++) {
+        vec v = Q::mul(Q::add(Q::add(s[k], x2), Q::add(x1, x1)), b0);
+        x2 = x1; x1 = s[k];
+        s[k] = Q::fnma(Q::fnma(v, a2, y2), a1, y1);
+        y2 = y1; y1 = s[k];
+      }
+
+      Q::transpose(s);
+      for (int k = 0; k < Q::width; k++) {
+        Q::store(&src[l + k][i], Q::mul(s[k], Q::mul(Q::load(&amps[l + k][i]), g[k])));
+      }
+    }
+
+    Q::store(&lanes.x1[l], x1); Q::store(&lanes.x2[l], x2);
+    Q::store(&lanes.y1[l], y1); Q::store(&lanes.y2[l], y2);
+  }
+}
+
+// The stages of a biquad cascade, one per lane. Each new sample enters
+// the first lane while the outputs of the stages for the previous sample
+// are shifted to the next lane.
+
+template <class S> void filterCascade(float * data, int count, int stride,
+                                      const SimdCascade & coefs, SimdCascadeState & state)
+{
+  typedef typename S::quad      Q;
+  typedef typename Q::vec       vec;
+
+  const int n = SIMD_CASCADE_LANES / Q::width;
+
+  vec b0[n], b1[n], b2[n], a1[n], a2[n];
+  vec s1[n], s2[n], y[n];
+
+  for (int j = 0; j < n; j++) {
+    b0[j] = Q::load(&coefs.b0[j * Q::width]);
+    b1[j] = Q::load(&coefs.b1[j * Q::width]);
+    b2[j] = Q::load(&coefs.b2[j * Q::width]);
+    a1[j] = Q::load(&coefs.a1[j * Q::width]);
+    a2[j] = Q::load(&coefs.a2[j * Q::width]);
+    s1[j] = Q::load(&state.s1[j * Q::width]);
+    s2[j] = Q::load(&state.s2[j * Q::width]);
+    y[j]  = Q::load(&state.out[j * Q::width]);
+  }
+
+  for (int i = 0; i < count; i++, data += stride) {
+    vec prev = Q::dup(*data);
+
+    for (int j = 0; j < n; j++) {
+      vec x = Q::shiftIn(prev, y[j]);
+      prev  = y[j];
+
+      y[j]  = Q::fma(s1[j], b0[j], x);
+      s1[j] = Q::fnma(Q::fma(s2[j], b1[j], x), a1[j], y[j]);
+      s2[j] = Q::fnma(Q::mul(b2[j], x), a2[j], y[j]);
+    }
+
+    *data = Q::template lane<SIMD_CASCADE_OUTPUT % Q::width>(y[SIMD_CASCADE_OUTPUT / Q::width]);
+  }
+
+  for (int j = 0; j < n; j++) {
+    Q::store(&state.s1[j * Q::width], s1[j]);
+    Q::store(&state.s2[j * Q::width], s2[j]);
+    Q::store(&state.out[j * Q::width], y[j]);
+  }
+}
+
+// One pole filters, one row per lane. The rows are transposed as for the
+// voice bank.
+
+template <class S> void filterRows(float * const * rows, int rowCount, float * state, const float * gains,
+                                   const float * input, float a, float b, int count)
+{
+  typedef typename S::quad      Q;
+  typedef typename Q::vec       vec;
+
+  vec va = Q::dup(a);
+  vec vb = Q::dup(b);
+
+  for (int r = 0; r < rowCount; r += Q::width) {
+    vec last = Q::load(&state[r]);
+    vec g    = Q::load(&gains[r]);
+
+    for (int i = 0; i < count; i += Q::width) {
+      vec v[Q::width];
+
+      for (int k = 0; k < Q::width; k++) v[k] = Q::load(&rows[r + k][i]);
+      Q::transpose(v);
+
+      for (int k = 0; k < Q::width; k++) {
+        vec x = (input != NULL) ? Q::fma(Q::dup(input[i + k]), v[k], va) : Q::mul(v[k], va);
+        last  = Q::fma(x, last, vb);
+        v[k]  = Q::mul(last, g);
+      }
+
+      Q::transpose(v);
+      for (int k = 0; k < Q::width; k++) Q::store(&rows[r + k][i], v[k]);
+    }
+
+    Q::store(&state[r], last);
+  }
+}
+
+template <class S> void allpass(float * x, float * line, int count, float gain, float delayed, float direct)
+{
+  typename S::vec g = S::dup(gain);
+  typename S::vec d = S::dup(delayed);
+  typename S::vec e = S::dup(direct);
+  int i = 0;
+
+  for (; i <= (count - S::width); i += S::width) {
+    typename S::vec m = S::load(&line[i]);
+    typename S::vec v = S::fma(S::load(&x[i]), m, g);
+    S::store(&line[i], v);
+    S::store(&x[i], S::fnma(S::mul(m, d), v, e));
+  }
+
+  if (S::width > 1) allpass<SimdScalar>(&x[i], &line[i], count - i, gain, delayed, direct);
+}
+
+template <class S> void sumRows(float * dst, const float * const * rows, int rowCount, int count)
+{
+  int i = 0;
+
+  for (; i <= (count - S::width); i += S::width) {
+    typename S::vec sum = S::load(&rows[0][i]);
+    for (int r = 1; r < rowCount; r++) sum = S::add(sum, S::load(&rows[r][i]));
+    S::store(&dst[i], sum);
+  }
+
+  for (; i < count; i++) {
+    float sum = rows[0][i];
+    for (int r = 1; r < rowCount; r++) sum += rows[r][i];
+    dst[i] = sum;
+  }
+}
+
+template <class S> void hadamard8(float * const * rows, const float * inl, const float * inr,
+                                  float * outl, float * outr, int count)
+{
+  int i = 0;
+
+  for (; i <= (count - S::width); i += S::width) {
+    typename S::vec v[8];
+
+    for (int r = 0; r < 8; r++) v[r] = S::load(&rows[r][i]);
+
+    S::store(&outl[i], S::add(S::add(v[0], v[2]), S::add(v[4], v[6])));
+    S::store(&outr[i], S::add(S::add(v[1], v[3]), S::add(v[5], v[7])));
+
+    for (int step = 1; step < 8; step <<= 1) {
+      for (int r = 0; r < 8; r++) {
+        if ((r & step) == 0) {
+          typename S::vec tmp = v[r];
+          v[r]        = S::add(tmp, v[r + step]);
+          v[r + step] = S::sub(tmp, v[r + step]);
+        }
+      }
+    }
+
+    typename S::vec left  = S::load(&inl[i]);
+    typename S::vec right = S::load(&inr[i]);
+
+    for (int r = 0; r < 8; r += 2) {
+      S::store(&rows[r    ][i], S::add(v[r    ], left));
+      S::store(&rows[r + 1][i], S::add(v[r + 1], right));
+    }
+  }
+
+  if (S::width > 1) {
+    float * tails[8];
+    for (int r = 0; r < 8; r++) tails[r] = &rows[r][i];
+    hadamard8<SimdScalar>(tails, &inl[i], &inr[i], &outl[i], &outr[i], count - i);
+  }
+}
+
+template <class S> void mixWidth(float * dst, const float * left, const float * right, int count,
+                                 float wet1, float wet2)
+{
+  typename S::vec w1 = S::dup(wet1);
+  typename S::vec w2 = S::dup(wet2);
+  int i = 0;
+
+  for (; i <= (count - S::width); i += S::width) {
+    typename S::vec l = S::load(&left[i]);
+    typename S::vec r = S::load(&right[i]);
+    S::store2(&dst[2 * i], S::fma(S::mul(l, w1), r, w2), S::fma(S::mul(r, w1), l, w2));
+  }
+
+  if (S::width > 1) mixWidth<SimdScalar>(&dst[2 * i], &left[i], &right[i], count - i, wet1, wet2);
+}
+
+template <class S> void deinterleave(float * left, float * right, const float * src, int count, float gain)
+{
+  typename S::vec g = S::dup(gain);
+  int i = 0;
+
+  for (; i <= (count - S::width); i += S::width) {
+    typename S::vec l, r;
+    S::load2(&src[2 * i], l, r);
+    S::store(&left[i],  S::mul(l, g));
+    S::store(&right[i], S::mul(r, g));
+  }
+
+  if (S::width > 1) deinterleave<SimdScalar>(&left[i], &right[i], &src[2 * i], count - i, gain);
+}
+
+template <class S> void complexMultiplyAdd(float * dstRe, float * dstIm, const float * xRe, const float * xIm,
+                                           const float * hRe, const float * hIm, int count)
+{
+  int i = 0;
+
+  for (; i <= (count - S::width); i += S::width) {
+    typename S::vec xr = S::load(&xRe[i]), xi = S::load(&xIm[i]);
+    typename S::vec hr = S::load(&hRe[i]), hi = S::load(&hIm[i]);
+
+    S::store(&dstRe[i], S::fnma(S::fma(S::load(&dstRe[i]), xr, hr), xi, hi));
+    S::store(&dstIm[i], S::fma(S::fma(S::load(&dstIm[i]), xr, hi), xi, hr));
+  }
+
+  if (S::width > 1) {
+    complexMultiplyAdd<SimdScalar>(&dstRe[i], &dstIm[i], &xRe[i], &xIm[i], &hRe[i], &hIm[i], count - i);
+  }
+}
+
+// The radix 4 butterfly, without twiddles, in place on r[0 .. 3] and
+// i[0 .. 3] (a, b, c and d):
+//
+//   X0 = (a + c) +   (b + d)
+//   X1 = (a - c) - i (b - d)
+//   X2 = (a + c) -   (b + d)
+//   X3 = (a - c) + i (b - d)
+
+template <class S> inline void butterfly4(typename S::vec * r, typename S::vec * i)
+{
+  typename S::vec apcr = S::add(r[0], r[2]), apci = S::add(i[0], i[2]);
+  typename S::vec amcr = S::sub(r[0], r[2]), amci = S::sub(i[0], i[2]);
+  typename S::vec bpdr = S::add(r[1], r[3]), bpdi = S::add(i[1], i[3]);
+  typename S::vec bmdr = S::sub(r[1], r[3]), bmdi = S::sub(i[1], i[3]);
+
+  r[0] = S::add(apcr, bpdr); i[0] = S::add(apci, bpdi);
+  r[1] = S::add(amcr, bmdi); i[1] = S::sub(amci, bmdr);
+  r[2] = S::sub(apcr, bpdr); i[2] = S::sub(apci, bpdi);
+  r[3] = S::sub(amcr, bmdi); i[3] = S::add(amci, bmdr);
+}
+
+// (r, i) = (r, i) * (wr, wi)
+
+template <class S> inline void complexMultiply(typename S::vec & r, typename S::vec & i,
+                                               typename S::vec wr, typename S::vec wi)
+{
+  typename S::vec t = S::fnma(S::mul(r, wr), i, wi);
+  i = S::fma(S::mul(r, wi), i, wr);
+  r = t;
+}
+
+// A radix 4 stage with vectors loaded along the s sub-transforms (s is
+// a multiple of the width).
+
+template <class S> void radix4Columns(int n, int s, const float * w, const float * xr, const float * xi,
+                                      float * yr, float * yi)
+{
+  int m  = n / 4;
+  int sm = s * m;
+
+  for (int p = 0; p < m; p++) {
+    typename S::vec wr[3], wi[3];
+
+    for (int k = 0; k < 3; k++) {
+      wr[k] = S::dup(w[(2 * k) * m + p]);
+      wi[k] = S::dup(w[(2 * k + 1) * m + p]);
+    }
+
+    for (int q = 0; q < s; q += S::width) {
+      int i = q + s * p;
+      int o = q + s * 4 * p;
+
+      typename S::vec r[4], im[4];
+
+      for (int k = 0; k < 4; k++) {
+        r[k]  = S::load(&xr[i + k * sm]);
+        im[k] = S::load(&xi[i + k * sm]);
+      }
+
+      butterfly4<S>(r, im);
+
+      for (int k = 1; k < 4; k++) complexMultiply<S>(r[k], im[k], wr[k - 1], wi[k - 1]);
+
+      for (int k = 0; k < 4; k++) {
+        S::store(&yr[o + k * s], r[k]);
+        S::store(&yi[o + k * s], im[k]);
+      }
+    }
+  }
+}
+
+// The first radix 4 stage (s = 1), with vectors loaded along the twiddle
+// positions p (m is a multiple of the width). The four results of each
+// butterfly are consecutive in y: they are interleaved when stored.
+
+template <class S> void radix4First(int n, const float * w, const float * xr, const float * xi,
+                                    float * yr, float * yi)
+{
+  int m = n / 4;
+
+  for (int p = 0; p < m; p += S::width) {
+    typename S::vec r[4], im[4];
+
+    for (int k = 0; k < 4; k++) {
+      r[k]  = S::load(&xr[p + k * m]);
+      im[k] = S::load(&xi[p + k * m]);
+    }
+
+    butterfly4<S>(r, im);
+
+    for (int k = 1; k < 4; k++) {
+      complexMultiply<S>(r[k], im[k], S::load(&w[(2 * k - 2) * m + p]), S::load(&w[(2 * k - 1) * m + p]));
+    }
+
+    S::store4(&yr[4 * p], r[0],  r[1],  r[2],  r[3]);
+    S::store4(&yi[4 * p], im[0], im[1], im[2], im[3]);
+  }
+}
+
+template <class S> void fftRadix4(int n, int s, const float * w, const float * xr, const float * xi,
+                                  float * yr, float * yi)
+{
+  typedef typename S::quad Q;
+
+  if (s >= S::width) {
+    radix4Columns<S>(n, s, w, xr, xi, yr, yi);
+  }
+  else if (s >= Q::width) {
+    radix4Columns<Q>(n, s, w, xr, xi, yr, yi);
+  }
+  else if ((s == 1) && (((n / 4) % Q::width) == 0)) {
+    radix4First<Q>(n, w, xr, xi, yr, yi);
+  }
+  else {
+    radix4Columns<SimdScalar>(n, s, w, xr, xi, yr, yi);
+  }
+}
+
+template <class S> void radix2Columns(int s, const float * xr, const float * xi, float * yr, float * yi)
+{
+  for (int q = 0; q < s; q += S::width) {
+    typename S::vec ar = S::load(&xr[q    ]), ai = S::load(&xi[q    ]);
+    typename S::vec br = S::load(&xr[q + s]), bi = S::load(&xi[q + s]);
+
+    S::store(&yr[q    ], S::add(ar, br)); S::store(&yi[q    ], S::add(ai, bi));
+    S::store(&yr[q + s], S::sub(ar, br)); S::store(&yi[q + s], S::sub(ai, bi));
+  }
+}
+
+template <class S> void fftRadix2(int s, const float * xr, const float * xi, float * yr, float * yi)
+{
+  typedef typename S::quad Q;
+
+  if      (s >= S::width) radix2Columns<S>(s, xr, xi, yr, yi);
+  else if (s >= Q::width) radix2Columns<Q>(s, xr, xi, yr, yi);
+  else                    radix2Columns<SimdScalar>(s, xr, xi, yr, yi);
+}
+
+} // namespace
+
+#define SIMD_KERNELS(S, name)                                              \
+  { name, mixToStereo<S>, multiplyScaled<S>, clip<S>, mixDryWet<S>,        \
+    filterBank<S>, filterCascade<S>, filterRows<S>, allpass<S>, sumRows<S>, \
+    hadamard8<S>, mixWidth<S>, deinterleave<S>, complexMultiplyAdd<S>,     \
+    fftRadix4<S>, fftRadix2<S> }
+
+#endif
@@ -61,7 +61,7 @@
 #define CHKPA(stmt, msg) \
   if ((err = stmt) < 0) { logger.FATAL(msg, Pa_GetErrorText(err)); }
 
-class Sound : public NewHandlerSupport<Sound> {
+class Sound : public RtArenaSupport<Sound> {
 
  private:
   PaStream *dac;  ///< The connection to the PortAudio stream
@@ -117,6 +117,11 @@ class Sound : public NewHandlerSupport<Sound> {
 
   // void checkPort(); // Not working.
 
+  /// Mix the voices and apply the chorus, the reverb and the equalizer to
+  /// produce the next buffer. Used by the sound callback and by the render
+  /// regression check, that runs without audio device.
+  static void mix(frameRecord & buff);
+
   bool holding() { return hold; }
 
   /// Put sound on hold waiting for a new sample library to be loaded from disk
@@ -59,19 +59,50 @@ private:
   const char * data;
   bool loaded;
 
+  std::string filename;
+  int         bankOffset;   ///< Added to the bank number of every preset of this file
+
+  SoundFont2Index index;    ///< Sidecar index of the file
+  sf2Tables       tables;   ///< The presets, instruments, zones and samples location
+
+  // Tables built from the pdta part of the file when there is no valid index
+
+  std::vector<sf2ZoneSet> presetList;
+  std::vector<sf2ZoneSet> instrumentList;
+  std::vector<sf2Zone>    zoneList;
+  std::vector<sfGenList>  genList;
+  std::vector<sfModList>  modList;
+
+  /// The bags, generators and modulators of the presets or of the instruments
+  struct bagTables {
+    sfBag     * bags; uint32_t bagCount;
+    sfGenList * gens; uint32_t genCount;
+    sfModList * mods; uint32_t modCount;
+  };
+
   chunk     * findChunk    (char const * id, chunkList & src);
   chunkList * findChunkList(char const * name);
 
+  /// Build the tables by walking through the RIFF structure of the file
+  /// and the bags of the presets and instruments. Only used when there is
+  /// no valid index.
+  bool retrieveTables();
+
+  /// Take the zones of a preset or an instrument out of its bags. idOper
+  /// is the generator that ends a zone, its value being less than idLimit.
+  void retrieveZones(sf2ZoneSet  & set,
+                     uint16_t      bagIdx,
+                     uint16_t      bagCount,
+                     bagTables   & src,
+                     SFGenerator   idOper,
+                     uint32_t      idLimit);
+
   bool retrieveInstrumentList();
   bool retrievePresetList();
   bool retrieveSamples();
-  void addPresetToMidiList(Preset *preset);
 
   static void  outOfMemory();  ///< New operation handler when out of memory occurs
 
-  Preset * currentPreset;
-  Preset * firstMidiPreset;
-
 public:
 
   std::vector<Instrument *> instruments;
@@ -79,44 +110,37 @@ public:
   std::vector<Sample *>     samples;
 
   /// Open a sound font version 2 file. This will retrieve the list
-  /// of instruments and presets present in the sound font.
-  SoundFont2(std::string & sf2Filename);
+  /// of instruments, presets and samples present in the sound font. Only
+  /// the pdta part of the file is parsed at this point, or its sidecar
+  /// index when available. Samples are prepared when a preset using them
+  /// is loaded.
+  SoundFont2(std::string & sf2Filename, int bankOffset = 0);
   ~SoundFont2();
 
+  inline bool          isLoaded()      { return loaded;     }
+  inline std::string & getFilename()   { return filename;   }
+  inline int           getBankOffset() { return bankOffset; }
+
+  /// Load the zones of an instrument for the range of keys. The samples
+  /// required are added to the batch, to be prepared later on.
   bool loadInstrument(std::string & instrumentName,
-                      rangesType  & keys);
+                      rangesType  & keys,
+                      sampleBatch & batch);
   bool loadInstrument(uint16_t instrumentIndex,
-                      rangesType  & keys);
-
-  bool loadPreset(std::string & presetName);
-  bool loadPreset(uint16_t presetIndex);
-  bool loadPreset(Preset * p);
-  bool loadMidiPreset(uint8_t bankNbr, uint8_t midiNbr);
-
-  bool loadNextPreset();
-  bool loadPreviousPreset();
-  bool loadFirstPreset();
+                      rangesType  & keys,
+                      sampleBatch & batch);
 
-  std::vector<uint16_t> showMidiPresetList();
+  /// Retrieve the zones of a preset from the file
+  bool loadPresetData(Preset * preset);
 
-  inline Preset * getCurrentPreset() { return currentPreset; };
+  /// Returns true if the instrument is part of a loaded preset other
+  /// than the one supplied.
+  bool isInstrumentUsed(int16_t instrumentIndex, Preset * except);
 
-  inline bool loadSample(uint16_t sampleIndex) {
-    if (sampleIndex < samples.size()) {
-      assert(samples[sampleIndex] != NULL);
-      return samples[sampleIndex]->load();
-    }
-    return false;
+  inline Sample * getSample(uint16_t sampleIndex) {
+    return sampleIndex < samples.size() ? samples[sampleIndex] : NULL;
   };
 
-  inline void playNote(uint8_t note, uint8_t velocity) {
-    if (currentPreset) currentPreset->playNote(note, velocity);
-  };
-
-  inline void stopNote(uint8_t note) {
-    if (currentPreset) currentPreset->stopNote(note);
-  }
-
   inline Instrument * getInstrument(uint16_t index) {
     return index < instruments.size() ? instruments[index] : NULL;
   };
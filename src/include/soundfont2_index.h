@@ -0,0 +1,140 @@
+// Notice
+// ------
+//
+// This file is part of the Mezzo SoundFont2 Sampling Based Synthesizer:
+//
+//     https://github.com/turgu1/mezzo
+//
+// Simplified BSD License
+// ----------------------
+//
+// Copyright (c) 2018, Guy Turcotte
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// The views and conclusions contained in the software and documentation are those
+// of the authors and should not be interpreted as representing official policies,
+// either expressed or implied, of the FreeBSD Project.
+//
+#ifndef _SOUNDFONT2_INDEX_
+#define _SOUNDFONT2_INDEX_
+
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <string>
+
+/// A preset or an instrument, as retrieved from the pdta tables. Its
+/// zones are consecutive in the zones table, the global zone being the
+/// first one when present.
+
+struct sf2ZoneSet {
+  char     name[20];
+  uint16_t midiNbr;         ///< Presets only
+  uint16_t bankNbr;         ///< Presets only
+  uint32_t zoneIdx;         ///< First zone in the zones table
+  uint16_t zoneCount;       ///< Number of zones, not counting the global zone
+  uint16_t globalZone;      ///< 1 if the first zone is a global zone
+};
+
+/// A zone with its generators and modulators taken out of the bags. Apart
+/// for the global zone, the key range, velocity range and instrument or
+/// sample id are not part of the generators list.
+
+struct sf2Zone {
+  uint32_t   genIdx;        ///< First generator in the generators table
+  uint32_t   modIdx;        ///< First modulator in the modulators table
+  uint16_t   genCount;
+  uint16_t   modCount;
+  rangesType keys;          ///< 0-0 when not specified
+  rangesType velocities;    ///< 0-0 when not specified
+  int16_t    index;         ///< Instrument of a preset zone or sample of an instrument zone
+  uint16_t   filler;
+};
+
+/// Location of the tables of a sound font file. The samples attributes are
+/// pointing either inside the sound font file itself or inside its sidecar
+/// index. The other tables, built from the pdta part of the file, are kept
+/// by the SoundFont2 class or are inside the index.
+
+struct sf2Tables {
+  sf2ZoneSet * presets;     uint32_t presetCount;
+  sf2ZoneSet * instruments; uint32_t instrumentCount;
+  sf2Zone    * zones;       uint32_t zoneCount;
+  sfGenList  * gens;        uint32_t genCount;
+  sfModList  * mods;        uint32_t modCount;
+  sfSample   * samples;     uint32_t sampleCount;
+
+  uint32_t smplOffset, smplLen;  ///< Location of the 16 bits samples in the sound font file
+  uint32_t sm24Offset, sm24Len;  ///< Location of the low 8 bits of 24 bits samples (len is 0 if none)
+};
+
+/// A SoundFont2Index is a compact binary sidecar of a sound font file
+/// (the file name with a .mzidx suffix). It keeps the presets, instruments
+/// and zones of the pdta part, with the generators and modulators already
+/// taken out of the bags, the samples attributes and the location of the
+/// samples. The next startups don't have to walk through the RIFF structure
+/// of the file nor through the bags of the presets and instruments. It is
+/// loaded with a single memory map.
+///
+/// The index is associated with a sound font file through its size, its
+/// modification time and a hash of its first and last 4KB. When they don't
+/// match, the index is rebuilt.
+
+class SoundFont2Index : public NewHandlerSupport<SoundFont2Index> {
+
+private:
+  boost::iostreams::mapped_file_source file;
+
+  struct sf2FileId {
+    uint64_t size;
+    int64_t  mtime;
+    uint64_t hash;
+  };
+
+  /// Candidate locations of the index: next to the sound font file first,
+  /// then in the configured index folder, if any.
+  std::vector<std::string> indexFilenames(std::string & sf2Filename);
+
+  bool identify(std::string & sf2Filename, const char * sf2Data, uint64_t sf2Size,
+                sf2FileId & id);
+
+  /// Check that all table references are inside their table and that
+  /// the samples are inside the sound font file.
+  bool validate(sf2Tables & tables, uint64_t sf2Size);
+
+  static void  outOfMemory();  ///< New operation handler when out of memory occurs
+
+public:
+   SoundFont2Index();
+  ~SoundFont2Index();
+
+  /// Map the index of the sound font file. Returns false if there is
+  /// no index or it is not related to the current content of the file.
+  bool load(std::string & sf2Filename, const char * sf2Data, uint64_t sf2Size,
+            sf2Tables & tables);
+
+  /// Write the index of the sound font file, using the tables built
+  /// from its RIFF structure.
+  bool save(std::string & sf2Filename, const char * sf2Data, uint64_t sf2Size,
+            sf2Tables & tables);
+};
+
+#endif
@@ -47,6 +47,22 @@
 // transform samples in relashionship with the generators. A synthesizer
 // is attached to each voice and is central to the transformation of
 // sounds in the way the soundfont designer wanted it to be ear.
+//
+// Beside the dry mix, a voice feeds the reverb and chorus send buses,
+// scaled by its SF2 effect send amounts. The send gains are amplified by
+// EFFECT_SEND_GAIN such that a 20% send, the maximum reached through the
+// default controller 91/93 modulators, feeds the effects with about the
+// level of the dry mix.
+//
+// The modulation envelope and LFO are evaluated once per control block
+// (CONTROL_BLOCK_SIZE samples), for the whole buffer at the start of the
+// resampling. They are routed to the filter cutoff, to the pitch and (the
+// LFO only) to the volume. The pitch ratio and the volume gain are
+// interpolated linearly across each control block, from the value of the
+// previous block.
+
+#define EFFECT_SEND_GAIN 5.0f
+#define VOICE_SILENCE    1.0e-5f  ///< Level (-100 dB) under which a fading voice is ended
 
 class Synthesizer {
 
@@ -54,6 +70,7 @@ private:
   Vibrato   vib;
   Envelope  volEnvelope;
   Envelope  modEnvelope;
+  ModLfo    modLfo;
   BiQuad    biQuad;
 
   uint32_t  pos;
@@ -67,6 +84,15 @@ private:
   double    correctionFactor;
   float32_t left, right;
   int16_t   pan;
+  int16_t   modPan;              // Variation from the modulators since the note-on
+  int16_t   reverbSend;          // SF2 units (0.1%)
+  int16_t   chorusSend;
+  int16_t   modReverbSend;
+  int16_t   modChorusSend;
+  float     reverbGain;          // Resulting send gains
+  float     chorusGain;
+  float     modGain;             // Attenuation variation from the modulators
+  float     pitchFactor;         // Pitch variation from the modulators, as a ratio
   int16_t   fineTune;
   uint8_t   rootKey;
   int8_t    keynum;
@@ -81,84 +107,100 @@ private:
   #endif
 
   float attenuation;
-
-  enum setGensType { set, adjust, init };
+  float silentLevel;             // Volume envelope level under which the voice cannot be heard
+
+  int16_t   modLfoToPitch;       // cents at the LFO peak
+  int16_t   modLfoToVolume;      // cB at the LFO peak
+  int16_t   modEnvToPitch;       // cents at the envelope peak
+  bool      modEnvUsed;          // The modulation envelope / LFO feed a destination
+  bool      modLfoUsed;
+  bool      pitchModulated;
+  bool      volumeModulated;
+  bool      pitchRamping;        // Pitch ratios for the next buffer are not all 1
+
+  // Modulation values for each control block of the next buffer. The
+  // pitch ratios and volume gains are at the end of each block, index 0
+  // being the end of the last block of the previous buffer.
+
+  float     modEnvValues[CONTROL_BLOCK_COUNT];
+  float     modLfoValues[CONTROL_BLOCK_COUNT];
+  float     pitchRatios[CONTROL_BLOCK_COUNT + 1];
+  float     volumeGains[CONTROL_BLOCK_COUNT + 1];
+
+  enum setGensType { set, adjust, init, modulate };
   void setGens(sfGenList * gens, uint8_t genCount, setGensType type);
 
+  /// Mix the voice into the dry buffer, following the voice panning. The
+  /// vector backend is the one selected at startup (simd.h).
   inline void toStereoAndMix(frameRecord & dst, sampleRecord & src, uint16_t length)
   {
-    #if USE_NEON_INTRINSICS
-      // If required, pad the buffer to be a multiple of 4
-      if (length & 0x03) {
-        do {
-          src[length++] = 0.0f;
-        } while (length & 0x03);
-      }
-      assert(((length & 0x03) == 0) && (length >= 4) && (length <= BUFFER_SAMPLE_COUNT));
-    #else
-      assert((length >= 1) && (length <= BUFFER_SAMPLE_COUNT));
-    #endif
+    assert((length >= 1) && (length <= BUFFER_SAMPLE_COUNT));
 
+    int16_t totalPan = pan + modPan;
 
-    if (pan >=  250) {
-      #if USE_NEON_INTRINSICS
-        float32x4x2_t dstData;
-        float32x4_t   srcData;
-
-        for (int i = 0; i < length; i += 4) {
-          __builtin_prefetch(&dst[i].left);
-          __builtin_prefetch(&src[i]);
-          dstData = vld2q_f32(&dst[i].left);
-          srcData = vld1q_f32(&src[i]);
-          dstData.val[1] = vaddq_f32(dstData.val[1], srcData);
-          vst2q_f32(&dst[i].left, dstData);
-        }
-      #else
-        for (int i = 0; i < length; i++) dst[i].right += src[i];
-      #endif
-    }
-    else if (pan <= -250) {
-      #if USE_NEON_INTRINSICS
-        float32x4x2_t dstData;
-        float32x4_t   srcData;
-
-        for (int i = 0; i < length; i += 4) {
-          __builtin_prefetch(&dst[i].left);
-          __builtin_prefetch(&src[i]);
-          dstData = vld2q_f32(&dst[i].left);
-          srcData = vld1q_f32(&src[i]);
-          dstData.val[0] = vaddq_f32(dstData.val[0], srcData);
-          vst2q_f32(&dst[i].left, dstData);
-        }
-      #else
-        for (int i = 0; i < length; i++) dst[i].left += src[i];
-      #endif
-    }
-    else {
-      #if USE_NEON_INTRINSICS
-        float32x4x2_t dstData;
-        float32x4_t   srcData;
+    float l = (totalPan >=  250) ? 0.0f : ((totalPan <= -250) ? 1.0f : left );
+    float r = (totalPan <= -250) ? 0.0f : ((totalPan >=  250) ? 1.0f : right);
+
+    simd->mixToStereo(&dst[0].left, &src[0], length, l, r);
+  }
+
+  /// Mix the voice into an effect send bus, following the voice panning
+  inline void toBusAndMix(frameRecord & bus, sampleRecord & src, uint16_t length, float gain)
+  {
+    int16_t totalPan = pan + modPan;
+
+    float l = (totalPan >=  250) ? 0.0f : ((totalPan <= -250) ? gain : (left  * gain));
+    float r = (totalPan <= -250) ? 0.0f : ((totalPan >=  250) ? gain : (right * gain));
+
+    simd->mixToStereo(&bus[0].left, &src[0], length, l, r);
+  }
+
+  void computePanning();
+  void computeSends();
 
-        for (int i = 0; i < length; i += 4) {
-          __builtin_prefetch(&dst[i].left);
-          __builtin_prefetch(&src[i]);
-          dstData = vld2q_f32(&dst[i].left);
-          srcData = vld1q_f32(&src[i]);
+  /// Multiply the envelope amplitudes by the volume modulation
+  inline void applyVolumeModulation(sampleRecord & amps, uint16_t length)
+  {
+    if (!volumeModulated) return;
+
+    for (uint16_t blk = 0; blk < length; blk += CONTROL_BLOCK_SIZE) {
+
+      uint16_t blkEnd = ((length - blk) > CONTROL_BLOCK_SIZE) ? blk + CONTROL_BLOCK_SIZE : length;
+      float    gain   = volumeGains[blk / CONTROL_BLOCK_SIZE];
+      float    delta  = (volumeGains[(blk / CONTROL_BLOCK_SIZE) + 1] - gain) * (1.0f / CONTROL_BLOCK_SIZE);
+
+      #if USE_NEON_INTRINSICS
+        static const float steps[4] = { 1.0f, 2.0f, 3.0f, 4.0f };
 
-          dstData.val[0] = vmlaq_n_f32(dstData.val[0], srcData, left);
-          dstData.val[1] = vmlaq_n_f32(dstData.val[1], srcData, right);
+        float32x4_t gains = vmlaq_n_f32(vdupq_n_f32(gain), vld1q_f32(steps), delta);
+        float32x4_t incr  = vdupq_n_f32(4.0f * delta);
 
-          vst2q_f32(&dst[i].left, dstData);
+        for (int i = blk; i < blkEnd; i += 4) {
+          vst1q_f32(&amps[i], vmulq_f32(vld1q_f32(&amps[i]), gains));
+          gains = vaddq_f32(gains, incr);
         }
       #else
-        for (int i = 0; i < length; i++) {
-          dst[i].left  += src[i] * left;
-          dst[i].right += src[i] * right;
+        for (uint16_t i = blk; i < blkEnd; i++) {
+          gain    += delta;
+          amps[i] *= gain;
         }
       #endif
     }
   }
 
+  /// Retrieve the volume envelope amplitudes for the next length samples,
+  /// with the volume modulation, and check for the end of the sound. A
+  /// voice that has faded out is ended without waiting for the end of its
+  /// envelope or of its sample: its tail would only cost processing time,
+  /// down to the subnormal numbers range. Used with and without the voice
+  /// bank.
+  inline void getVolumeAmplitudes(sampleRecord & amps, uint16_t length)
+  {
+    endOfSound = volEnvelope.getAmplitudes(amps, length) ||
+                 volEnvelope.isFadedUnder(silentLevel);
+    applyVolumeModulation(amps, length);
+  }
+
   inline void setAttenuation  (int16_t a) { attenuation  = centibelToRatio(- a); }
   inline void addToAttenuation(int16_t a) { attenuation *= centibelToRatio(- a); }
 
@@ -198,6 +240,18 @@ public:
 
   inline void     setEndOfSound(bool val) { endOfSound = val;    }
 
+  inline float    getReverbGain()  { return reverbGain;        }
+  inline float    getChorusGain()  { return chorusGain;        }
+  inline float    getPitchFactor() { return pitchFactor;       }
+
+  /// Add the note-on value of the modulators to the generators. This is
+  /// done before completeParams().
+  void addModulators(Modulators & mods);
+
+  /// Follow the variations of the modulators since the note-on, for the
+  /// destinations that can change while the note is sounding.
+  void applyModulatorDeltas(Modulators & mods);
+
   #if loadInMemory
     inline void      setLastValue(sample_t v) { lastValue = v;    }
     inline sample_t  getLastValue()           { return lastValue; }
@@ -208,9 +262,10 @@ public:
 
   /// Returns true if this call must be considered the end of the note (in the
   /// case where the envelope as been desactivated)
-  inline bool keyHasBeenReleased() { return volEnvelope.keyHasBeenReleased(); }
-
-  inline float vibrato(uint32_t pos) { return vib.nextValue(pos); }
+  inline bool keyHasBeenReleased() {
+    modEnvelope.keyHasBeenReleased();
+    return volEnvelope.keyHasBeenReleased();
+  }
 
   static bool areAllFilterActive()   { return   BiQuad::areAllActive(); }
   static bool areAllVibratoActive()  { return  Vibrato::areAllActive(); }
@@ -220,6 +275,37 @@ public:
   static bool toggleVibrato()    { return  Vibrato::toggleAllActive(); }
   static bool toggleEnvelope()   { return Envelope::toggleAllActive(); }
 
+  /// Evaluate the modulation envelope and LFO for the control blocks of
+  /// the next buffer.
+  void computeModulations();
+
+  /// Fill ratios with the pitch modulation of each sample of the next
+  /// buffer. Returns the highest ratio.
+  float getPitchRamp(sampleRecord & ratios);
+
+  /// Set the filter cutoff for the control block blk of the buffer, from
+  /// the modulation envelope and LFO.
+  inline void updateFilter(int blk)
+  {
+    biQuad.update(modEnvValues[blk], modLfoValues[blk]);
+  }
+
+  /// Used by the voice bank (voice_bank.h) that filters four voices at a
+  /// time: retrieve the volume envelope amplitudes for the next length
+  /// samples and return the gain to apply with them.
+  inline float32_t prepareBankProcessing(sampleRecord & amps, uint16_t length, float gain)
+  {
+    getVolumeAmplitudes(amps, length);
+
+    return gain * attenuation * modGain;
+  }
+
+  inline BiQuad * getBiQuad() { return &biQuad; }
+
+  /// Apply the low-pass filter, the volume envelope and the gain. This is
+  /// done one control block at a time, the filter cutoff being updated
+  /// from the modulation envelope and LFO at the start of each block.
+  /// computeModulations() must have been called for the buffer.
   inline void applyEnvelopeAndGain(sampleRecord & src, uint16_t length, float gain)
   {
     sampleRecord amps;
@@ -236,35 +322,34 @@ public:
       assert((length >= 1) && (length <= BUFFER_SAMPLE_COUNT));
     #endif
 
-    float32_t attGain = gain * attenuation;
+    float32_t attGain = gain * attenuation * modGain;
     //std::cout << attGain << " / " << attenuation << std::endl;
 
-    endOfSound = volEnvelope.getAmplitudes(amps, length);
+    getVolumeAmplitudes(amps, length);
 
-    #if USE_NEON_INTRINSICS
-      float32x4_t   srcData;
-      float32x4_t   envData;
-
-      for (int i = 0; i < length; i += 4) {
-        __builtin_prefetch(&amps[i]);
-        __builtin_prefetch(&src[i]);
-        envData = vld1q_f32(&amps[i]);
-        srcData = vld1q_f32(&src[i]);
-        envData = vmulq_n_f32(envData, attGain);
-        srcData = vmulq_f32(srcData, envData);
-        vst1q_f32(&src[i], srcData);
-      }
-    #else
-      for (uint16_t i = 0; i < length; i++) {
-        src[i] *= attGain * amps[i];
+    bool filtering = biQuad.isActive();
+
+    for (uint16_t blk = 0; blk < length; blk += CONTROL_BLOCK_SIZE) {
+
+      uint16_t blkEnd = ((length - blk) > CONTROL_BLOCK_SIZE) ? blk + CONTROL_BLOCK_SIZE : length;
+
+      if (filtering) {
+        updateFilter(blk / CONTROL_BLOCK_SIZE);
+        biQuad.filter(&src[blk], blkEnd - blk);
       }
-    #endif
+
+      simd->multiplyScaled(&src[blk], &amps[blk], attGain, blkEnd - blk);
+    }
   }
 
-  inline bool transformAndMix(frameRecord & dst, sampleRecord & src, uint16_t length)
+  /// Mix the voice into the dry buffer and into the effect send buses.
+  /// A NULL bus is not fed.
+  inline bool transformAndMix(frameRecord & dst,
+                              frameRecord * reverbBus,
+                              frameRecord * chorusBus,
+                              sampleRecord & src,
+                              uint16_t length)
   {
-    //biQuad.filter(src, length);
-
     #if USE_NEON_INTRINSICS
       // If required, pad the buffer to be a multiple of 4
       if (length & 0x03) {
@@ -278,6 +363,9 @@ public:
 
     toStereoAndMix(dst, src, length);
 
+    if ((reverbBus != NULL) && (reverbGain > 0.0f)) toBusAndMix(*reverbBus, src, length, reverbGain);
+    if ((chorusBus != NULL) && (chorusGain > 0.0f)) toBusAndMix(*chorusBus, src, length, chorusGain);
+
     pos += length;
 
     // if (endOfSound) std::cout << "End of Sound" << std::endl;
@@ -110,26 +110,7 @@ public:
   // application, but rtAudio requires an C array of floats.
   static inline void clip(buffp dst, frameRecord & buff)
   {
-    const float minusOne = -1.0f;
-    const float one      =  1.0f;
-
-    #if USE_NEON_INTRINSICS
-      // If required, pad the buffer to be a multiple of 4
-      float32x4_t minusOnes = vld1q_dup_f32(&minusOne);
-      float32x4_t ones = vld1q_dup_f32(&one);
-
-      for (uint16_t i = 0; i < buff.size(); i += 2) {
-        float32x4_t data = vld1q_f32(&buff[i].left);
-        data = vminq_f32(vmaxq_f32(data, minusOnes), ones);
-        vst1q_f32(dst, data);
-        dst += 4;
-      }
-    #else
-      for (auto & element : buff) {
-        *dst++  = MIN(MAX(element.left, minusOne), one);
-        *dst++  = MIN(MAX(element.right, minusOne), one);
-      }
-    #endif
+    simd->clip(dst, &buff[0].left, 2 * buff.size());
   }
 
   static bool fileExists(const char * name);
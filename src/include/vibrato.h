@@ -43,56 +43,71 @@
 
 #include "mezzo.h"
 
+// The vibrato LFO of the SF2 specification, routed to the pitch. Its
+// value, in cents, is required at control rate only: the synthesizer
+// combines it with the other pitch modulations in a ratio ramp that is
+// applied by the resampler.
+
 class Vibrato
 {
 private:
   static bool allActive;
 
   Lfo      lfo;
-  float    pitch;
+  float    pitch;                // cents at the LFO peak
+  float    modPitch;             // Variation from the modulators since the note-on
   float    frequency;
   uint32_t delay;
-  float    pitchSamples;
+  uint32_t pos;
 
 public:
-  Vibrato() { pitch = 0.0f; frequency = 8.176f; delay = centsToSampleCount(-12000); }
+  Vibrato() { pitch = modPitch = 0.0f; frequency = 8.176f; delay = centsToSampleCount(-12000); pos = 0; }
 
-  inline void setup(uint8_t note) {
-    // The chosen phase is to get a smooth transition at the beginning of the vibrato integration.
-    lfo = Lfo(frequency, 3.0f * M_PI / 2.0f);
-    pitchSamples = log2(noteFrequency(note) * pitch / 100.0f);
+  inline void setup() {
+    lfo.setup(frequency);
+    modPitch = 0.0f;
+    pos      = 0;
   }
 
   static bool toggleAllActive() { return allActive = !allActive; }
   static bool areAllActive()    { return allActive;              }
 
+  inline bool isActive() { return allActive && ((pitch + modPitch) != 0.0f) && (frequency != 0.0f); }
+
   inline void setPitch(int16_t p)     { pitch      = ((float) p); }
   inline void addToPitch(int16_t p)   { pitch     += ((float) p); }
 
+  /// Modulators (e.g. the modulation wheel) moving the depth while the note is sounding
+  inline void setModPitch(int16_t p)  { modPitch   = ((float) p); }
+
   inline void setDelay(int16_t d)     { delay      = (d == -32768) ? 0 : centsToSampleCount(d); }
   inline void addToDelay(int16_t d)   { delay     *= (d == -32768) ? 1 : centsToRatio(d); }
 
   inline void setFrequency(float f)   { frequency  = centsToFreq(f); }
   inline void addToFrequency(float f) { frequency *= centsToRatio(f); }
 
-  inline float nextValue(uint32_t pos)
+  /// Pitch variation in cents for the next control block
+  inline float nextControlValue()
   {
-    if (allActive && (pitch  != 0.0f) && (frequency != 0.0f)) {
-      return (pos < delay) ? 0.0f : (pitchSamples + (lfo.nextValue() * pitchSamples));
-    }
-    else {
+    if (pos < delay) {
+      pos += CONTROL_BLOCK_SIZE;
       return 0.0f;
     }
+
+    return lfo.nextControlValue() * (pitch + modPitch);
   }
 
+  /// Let the time pass while the vibrato is not active, for the delay.
+  inline void skip(uint32_t length) { if (pos < delay) pos += length; }
+
   void showStatus(int spaces)
   {
     using namespace std;
 
     cout << setw(spaces) << ' '
-         <<"Vibrato: " << ((allActive && (pitch  != 0.0f) && (frequency != 0.0f)) ? "Active" : "Inactive")
+         <<"Vibrato: " << (isActive() ? "Active" : "Inactive")
          << " [Delay:" << delay
-         << " Pitch:"  << pitch
+         << " Pitch:"  << pitch + modPitch
          << " Freq:"   << frequency
          << "] ";
 
@@ -39,12 +39,16 @@
 #ifndef VOICE_H
 #define VOICE_H
 
+#include <atomic>
+
 #include "mezzo.h"
 
 typedef enum { DORMANT, ALIVE } voiceState;
 
 typedef class Voice * voicep;
 
+class VoiceBank;
+
 // The 4 additional float in the buffer will allow for the continuity of
 // interpolation between buffer retrieval action from the fifo. The last 4 samples
 // of the last retrieved record will be put back as the 4 first samples in the buffer
@@ -59,47 +63,70 @@ typedef std::array<sample_t, BUFFER_SAMPLE_COUNT + 4> scaleRecord;
 /// required to be played. The number of pre-allocated voices can be
 /// easily changed in the Poly class definition (poly.h).
 
-class Voice {
+class Voice : public RtArenaSupport<Voice> {
 
  private:
-  voicep  next;              ///< Next voice available in the list
-
-  uint32_t seq;
-  static uint32_t nextSeq;
-  static bool     showPlayingState;
-
-  volatile voiceState state; ///< This is the state of this voice, as described in the comments above
-  volatile bool  active;     ///< This voice is active and is being played
-  volatile int   stateLock;  ///< Locked by threads when reading/updating data
-
+  // The members are grouped by the threads accessing them, a group
+  // starting on its own cache line:
+  //
+  //   - the identity of the voice, read by all threads when walking the
+  //     voice list and only written at note on and note off;
+  //   - the lock and the buffer hand off flags, written at every buffer
+  //     by the feeder threads, the voice banks and the mixer;
+  //   - the resampler state, only used by the feeder threads;
+  //   - the synthesizer and modulators, less used per buffer.
+  //
+  // The resampled buffer itself is in a pool kept by Poly, away from the
+  // voices, such that the voice list stays compact.
+
+  voicep      next;          ///< Next voice available in the list
+  Channel   * channel;       ///< MIDI channel that started this voice
   samplep     sample;        ///< Pointer on the sample
+  uint32_t    seq;
+  volatile voiceState state; ///< This is the state of this voice, as described in the comments above
+  volatile bool active;      ///< This voice is active and is being played
   int8_t      note;          ///< Targeted note, can be different than the one from sample
+  uint8_t     velocity;      ///< How the key was struck by the player
   bool        noteIsOn;      ///< The note is played
   bool        keyIsOn;       ///< The *keyboard* midi key is on
-  float       gain;          ///< Gain to apply to this sample (depends on how the key was struck by the player)
-  uint32_t    outputPos;     ///< Position in the scaled (or not) processed stream of samples
+
+  alignas(CACHE_LINE_SIZE)
+  volatile int  stateLock;   ///< Locked by threads when reading/updating data
+  volatile bool bufferReady;
+  int           bufferSize;
+  std::atomic<bool> bankPending; ///< The buffer is waiting in a voice bank
+  std::atomic<uint32_t> retireSeq; ///< Sequence number of the note retired by the mixer
+
+  alignas(CACHE_LINE_SIZE)
+  double        factor;
+  double        samplePos;   ///< Position in the sample, taking into account pitch changes
+  uint32_t      outputPos;   ///< Position in the scaled (or not) processed stream of samples
 
   #if loadInMemory
-    buffp    sampleBuff;
-    uint32_t sampleBuffSize;
+    uint32_t loopStart;      ///< Loop position in the sample
+    uint32_t loopEnd;
+    uint32_t sampleEnd;      ///< End of the sample when not looping
+    buffp    sampleData;     ///< Sample data, with guards on both sides
+    buffp    loopData;       ///< Loop data (see Sample::getLoop()), NULL when not looping
   #else
-    Fifo        fifo;        ///< Fifo for samples retrieved through threading
-    scaleRecord sampleBuff;
     uint32_t    fifoLoadPos;
+    uint32_t    sampleBuffPos;
     uint16_t    sampleBuffSize;
+    scaleRecord sampleBuff;
+    Fifo        fifo;        ///< Fifo for samples retrieved through threading
   #endif
 
-  uint32_t      sampleBuffPos;
-  double        factor;
+  sampleRecord & buffer;     ///< Slot of the voice in the buffers pool
 
-  sampleRecord  buffer;
-  int           bufferSize;
-  volatile bool bufferReady;
+  static uint32_t nextSeq;
+  static bool     showPlayingState;
 
+  alignas(CACHE_LINE_SIZE)
   Synthesizer   synth;
+  Modulators    modulators;
 
  public:
-   Voice();
+   Voice(sampleRecord & poolBuffer);
   ~Voice();
 
   static bool togglePlayingState()   { return showPlayingState = !showPlayingState; }
@@ -111,10 +138,12 @@ class Voice {
   /// voice to be played.
   void setup(samplep       _sample,
              uint8_t       _note,
-             float         _gain,
+             uint8_t       _velocity,
              Synthesizer   _synth,
+             modulatorList & _instrumentMods,
              Preset      & _preset,
-             uint16_t      _presetZoneIdx);
+             uint16_t      _presetZoneIdx,
+             Channel     & _channel);
 
   #if !loadInMemory
     /// This method returns the next bundle of samples required by the
@@ -139,24 +168,44 @@ class Voice {
   inline bool isActive()   { return  active; }
   inline bool isInactive() { return !active; }
 
+  /// A voice whose buffer is waiting in a voice bank can't be set up
+  /// again, as the bank is still working on its buffer and filter.
+  inline bool isBankPending() { return bankPending.load(std::memory_order_acquire); }
+
+  /// Called by the mixer at the end of the sound. The voice is stopped
+  /// by its feeder thread (see Poly::feedVoice()), as the mixer must not
+  /// wait on the lock.
+  inline void retire()     { retireSeq.store(seq, std::memory_order_release); }
+  inline bool isRetiring() {
+    return active && (retireSeq.load(std::memory_order_acquire) == seq);
+  }
+
   inline bool isDormant()  { return state == DORMANT; }
   inline bool isAlive()    { return state == ALIVE;   }
 
   inline void setState(voiceState value) { state = value; };
 
-  inline void activate()   { if (isInactive()) setState(ALIVE);   active = true;  }
-  inline void inactivate() { if (isActive())   setState(DORMANT); active = false;
+  inline void activate()   {
+    if (isInactive()) { setState(ALIVE);   channel->incVoiceCount(); }
+    active = true;
+  }
+  /// Returns true if the voice was active. To be called under the lock.
+  inline bool inactivate() {
+    bool wasActive = isActive();
+    if (wasActive)    { setState(DORMANT); channel->decVoiceCount(); }
+    active = false;
     #if !loadInMemory
       clearFifo();
     #endif
+    return wasActive;
   }
 
   inline void    setNext(voicep n) { next = n;    }
   inline voicep  getNext()         { return next; }
   inline int8_t  getNote()         { return note; }
-  inline float   getGain()         { return gain; }
   inline int16_t  getPan()         { return synth.getPan(); }
   inline uint32_t getSeq()         { return seq;  }
+  inline Channel * getChannel()    { return channel; }
 
   static double getScaleFactor(int16_t diff);
 
@@ -166,6 +215,34 @@ class Voice {
   // time for the poly::mixer method.
   void feedBuffer(bool bypass = false);
 
+  /// Same as above, used by the feeder threads. The voice may be put
+  /// in the bank to be filtered along with other voices. It is then
+  /// unlocked and marked as pending in the bank.
+  void feedBuffer(VoiceBank & bank);
+
+  inline Synthesizer  & getSynth()        { return synth;  }
+  inline sampleRecord & getSampleBuffer() { return buffer; }
+  inline float          getMixGain()      { return config.masterVolume; }
+
+  /// Called by the voice bank once the full buffer has been processed.
+  inline void bufferProcessed() {
+    bufferSize  = BUFFER_SAMPLE_COUNT;
+    bufferReady = true;
+    bankPending.store(false, std::memory_order_release);
+  }
+
+  /// Called by the voice bank for a voice stopped while it was waiting.
+  inline void bufferDropped() {
+    bankPending.store(false, std::memory_order_release);
+  }
+
+ private:
+  int  resampleBuffer();
+  void fillBuffer();
+  void completeBuffer(int count);
+
+ public:
+
   #if !loadInMemory
     /// This method is used by the SampleFeeder thread to read new data
     /// from the sample and put it in the next avail slot in the
@@ -184,9 +261,16 @@ class Voice {
   inline bool noteOff()   { keyIsOn = noteIsOn = false;
                             return synth.keyHasBeenReleased(); }
 
-  inline bool transformAndMix(frameRecord & dst, sampleRecord & src, uint16_t length) {
-    return synth.transformAndMix(dst, src, length);
+  inline bool transformAndMix(frameRecord & dst,
+                              frameRecord * reverbBus,
+                              frameRecord * chorusBus,
+                              sampleRecord & src,
+                              uint16_t length) {
+    return synth.transformAndMix(dst, reverbBus, chorusBus, src, length);
   }
+
+  inline bool sendsToReverb() { return synth.getReverbGain() > 0.0f; }
+  inline bool sendsToChorus() { return synth.getChorusGain() > 0.0f; }
 };
 
 #endif
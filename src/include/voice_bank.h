@@ -0,0 +1,98 @@
+// Notice
+// ------
+//
+// This file is part of the Mezzo SoundFont2 Sampling Based Synthesizer:
+//
+//     https://github.com/turgu1/mezzo
+//
+// Simplified BSD License
+// ----------------------
+//
+// Copyright (c) 2018, Guy Turcotte
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// The views and conclusions contained in the software and documentation are those
+// of the authors and should not be interpreted as representing official policies,
+// either expressed or implied, of the FreeBSD Project.
+//
+
+#ifndef _VOICE_BANK_
+#define _VOICE_BANK_
+
+#include "mezzo.h"
+
+// The recursion of a voice filter cannot go faster than one sample after
+// the other. The voice bank is running the filters of four voices at
+// once instead: each voice is given a vector lane, the filter
+// coefficients and state being transposed in a structure of arrays. The
+// voice buffers are transposed four samples at a time in and out of the
+// lanes, and the volume envelope and gain are applied to the filtered
+// samples before they are stored back. This is the filterBank kernel of
+// the selected SIMD backend (see simd.h).
+//
+// Only the filter and the gain run across the lanes. The volume envelope
+// stays with each voice: its amplitudes are computed by the voice
+// (Synthesizer::prepareBankProcessing()) before the bank is processed.
+// A voice does not keep its lane from one buffer to the next, as the
+// bank takes the voices in the order they are ready. Envelope state kept
+// in lanes would be copied in and out on every buffer, like the filter
+// state. The envelope is also computed four samples at a time already.
+// Its segments end on a different sample for each voice, and these
+// transitions are computed one sample at a time: in lanes, they would
+// stop all four voices at each change.
+//
+// Each feeder thread owns a bank. Voices with an active filter are added
+// to it once their buffer has been resampled. They are no longer locked
+// but marked as pending in the bank: a pending voice is not fed, set up
+// again or stolen, and the bank skips it if it has been stopped in the
+// meantime. The bank is processed when its four lanes are used, and at
+// the end of each pass of the feeder thread on the voices list. Only full
+// buffers are going through the bank, the others (end of sample, fifo
+// underrun) are processed by the voice itself.
+
+#define VOICE_BANK_SIZE SIMD_BANK_LANES   ///< One voice per lane of the filterBank kernel
+
+class VoiceBank {
+
+ private:
+  int          laneCount;
+  voicep       voices[VOICE_BANK_SIZE];
+  sampleRecord amps[VOICE_BANK_SIZE];   // Volume envelope of each lane
+  sampleRecord spare;                   // Input of the unused lanes
+
+ public:
+  VoiceBank() { laneCount = 0; }
+
+  /// Add a pending voice whose buffer has been resampled. The bank is
+  /// processed when full.
+  inline void add(voicep voice) {
+    voices[laneCount++] = voice;
+    if (laneCount == VOICE_BANK_SIZE) process();
+  }
+
+  /// Filter and apply the envelope to the voices in the bank, then
+  /// release them to the mixer.
+  void process();
+};
+
+#endif
@@ -40,14 +40,16 @@
 
 #include "mezzo.h"
 
-Instrument::Instrument(char * instrumentName, uint16_t bagIndex, uint16_t bagQty)
+Instrument::Instrument(char * instrumentName, sf2ZoneSet & zoneSet, SoundFont2 * sf2)
 {
   setNewHandler(outOfMemory);
 
-  name = instrumentName;
+  name      = instrumentName;
+  soundFont = sf2;
 
-  bagIdx   = bagIndex;
-  bagCount = bagQty;
+  zoneRecordIdx    = zoneSet.zoneIdx;
+  zoneRecordCount  = zoneSet.zoneCount;
+  globalZoneRecord = zoneSet.globalZone != 0;
 
   init();
 
@@ -58,8 +60,7 @@ void Instrument::init()
 {
   for (int i = 0; i < 128; i++) keys[i] = KEY_NOT_USED;
 
-  gens                  =  NULL;
-  mods                  =  NULL;
+  modOps                =  NULL;
   zones                 =  NULL;
 
   zoneCount             =     0;
@@ -88,188 +89,95 @@ bool Instrument::unload()
   if (!loaded) return false;
 
   if (zones) delete [] zones;
-  if (gens)  delete [] gens;
-  if (mods)  delete [] mods;
+  if (modOps) delete [] modOps;
 
   init();
   return true;
 }
 
-bool Instrument::load(sfBag      * bags,
+bool Instrument::load(sf2Zone    * zoneRecords,
                       sfGenList  * generators,
                       sfModList  * modulators,
-                      rangesType & keysToLoad)
+                      rangesType & keysToLoad,
+                      sampleBatch & batch)
 {
-  int count;
-
-  if (bagCount == 0) return false;
+  if ((zoneRecordCount == 0) && !globalZoneRecord) return false;
 
   if (!loaded) {
 
-    // We get one more as an end of list indicator (sampleIndex will be -1)
-
-    zones     = new aZone[bagCount + 1];
-    zoneCount = bagCount;
-
-    for (uint16_t zoneIdx = 0; zoneIdx <= zoneCount; zoneIdx++) {
-      zones[zoneIdx].keys.byHi       =    0;
-      zones[zoneIdx].keys.byLo       =    0;
-      zones[zoneIdx].velocities.byLo =    0;
-      zones[zoneIdx].velocities.byHi =    0;
-      zones[zoneIdx].sampleIndex     =   -1;
-      zones[zoneIdx].generators      = NULL;
-      zones[zoneIdx].modulators      = NULL;
-      zones[zoneIdx].genCount        =    0;
-      zones[zoneIdx].modCount        =    0;
-    }
-
-    int firstGenIdx = bags[bagIdx].wGenNdx;
-    int lastGenIdx  = bags[bagIdx + bagCount].wGenNdx;
-    int firstModIdx = bags[bagIdx].wModNdx;
-    int lastModIdx  = bags[bagIdx + bagCount].wModNdx;
-
-    // If there is no generators in the bags but only modulators
-    // that means there is only a global zone.
+    sf2Zone * z = &zoneRecords[zoneRecordIdx];
 
-    globalZonePresent =
-      ((lastGenIdx - firstGenIdx) == 0) &&
-      ((lastModIdx - firstModIdx) > 0);
+    // ---- globalZone ----
 
-    // If there is some generators, check if the first zone is
-    // a global one. The last gen in the zone must not be a sampleID Operator
+    globalZonePresent = globalZoneRecord;
 
-    globalZonePresent = globalZonePresent ||
-      (((lastGenIdx - firstGenIdx) > 0) &&
-       (generators[bags[bagIdx + 1].wGenNdx - 1].sfGenOper != sfGenOper_sampleID));
-
-    uint8_t globalGenCount;
     if (globalZonePresent) {
-      zoneCount--;
-      globalGenCount = bags[bagIdx + 1].wGenNdx - bags[bagIdx].wGenNdx;
-    }
-    else {
-      globalGenCount = 0;
-    }
-
-    // Count how many generators need to be allocated, considering
-    // that some generator values will be retrieved as normal
-    // instrument parameters.
-
-    int genCount = globalGenCount;
-
-    for (int i = firstGenIdx + globalGenCount; i < lastGenIdx; i++) {
-      if ((generators[i].sfGenOper != sfGenOper_keyRange) &&
-          (generators[i].sfGenOper != sfGenOper_velRange) &&
-          (generators[i].sfGenOper != sfGenOper_sampleID)) genCount++;
-    }
-
-    int modCount = lastModIdx - firstModIdx;
-
-    if (genCount > 0) gens = new sfGenList[genCount];
-    if (modCount > 0) mods = new sfModList[modCount];
-
-    //if ((genCount > 0) || (modCount > 0))
-    {
-      uint16_t    zoneIdx  = 0; // index into zones
-      sfGenList * g  = gens;
-      sfGenList * gg = &generators[bags[bagIdx].wGenNdx];
-      sfModList * m  = mods;
-      sfModList * mm = &modulators[bags[bagIdx].wModNdx];
-      sfBag     * b  = &bags[bagIdx];
-
-      int i = 0;  // How many zone entries we have processed in bags
-
-      // ---- globalZone ----
-
-      // global gens
-
-      // There is global gens if the last gen for the zone is not a sampleId operator
-
-      if (globalGenCount > 0) {
-
-        // There is globals gens so get the gens...
-        globalZone.generators = g;
-        globalZone.genCount   = globalGenCount;
-
-        while (globalGenCount--) *g++ = *gg++;
-
-        assert(globalZonePresent); // Double check...
+      if (z->genCount > 0) {
+        globalZone.generators = &generators[z->genIdx];
+        globalZone.genCount   = z->genCount;
       }
+      if (z->modCount > 0) {
+        globalZone.modulators = &modulators[z->modIdx];
+        globalZone.modCount   = z->modCount;
+      }
+      z++;
+    }
 
-      // global mods
-
-      if (globalZonePresent) {
-
-        count = b[1].wModNdx - b[0].wModNdx;
-        if (count > 0) {
-          globalZone.modulators = m;
-          globalZone.modCount   = count;
+    // We get one more as an end of list indicator (sampleIndex will be -1)
 
-          while (count--) *m++ = *mm++;
+    zones     = new aZone[zoneRecordCount + 1];
+    zoneCount = zoneRecordCount;
+
+    for (uint16_t zoneIdx = 0; zoneIdx < zoneCount; zoneIdx++, z++) {
+      aZone & zone = zones[zoneIdx];
+
+      zone.keys               = z->keys;
+      zone.velocities         = z->velocities;
+      zone.sampleIndex        = z->index;
+      zone.generators         = (z->genCount > 0) ? &generators[z->genIdx] : NULL;
+      zone.modulators         = (z->modCount > 0) ? &modulators[z->modIdx] : NULL;
+      zone.genCount           = z->genCount;
+      zone.modCount           = z->modCount;
+      zone.compiledMods.ops   = NULL;
+      zone.compiledMods.count = 0;
+
+      if ((zone.keys.byLo != 0) || (zone.keys.byHi != 0)) {
+        for (int k = zone.keys.byLo; k <= zone.keys.byHi; k++) {
+          if (keys[k] == KEY_NOT_USED) keys[k] = zoneIdx;
         }
-        b++; i++;
       }
+    }
 
-      while (i < bagCount) {
-        // Loop for each zone
-
-        // ---- generators ----
-
-        // Get the number of generators in the zone
-        count = b[1].wGenNdx - b[0].wGenNdx;
-
-        if (count > 0) {
-          if (gg[count - 1].sfGenOper == sfGenOper_sampleID) {
-            zones[zoneIdx].generators = g;
-            while (count--) {
-              switch (gg->sfGenOper) {
-                case sfGenOper_keyRange:
-                  zones[zoneIdx].keys = gg->genAmount.ranges;
-                  //if (keys[zones[zoneIdx].keys.byLo] == KEY_NOT_USED) {
-                    for (int k = zones[zoneIdx].keys.byLo; k <= zones[zoneIdx].keys.byHi; k++) {
-                      if (keys[k] == KEY_NOT_USED) keys[k] = zoneIdx;
-                    }
-                  //}
-                  break;
-                case sfGenOper_velRange:
-                  zones[zoneIdx].velocities = gg->genAmount.ranges;
-                  break;
-                case sfGenOper_sampleID:
-                  zones[zoneIdx].sampleIndex = gg->genAmount.wAmount;
-                  break;
-                default:
-                  *g++ = *gg;
-                  zones[zoneIdx].genCount++;
-                  break;
-              }
-              gg++;
-            }
-            if (zones[zoneIdx].genCount == 0) zones[zoneIdx].generators = NULL;
-          }
-          else {
-            // The generators list is not valid.
-            while (count--) gg++;
-          }
-        }
-
-        // ---- modulators ----
-
-        count = b[1].wModNdx - b[0].wModNdx;
-
-        if (count > 0) {
-          zones[zoneIdx].modulators = m;
-          zones[zoneIdx].modCount   = count;
-          while (count--) *m++ = *mm++;
-        }
+    zones[zoneCount].keys.byLo          =    0;
+    zones[zoneCount].keys.byHi          =    0;
+    zones[zoneCount].velocities.byLo    =    0;
+    zones[zoneCount].velocities.byHi    =    0;
+    zones[zoneCount].sampleIndex        =   -1;
+    zones[zoneCount].generators         = NULL;
+    zones[zoneCount].modulators         = NULL;
+    zones[zoneCount].genCount           =    0;
+    zones[zoneCount].modCount           =    0;
+    zones[zoneCount].compiledMods.ops   = NULL;
+    zones[zoneCount].compiledMods.count =    0;
+
+    // ---- compiled modulators (modulator.h) ----
+
+    int opCount = 0;
+    for (uint16_t zoneIdx = 0; zoneIdx < zoneCount; zoneIdx++) {
+      opCount += Modulators::roomNeeded(globalZone.modCount, zones[zoneIdx].modCount, true);
+    }
 
-        if (zones[zoneIdx].sampleIndex != -1) {
-          zoneIdx++;       // Goto next zone
-        }
-        else {
-          zoneCount--;
-        }
-        b++; i++;  // ... and next bag
-      }
+    modOps = new modOperation[opCount];
+
+    modOperation * op = modOps;
+    for (uint16_t zoneIdx = 0; zoneIdx < zoneCount; zoneIdx++) {
+      zones[zoneIdx].compiledMods.ops   = op;
+      zones[zoneIdx].compiledMods.count =
+        Modulators::compile(op,
+                            globalZone.modulators,     globalZone.modCount,
+                            zones[zoneIdx].modulators, zones[zoneIdx].modCount,
+                            true);
+      op += zones[zoneIdx].compiledMods.count;
     }
 
     loaded = true;
@@ -289,10 +197,20 @@ bool Instrument::load(sfBag      * bags,
     };
 
     if ((keysToLoad.byLo <= zones[zoneIdx].keys.byHi) && (keysToLoad.byHi >= zones[zoneIdx].keys.byLo)) {
-      if (soundFont->loadSample(zones[zoneIdx].sampleIndex)) {
-        zones[zoneIdx].synth.setDefaults(soundFont->samples[zones[zoneIdx].sampleIndex]);
+      Sample * sample = soundFont->getSample(zones[zoneIdx].sampleIndex);
+      if (sample != NULL) {
+        batch.push_back(sample);
+        zones[zoneIdx].synth.setDefaults(sample);
         zones[zoneIdx].synth.initGens(globalZone.generators, globalZone.genCount);
         zones[zoneIdx].synth.setGens(zones[zoneIdx].generators, zones[zoneIdx].genCount);
+        #if loadInMemory
+          if (zones[zoneIdx].synth.isLooping() &&
+              !sample->addLoop(zones[zoneIdx].synth.getStartLoop(),
+                               zones[zoneIdx].synth.getEndLoop())) {
+            logger.DEBUG("Instrument %s: Loop of zones[%d] not prepared in sample %s.",
+                         name.c_str(), zoneIdx, sample->getName().c_str());
+          }
+        #endif
         //zones[zoneIdx].synth.completeParams(60);
       }
       else {
@@ -346,7 +264,8 @@ void Instrument::showZone(uint16_t zoneIdx)
     "gen count ["    << +zones[zoneIdx].genCount        << "] " <<
     "mod count ["    << +zones[zoneIdx].modCount        << "] " << endl;
 
-  soundFont->samples[zones[zoneIdx].sampleIndex]->showStatus(2);
+  Sample * sample = soundFont->getSample(zones[zoneIdx].sampleIndex);
+  if (sample != NULL) sample->showStatus(2);
   zones[zoneIdx].synth.showStatus(2);
 
   if (zones[zoneIdx].genCount > 0) {
@@ -400,7 +319,8 @@ void Instrument::showZones()
 void Instrument::playNote(uint8_t note,
                           uint8_t velocity,
                           Preset & preset,
-                          uint16_t presetZoneIdx)
+                          uint16_t presetZoneIdx,
+                          Channel & channel)
 {
   uint16_t zoneIdx = keys[note];
 
@@ -414,14 +334,16 @@ void Instrument::playNote(uint8_t note,
         (note <= zones[zoneIdx].keys.byHi) &&
         (zones[zoneIdx].velocities.byLo <= velocity) &&
         (velocity <= zones[zoneIdx].velocities.byHi)) {
-      assert(zones[zoneIdx].sampleIndex < (int16_t) soundFont->samples.size());
-      assert(soundFont->samples[zones[zoneIdx].sampleIndex] != NULL);
+      // A sample out of the samples chunk has not been retained
+      Sample * sample = soundFont->getSample(zones[zoneIdx].sampleIndex);
+      if (sample == NULL) continue;
       //someNote = true;
       poly->addVoice(
-        soundFont->samples[zones[zoneIdx].sampleIndex],
-        note, velocity / 127.0f,
+        sample,
+        note, velocity,
         zones[zoneIdx].synth,
-        preset, presetZoneIdx);
+        zones[zoneIdx].compiledMods,
+        preset, presetZoneIdx, channel);
       if (unblock) {
         unblock = false;
         poly->UnblockVoiceThreads();
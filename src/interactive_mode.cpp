@@ -65,9 +65,10 @@ char InteractiveMode::showMenuGetSelection(bool showMenu)
          << "S : Sound device selection   V : Show Voices state while playing" << endl
          << "M : Midi device selection    p : Show Preset Zones"               << endl
          << "f : toggle low-pass filter   i : Show Instruments Zones"          << endl
-         << "e : toggle envelope"                                              << endl
-         << "v : toggle vibrato"                                               << endl
+         << "e : toggle envelope          C : Chorus adjusments"               << endl
+         << "v : toggle vibrato           c : Show MIDI Channels state"        << endl
          << "m : toggle metronome         b : Beats per second"                << endl
+         << "s : Show timing statistics"                                       << endl
          // << "l - dump sample Library"        << endl
          // << "c - show Config read from file" << endl
          << "x : eXit                     ? : Show this menu"                  << endl << endl;
@@ -98,8 +99,11 @@ void InteractiveMode::menu()
   case 'x': keepRunning = false;             return;
   case 'A': poly->monitorCount();            break;
   case 'B': midi->monitorMessages();         break;
+  case 'c': midi->showChannels();            break;
+  case 's': metrics.showStatus();            break;
   case 'E': equalizer->interactiveAdjust();  break;
   case 'R': reverb->interactiveAdjust();     break;
+  case 'C': chorus->interactiveAdjust();     break;
   case 'S': {
     int devNbr = sound->selectDevice(-1);
     sound->openPort(devNbr); }
@@ -119,18 +123,18 @@ void InteractiveMode::menu()
   // case 'c': config->showState();          break;
   
   case '+': 
-    soundFont->loadNextPreset();
-    cout << soundFont->getCurrentPreset()->getName() << " Selected." << endl;
+    library->loadNextPreset();
+    cout << library->getCurrentPreset()->getName() << " Selected." << endl;
     break;  
         
   case '-': 
-    soundFont->loadPreviousPreset(); 
-    cout << soundFont->getCurrentPreset()->getName() << " Selected." << endl;
+    library->loadPreviousPreset(); 
+    cout << library->getCurrentPreset()->getName() << " Selected." << endl;
     break;
   
   case 'P': 
     {
-      std::vector<uint16_t> theList = soundFont->showMidiPresetList();
+      std::vector<Preset *> theList = library->showMidiPresetList();
       while (true) {
         cout << endl << "Please enter preset index > " << flush;
         do {
@@ -138,8 +142,8 @@ void InteractiveMode::menu()
         } while (nbr < 0);
 
         if ((nbr >= 1) && (((uint16_t) nbr) <= theList.size())) {
-          soundFont->loadPreset(theList[nbr - 1]);
-          cout << "=====> " << soundFont->getCurrentPreset()->getName() << " Selected. <=====" << endl;
+          library->loadPreset(theList[nbr - 1]);
+          cout << "=====> " << library->getCurrentPreset()->getName() << " Selected. <=====" << endl;
           break;
         }
         else {
@@ -150,12 +154,12 @@ void InteractiveMode::menu()
     break;      
     
   case 'p':
-    p = soundFont->getCurrentPreset();
+    p = library->getCurrentPreset();
     if (p != NULL) p->showZones();
     break;
     
   case 'i':
-    p = soundFont->getCurrentPreset();
+    p = library->getCurrentPreset();
     if (p != NULL) {
       vector<presetInstrument *> & pi = p->getInstrumentsList();
       for (unsigned i = 0; i < pi.size(); i++) {
@@ -168,7 +172,7 @@ void InteractiveMode::menu()
       } while (nbr < 0);
 
       if ((nbr >= 0) && (((uint16_t) nbr) < pi.size())) {
-        Instrument * inst = soundFont->getInstrument(pi[((uint16_t) nbr)]->index);
+        Instrument * inst = p->getSoundFont()->getInstrument(pi[((uint16_t) nbr)]->index);
         assert(inst != NULL);
         inst->showZones();
       }
@@ -38,6 +38,8 @@
 
 #include "lcd_keypad.h"
 
+LcdKeypad * LcdKeypad::instance = NULL;
+
 int  vol   =    70;
 int  bpm   =    70;
 int  bpms  =     4;
@@ -84,6 +86,17 @@ void   setMetBPMin(int v) {        metronome->setBeatsPerMinute(v);  }
 int    getMetBPMea()      { return metronome->getBeatsPerMeasure();  }
 void   setMetBPMea(int v) {        metronome->setBeatsPerMeasure(v); }
 
+// Chorus parameters are shown as percentages
+
+int  getChoLevel()      { return (int) roundf(chorus->getLevel()    * 100.0f); }
+void setChoLevel(int v) {        chorus->setLevel(v / 100.0f);                 }
+int  getChoRate()       { return (int) roundf(chorus->getRate()     * 100.0f); }
+void setChoRate(int v)  {        chorus->setRate(v / 100.0f);                  }
+int  getChoDepth()      { return (int) roundf(chorus->getDepth()    * 100.0f); }
+void setChoDepth(int v) {        chorus->setDepth(v / 100.0f);                 }
+int  getChoFeedb()      { return (int) roundf(chorus->getFeedback() * 100.0f); }
+void setChoFeedb(int v) {        chorus->setFeedback(v / 100.0f);              }
+
 #define M menus
 #define K LcdKeypad
 #define c config
@@ -91,15 +104,22 @@ void   setMetBPMea(int v) {        metronome->setBeatsPerMeasure(v); }
 
 LcdKeypad::menuEntry M[] = {
   //  label           setFunc        getFunc        next    prev    sub     param type       low,  high,  choices
-  {  "Mezzo V1.0",    NULL,          NULL,          &M[ 1], &M[ 1], &M[ 6], NULL, K::NONE,   0,    0,     NULL   }, // 0
-  {  "Metronome",     NULL,          NULL,          &M[ 0], &M[ 0], &M[ 2], NULL, K::NONE,   0,    0,     NULL   }, // 1
+  {  "Mezzo V1.0",    NULL,          NULL,          &M[ 1], &M[ 7], &M[ 6], NULL, K::NONE,   0,    0,     NULL   }, // 0
+  {  "Metronome",     NULL,          NULL,          &M[ 7], &M[ 0], &M[ 2], NULL, K::NONE,   0,    0,     NULL   }, // 1
 
   {  "Enable",        setMetEnabled, getMetEnabled, &M[ 3], &M[ 5], NULL,   NULL, K::BOOL,   0,    0,     yesNo  }, // 2
   {  "Running",       setMetActive,  getMetActive,  &M[ 4], &M[ 2], NULL,   NULL, K::BOOL,   0,    0,     yesNo  }, // 3
   {  "Beats/Minute",  setMetBPMin,   getMetBPMin,   &M[ 5], &M[ 3], NULL,   NULL, K::INT,   10,  250,     NULL   }, // 4
   {  "Beats/Measure", setMetBPMea,   getMetBPMea,   &M[ 2], &M[ 4], NULL,   NULL, K::INT,    0,    0,     beats  }, // 5
 
-  {  "Volume",        NULL,          NULL,          &M[ 6], &M[ 6], NULL,   &vol, K::INT,    0,  100,     NULL   }  // 6
+  {  "Volume",        NULL,          NULL,          &M[ 6], &M[ 6], NULL,   &vol, K::INT,    0,  100,     NULL   }, // 6
+
+  {  "Chorus",        NULL,          NULL,          &M[ 0], &M[ 1], &M[ 8], NULL, K::NONE,   0,    0,     NULL   }, // 7
+
+  {  "Level",         setChoLevel,   getChoLevel,   &M[ 9], &M[11], NULL,   NULL, K::INT,    0,  100,     NULL   }, // 8
+  {  "Rate",          setChoRate,    getChoRate,    &M[10], &M[ 8], NULL,   NULL, K::INT,    0,  100,     NULL   }, // 9
+  {  "Depth",         setChoDepth,   getChoDepth,   &M[11], &M[ 9], NULL,   NULL, K::INT,    0,  100,     NULL   }, // 10
+  {  "Feedback",      setChoFeedb,   getChoFeedb,   &M[ 8], &M[10], NULL,   NULL, K::INT,    0,  100,     NULL   }  // 11
 };
 
 #undef M
@@ -112,7 +132,17 @@ LcdKeypad::LcdKeypad(std::string & devName)
   deviceName  = devName;
   keypadFd    = -1;
   state       = WAIT_RESET;
+  refresh     = false;
   initMenu();
+
+  instance = this;
+  if (sampleLoader != NULL) sampleLoader->setProgressFunc(loadProgress);
+}
+
+LcdKeypad::~LcdKeypad()
+{
+  if (sampleLoader != NULL) sampleLoader->setProgressFunc(NULL);
+  instance = NULL;
 }
 
 void LcdKeypad::initMenu()
@@ -353,7 +383,9 @@ void LcdKeypad::initMonitor()
 
 void LcdKeypad::showMonitor()
 {
-  std::string data = "0,0C:" + soundFont->getCurrentPreset()->getName().substr(0, 16) + "\n";
+  if (refresh.exchange(false)) initMonitor();
+
+  std::string data = "0,0C:" + library->getCurrentPreset()->getName().substr(0, 16) + "\n";
   if (mainString != data) {
     mainString = data;
     show(data);
@@ -390,6 +422,27 @@ void LcdKeypad::showMonitor()
   }
 }
 
+//---- showProgress() ----
+//
+// Called from the thread loading a preset, which may be the MIDI thread.
+// Only the LCD is written here; the monitor strings are redrawn by the
+// keypad thread at its next update.
+
+void LcdKeypad::loadProgress(int done, int total)
+{
+  if (instance != NULL) instance->showProgress(done, total);
+}
+
+void LcdKeypad::showProgress(int done, int total)
+{
+  if ((keypadFd == -1) || (state != MONITOR)) return;
+
+  std::string data = "1,0C:Loading " + std::to_string((done * 100) / total) + "%\n";
+  show(data);
+
+  if (done == total) refresh = true;
+}
+
 char LcdKeypad::getNextKey()
 {
   do {
@@ -474,10 +527,10 @@ void LcdKeypad::process()
         }
         break;
       case DOWN:
-        soundFont->loadNextPreset();
+        library->loadNextPreset();
         break;  
       case UP:
-        soundFont->loadPreviousPreset(); 
+        library->loadPreviousPreset(); 
         break;
       case NOTHING:
         break;
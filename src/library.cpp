@@ -0,0 +1,284 @@
+// Notice
+// ------
+//
+// This file is part of the Mezzo SoundFont2 Sampling Based Synthesizer:
+//
+//     https://github.com/turgu1/mezzo
+//
+// Simplified BSD License
+// ----------------------
+//
+// Copyright (c) 2018, Guy Turcotte
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// The views and conclusions contained in the software and documentation are those
+// of the authors and should not be interpreted as representing official policies,
+// either expressed or implied, of the FreeBSD Project.
+//
+#include <iomanip>
+
+#include "mezzo.h"
+
+Library::Library(std::vector<std::string> & sf2Filenames,
+                 std::vector<int>         & bankOffsets)
+{
+  setNewHandler(outOfMemory);
+
+  currentPreset   = NULL;
+  firstMidiPreset = NULL;
+
+  for (unsigned i = 0; i < sf2Filenames.size(); i++) {
+    int offset = i < bankOffsets.size() ? bankOffsets[i] : 0;
+
+    SoundFont2 * sf2 = new SoundFont2(sf2Filenames[i], offset);
+    if (!sf2->isLoaded()) {
+      logger.ERROR("Sound font %s ignored.", sf2Filenames[i].c_str());
+      delete sf2;
+      continue;
+    }
+
+    soundFonts.push_back(sf2);
+
+    int hidden = 0;
+    for (unsigned j = 0; j < sf2->presets.size(); j++) {
+      if (!addPresetToMidiList(sf2->presets[j])) hidden++;
+    }
+
+    logger.INFO("Sound font %s: %d presets, bank offset %d.",
+                sf2Filenames[i].c_str(), (int) sf2->presets.size(), offset);
+    if (hidden > 0) {
+      logger.WARNING("%d presets of %s hidden by previous files.",
+                     hidden, sf2Filenames[i].c_str());
+    }
+  }
+}
+
+Library::~Library()
+{
+  std::vector<SoundFont2 *>::iterator sf2;
+  for (sf2 = soundFonts.begin(); sf2 != soundFonts.end(); sf2++) {
+    delete * sf2;
+  }
+}
+
+void Library::outOfMemory()
+{
+  logger.FATAL("Library: Unable to allocate memory.");
+}
+
+Preset * Library::findMidiPreset(uint16_t bankNbr, uint16_t midiNbr)
+{
+  Preset * p = firstMidiPreset;
+  while (p && ((p->getBankNbr() != bankNbr) ||
+               (p->getMidiNbr() != midiNbr))) {
+    p = p->getNextMidiPreset();
+  }
+  return p;
+}
+
+bool Library::loadPreset(std::string & presetName)
+{
+  for (Preset * p = firstMidiPreset; p != NULL; p = p->getNextMidiPreset()) {
+    if (presetName == p->getName()) return loadPreset(p);
+  }
+  return false;
+}
+
+bool Library::loadMidiPreset(uint16_t bankNbr, uint16_t midiNbr)
+{
+  Preset * p = findMidiPreset(bankNbr, midiNbr);
+  if (p != NULL) return loadPreset(p);
+  return false;
+}
+
+bool Library::loadFirstPreset()
+{
+  return loadPreset(firstMidiPreset);
+}
+
+bool Library::loadNextPreset()
+{
+  if (currentPreset == NULL) return false;
+  return loadPreset(currentPreset->getNextMidiPreset());
+}
+
+bool Library::loadPreviousPreset()
+{
+  Preset * p = firstMidiPreset;
+  Preset * po = NULL;
+
+  if (p == NULL) return false;
+
+  while ((p != NULL) && (p != currentPreset)) {
+    po = p;
+    p = p->getNextMidiPreset();
+  }
+  if (po == NULL) return false;
+  return loadPreset(po);
+}
+
+//---- loadPreset() ----
+//
+// The percussion channel keeps its drum kit, unless nothing was found
+// for it at startup.
+
+bool Library::loadPreset(Preset * preset)
+{
+  if (preset == NULL) return false;
+
+  bool result = true;
+
+  for (int i = 0; i < MIDI_CHANNEL_COUNT; i++) {
+    if (channels[i].isPercussion() && (channels[i].getPreset() != NULL)) continue;
+    result = channels[i].setPreset(preset) && result;
+  }
+
+  currentPreset = preset;
+  return result;
+}
+
+//---- usePreset() ----
+
+bool Library::usePreset(Preset * preset)
+{
+  if (preset == NULL) return false;
+
+  if (!preset->is_loaded() &&
+      !preset->getSoundFont()->loadPresetData(preset)) return false;
+
+  preset->incUseCount();
+  return true;
+}
+
+//---- releasePreset() ----
+
+void Library::releasePreset(Preset * preset)
+{
+  if ((preset == NULL) || (preset->getUseCount() == 0)) return;
+
+  if (preset->decUseCount() == 0) preset->unload();
+}
+
+//---- addPresetToMidiList() ----
+
+bool Library::addPresetToMidiList(Preset * preset)
+{
+  preset->setNextMidiPreset(NULL);
+  if (firstMidiPreset == NULL) {
+    firstMidiPreset = preset;
+  }
+  else {
+    Preset * p  = firstMidiPreset;
+    Preset * po = NULL;
+    while (p) {
+      if (p->getBankNbr() > preset->getBankNbr()) {
+        break;
+      }
+      else if (p->getBankNbr() == preset->getBankNbr()) {
+        if (p->getMidiNbr() == preset->getMidiNbr()) return false;
+        if (p->getMidiNbr() >  preset->getMidiNbr()) break;
+      }
+      po = p;
+      p  = p->getNextMidiPreset();
+    }
+    preset->setNextMidiPreset(p);
+    if (po == NULL) {
+      firstMidiPreset = preset;
+    }
+    else {
+      po->setNextMidiPreset(preset);
+    }
+  }
+  return true;
+}
+
+//---- showMidiPresetList() ----
+
+std::vector<Preset *> Library::showMidiPresetList()
+{
+  using namespace std;
+  vector<Preset *> theList;
+
+  for (Preset * p = firstMidiPreset; p != NULL; p = p->getNextMidiPreset()) {
+    theList.push_back(p);
+  }
+
+  int i = 0;
+  int qty = theList.size();
+  int qty2;
+  int colCount;
+  int entriesPerColumn;
+
+  if (qty == 0) return theList;
+
+  if (qty <= 12) colCount = 1;
+  else if (qty <= 24) colCount = 2;
+  else colCount = 3;
+
+  entriesPerColumn = (qty + colCount - 1) / colCount;
+  qty2 = entriesPerColumn * colCount;
+
+  for (i = 0; i < colCount; i++) cout << "Idx    Bk Mid  Name                 ";
+  cout << endl;
+  for (i = 0; i < colCount; i++) cout << "---   --- ---  -------------------- ";
+  cout << endl;
+
+  i = 0;
+  int nxt = 0;
+
+  do {
+    if (nxt < qty) {
+      Preset * p = theList[nxt];
+      cout << setw(3) << right << (nxt + 1) << ": "
+           << "[" << setw(3) << right << p->getBankNbr()
+                  << setw(4) << right << p->getMidiNbr() << "] "
+           << setw(20) << left << p->getName() << " ";
+      if ((++i % colCount) == 0) {
+        cout << endl;
+      }
+    }
+    else {
+      cout << endl;
+    }
+
+    if (colCount > 1) {
+      if ((nxt + entriesPerColumn) < qty2) {
+        nxt += entriesPerColumn;
+      }
+      else {
+        nxt = (nxt + entriesPerColumn + 1) - qty2;
+        if (nxt >= entriesPerColumn) break;
+      }
+    }
+    else {
+      nxt += 1;
+    }
+
+    if (nxt >= qty2) break;
+
+  } while (true);
+
+  if ((i % colCount) != 0) cout << endl;
+
+  return theList;
+}
@@ -80,10 +80,18 @@ int main(int argc, char **argv)
     feenableexcept(FE_DIVBYZERO|FE_INVALID);
   #endif
 
+  // Inherited by the threads started by the libraries
+
+  Scheduling::flushDenormals();
+
   keepRunning = true;
 
   if (!config.loadConfig(argc, argv)) return 1;
 
+  // All memory allocated from now on is locked, if so configured
+
+  Scheduling::lockMemory();
+
   mezzo = new Mezzo();
 
   assert(mezzo != NULL);
@@ -92,37 +100,27 @@ int main(int argc, char **argv)
   pthread_t vFeeder2;
   // pthread_t prtMonitor;
 
-  pthread_attr_t attr;
-  //struct sched_param schedParam;
-
-  //schedParam.sched_priority = 2;
-  //if (sched_setscheduler(0, SCHED_FIFO, &schedParam)) perror("sched_setscheduler() error");
-
-  if (pthread_attr_init(&attr)) {
-    logger.FATAL("Unable to initialize pthread attributes.");
-  }
-  if (pthread_attr_setschedpolicy(&attr, SCHED_RR)) {
-    logger.FATAL("Unable to set pthread scheduling policy.");
-  }
-
   #if !loadInMemory
     pthread_t smplFeeder;
-    if (pthread_create(&smplFeeder, &attr, samplesFeeder, NULL)) {
+    if (Scheduling::createThread(&smplFeeder, ROLE_IO, "samples", samplesFeeder, NULL)) {
       logger.FATAL("Unable to start samplesFeeder thread.");
     }
   #endif
 
-  if (pthread_create(&vFeeder1, &attr, voicesFeeder1, NULL)) {
+  if (Scheduling::createThread(&vFeeder1, ROLE_RENDER, "voices1", voicesFeeder1, NULL)) {
     logger.FATAL("Unable to start voicesFeeder1 thread.");
   }
 
-  if (pthread_setschedprio(vFeeder1, 2)) perror("pthread_setschedprio() error");
-
-  if (pthread_create(&vFeeder2, &attr, voicesFeeder2, NULL)) {
+  if (Scheduling::createThread(&vFeeder2, ROLE_RENDER, "voices2", voicesFeeder2, NULL)) {
     logger.FATAL("Unable to start voicesFeeder2 thread.");
   }
 
-  if (pthread_setschedprio(vFeeder2, 2)) perror("pthread_setschedprio() error");
+  // Done last, as the threads started by the libraries get the affinity of
+  // their creator
+
+  Scheduling::applyToThread(ROLE_UI, "ui");
+  Scheduling::report();
+  RtArena::report();
 
   if (config.interactive) {
     InteractiveMode im;
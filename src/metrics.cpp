@@ -0,0 +1,213 @@
+// Notice
+// ------
+//
+// This file is part of the Mezzo SoundFont2 Sampling Based Synthesizer:
+//
+//     https://github.com/turgu1/mezzo
+//
+// Simplified BSD License
+// ----------------------
+//
+// Copyright (c) 2018, Guy Turcotte
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// The views and conclusions contained in the software and documentation are those
+// of the authors and should not be interpreted as representing official policies,
+// either expressed or implied, of the FreeBSD Project.
+//
+
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+
+#include "mezzo.h"
+
+const char * Metrics::stageNames[METRIC_STAGE_COUNT] = {
+  "midi", "voice", "voice_bank", "mix", "chorus", "reverb", "equalizer", "output", "callback"
+};
+
+//---- Histogram::clear() ----
+//
+// Not synchronized with the writers: values recorded at the same time may
+// be partially kept.
+
+void Histogram::clear()
+{
+  for (int i = 0; i < METRICS_BUCKET_COUNT; i++) counts[i].store(0, std::memory_order_relaxed);
+
+  count.store(0, std::memory_order_relaxed);
+  sum.store(0, std::memory_order_relaxed);
+  maximum.store(0, std::memory_order_relaxed);
+}
+
+//---- Histogram::bucketLimit() ----
+
+int64_t Histogram::bucketLimit(int idx)
+{
+  if (idx < METRICS_SUB_BUCKETS) return idx;
+
+  int     shift    = (idx >> METRICS_SUB_BITS) - 1;
+  int64_t mantissa = (idx & (METRICS_SUB_BUCKETS - 1)) + METRICS_SUB_BUCKETS;
+
+  return ((mantissa + 1) << shift) - 1;
+}
+
+//---- Histogram::percentile() ----
+//
+// The counters are read once, from a copy, as they may be updated at the
+// same time.
+
+int64_t Histogram::percentile(double fraction)
+{
+  uint32_t snapshot[METRICS_BUCKET_COUNT];
+  uint64_t total = 0;
+
+  for (int i = 0; i < METRICS_BUCKET_COUNT; i++) {
+    snapshot[i] = getBucket(i);
+    total      += snapshot[i];
+  }
+
+  if (total == 0) return 0;
+
+  uint64_t target = ceil(fraction * total);
+  if (target == 0) target = 1;
+
+  uint64_t seen = 0;
+
+  for (int i = 0; i < METRICS_BUCKET_COUNT; i++) {
+    seen += snapshot[i];
+    if (seen >= target) {
+      int64_t limit = bucketLimit(i);
+      int64_t max   = getMax();
+      return (limit < max) ? limit : max;
+    }
+  }
+
+  return getMax();
+}
+
+//---- registerWorker() ----
+//
+// Only called when a thread starts. The entry is filled before the count
+// that makes it visible to the readers is updated.
+
+void Metrics::registerWorker(const char * name)
+{
+  PRIVATE pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+
+  pthread_mutex_lock(&mutex);
+
+  int idx = workerCount.load(std::memory_order_relaxed);
+
+  if (idx < METRICS_MAX_WORKERS) {
+    workers[idx]     = pthread_self();
+    workerNames[idx] = name;
+    workerCount.store(idx + 1, std::memory_order_release);
+  }
+
+  pthread_mutex_unlock(&mutex);
+}
+
+//---- getWorkerCpuTime() ----
+
+int64_t Metrics::getWorkerCpuTime(int idx)
+{
+  clockid_t       clock;
+  struct timespec ts;
+
+  if (pthread_getcpuclockid(workers[idx], &clock) ||
+      clock_gettime(clock, &ts)) return 0;
+
+  return (ts.tv_sec * 1000000000LL) + ts.tv_nsec;
+}
+
+//---- clear() ----
+
+void Metrics::clear()
+{
+  for (int s = 0; s < METRIC_STAGE_COUNT; s++) stages[s].clear();
+
+  deadlineMisses   = 0;
+  underflows       = 0;
+  lateVoiceBuffers = 0;
+  lateReverbTails  = 0;
+}
+
+//---- showStatus() ----
+
+void Metrics::showStatus()
+{
+  using namespace std;
+
+  cout << endl
+       << "Durations in usec:" << endl << endl
+       << setw(12) << "stage"
+       << setw(12) << "count"
+       << setw(10) << "mean"
+       << setw(10) << "p50"
+       << setw(10) << "p99"
+       << setw(10) << "p99.9"
+       << setw(10) << "max" << endl;
+
+  for (int s = 0; s < METRIC_STAGE_COUNT; s++) {
+    Histogram & h = stages[s];
+
+    cout << setw(12) << stageNames[s]
+         << setw(12) << h.getCount()
+         << fixed << setprecision(1)
+         << setw(10) << h.getMean()            / 1000.0
+         << setw(10) << h.percentile(0.50)     / 1000.0
+         << setw(10) << h.percentile(0.99)     / 1000.0
+         << setw(10) << h.percentile(0.999)    / 1000.0
+         << setw(10) << h.getMax()             / 1000.0 << endl;
+  }
+
+  cout << endl
+       << "Deadline misses: " << getDeadlineMisses()
+       << ", output underflows: " << getUnderflows()
+       << ", late voice buffers: " << getLateVoiceBuffers()
+       << ", late reverb tails: " << getLateReverbTails() << endl;
+}
+
+//---- logSummary() ----
+
+void Metrics::logSummary()
+{
+  for (int s = 0; s < METRIC_STAGE_COUNT; s++) {
+    Histogram & h = stages[s];
+
+    if (h.getCount() == 0) continue;
+
+    logger.INFO("Duration of %s: p50 %ld, p99 %ld, p99.9 %ld, max %ld nsec (%lu times).",
+                stageNames[s],
+                (long) h.percentile(0.50),
+                (long) h.percentile(0.99),
+                (long) h.percentile(0.999),
+                (long) h.getMax(),
+                (unsigned long) h.getCount());
+  }
+
+  logger.INFO("Audio deadline misses: %u, output underflows: %u, late voice buffers: %u, "
+              "late reverb tails: %u.",
+              getDeadlineMisses(), getUnderflows(), getLateVoiceBuffers(), getLateReverbTails());
+}
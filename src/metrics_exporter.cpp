@@ -0,0 +1,271 @@
+// Notice
+// ------
+//
+// This file is part of the Mezzo SoundFont2 Sampling Based Synthesizer:
+//
+//     https://github.com/turgu1/mezzo
+//
+// Simplified BSD License
+// ----------------------
+//
+// Copyright (c) 2018, Guy Turcotte
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// The views and conclusions contained in the software and documentation are those
+// of the authors and should not be interpreted as representing official policies,
+// either expressed or implied, of the FreeBSD Project.
+//
+
+#include <cstring>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "mezzo.h"
+
+#define EXPORTER_POLL_TIMEOUT   500   ///< msec, to check for the end of the run
+#define EXPORTER_READ_TIMEOUT   200   ///< msec, for the request to come in
+
+PRIVATE const double quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+
+MetricsExporter::MetricsExporter(int port, const std::string & socketPath)
+{
+  setNewHandler(outOfMemory);
+
+  tcpSocket  = -1;
+  unixSocket = -1;
+  running    = false;
+  stopping   = false;
+
+  if (port > 0) {
+    struct sockaddr_in addr;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_port        = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    int on = 1;
+
+    if (((tcpSocket = socket(AF_INET, SOCK_STREAM, 0)) < 0) ||
+        setsockopt(tcpSocket, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) ||
+        bind(tcpSocket, (struct sockaddr *) &addr, sizeof(addr)) ||
+        listen(tcpSocket, 4)) {
+      logger.ERROR("Metrics: Unable to listen on port %d: %s.", port, strerror(errno));
+      if (tcpSocket >= 0) close(tcpSocket);
+      tcpSocket = -1;
+    }
+  }
+
+  if (socketPath.size() > 0) {
+    struct sockaddr_un addr;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+
+    unlink(addr.sun_path);
+
+    if (((unixSocket = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) ||
+        bind(unixSocket, (struct sockaddr *) &addr, sizeof(addr)) ||
+        listen(unixSocket, 4)) {
+      logger.ERROR("Metrics: Unable to listen on %s: %s.", socketPath.c_str(), strerror(errno));
+      if (unixSocket >= 0) close(unixSocket);
+      unixSocket = -1;
+    }
+    else {
+      unixPath = addr.sun_path;
+    }
+  }
+
+  if ((tcpSocket < 0) && (unixSocket < 0)) return;
+
+  if (Scheduling::createThread(&thread, ROLE_IO, "metrics", server, this)) {
+    logger.ERROR("Metrics: Unable to start the exporter thread.");
+  }
+  else {
+    running = true;
+  }
+}
+
+MetricsExporter::~MetricsExporter()
+{
+  stopping = true;
+
+  if (running) pthread_join(thread, NULL);
+
+  if (tcpSocket  >= 0) close(tcpSocket);
+  if (unixSocket >= 0) {
+    close(unixSocket);
+    unlink(unixPath.c_str());
+  }
+}
+
+void MetricsExporter::outOfMemory()
+{
+  logger.FATAL("MetricsExporter: Unable to allocate memory.");
+}
+
+void * MetricsExporter::server(void * args)
+{
+  ((MetricsExporter *) args)->serve();
+  return NULL;
+}
+
+//---- serve() ----
+
+void MetricsExporter::serve()
+{
+  struct pollfd fds[2];
+  int count = 0;
+
+  if (tcpSocket  >= 0) { fds[count].fd = tcpSocket;  fds[count].events = POLLIN; count++; }
+  if (unixSocket >= 0) { fds[count].fd = unixSocket; fds[count].events = POLLIN; count++; }
+
+  while (keepRunning && !stopping) {
+    if (poll(fds, count, EXPORTER_POLL_TIMEOUT) <= 0) continue;
+
+    for (int i = 0; i < count; i++) {
+      if (fds[i].revents & POLLIN) {
+        int fd = accept(fds[i].fd, NULL, NULL);
+        if (fd >= 0) {
+          answer(fd);
+          close(fd);
+        }
+      }
+    }
+  }
+}
+
+//---- answer() ----
+//
+// The request is read but not interpreted: all paths are giving the
+// metrics.
+
+void MetricsExporter::answer(int fd)
+{
+  char request[1024];
+  struct pollfd pfd = { fd, POLLIN, 0 };
+
+  if ((poll(&pfd, 1, EXPORTER_READ_TIMEOUT) > 0) &&
+      (read(fd, request, sizeof(request)) < 0)) return;
+
+  std::ostringstream body;
+  collect(body);
+
+  std::string content = body.str();
+  std::ostringstream header;
+
+  header << "HTTP/1.0 200 OK\r\n"
+         << "Content-Type: text/plain; version=0.0.4\r\n"
+         << "Content-Length: " << content.size() << "\r\n"
+         << "Connection: close\r\n\r\n";
+
+  std::string response = header.str() + content;
+
+  const char * data = response.c_str();
+  size_t       left = response.size();
+
+  while (left > 0) {
+    ssize_t sent = send(fd, data, left, MSG_NOSIGNAL);
+    if (sent <= 0) break;
+    data += sent;
+    left -= sent;
+  }
+}
+
+//---- collect() ----
+
+void MetricsExporter::collect(std::ostringstream & out)
+{
+  out << "# HELP mezzo_voices Voices currently playing.\n"
+      << "# TYPE mezzo_voices gauge\n"
+      << "mezzo_voices " << ((poly != NULL) ? poly->getVoiceCount() : 0) << "\n"
+
+      << "# HELP mezzo_voices_mixed_max Maximum number of voices mixed at once.\n"
+      << "# TYPE mezzo_voices_mixed_max gauge\n"
+      << "mezzo_voices_mixed_max " << maxVoicesMixed << "\n";
+
+  if (channels != NULL) {
+    out << "# HELP mezzo_channel_voices Voices currently playing on a MIDI channel.\n"
+        << "# TYPE mezzo_channel_voices gauge\n";
+    for (int i = 0; i < MIDI_CHANNEL_COUNT; i++) {
+      out << "mezzo_channel_voices{channel=\"" << (i + 1) << "\"} " << channels[i].getVoiceCount() << "\n";
+    }
+  }
+
+  out << "# HELP mezzo_worker_cpu_seconds_total CPU time used by a rendering thread.\n"
+      << "# TYPE mezzo_worker_cpu_seconds_total counter\n";
+  for (int i = 0; i < metrics.getWorkerCount(); i++) {
+    out << "mezzo_worker_cpu_seconds_total{worker=\"" << metrics.getWorkerName(i) << "\"} "
+        << (metrics.getWorkerCpuTime(i) / 1e9) << "\n";
+  }
+
+  out << "# HELP mezzo_stage_duration_seconds Duration of a processing stage.\n"
+      << "# TYPE mezzo_stage_duration_seconds summary\n";
+  for (int s = 0; s < METRIC_STAGE_COUNT; s++) {
+    Histogram  & h    = metrics.getStage((metricStage) s);
+    const char * name = Metrics::getStageName((metricStage) s);
+
+    for (unsigned q = 0; q < sizeof(quantiles) / sizeof(quantiles[0]); q++) {
+      out << "mezzo_stage_duration_seconds{stage=\"" << name << "\",quantile=\"" << quantiles[q] << "\"} "
+          << (h.percentile(quantiles[q]) / 1e9) << "\n";
+    }
+    out << "mezzo_stage_duration_seconds_sum{stage=\""   << name << "\"} " << (h.getSum() / 1e9) << "\n"
+        << "mezzo_stage_duration_seconds_count{stage=\"" << name << "\"} " << h.getCount()       << "\n";
+  }
+
+  out << "# HELP mezzo_stage_duration_max_seconds Longest duration of a processing stage.\n"
+      << "# TYPE mezzo_stage_duration_max_seconds gauge\n";
+  for (int s = 0; s < METRIC_STAGE_COUNT; s++) {
+    out << "mezzo_stage_duration_max_seconds{stage=\"" << Metrics::getStageName((metricStage) s) << "\"} "
+        << (metrics.getStage((metricStage) s).getMax() / 1e9) << "\n";
+  }
+
+  out << "# HELP mezzo_deadline_misses_total Audio callbacks longer than the buffer they produce.\n"
+      << "# TYPE mezzo_deadline_misses_total counter\n"
+      << "mezzo_deadline_misses_total " << metrics.getDeadlineMisses() << "\n"
+
+      << "# HELP mezzo_output_underflows_total Output underflows reported by the audio device.\n"
+      << "# TYPE mezzo_output_underflows_total counter\n"
+      << "mezzo_output_underflows_total " << metrics.getUnderflows() << "\n"
+
+      << "# HELP mezzo_late_voice_buffers_total Voice buffers not rendered in time for the mix.\n"
+      << "# TYPE mezzo_late_voice_buffers_total counter\n"
+      << "mezzo_late_voice_buffers_total " << metrics.getLateVoiceBuffers() << "\n"
+
+      << "# HELP mezzo_late_reverb_tails_total Convolution reverb tails left out, not computed in time.\n"
+      << "# TYPE mezzo_late_reverb_tails_total counter\n"
+      << "mezzo_late_reverb_tails_total " << metrics.getLateReverbTails() << "\n"
+
+      << "# HELP mezzo_midi_events_total MIDI events received.\n"
+      << "# TYPE mezzo_midi_events_total counter\n"
+      << "mezzo_midi_events_total " << metrics.getStage(METRIC_MIDI).getCount() << "\n"
+
+      << "# HELP mezzo_sample_memory_bytes Memory used by the data of the loaded samples.\n"
+      << "# TYPE mezzo_sample_memory_bytes gauge\n"
+      << "mezzo_sample_memory_bytes " << Sample::getMemoryUsed() << "\n";
+}
@@ -47,12 +47,25 @@ Mezzo::Mezzo()
 {
   setNewHandler(outOfMemory);
 
-  if (soundFont) delete soundFont;
-  soundFont = new SoundFont2(config.soundFontFilename);
+  if (!Simd::select(config.simdBackend.c_str())) {
+    logger.WARNING("SIMD backend %s not available on this processor.", config.simdBackend.c_str());
+  }
+  logger.INFO("Using the %s SIMD kernels.", simd->name);
 
-  soundFont->loadMidiPreset(0, 0);
+  if (sampleLoader) delete sampleLoader;
+  sampleLoader = new SampleLoader(config.sampleLoaderThreads);
 
-  show("reverb");    reverb    = new Reverb();
+  if (library) delete library;
+  library = new Library(config.soundFontFilenames, config.sf2BankOffsets);
+  if (!library->isLoaded()) logger.FATAL("No sound font library could be loaded.");
+
+  if (channels) delete [] channels;
+  channels  = new Channel[MIDI_CHANNEL_COUNT];
+
+  Midi::setupChannels();
+
+  show("reverb");    reverb    = Reverb::create(config.reverbEngine);
+  show("chorus");    chorus    = new Chorus();
   show("poly");      poly      = new Poly();
   show("equalizer"); equalizer = new Equalizer();
   show("sound");     sound     = new Sound();
@@ -61,6 +74,10 @@ Mezzo::Mezzo()
   
   show("conti");     sound->conti();
 
+  if ((config.metricsPort > 0) || (config.metricsSocket.size() > 0)) {
+    metricsExporter = new MetricsExporter(config.metricsPort, config.metricsSocket);
+  }
+
   binFile.open("data.bin", std::ios::out | std::ios::binary);
   
   logger.INFO("Ready!");
@@ -69,25 +86,25 @@ Mezzo::Mezzo()
 Mezzo::~Mezzo()
 {
   binFile.close();
-  
-  if (soundFont) delete soundFont;
 
+  if (metricsExporter) delete metricsExporter;
+  
   delete midi;
   delete sound;
   delete poly;
   delete reverb;
+  delete chorus;
   delete equalizer;
 
+  if (channels)  delete [] channels;
+  if (library)   delete library;
+  if (sampleLoader) delete sampleLoader;
+
   logger.INFO("Max number of voices mixed at once: %d.", maxVoicesMixed);
 
   // logger.INFO("Max volume: %8.2f.", maxVolume);
 
-  logger.INFO("Max duration of mixer function: %ld nsec (%.0f Hz).",
-              mixerDuration, 1000000000.0 / mixerDuration);
-  logger.INFO("Min duration of reverb function: %ld nsec (%.0f Hz).",
-              reverbMinDuration, 1000000000.0 / reverbMinDuration);
-  logger.INFO("Max duration of reverb function: %ld nsec (%.0f Hz).",
-              reverbMaxDuration, 1000000000.0 / reverbMaxDuration);
+  metrics.logSummary();
 }
 
 void Mezzo::outOfMemory()
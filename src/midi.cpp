@@ -129,12 +129,25 @@ void midiCallBack (double timeStamp,
   (void) timeStamp;
   (void) userData;
 
-  static uint8_t bankNbr = 0;
+  // The MIDI thread belongs to RtMidi, that starts a new one when the port
+  // is opened again
+
+  PRIVATE pthread_t midiThread;
+  PRIVATE bool      midiThreadKnown = false;
+
+  if (!midiThreadKnown || !pthread_equal(midiThread, pthread_self())) {
+    midiThread      = pthread_self();
+    midiThreadKnown = true;
+    Scheduling::applyToThread(ROLE_MIDI, "midi");
+    Scheduling::report(ROLE_MIDI);
+  }
 
   int count = message->size();
 
   if (count <= 0) return;
 
+  Duration duration;
+
   int channel = message->at(0) & MIDI_CHANNEL_MASK;
 
   uint8_t command = message->at(0) & ((uint8_t) MIDI_COMMAND_MASK);
@@ -151,44 +164,22 @@ void midiCallBack (double timeStamp,
 
     switch (command) {
     case MIDI_NOTE_ON:
-      midi->setNoteOn(data1 + config.midiTranspose, data2);
+      midi->setNoteOn(channels[channel], data1 + config.midiTranspose, data2);
       break;
     case MIDI_NOTE_OFF:
-      midi->setNoteOff(data1 + config.midiTranspose, data2);
+      midi->setNoteOff(channels[channel], data1 + config.midiTranspose, data2);
       break;
     case MIDI_CONTROL:
-      switch (data1) {
-      case 0x20:
-        bankNbr = data2;
-        break;
-      case 0x40:
-        if (midi->sustainIsOn() && (data2 < config.midiSustainTreshold)) {
-          midi->setSustainOff();
-        }
-        else if (!midi->sustainIsOn() && (data2 >= config.midiSustainTreshold)) {
-          midi->setSustainOn();
-        }
-        break;
-      case 0x47:
-        reverb->setRoomSize(0.7f + 0.29f * (data2 / 127.0f));
-        break;
-      case 0x4A:
-        config.masterVolume = data2 / 127.0f;
-        config.volume = 100 * data2 / 127;
-        break;
-      default:
-          //logger.WARNING("Midi: Ignored Control: %02xh %d.\n",
-          //               data1, data2);
-        break;
-      }
+      midi->setControl(channels[channel], data1, data2);
       break;
     case MIDI_PROGRAM:
-      if (!sound->holding()) {
-        sound->wait();
-        poly->inactivateAllVoices();
-        soundFont->loadMidiPreset(bankNbr, data1);
-        sound->conti();
-      }
+      midi->setProgram(channels[channel], data1);
+      break;
+    case MIDI_PITCHBEND:
+      channels[channel].setPitchBend(((data2 << 7) | data1) - 8192);
+      break;
+    case MIDI_CHANNEL_AT:
+      channels[channel].setPressure(data1);
       break;
     default:
         // logger.WARNING("Midi: Ignored Event: %02xh %d %d.\n",
@@ -197,6 +188,8 @@ void midiCallBack (double timeStamp,
     }
   }
 
+  metrics.record(METRIC_MIDI, duration.getElapse());
+
   using namespace std;
 
   if (midi->monitoring) {
@@ -303,7 +296,6 @@ Midi::Midi()
   using namespace std;
 
   monitoring = false;
-  sustainOn  = false;
   midiPort   = NULL;
 
   try {
@@ -362,9 +354,34 @@ Midi::Midi()
   channelMask = config.midiChannel;
 }
 
+//---- setupChannels() ----
+
+void Midi::setupChannels()
+{
+  for (int i = 0; i < MIDI_CHANNEL_COUNT; i++) {
+    channels[i].setNbr(i, (i + 1) == config.midiDrumChannel);
+    if (channels[i].isPercussion()) channels[i].programChange(0);
+  }
+
+  if (!library->loadMidiPreset(0, 0)) library->loadFirstPreset();
+}
+
+//---- showChannels() ----
+
+void Midi::showChannels()
+{
+  using namespace std;
+
+  cout << endl << "[Channels State]" << endl;
+  for (int i = 0; i < MIDI_CHANNEL_COUNT; i++) {
+    if (channelMask & (1 << i)) channels[i].showStatus(2);
+  }
+  cout << "[End]" << endl << endl;
+}
+
 //---- setNoteOn() ----
 
-void Midi::setNoteOn(char note, char velocity)
+void Midi::setNoteOn(Channel & channel, char note, char velocity)
 {
   //logger.DEBUG("Note ON %d (%d)\n", note, velocity);
 
@@ -402,43 +419,56 @@ void Midi::setNoteOn(char note, char velocity)
   }
   else {
     if (velocity == 0) {
-      poly->noteOff(note, sustainOn);
+      channel.noteOff(note);
     }
     else {
-      soundFont->playNote(note, velocity);
+      channel.noteOn(note, velocity);
     }
   }
 }
 
 //---- setNoteOff() ----
 
-void Midi::setNoteOff(char note, char velocity)
+void Midi::setNoteOff(Channel & channel, char note, char velocity)
 {
   //logger.DEBUG("Note OFF %d (%d)\n", note, velocity);
 
   (void) velocity;
 
-  poly->noteOff(note, sustainOn);
+  channel.noteOff(note);
 }
 
-//---- setSustainOn() ----
+//---- setControl() ----
+//
+// Reverb room size and master volume are global to all channels. All
+// other controllers are kept by the channel.
 
-void Midi::setSustainOn()
+void Midi::setControl(Channel & channel, uint8_t ctrl, uint8_t value)
 {
-  //logger.DEBUG("Sustain ON\n");
-
-  sustainOn = true;
+  switch (ctrl) {
+  case 0x47:
+    reverb->setRoomSize(0.7f + 0.29f * (value / 127.0f));
+    break;
+  case 0x4A:
+    config.masterVolume = value / 127.0f;
+    config.volume = 100 * value / 127;
+    break;
+  default:
+    channel.setController(ctrl, value);
+    break;
+  }
 }
 
-//---- setSustainOff() ----
+//---- setProgram() ----
+//
+// Only the voices of the channel are stopped. The other channels continue
+// to play while the new preset is being loaded.
 
-void Midi::setSustainOff()
+void Midi::setProgram(Channel & channel, uint8_t midiNbr)
 {
-  //logger.DEBUG("Sustain OFF\n");
-
-  if (sustainOn) {
-    sustainOn = false;
-    poly->voicesSustainOff();
+  if (!sound->holding()) {
+    poly->allSoundOff(channel);
+    channel.programChange(midiNbr);
   }
 }
 
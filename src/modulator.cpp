@@ -0,0 +1,337 @@
+// Notice
+// ------
+//
+// This file is part of the Mezzo SoundFont2 Sampling Based Synthesizer:
+//
+//     https://github.com/turgu1/mezzo
+//
+// Simplified BSD License
+// ----------------------
+//
+// Copyright (c) 2018, Guy Turcotte
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// The views and conclusions contained in the software and documentation are those
+// of the authors and should not be interpreted as representing official policies,
+// either expressed or implied, of the FreeBSD Project.
+//
+
+#include <cmath>
+
+#include "mezzo.h"
+
+// The default modulators of the SF2 2.04 specification (section 8.4).
+// As most synthesizers are doing, the pan modulator amount is 500, the
+// full pan range, instead of 1000.
+//
+// Fields: source (index, CC, direction, polarity, type), destination,
+// amount, amount source, transform.
+
+const sfModList Modulators::defaults[DEFAULT_MODULATOR_COUNT] = {
+  { {   2, false, 1, 0, MOD_CURVE_CONCAVE }, sfGenOper_initialAttenuation,   960,
+    {   0, false, 0, 0, MOD_CURVE_LINEAR  }, linear },                             // Velocity
+  { {   2, false, 1, 0, MOD_CURVE_LINEAR  }, sfGenOper_initialFilterFc,    -2400,
+    {   0, false, 0, 0, MOD_CURVE_LINEAR  }, linear },                             // Velocity
+  { {  13, false, 0, 0, MOD_CURVE_LINEAR  }, sfGenOper_vibLfoToPitch,         50,
+    {   0, false, 0, 0, MOD_CURVE_LINEAR  }, linear },                             // Channel pressure
+  { {   1, true,  0, 0, MOD_CURVE_LINEAR  }, sfGenOper_vibLfoToPitch,         50,
+    {   0, false, 0, 0, MOD_CURVE_LINEAR  }, linear },                             // CC 1 Modulation
+  { {   7, true,  1, 0, MOD_CURVE_CONCAVE }, sfGenOper_initialAttenuation,   960,
+    {   0, false, 0, 0, MOD_CURVE_LINEAR  }, linear },                             // CC 7 Volume
+  { {  10, true,  0, 1, MOD_CURVE_LINEAR  }, sfGenOper_pan,                  500,
+    {   0, false, 0, 0, MOD_CURVE_LINEAR  }, linear },                             // CC 10 Pan
+  { {  11, true,  1, 0, MOD_CURVE_CONCAVE }, sfGenOper_initialAttenuation,   960,
+    {   0, false, 0, 0, MOD_CURVE_LINEAR  }, linear },                             // CC 11 Expression
+  { {  91, true,  0, 0, MOD_CURVE_LINEAR  }, sfGenOper_reverbEffectsSend,    200,
+    {   0, false, 0, 0, MOD_CURVE_LINEAR  }, linear },                             // CC 91 Reverb
+  { {  93, true,  0, 0, MOD_CURVE_LINEAR  }, sfGenOper_chorusEffectsSend,    200,
+    {   0, false, 0, 0, MOD_CURVE_LINEAR  }, linear },                             // CC 93 Chorus
+  { {  14, false, 0, 1, MOD_CURVE_LINEAR  }, (SFGenerator) MOD_DEST_PITCH, 12700,
+    {  16, false, 0, 0, MOD_CURVE_LINEAR  }, linear }                              // Pitch wheel
+};
+
+PRIVATE inline bool sameSource(const sfModulator & a, const sfModulator & b)
+{
+  return (a.index     == b.index    ) &&
+         (a.midiContinuousControllerFlag == b.midiContinuousControllerFlag) &&
+         (a.direction == b.direction) &&
+         (a.polarity  == b.polarity ) &&
+         (a.type      == b.type     );
+}
+
+//---- isRealtime() ----
+//
+// Velocity and key are the only sources that cannot change while the note
+// is sounding.
+
+PRIVATE inline bool isRealtime(const sfModulator & src)
+{
+  return src.midiContinuousControllerFlag ||
+         ((src.index != MOD_SRC_NONE    ) &&
+          (src.index != MOD_SRC_VELOCITY) &&
+          (src.index != MOD_SRC_KEY     ));
+}
+
+//---- isValidSource() ----
+
+PRIVATE bool isValidSource(const sfModulator & src)
+{
+  if (src.type > MOD_CURVE_SWITCH) return false;
+
+  if (src.midiContinuousControllerFlag) {
+    // Bank select, data entry, RPN/NRPN and mode messages are not sources
+    return (src.index != 0) && (src.index != 6) && (src.index != 32) && (src.index != 38) &&
+           ((src.index < 96) || (src.index > 101)) && (src.index < 120);
+  }
+
+  switch (src.index) {
+    case MOD_SRC_NONE:
+    case MOD_SRC_VELOCITY:
+    case MOD_SRC_KEY:
+    case MOD_SRC_POLY_PRESSURE:
+    case MOD_SRC_CHANNEL_PRESSURE:
+    case MOD_SRC_PITCH_WHEEL:
+    case MOD_SRC_PITCH_WHEEL_SENSITIVITY:
+      return true;
+    default:
+      return false;   // Including linked modulators
+  }
+}
+
+//---- isValidDestination() ----
+
+PRIVATE bool isValidDestination(uint16_t dest)
+{
+  if (dest == MOD_DEST_PITCH) return true;
+  if (dest >= sfGenOper_endOper) return false;
+
+  const generatorDescriptor & desc = generatorsDesc[dest];
+
+  return (desc.valueType > 0) && !desc.instrumentOnly && (dest != sfGenOper_instrumentID);
+}
+
+//---- compile() ----
+
+uint8_t Modulators::compile(modOperation * dst,
+                            sfModList    * globalMods, uint8_t globalCount,
+                            sfModList    * zoneMods,   uint8_t zoneCount,
+                            bool           withDefaults)
+{
+  uint8_t count = 0;
+
+  for (int part = 0; part < 3; part++) {
+
+    const sfModList * mods;
+    int               modCount;
+
+    switch (part) {
+      case 0:  mods = defaults;   modCount = withDefaults ? DEFAULT_MODULATOR_COUNT : 0; break;
+      case 1:  mods = globalMods; modCount = globalCount; break;
+      default: mods = zoneMods;   modCount = zoneCount;   break;
+    }
+
+    for (int i = 0; i < modCount; i++) {
+      const sfModList & mod = mods[i];
+
+      if (!isValidSource(mod.sfModSrcOper)    ||
+          !isValidSource(mod.sfModAmtSrcOper) ||
+          !isValidDestination(mod.sfModDestOper)) continue;
+
+      // An identical modulator is replaced
+
+      int idx;
+      for (idx = 0; idx < count; idx++) {
+        if (sameSource(dst[idx].source,       mod.sfModSrcOper   ) &&
+            sameSource(dst[idx].amountSource, mod.sfModAmtSrcOper) &&
+            (dst[idx].destination == mod.sfModDestOper)) break;
+      }
+
+      if (idx == count) {
+        if (count == MAX_ZONE_MODULATORS) {
+          logger.WARNING("Modulators: Too many modulators in a zone, some are ignored.");
+          continue;
+        }
+        count++;
+      }
+
+      dst[idx].source       = mod.sfModSrcOper;
+      dst[idx].amountSource = mod.sfModAmtSrcOper;
+      dst[idx].destination  = mod.sfModDestOper;
+      dst[idx].absolute     = mod.sfModTransOper == absoluteValue;
+      dst[idx].realtime     = isRealtime(mod.sfModSrcOper) || isRealtime(mod.sfModAmtSrcOper);
+      dst[idx].amount       = mod.modAmount;
+    }
+  }
+
+  // A modulator with no amount is a way to disable a default one
+
+  uint8_t kept = 0;
+
+  for (int idx = 0; idx < count; idx++) {
+    if (dst[idx].amount != 0) dst[kept++] = dst[idx];
+  }
+
+  return kept;
+}
+
+//---- rawValue() ----
+//
+// Controllers are 7 bits values, the pitch wheel is 14 bits (0 at center).
+
+uint16_t Modulators::rawValue(sfModulator src)
+{
+  if (src.midiContinuousControllerFlag) return channel->getController(src.index);
+
+  switch (src.index) {
+    case MOD_SRC_VELOCITY:                return velocity;
+    case MOD_SRC_KEY:                     return key;
+    case MOD_SRC_CHANNEL_PRESSURE:        return channel->getPressure();
+    case MOD_SRC_PITCH_WHEEL:             return channel->getPitchBend() + 8192;
+    case MOD_SRC_PITCH_WHEEL_SENSITIVITY: return channel->getPitchBendRange();
+    default:                              return 0;    // Poly pressure is not kept
+  }
+}
+
+//---- curve() ----
+//
+// The concave and convex curves are reaching the full output at 96 dB of
+// the corresponding amplitude: a concave curve applied to the attenuation
+// with an amount of 960 cB gives an amplitude following the square of the
+// source.
+
+PRIVATE inline float curve(float x, unsigned int type)
+{
+  switch (type) {
+    case MOD_CURVE_CONCAVE: return (x >= 1.0f) ? 1.0f : fminf(1.0f, -(40.0f / 96.0f) * log10f(1.0f - x));
+    case MOD_CURVE_CONVEX:  return (x <= 0.0f) ? 0.0f : fmaxf(0.0f, 1.0f + ((40.0f / 96.0f) * log10f(x)));
+    case MOD_CURVE_SWITCH:  return (x >= 0.5f) ? 1.0f : 0.0f;
+    default:                return x;
+  }
+}
+
+//---- sourceValue() ----
+//
+// The raw value is normalized in 0..1, such that full scale (127) is 1
+// for unipolar sources and the center value (64) is exactly 0.5 for
+// bipolar ones. It is then mapped through the direction, polarity and
+// curve. A bipolar curve is applied on both sides of the center.
+
+float Modulators::sourceValue(sfModulator src, uint16_t raw)
+{
+  float x;
+
+  if (!src.midiContinuousControllerFlag && (src.index == MOD_SRC_NONE)) return 1.0f;
+
+  if (!src.midiContinuousControllerFlag && (src.index == MOD_SRC_PITCH_WHEEL)) {
+    x = raw * (1.0f / 16384.0f);
+  }
+  else {
+    x = raw * (src.polarity ? (1.0f / 128.0f) : (1.0f / 127.0f));
+  }
+
+  if (src.direction) x = 1.0f - x;
+
+  if (!src.polarity) return curve(x, src.type);
+
+  if (src.type == MOD_CURVE_LINEAR) return (2.0f * x) - 1.0f;
+
+  return (x >= 0.5f) ?  curve((2.0f * x) - 1.0f, src.type) :
+                       -curve(1.0f - (2.0f * x), src.type);
+}
+
+//---- evaluate() ----
+
+float Modulators::evaluate(const modOperation & op, uint32_t raws)
+{
+  float value = sourceValue(op.source,       raws & 0xFFFF) *
+                sourceValue(op.amountSource, raws >> 16   ) * op.amount;
+
+  return op.absolute ? fabsf(value) : value;
+}
+
+//---- noteOn() ----
+
+void Modulators::noteOn(modulatorList & instrumentMods,
+                        modulatorList & presetMods,
+                        uint8_t         _key,
+                        uint8_t         _velocity,
+                        Channel       & _channel)
+{
+  lists[0] = instrumentMods;
+  lists[1] = presetMods;
+  key      = _key;
+  velocity = _velocity;
+  channel  = &_channel;
+  serial   = channel->getSerial();
+
+  for (int dest = 0; dest < generatorDescriptorCount; dest++) {
+    totals[dest] = deltas[dest] = 0.0f;
+  }
+
+  for (int l = 0; l < 2; l++) {
+    for (int i = 0; i < lists[l].count; i++) {
+      const modOperation & op = lists[l].ops[i];
+
+      raws[l][i]              = rawValue(op.source) | (((uint32_t) rawValue(op.amountSource)) << 16);
+      values[l][i]            = evaluate(op, raws[l][i]);
+      totals[op.destination] += values[l][i];
+    }
+  }
+}
+
+//---- update() ----
+//
+// Only the operations whose sources changed are evaluated again.
+
+bool Modulators::update()
+{
+  uint32_t current = channel->getSerial();
+
+  if (current == serial) return false;
+  serial = current;
+
+  bool changed = false;
+
+  for (int l = 0; l < 2; l++) {
+    for (int i = 0; i < lists[l].count; i++) {
+      const modOperation & op = lists[l].ops[i];
+
+      if (!op.realtime) continue;
+
+      uint32_t raw = rawValue(op.source) | (((uint32_t) rawValue(op.amountSource)) << 16);
+
+      if (raw == raws[l][i]) continue;
+      raws[l][i] = raw;
+
+      float value = evaluate(op, raw);
+
+      if (value != values[l][i]) {
+        deltas[op.destination] += value - values[l][i];
+        values[l][i] = value;
+        changed = true;
+      }
+    }
+  }
+
+  return changed;
+}
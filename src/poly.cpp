@@ -66,6 +66,8 @@ void stopThreads()
   {
     (void) args;
 
+    metrics.registerWorker("samples");
+
     while (keepRunning) {
 
       // If there is no active voice, put the thread on hold
@@ -92,12 +94,18 @@ void stopThreads()
 //---- voicesFeeder() ----
 //
 // This function represent a thread responsible of readying a voice buffer packet
-// on time for consumption by the poly::mixer method.
+// on time for consumption by the poly::mixer method. The voices with an active
+// filter are processed four at a time through the thread's voice bank, which is
+// flushed at the end of each pass on the voices list.
 
 void * voicesFeeder1(void * args)
 {
   (void) args;
 
+  VoiceBank bank;
+
+  metrics.registerWorker("voices1");
+
   while (keepRunning) {
 
     if (poly->getVoiceCount() == 0) {
@@ -111,13 +119,15 @@ void * voicesFeeder1(void * args)
 
     while ((voice != NULL) && keepRunning) {
 
-      voice->feedBuffer();
+      poly->feedVoice(voice, bank);
 
       sched_yield();
       do {
         voice = voice->getNext();
       } while ((voice != NULL) && (voice->getSeq() & 0x01));
     }
+
+    bank.process();
   }
 
   pthread_exit(NULL);
@@ -127,6 +137,10 @@ void * voicesFeeder2(void * args)
 {
   (void) args;
 
+  VoiceBank bank;
+
+  metrics.registerWorker("voices2");
+
   while (keepRunning) {
 
     if (poly->getVoiceCount() == 0) {
@@ -140,13 +154,15 @@ void * voicesFeeder2(void * args)
 
     while ((voice != NULL) && keepRunning) {
 
-      voice->feedBuffer();
+      poly->feedVoice(voice, bank);
 
       sched_yield();
       do {
         voice = voice->getNext();
       } while ((voice != NULL) && ((voice->getSeq() & 0x01) == 0));
     }
+
+    bank.process();
   }
 
   pthread_exit(NULL);
@@ -214,9 +230,14 @@ Poly::Poly()
   voicep prev  = NULL;
   voicep voice = NULL;
 
+  // The buffers are kept apart from the voices: they are only accessed
+  // by the feeder of a voice and by the mixer, when the voice is active
+
+  buffers = RtArena::allocateArray<sampleRecord>(MAX_VOICES);
+
   for (int i = 0; i < MAX_VOICES; i++) {
 
-    voice = new Voice();
+    voice = new Voice(buffers[i]);
 
     voice->setNext(prev);
 
@@ -226,6 +247,8 @@ Poly::Poly()
   voices = voice;
 
   voiceCount = maxVoiceCount = 0;
+
+  reverbBusUsed = chorusBusUsed = false;
 }
 
 //---- ~Poly() ----
@@ -246,6 +269,8 @@ Poly::~Poly()
     voice = next;
   }
 
+  RtArena::release(buffers);
+
   int maxCount = maxVoiceCount;
   logger.INFO("Max Nbr of Voices used: %d.\n", maxCount);
 }
@@ -257,6 +282,43 @@ void Poly::outOfMemory()
   logger.FATAL("Poly: Unable to allocate memory.");
 }
 
+//---- stopVoice() ----
+//
+// Inactivates the voice under its lock. As a feeder thread and the MIDI
+// thread may both try to stop the same voice, the count is only
+// decremented by the call that did it. Not to be used by the mixer, that
+// retires the voices instead.
+
+bool Poly::stopVoice(voicep voice)
+{
+  voice->BEGIN();
+    bool stopped = voice->inactivate();
+  voice->END();
+
+  if (stopped) voiceCount--;
+
+  return stopped;
+}
+
+//---- feedVoice() ----
+//
+// Called by the feeder thread of the voice. A voice retired by the mixer
+// is stopped here, under its lock, else its next buffer is prepared.
+
+void Poly::feedVoice(voicep voice, VoiceBank & bank)
+{
+  if (voice->isRetiring()) {
+    voice->BEGIN();
+      bool stopped = voice->isRetiring() && voice->inactivate();
+    voice->END();
+
+    if (stopped) voiceCount--;
+  }
+  else {
+    voice->feedBuffer(bank);
+  }
+}
+
 //---- inactivateAllVoices()
 
 void Poly::inactivateAllVoices()
@@ -320,7 +382,7 @@ voicep Poly::nextAvailable()
   voicep voice = voices;
 
   while (voice) {
-    if (voice->isInactive() && voice->isDormant()) {
+    if (voice->isInactive() && voice->isDormant() && !voice->isBankPending()) {
       break;
     }
 
@@ -329,17 +391,68 @@ voicep Poly::nextAvailable()
   return voice;
 }
 
+//---- stealVoice() ----
+//
+// Called when all voices are in use. To be fair between channels, the
+// voice is taken from the channel that is using the most voices. On that
+// channel, the oldest voice for which the key was released is selected,
+// else the oldest voice. A voice pending in a voice bank is not taken, as
+// the bank is still working on it.
+
+voicep Poly::stealVoice()
+{
+  Channel * victimChannel = NULL;
+  int       maxCount      = 0;
+
+  for (int i = 0; i < MIDI_CHANNEL_COUNT; i++) {
+    if (channels[i].getVoiceCount() > maxCount) {
+      maxCount      = channels[i].getVoiceCount();
+      victimChannel = &channels[i];
+    }
+  }
+
+  if (victimChannel == NULL) return NULL;
+
+  voicep oldest   = NULL;
+  voicep released = NULL;
+  voicep voice    = voices;
+
+  while (voice) {
+    if (voice->isActive() && !voice->isBankPending() &&
+        (voice->getChannel() == victimChannel)) {
+      if ((oldest == NULL) || (voice->getSeq() < oldest->getSeq())) {
+        oldest = voice;
+      }
+      if (!voice->isNoteOn() &&
+          ((released == NULL) || (voice->getSeq() < released->getSeq()))) {
+        released = voice;
+      }
+    }
+    voice = voice->getNext();
+  }
+
+  voice = (released != NULL) ? released : oldest;
+
+  if (voice != NULL) {
+    stopVoice(voice);
+  }
+
+  return voice;
+}
+
 //---- addVoice() ----
 //
 // A sample is added to voices. If there is no more voice structure available,
-// retrieve the oldest one from the current voices list.
-
-void Poly::addVoice(samplep       sample,
-                    uint8_t       note,
-                    float         gain,
-                    Synthesizer & synth,
-                    Preset      & preset,
-                    uint16_t presetZoneIdx)
+// one is stolen from the channel using the most voices.
+
+void Poly::addVoice(samplep         sample,
+                    uint8_t         note,
+                    uint8_t         velocity,
+                    Synthesizer   & synth,
+                    modulatorList & instrumentMods,
+                    Preset        & preset,
+                    uint16_t        presetZoneIdx,
+                    Channel       & channel)
 {
   voicep voice;
   // bool unblockThreads = (voiceCount == 0);
@@ -351,8 +464,8 @@ void Poly::addVoice(samplep       sample,
     return;
   }
 
-  if ((voice = nextAvailable()) == NULL) {
-    // TODO: Get rid of the oldest voice and take the place
+  if (((voice = nextAvailable()) == NULL) &&
+      ((voice = stealVoice())    == NULL)) {
     logger.ERROR("Overrun!");
     return;
   }
@@ -362,7 +475,7 @@ void Poly::addVoice(samplep       sample,
   int theCount = voiceCount;
   if (theCount > maxVoiceCount) maxVoiceCount = theCount;
 
-  voice->setup(sample, note, gain, synth, preset, presetZoneIdx);
+  voice->setup(sample, note, velocity, synth, instrumentMods, preset, presetZoneIdx, channel);
 
   // if (unblockThreads) {
   //   pthread_cond_broadcast(&voiceCond);
@@ -376,11 +489,15 @@ void Poly::UnblockVoiceThreads()
 
 //---- noteOff() ----
 
-void Poly::noteOff(char note, bool pedalOn)
+void Poly::noteOff(char note, Channel & channel)
 {
+  bool pedalOn = channel.isSustainOn();
+
   voicep voice = voices;
   while (voice) {
-    if (voice->isActive() && (voice->getNote() == note)) {
+    if (voice->isActive() &&
+        (voice->getNote() == note) &&
+        (voice->getChannel() == &channel)) {
       if (pedalOn) {
         voice->keyOff();   // Just to keep the key state
       }
@@ -389,10 +506,7 @@ void Poly::noteOff(char note, bool pedalOn)
           // Come here usually when the envelope is inactive and there is no
           // other way to know the time to stop playing this voice. This won't
           // be good for the player as he/she will ear clicks from the speakers
-          voice->BEGIN();
-            voice->inactivate();
-          voice->END();
-          voiceCount--;
+          stopVoice(voice);
         }
       }
     }
@@ -400,13 +514,48 @@ void Poly::noteOff(char note, bool pedalOn)
   }
 }
 
-void Poly::voicesSustainOff()
+void Poly::voicesSustainOff(Channel & channel)
 {
   voicep voice = voices;
   while (voice) {
     // When we receive the signal that the sustain pedal is off, we
     // don't want to stop notes that are still strucked by the player
-    if (voice->isActive() && !voice->isKeyOn()) voice->noteOff();
+    if (voice->isActive() &&
+        (voice->getChannel() == &channel) &&
+        !voice->isKeyOn()) voice->noteOff();
+    voice = voice->getNext();
+  }
+}
+
+//---- allNotesOff() ----
+//
+// Same as if every key was released on the channel. Notes held by the
+// sustain pedal continue to sound.
+
+void Poly::allNotesOff(Channel & channel)
+{
+  voicep voice = voices;
+  while (voice) {
+    if (voice->isActive() &&
+        (voice->getChannel() == &channel) &&
+        voice->isKeyOn()) {
+      noteOff(voice->getNote(), channel);
+    }
+    voice = voice->getNext();
+  }
+}
+
+//---- allSoundOff() ----
+//
+// All voices of the channel are stopped right away, without release.
+
+void Poly::allSoundOff(Channel & channel)
+{
+  voicep voice = voices;
+  while (voice) {
+    if (voice->isActive() && (voice->getChannel() == &channel)) {
+      stopVoice(voice);
+    }
     voice = voice->getNext();
   }
 }
@@ -415,7 +564,7 @@ void Poly::voicesSustainOff()
 
 # define MIX(a, b) (a + b)
 
-int Poly::mixer(frameRecord & buff)
+int Poly::mixer(frameRecord & buff, frameRecord * reverbBuff, frameRecord * chorusBuff)
 {
   int maxFrameCount = 0; // Max number of frames that have been mixed
   int mixedCount = 0;    // Running counter on how many voices have beed
@@ -423,8 +572,12 @@ int Poly::mixer(frameRecord & buff)
   static frame_t zero = { 0.0f, 0.0f };
 
   std::fill(std::begin(buff), std::end(buff), zero);
+  if (reverbBuff != NULL) std::fill(std::begin(*reverbBuff), std::end(*reverbBuff), zero);
+  if (chorusBuff != NULL) std::fill(std::begin(*chorusBuff), std::end(*chorusBuff), zero);
 
-  Duration *duration = new Duration(); // TODO: Keep a duration object forever
+  reverbBusUsed = chorusBusUsed = false;
+
+  Duration duration;
 
   voicep voice = firstVoice();
 
@@ -433,32 +586,32 @@ int Poly::mixer(frameRecord & buff)
     int16_t count;
     sampleRecord & voiceBuff = voice->getBuffer(&count);
 
-    if (count < 0) {
-      std::cout << '.' << std::flush;
+    if (voice->isRetiring()) {
+      // Waiting to be stopped by its feeder thread
+    }
+    else if (count < 0) {
+      metrics.lateVoiceBuffer();  // Not rendered yet by its feeder thread
     }
     else if (count > 0) {
 
-      bool endOfSound = voice->transformAndMix(buff, voiceBuff, count);
+      bool endOfSound = voice->transformAndMix(buff, reverbBuff, chorusBuff, voiceBuff, count);
+
+      reverbBusUsed |= (reverbBuff != NULL) && voice->sendsToReverb();
+      chorusBusUsed |= (chorusBuff != NULL) && voice->sendsToChorus();
 
       voice->releaseBuffer();
 
       // if endOfSound, we are at the end of the envelope sequence
       // and will now get rid of the voice.
       if (endOfSound) {
-        voice->BEGIN();
-          voice->inactivate();
-        voice->END();
-        voiceCount--;
+        voice->retire();
       }
 
       maxFrameCount = MAX(maxFrameCount, count);
     }
     else {
       // There is no more frames available so we desactivate the current voice.
-      voice->BEGIN();
-        voice->inactivate();
-      voice->END();
-      voiceCount--;
+      voice->retire();
     }
 
     mixedCount += 1;
@@ -468,10 +621,7 @@ int Poly::mixer(frameRecord & buff)
 
   maxVoicesMixed = MAX(maxVoicesMixed, mixedCount);
 
-  long dur = duration->getElapse();
-
-  mixerDuration = MAX(mixerDuration, dur);
-  delete duration;
+  metrics.record(METRIC_MIX, duration.getElapse());
 
   return maxFrameCount;
 }
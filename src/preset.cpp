@@ -41,19 +41,22 @@
 Preset::Preset(char * presetName,
                uint16_t midi,
                uint16_t bank,
-               uint16_t bagIndex,
-               uint16_t bagQty)
+               sf2ZoneSet & zoneSet,
+               SoundFont2 * sf2)
 {
   setNewHandler(outOfMemory);
 
   name           = presetName;
   midiNbr        = midi;
   bankNbr        = bank;
+  soundFont      = sf2;
 
-  bagIdx         = bagIndex;
-  bagCount       = bagQty;
+  zoneRecordIdx    = zoneSet.zoneIdx;
+  zoneRecordCount  = zoneSet.zoneCount;
+  globalZoneRecord = zoneSet.globalZone != 0;
 
   nextMidiPreset = NULL;
+  useCount       = 0;
 
   init();
 
@@ -64,8 +67,7 @@ void Preset::init()
 {
   for (int i = 0; i < 128; i++) keys[i] = KEY_NOT_USED;
 
-  gens                  = NULL;
-  mods                  = NULL;
+  modOps                = NULL;
   zones                 = NULL;
   zoneCount             =    0;
 
@@ -101,7 +103,10 @@ bool Preset::unload()
   assert(soundFont != NULL);
 
   for (int zoneIdx = 0; zoneIdx < zoneCount; zoneIdx++) {
-    if (zones[zoneIdx].instrumentIndex >= 0) {
+    // Instruments can be shared between presets playing on different channels
+
+    if ((zones[zoneIdx].instrumentIndex >= 0) &&
+        !soundFont->isInstrumentUsed(zones[zoneIdx].instrumentIndex, this)) {
       assert(zones[zoneIdx].instrumentIndex < (int) soundFont->instruments.size());
       assert(soundFont->instruments[zones[zoneIdx].instrumentIndex] != NULL);
       soundFont->instruments[zones[zoneIdx].instrumentIndex]->unload();
@@ -109,210 +114,124 @@ bool Preset::unload()
   }
 
   if (zones) delete [] zones;
-  if (gens)  delete [] gens;
-  if (mods)  delete [] mods;
+  if (modOps) delete [] modOps;
 
   init();
   return true;
 }
 
-bool Preset::load(sfBag     * bags,
+bool Preset::load(sf2Zone   * zoneRecords,
                   sfGenList * generators,
                   sfModList * modulators)
 {
-  int count;
-
   if (loaded) return true;
 
-  if (bagCount == 0) {
-    logger.DEBUG("Bag Count is 0 for preset %s", name.c_str());
+  if ((zoneRecordCount == 0) && !globalZoneRecord) {
+    logger.DEBUG("Zone Count is 0 for preset %s", name.c_str());
     return false;
   }
 
-  // We get one more as an end of list indicator (instrumentIndex will be -1)
-
-  zones     = new aZone[bagCount + 1];
-  zoneCount = bagCount;
-
-  for (int zoneIdx = 0; zoneIdx <= zoneCount; zoneIdx++) {
-    zones[zoneIdx].keys.byHi       =    0;
-    zones[zoneIdx].keys.byLo       =    0;
-    zones[zoneIdx].velocities.byLo =    0;
-    zones[zoneIdx].velocities.byHi =    0;
-    zones[zoneIdx].instrumentIndex =   -1;
-    zones[zoneIdx].generators      = NULL;
-    zones[zoneIdx].modulators      = NULL;
-    zones[zoneIdx].genCount        =    0;
-    zones[zoneIdx].modCount        =    0;
-  }
-
-  zones[zoneCount].instrumentIndex = -999;
+  sf2Zone * z = &zoneRecords[zoneRecordIdx];
 
-  int firstGenIdx = bags[bagIdx].wGenNdx;
-  int lastGenIdx  = bags[bagIdx + bagCount].wGenNdx;
-  int firstModIdx = bags[bagIdx].wModNdx;
-  int lastModIdx  = bags[bagIdx + bagCount].wModNdx;
+  // ---- globalZone ----
 
-  // If there is no generators in the bags but only modulators
-  // that means there is only a global zone.
+  globalZonePresent = globalZoneRecord;
 
-  globalZonePresent =
-    ((lastGenIdx - firstGenIdx) == 0) &&
-    ((lastModIdx - firstModIdx) > 0);
-
-  // If there is some generators, check if the first zone is
-  // a global one.
-
-  globalZonePresent = globalZonePresent ||
-    (((lastGenIdx - firstGenIdx) > 0) &&
-     (generators[bags[bagIdx + 1].wGenNdx - 1].sfGenOper != sfGenOper_instrumentID));
-
-  uint8_t globalGenCount;
   if (globalZonePresent) {
-    zoneCount--;
-    globalGenCount = bags[bagIdx + 1].wGenNdx - bags[bagIdx].wGenNdx;
-  }
-  else {
-    globalGenCount = 0;
-  }
-
-  // Count how many generators need to be allocated, considering
-  // that some generator values will be retrieved as normal
-  // instrument parameters.
-
-  int genCount = globalGenCount;
-
-  for (int i = firstGenIdx + globalGenCount; i < lastGenIdx; i++) {
-    if ((generators[i].sfGenOper != sfGenOper_keyRange) &&
-        (generators[i].sfGenOper != sfGenOper_velRange) &&
-        (generators[i].sfGenOper != sfGenOper_instrumentID)) genCount++;
-  }
-
-  int modCount = lastModIdx - firstModIdx;
-
-  if (genCount > 0) gens = new sfGenList[genCount];
-  if (modCount > 0) mods = new sfModList[modCount];
-
-  //if ((genCount > 0) || (modCount > 0))
-  {
-    uint16_t    zoneIdx = 0;   // Index into zones
-    sfGenList *       g = gens;
-    sfGenList *      gg = &generators[bags[bagIdx].wGenNdx];
-    sfModList *       m = mods;
-    sfModList *      mm = &modulators[bags[bagIdx].wModNdx];
-    sfBag     *       b = &bags[bagIdx];
-
-    int i = 0;  // How many zone entries we have processed in bags
-
-    // ---- globalZone ----
-
-    // global gens
-
-    if (globalGenCount > 0) {
-
-      // There is globals gens so get the gens...
-      globalZone.generators = g;
-      globalZone.genCount   = globalGenCount;
-
-      while (globalGenCount--) *g++ = *gg++;
-
-      assert(globalZonePresent);
+    if (z->genCount > 0) {
+      globalZone.generators = &generators[z->genIdx];
+      globalZone.genCount   = z->genCount;
     }
-
-    // global mods
-
-    if (globalZonePresent) {
-
-      count = b[1].wModNdx - b[0].wModNdx;
-      if (count > 0) {
-        globalZone.modulators = m;
-        globalZone.modCount   = count;
-
-        while (count--) *m++ = *mm++;
-      }
-      b++; i++;
+    if (z->modCount > 0) {
+      globalZone.modulators = &modulators[z->modIdx];
+      globalZone.modCount   = z->modCount;
     }
+    z++;
+  }
 
-    while (i < bagCount) {
-      // Loop for each zone
-
-      // ---- generators ----
-
-      // Get the number of generators in the zone
-      count = b[1].wGenNdx - b[0].wGenNdx;
-
-      if (count > 0) {
-        if (gg[count - 1].sfGenOper == sfGenOper_instrumentID) {
-          zones[zoneIdx].generators = g;
-          while (count--) {
-            switch (gg->sfGenOper) {
-              case sfGenOper_keyRange:
-                zones[zoneIdx].keys = gg->genAmount.ranges;
-                //if (keys[zones[zoneIdx].keys.byLo] == KEY_NOT_USED) {
-                  for (int k = zones[zoneIdx].keys.byLo; k <= zones[zoneIdx].keys.byHi; k++) {
-                    if (keys[k] == KEY_NOT_USED) {
-                      keys[k] = zoneIdx;
-                      keyShortCutPresent = true;
-                    }
-                  }
-                //}
-                break;
-              case sfGenOper_velRange:
-                zones[zoneIdx].velocities = gg->genAmount.ranges;
-                velocitiesPresent = true;
-                break;
-              case sfGenOper_instrumentID:
-                zones[zoneIdx].instrumentIndex = gg->genAmount.wAmount;
-                uint16_t k;
-                for (k = 0; k < instruments.size(); k++) {
-                  if (instruments[k]->index == zones[zoneIdx].instrumentIndex) break;
-                }
-                if (k >= instruments.size()) {
-                  presetInstrument * pi = new presetInstrument;
-                  assert(pi != NULL);
-                  pi->index = zones[zoneIdx].instrumentIndex;
-                  Instrument * inst = soundFont->getInstrument(pi->index);
-                  assert(inst != NULL);
-                  pi->name = inst->getName();
-                  instruments.push_back(pi);
-                }
-                break;
-              default:
-                *g++ = *gg;
-                zones[zoneIdx].genCount++;
-                break;
-            }
-            gg++;
-          }
-          if (zones[zoneIdx].genCount == 0) zones[zoneIdx].generators = NULL;
-        }
-        else {
-          // The generators list is not valid.
-          while (count--) gg++;
+  // We get one more as an end of list indicator
+
+  zones     = new aZone[zoneRecordCount + 1];
+  zoneCount = zoneRecordCount;
+
+  for (int zoneIdx = 0; zoneIdx < zoneCount; zoneIdx++, z++) {
+    aZone & zone = zones[zoneIdx];
+
+    zone.keys               = z->keys;
+    zone.velocities         = z->velocities;
+    zone.instrumentIndex    = z->index;
+    zone.generators         = (z->genCount > 0) ? &generators[z->genIdx] : NULL;
+    zone.modulators         = (z->modCount > 0) ? &modulators[z->modIdx] : NULL;
+    zone.genCount           = z->genCount;
+    zone.modCount           = z->modCount;
+    zone.compiledMods.ops   = NULL;
+    zone.compiledMods.count = 0;
+
+    if ((zone.keys.byLo != 0) || (zone.keys.byHi != 0)) {
+      for (int k = zone.keys.byLo; k <= zone.keys.byHi; k++) {
+        if (keys[k] == KEY_NOT_USED) {
+          keys[k] = zoneIdx;
+          keyShortCutPresent = true;
         }
       }
+    }
 
-      // ---- modulators ----
+    if ((zone.velocities.byLo != 0) || (zone.velocities.byHi != 0)) {
+      velocitiesPresent = true;
+    }
 
-      count = b[1].wModNdx - b[0].wModNdx;
+    uint16_t k;
+    for (k = 0; k < instruments.size(); k++) {
+      if (instruments[k]->index == zone.instrumentIndex) break;
+    }
+    if (k >= instruments.size()) {
+      presetInstrument * pi = new presetInstrument;
+      assert(pi != NULL);
+      pi->index = zone.instrumentIndex;
+      Instrument * inst = soundFont->getInstrument(pi->index);
+      assert(inst != NULL);
+      pi->name = inst->getName();
+      instruments.push_back(pi);
+    }
+  }
 
-      if (count > 0) {
-        zones[zoneIdx].modulators = m;
-        zones[zoneIdx].modCount   = count;
-        while (count--) *m++ = *mm++;
-      }
+  zones[zoneCount].keys.byLo          =    0;
+  zones[zoneCount].keys.byHi          =    0;
+  zones[zoneCount].velocities.byLo    =    0;
+  zones[zoneCount].velocities.byHi    =    0;
+  zones[zoneCount].instrumentIndex    = -999;
+  zones[zoneCount].generators         = NULL;
+  zones[zoneCount].modulators         = NULL;
+  zones[zoneCount].genCount           =    0;
+  zones[zoneCount].modCount           =    0;
+  zones[zoneCount].compiledMods.ops   = NULL;
+  zones[zoneCount].compiledMods.count =    0;
+
+  // Compiled modulators (modulator.h). Preset zones don't get the
+  // default modulators.
+
+  int opCount = 0;
+  for (uint16_t zoneIdx = 0; zoneIdx < zoneCount; zoneIdx++) {
+    opCount += Modulators::roomNeeded(globalZone.modCount, zones[zoneIdx].modCount, false);
+  }
 
-      if (zones[zoneIdx].instrumentIndex != -1) {
-        zoneIdx++;       // Goto next zone
-      }
-      else {
-        zoneCount--;
-      }
-      b++; i++;  // ... and next bag
-    }
+  if (opCount > 0) modOps = new modOperation[opCount];
+
+  modOperation * op = modOps;
+  for (uint16_t zoneIdx = 0; zoneIdx < zoneCount; zoneIdx++) {
+    if (Modulators::roomNeeded(globalZone.modCount, zones[zoneIdx].modCount, false) == 0) continue;
+    zones[zoneIdx].compiledMods.ops   = op;
+    zones[zoneIdx].compiledMods.count =
+      Modulators::compile(op,
+                          globalZone.modulators,     globalZone.modCount,
+                          zones[zoneIdx].modulators, zones[zoneIdx].modCount,
+                          false);
+    op += zones[zoneIdx].compiledMods.count;
   }
 
-  // Load instruments
+  // Load instruments, then prepare all their samples at once
+
+  sampleBatch batch;
 
   for (uint16_t zoneIdx = 0; zoneIdx < zoneCount; zoneIdx++) {
     assert(soundFont != NULL);
@@ -328,14 +247,39 @@ bool Preset::load(sfBag     * bags,
     };
 
     soundFont->loadInstrument(zones[zoneIdx].instrumentIndex,
-                              zones[zoneIdx].keys);
+                              zones[zoneIdx].keys,
+                              batch);
   }
 
+  Duration duration;
+  bool     samplesLoaded = true;
+
+  if (sampleLoader != NULL) {
+    samplesLoaded = sampleLoader->loadSamples(batch);
+  }
+  else {
+    for (unsigned i = 0; i < batch.size(); i++) {
+      samplesLoaded = batch[i]->load() && samplesLoaded;
+    }
+  }
+
+  logger.DEBUG("Preset %s: samples prepared in %ld usec.",
+               name.c_str(), duration.getElapse() / 1000);
+
   // showZones();
 
   // logger.DEBUG("Preset %s loaded.", name.c_str());
 
   loaded = true;
+
+  // The instruments already loaded are released with the preset
+
+  if (!samplesLoaded) {
+    logger.ERROR("Preset %s: unable to prepare its samples.", name.c_str());
+    unload();
+    return false;
+  }
+
   return true;
 }
 
@@ -426,7 +370,15 @@ void Preset::showZones()
   cerr << endl << "[End]" << endl;
 }
 
-void Preset::playNote(uint8_t note, uint8_t velocity)
+bool Preset::usesInstrument(int16_t instrumentIndex)
+{
+  for (int zoneIdx = 0; zoneIdx < zoneCount; zoneIdx++) {
+    if (zones[zoneIdx].instrumentIndex == instrumentIndex) return true;
+  }
+  return false;
+}
+
+void Preset::playNote(uint8_t note, uint8_t velocity, Channel & channel)
 {
   //std::cout << zoneCount << std::endl;
 
@@ -436,7 +388,7 @@ void Preset::playNote(uint8_t note, uint8_t velocity)
         (zones[zoneIdx].velocities.byLo <= velocity) &&
         (velocity <= zones[zoneIdx].velocities.byHi)) {
       soundFont->instruments[zones[zoneIdx].instrumentIndex]->playNote(
-        note, velocity, *this, zoneIdx);
+        note, velocity, *this, zoneIdx, channel);
     }
     else {
       //std::cout << "No note played: " << +note << "[" << +velocity << "]" << std::endl;
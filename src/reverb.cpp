@@ -39,6 +39,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 
 #include <unistd.h>
 #include <termios.h>
@@ -46,334 +47,143 @@
 
 #include "mezzo.h"
 
-const int Reverb::comb_m[REVERB_COMB_COUNT] = {
-  1557, 1617, 1491, 1422, 1277, 1356, 1188, 1116
-};
-
-const int Reverb::ap_m[REVERB_AP_COUNT] = {
-  225, 556, 441, 341
-};
-
 Reverb::Reverb()
 {
   setNewHandler(outOfMemory);
 
-  for (int i = 0; i < REVERB_COMB_COUNT; i++) {
-
-    int  frameCount = comb_m[i];
-
-    // left combs
-    leftCombs[i].buff = new sample_t[frameCount + PADDING];
-    std::fill(leftCombs[i].buff, leftCombs[i].buff + frameCount + PADDING,  0.0f);
-
-    leftCombs[i].end  = leftCombs[i].buff + frameCount;
-    leftCombs[i].head = leftCombs[i].tail = leftCombs[i].buff;
-    leftLast[i] = 0.0f;
-
-    // right combs
-    frameCount += 23;
-
-    rightCombs[i].buff = new sample_t[frameCount + PADDING];
-    std::fill(rightCombs[i].buff, rightCombs[i].buff + frameCount + PADDING,  0.0f);
-
-    rightCombs[i].end  = rightCombs[i].buff + frameCount;
-    rightCombs[i].head = rightCombs[i].tail = rightCombs[i].buff;
-    rightLast[i] = 0.0f;
-  }
-
-  for (int i = 0; i < REVERB_AP_COUNT; i++) {
-
-    int  frameCount = ap_m[i];
-
-    // left all pass filters
-    leftAp[i].buff = new sample_t[frameCount + PADDING];
-    std::fill(leftAp[i].buff, leftAp[i].buff + frameCount + PADDING,  0.0f);
-
-    leftAp[i].end  = leftAp[i].buff + frameCount;
-    leftAp[i].head = leftAp[i].tail = leftAp[i].buff;
-
-    // right all pass filters
-    rightAp[i].buff = new sample_t[frameCount + PADDING];
-    std::fill(rightAp[i].buff, rightAp[i].buff + frameCount + PADDING,  0.0f);
-
-    rightAp[i].end  = rightAp[i].buff + frameCount;
-    rightAp[i].head = rightAp[i].tail = rightAp[i].buff;
-  }
-
   roomSize = config.reverbRoomSize;
   damping  = config.reverbDamping;
   width    = config.reverbWidth;
   dryWet   = config.reverbDryWet;
   apGain   = config.reverbApGain;
-}
 
-//----- outOfMemory() ----
+  static frame_t zero = { 0.0f, 0.0f };
+  std::fill(std::begin(silence), std::end(silence), zero);
 
-void Reverb::outOfMemory()
-{
-  logger.FATAL("Reverb: Unable to allocate memory.");
+  idle        = true;
+  silentCount = 0;
 }
 
-#define LOAD_YN_M(combs_ptr)                   \
-  GETv(&combs_ptr[0], yn_m_ab.val[0]);         \
-  GETv(&combs_ptr[1], yn_m_ab.val[1]);         \
-  GETv(&combs_ptr[2], yn_m_cd.val[0]);         \
-  GETv(&combs_ptr[3], yn_m_cd.val[1]);
-
-#define TRANSPOSE_FORWARD_YN_M()                           \
-  yn_m_ab = vuzpq_f32(yn_m_ab.val[0], yn_m_ab.val[1]);     \
-  yn_m_cd = vuzpq_f32(yn_m_cd.val[0], yn_m_cd.val[1]);     \
-  yn_m_ac = vuzpq_f32(yn_m_ab.val[0], yn_m_cd.val[0]);     \
-  yn_m_bd = vuzpq_f32(yn_m_ab.val[1], yn_m_cd.val[1]);
-
-#define TRANSPOSE_BACKWARD_YN_M()                          \
-  yn_m_ab = vuzpq_f32(yn_m_ac.val[0], yn_m_bd.val[0]);     \
-  yn_m_cd = vuzpq_f32(yn_m_ac.val[1], yn_m_bd.val[1]);     \
-  yn_m_ac = vuzpq_f32(yn_m_ab.val[0], yn_m_cd.val[0]);     \
-  yn_m_bd = vuzpq_f32(yn_m_ab.val[1], yn_m_cd.val[1]);
-
-#define STORE_YN_M(combs_ptr)                   \
-  PUTv(&combs_ptr[0], yn_m_ac.val[0]);          \
-  PUTv(&combs_ptr[1], yn_m_bd.val[0]);          \
-  PUTv(&combs_ptr[2], yn_m_ac.val[1]);          \
-  PUTv(&combs_ptr[3], yn_m_bd.val[1]);
-
-#define FILTER(pos)                                                 \
-  input = vdupq_n_f32((buffIn[0] + buffIn[1]) * 0.015f);            \
-  yn_m_##pos = vmlaq_n_f32(input,                                   \
-                           vmlsq_n_f32(yn_m_##pos,                  \
-                                       vsubq_f32(yn_m_##pos, yn_1), \
-                                       damping),                    \
-                           roomSize);                               \
-  yn_1 = yn_m_##pos;                                                \
-  vst1q_f32(tmp, yn_1);                                             \
-  *o++ += tmp[0] + tmp[1] + tmp[2] + tmp[3];                        \
-  buffIn += 2;
-
-#define FILTERS()         \
-  FILTER(ac.val[0]);      \
-  FILTER(bd.val[0]);      \
-  FILTER(ac.val[1]);      \
-  FILTER(bd.val[1]);
+//---- ~Reverb() ----
 
 Reverb::~Reverb()
 {
-  for (int i = 0; i < REVERB_COMB_COUNT; i++) {
-    delete [] leftCombs[i].buff;
-    delete [] rightCombs[i].buff;
-  }
-  for (int i = 0; i < REVERB_AP_COUNT; i++) {
-    delete []  leftAp[i].buff;
-    delete [] rightAp[i].buff;
-  }
 }
 
-void Reverb::process(frameRecord & buff)
-{
-  float        dry = dryWet;
-  float        wet = 1.0f - dryWet;
-  float apGainPlus = 1.0f + apGain;
-
-  Duration * duration = new Duration;
-
-#if USE_NEON_INTRINSICS
-
-  static float outl[BUFFER_FRAME_COUNT];
-  static float outr[BUFFER_FRAME_COUNT];
-
-  buffp o_l;
-  buffp o_r;
-  buffp buffIn, b;
-  int fr;
-
-  std::fill(outl, outl + BUFFER_FRAME_COUNT,  0.0f);
-  std::fill(outr, outr + BUFFER_FRAME_COUNT,  0.0f);
-
-  for (fr = 0, o_l = outl, o_r = outr;
-       fr < BUFFER_FRAME_COUNT;
-       fr += 4, o_l += 4, o_r += 4) {
-
-    fifop lc = leftCombs;
-    fifop rc = rightCombs;
-
-    float32x4x2_t yn_m_ab;
-    float32x4x2_t yn_m_cd;
-    float32x4x2_t yn_m_ac; // partially transposed combs values
-    float32x4x2_t yn_m_bd; // ..
-
-    float32x4_t yn_1;
-    float32x4_t input;
-    float tmp[4];
-    buffp o;
-
-    // ==== LEFT ====
-
-    yn_1 = vld1q_f32(&leftLast[0]);
-
-    buffIn = b = &buff[fr].left;
-    o = o_l;
-
-    LOAD_YN_M(lc);
-    TRANSPOSE_FORWARD_YN_M();
-    FILTERS();
-    TRANSPOSE_BACKWARD_YN_M();
-    STORE_YN_M(lc);
-
-    vst1q_f32(&leftLast[0], yn_1);
-
-    lc += 4;
-    buffIn = b;
-    o = o_l;
-
-    yn_1 = vld1q_f32(&leftLast[4]);
-
-    LOAD_YN_M(lc);
-    TRANSPOSE_FORWARD_YN_M();
-    FILTERS();
-    TRANSPOSE_BACKWARD_YN_M();
-    STORE_YN_M(lc);
-
-    vst1q_f32(&leftLast[4], yn_1);
-
-    // ==== RIGHT ====
-
-    yn_1 = vld1q_f32(&rightLast[0]);
-
-    buffIn = b;
-    o = o_r;
-
-    LOAD_YN_M(rc);
-    TRANSPOSE_FORWARD_YN_M();
-    FILTERS();
-    TRANSPOSE_BACKWARD_YN_M();
-    STORE_YN_M(rc);
-
-    vst1q_f32(&rightLast[0], yn_1);
+//----- outOfMemory() ----
 
-    rc += 4;
-    buffIn = b;
-    o = o_r;
+void Reverb::outOfMemory()
+{
+  logger.FATAL("Reverb: Unable to allocate memory.");
+}
 
-    yn_1 = vld1q_f32(&rightLast[4]);
+//---- create() ----
 
-    LOAD_YN_M(rc);
-    TRANSPOSE_FORWARD_YN_M();
-    FILTERS();
-    TRANSPOSE_BACKWARD_YN_M();
-    STORE_YN_M(rc);
+Reverb * Reverb::create(const std::string & engineName)
+{
+  if (engineName == "fdn") return FdnReverb::create();
 
-    vst1q_f32(&rightLast[4], yn_1);
+  if (engineName == "convolution") {
+    Reverb * rev = ConvolutionReverb::create();
+    if (rev != NULL) return rev;
+    logger.ERROR("Convolution reverb not available. FreeVerb will be used.");
+  }
+  else if (engineName != "freeverb") {
+    logger.ERROR("Unknown reverb engine: %s. FreeVerb will be used.", engineName.c_str());
   }
 
-  //buffIn = b;
+  return FreeVerb::create();
+}
 
-  for (fr = 0, buffIn = &buff[0].left, o_l = outl, o_r = outr;
-       fr < (BUFFER_FRAME_COUNT >> 2);
-       fr++, buffIn += 8, o_l += 4, o_r += 4) {
+//---- process() ----
 
-    float32x4_t left, right;
-    left  = vld1q_f32(o_l);
-    right = vld1q_f32(o_r);
+void Reverb::process(frameRecord & buff, frameRecord * send)
+{
+  float dry = dryWet;
+  float wet = 1.0f - dryWet;
+
+  if (send == NULL) {
+    if (idle) {
+      for (int fr = 0; fr < BUFFER_FRAME_COUNT; fr++) {
+        buff[fr].left  *= dry;
+        buff[fr].right *= dry;
+      }
+      return;
+    }
+    send = &silence;
+  }
 
-    fifop lap, rap;
-    int i;
+  Duration duration;
 
-    for (i = 0, lap = leftAp, rap = rightAp;
-         i < REVERB_AP_COUNT;
-         i++, lap++, rap++) {
+  processBuffer(*send, ret);
 
-      float32x4_t vn_m, vn;
+  float maxLevel = simd->mixDryWet(&buff[0].left, &ret[0].left, 2 * BUFFER_FRAME_COUNT, dry, wet);
 
-      // left
-      GETv(lap, vn_m);
-      // vn = *o_l + (apGain * vn_m);
-      vn = vmlaq_n_f32(left, vn_m, apGain);
-      PUTv(lap, vn);
-      // *o_l = -vn + vn_m * apGainPlus;
-      left = vmlaq_n_f32(vnegq_f32(vn), vn_m, apGainPlus);
+  // The reverb becomes idle when nothing has been sent to it and its
+  // tail has been under the silence level for long enough for the
+  // content of the delay lines to come out. They are then emptied, such
+  // that the next sound starts on a clean state.
 
-      // right
-      GETv(rap, vn_m);
-      // vn = *o_r + (apGain * vn_m);
-      vn = vmlaq_n_f32(right, vn_m, apGain);
-      PUTv(rap, vn);
-      // *o_r = -vn + vn_m * apGainPlus;
-      right = vmlaq_n_f32(vnegq_f32(vn), vn_m, apGainPlus);
+  if ((send == &silence) && (maxLevel < REVERB_SILENCE)) {
+    if (++silentCount >= REVERB_IDLE_BUFFERS) {
+      idle = true;
+      clear();
     }
-
-    float32x4x2_t bb  = vld2q_f32(buffIn);
-
-    bb.val[0] = vmlaq_n_f32(vmulq_n_f32(bb.val[0], dry), left,  wet);
-    bb.val[1] = vmlaq_n_f32(vmulq_n_f32(bb.val[1], dry), right, wet);
-
-    vst2q_f32(buffIn, bb);
+  }
+  else {
+    silentCount = 0;
+    idle = false;
   }
 
-#else
-
-  for (int fr = 0; fr < BUFFER_FRAME_COUNT; fr++) {
-    int i;
-    fifop lc, rc;
-    fifop lap, rap;
-
-    float input = (buff[fr].left + buff[fr].right) * 0.015f;
-
-    float outl = 0.0f;
-    float outr = 0.0f;
+  metrics.record(METRIC_REVERB, duration.getElapse());
+}
 
-    float * llast;
-    float * rlast;
+//---- readLine() ----
 
-    for (i = 0, lc = leftCombs, rc = rightCombs, llast = leftLast, rlast = rightLast;
-         i < REVERB_COMB_COUNT;
-         i++, lc++, rc++, llast++, rlast++) {
+void Reverb::readLine(const delayLine & line, float * dst)
+{
+  int count = MIN(line.length - line.pos, BUFFER_FRAME_COUNT);
 
-      float yn_m, yn;
+  memcpy(dst, line.buff + line.pos, count * sizeof(float));
+  if (count < BUFFER_FRAME_COUNT) {
+    memcpy(dst + count, line.buff, (BUFFER_FRAME_COUNT - count) * sizeof(float));
+  }
+}
 
-      // left
-      GET(lc, yn_m);
-      yn = input + (roomSize * (yn_m - (damping * (yn_m - *llast))));
-      PUT(lc, yn);
-      *llast = yn;
-      outl += yn;
+//---- writeLine() ----
 
-      // right
-      GET(rc, yn_m);
-      yn = input + (roomSize * (yn_m - (damping * (yn_m - *rlast))));
-      PUT(rc, yn);
-      *rlast = yn;
-      outr += yn;
-    }
+void Reverb::writeLine(delayLine & line, const float * src)
+{
+  int count = MIN(line.length - line.pos, BUFFER_FRAME_COUNT);
 
-    for (i = 0, lap = leftAp, rap = rightAp;
-         i < REVERB_AP_COUNT;
-         i++, lap++, rap++) {
+  memcpy(line.buff + line.pos, src, count * sizeof(float));
+  if (count < BUFFER_FRAME_COUNT) {
+    memcpy(line.buff, src + count, (BUFFER_FRAME_COUNT - count) * sizeof(float));
+    line.pos = BUFFER_FRAME_COUNT - count;
+  }
+  else {
+    line.pos += BUFFER_FRAME_COUNT;
+    if (line.pos >= line.length) line.pos -= line.length;
+  }
+}
 
-      float vn_m, vn;
+//---- allpassLine() ----
+//
+// The buffer is cut where the line wraps around. A segment is never
+// longer than the line: the delayed values of its frames all come from
+// the preceding segments.
 
-      // left
-      GET(lap, vn_m);
-      vn = outl + (apGain * vn_m);
-      PUT(lap, vn);
-      outl = -vn + vn_m * apGainPlus;
+void Reverb::allpassLine(delayLine & line, float * x, float gain, float delayed, float direct)
+{
+  for (int fr = 0; fr < BUFFER_FRAME_COUNT; ) {
+    int count = MIN(line.length - line.pos, BUFFER_FRAME_COUNT - fr);
 
-      // right
-      GET(rap, vn_m);
-      vn = outr + (apGain * vn_m);
-      PUT(rap, vn);
-      outr = -vn + vn_m * apGainPlus;
-    }
+    simd->allpass(x + fr, line.buff + line.pos, count, gain, delayed, direct);
 
-    buff[fr].left = (buff[fr].left * dry) + (outl * wet);  // left
-    buff[fr].right = (buff[fr].right * dry) + (outr * wet);  // right
+    fr += count;
+    line.pos += count;
+    if (line.pos >= line.length) line.pos = 0;
   }
-#endif
-
-  long dur = duration->getElapse();
-  reverbMinDuration = reverbMinDuration == 0 ? dur : MIN(reverbMinDuration, dur);
-  reverbMaxDuration = MAX(reverbMaxDuration, dur);
-
-  delete duration;
 }
 
 //---- adjustValue() ----
@@ -426,7 +236,7 @@ void Reverb::interactiveAdjust()
   cout.setf(ios::showpoint);
 
   cout << endl << endl;
-  cout << "REVERB ADJUSTMENTS."               << endl;
+  cout << "REVERB ADJUSTMENTS (" << getName() << ")." << endl;
   cout << "Values must be between 0 and 1.0"  << endl;
   cout << "Please use the following keys:"    << endl << endl;
   cout << "For 0.05 increment steps: qwert"   << endl;
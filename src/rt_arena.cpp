@@ -0,0 +1,244 @@
+// Notice
+// ------
+//
+// This file is part of the Mezzo SoundFont2 Sampling Based Synthesizer:
+//
+//     https://github.com/turgu1/mezzo
+//
+// Simplified BSD License
+// ----------------------
+//
+// Copyright (c) 2018, Guy Turcotte
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// The views and conclusions contained in the software and documentation are those
+// of the authors and should not be interpreted as representing official policies,
+// either expressed or implied, of the FreeBSD Project.
+//
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "mezzo.h"
+
+#define CHUNK_HEADER_SIZE ((sizeof(chunk) + CACHE_LINE_SIZE - 1) & ~(size_t)(CACHE_LINE_SIZE - 1))
+
+RtArena::chunk * RtArena::chunks       = NULL;
+pthread_mutex_t  RtArena::mutex        = PTHREAD_MUTEX_INITIALIZER;
+size_t           RtArena::fallbackSize = 0;
+
+PRIVATE bool mapFailed = false;
+
+//---- mapChunk() ----
+//
+// Map a chunk of size bytes (a multiple of RT_ARENA_PAGE_SIZE) aligned on
+// a huge page. Transparent huge pages only apply to aligned ranges: the
+// anonymous mapping is made one huge page larger and trimmed.
+
+RtArena::chunk * RtArena::mapChunk(size_t size)
+{
+  void * base    = MAP_FAILED;
+  bool   hugeTlb = false;
+
+  #ifdef MAP_HUGETLB
+    base    = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    hugeTlb = (base != MAP_FAILED);
+  #endif
+
+  if (base == MAP_FAILED) {
+    uint8_t * region = (uint8_t *) mmap(NULL, size + RT_ARENA_PAGE_SIZE, PROT_READ | PROT_WRITE,
+                                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (region == MAP_FAILED) return NULL;
+
+    uint8_t * aligned = (uint8_t *) (((uintptr_t) region + RT_ARENA_PAGE_SIZE - 1) &
+                                     ~(uintptr_t) (RT_ARENA_PAGE_SIZE - 1));
+
+    if (aligned > region) munmap(region, aligned - region);
+    munmap(aligned + size, (region + RT_ARENA_PAGE_SIZE) - aligned);
+
+    #ifdef MADV_HUGEPAGE
+      madvise(aligned, size, MADV_HUGEPAGE);
+    #endif
+
+    base = aligned;
+  }
+
+  // Lock first, then touch every page: with the pages locked, the kernel
+  // will not reclaim them once present.
+
+  int lockError = (mlock(base, size) == 0) ? 0 : errno;
+
+  long pageSize = sysconf(_SC_PAGESIZE);
+  for (size_t offset = 0; offset < size; offset += pageSize) {
+    ((volatile uint8_t *) base)[offset] = 0;
+  }
+
+  chunk * c     = (chunk *) base;
+  c->next       = NULL;
+  c->size       = size;
+  c->used       = CHUNK_HEADER_SIZE;
+  c->hugeTlb    = hugeTlb;
+  c->lockError  = lockError;
+
+  return c;
+}
+
+//---- tryAllocate() ----
+//
+// Allocations are taken from the first chunk of the list. A request
+// larger than half a chunk gets a chunk of its own, put behind the first
+// one, so that the free space of the first chunk is kept for the next
+// requests.
+
+void * RtArena::tryAllocate(size_t size)
+{
+  void * ptr = NULL;
+
+  size = (size + CACHE_LINE_SIZE - 1) & ~(size_t)(CACHE_LINE_SIZE - 1);
+
+  pthread_mutex_lock(&mutex);
+
+  chunk * c = chunks;
+
+  if ((c == NULL) || ((c->size - c->used) < size)) {
+
+    bool   large     = (size > (RT_ARENA_CHUNK_SIZE / 2));
+    size_t chunkSize = large ? ((CHUNK_HEADER_SIZE + size + RT_ARENA_PAGE_SIZE - 1) &
+                                ~(size_t)(RT_ARENA_PAGE_SIZE - 1))
+                             : RT_ARENA_CHUNK_SIZE;
+
+    c = mapFailed ? NULL : mapChunk(chunkSize);
+
+    if (c == NULL) {
+      if (!mapFailed) {
+        logger.WARNING("RtArena: Unable to map %zu bytes: %s. Using the general allocator.",
+                       chunkSize, strerror(errno));
+        mapFailed = true;
+      }
+    }
+    else if (large && (chunks != NULL)) {
+      c->next      = chunks->next;
+      chunks->next = c;
+    }
+    else {
+      c->next = chunks;
+      chunks  = c;
+    }
+  }
+
+  if (c != NULL) {
+    ptr      = (uint8_t *) c + c->used;
+    c->used += size;
+  }
+
+  pthread_mutex_unlock(&mutex);
+
+  return ptr;
+}
+
+//---- allocate() ----
+
+void * RtArena::allocate(size_t size)
+{
+  void * ptr = tryAllocate(size);
+
+  if (ptr == NULL) {
+    if (posix_memalign(&ptr, CACHE_LINE_SIZE, (size > 0) ? size : 1) != 0) throw std::bad_alloc();
+    memset(ptr, 0, size);
+
+    pthread_mutex_lock(&mutex);
+    fallbackSize += size;
+    pthread_mutex_unlock(&mutex);
+  }
+
+  return ptr;
+}
+
+//---- contains() ----
+
+bool RtArena::contains(const void * ptr)
+{
+  bool found = false;
+
+  pthread_mutex_lock(&mutex);
+
+  for (chunk * c = chunks; c != NULL; c = c->next) {
+    if ((ptr >= (const void *) c) && (ptr < (const void *) ((uint8_t *) c + c->size))) {
+      found = true;
+      break;
+    }
+  }
+
+  pthread_mutex_unlock(&mutex);
+
+  return found;
+}
+
+//---- release() ----
+
+void RtArena::release(void * ptr)
+{
+  if ((ptr != NULL) && !contains(ptr)) free(ptr);
+}
+
+//---- report() ----
+
+void RtArena::report()
+{
+  size_t mapped = 0, used = 0, hugeTlb = 0, locked = 0;
+  int    count  = 0;
+  int    lockError = 0;
+
+  pthread_mutex_lock(&mutex);
+
+  for (chunk * c = chunks; c != NULL; c = c->next) {
+    count++;
+    mapped += c->size;
+    used   += c->used;
+    if (c->hugeTlb) hugeTlb += c->size;
+    if (c->lockError == 0) locked += c->size;
+    else lockError = c->lockError;
+  }
+
+  size_t fallback = fallbackSize;
+
+  pthread_mutex_unlock(&mutex);
+
+  logger.INFO("RtArena: %zu kB used in %d chunk(s), %zu kB mapped with %s, %s.",
+              used / 1024, count, mapped / 1024,
+              ((count > 0) && (hugeTlb == mapped)) ? "explicit huge pages" : "transparent huge pages",
+              (locked == mapped) ? "locked" : "not locked");
+
+  if (lockError != 0) {
+    logger.WARNING("RtArena: Unable to lock memory: %s (see ulimit -l).", strerror(lockError));
+  }
+
+  if (fallback > 0) {
+    logger.WARNING("RtArena: %zu kB allocated by the general allocator.", fallback / 1024);
+  }
+}
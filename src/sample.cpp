@@ -42,22 +42,29 @@
 
 #include "mezzo.h"
 
-int16_t * Sample::data = NULL;
+std::atomic<uint64_t> Sample::memoryUsed(0);
 
 #if samples24bits
-  int8_t * Sample::data24 = NULL;
+  Sample::Sample(sfSample & info, int16_t * dta, int8_t * dta24)
+#else
+  Sample::Sample(sfSample & info, int16_t * dta)
 #endif
-
-Sample::Sample(sfSample & info)
 {
   setNewHandler(outOfMemory);
 
+  data = dta;
+  #if samples24bits && !loadInMemory
+    data24 = dta24;
+  #endif
+
   char theName[21];
   strncpy(theName, info.achSampleName, 20);
   theName[20]  = '\0';
 
   #if loadInMemory
-    samples = NULL;
+    samples   = NULL;
+    loopCount = 0;
+    for (int i = 0; i < MAX_SAMPLE_LOOPS; i++) loops[i].data = NULL;
   #else
     firstBlock     = NULL;
     #if samples24bits
@@ -95,14 +102,32 @@ Sample::Sample(sfSample & info)
 Sample::~Sample()
 {
   #if loadInMemory
-    if (loaded && samples) delete [] samples;
+    if (loaded && samples) {
+      delete [] (samples - SAMPLE_GUARD);
+      memoryUsed -= (sizeSample + (2 * SAMPLE_GUARD)) * sizeof(sample_t);
+    }
     samples = NULL;
+
+    for (int i = 0; i < loopCount; i++) {
+      buffp loopData = loops[i].data;
+      if (loopData) {
+        delete [] (loopData - SAMPLE_GUARD);
+        memoryUsed -= (loops[i].end - loops[i].start + (2 * SAMPLE_GUARD)) * sizeof(sample_t);
+      }
+      loops[i].data = NULL;
+    }
   #else
-    if (loaded && firstBlock) delete [] firstBlock;
+    if (loaded && firstBlock) {
+      delete [] firstBlock;
+      memoryUsed -= sizeFirstBlock * sizeof(int16_t);
+    }
     firstBlock = NULL;
 
     #if samples24bits
-      if (firstBlock24) delete [] firstBlock24;
+      if (firstBlock24) {
+        delete [] firstBlock24;
+        memoryUsed -= sizeFirstBlock;
+      }
       firstBlock24 = NULL;
     #endif
   #endif
@@ -119,18 +144,28 @@ bool Sample::load()
   if (loaded) return true;
 
   #if loadInMemory
-    samples = new sample_t[sizeSample];
+    buffp buff = new sample_t[sizeSample + (2 * SAMPLE_GUARD)];
+    memoryUsed += (sizeSample + (2 * SAMPLE_GUARD)) * sizeof(sample_t);
+
+    std::fill(buff, buff + SAMPLE_GUARD, 0.0f);
+    std::fill(buff + SAMPLE_GUARD + sizeSample, buff + sizeSample + (2 * SAMPLE_GUARD), 0.0f);
+
+    samples = buff + SAMPLE_GUARD;
     Utils::shortToFloatNormalize(samples, &data[start], sizeSample);
+
+    for (int i = 0; i < loopCount; i++) prepareLoop(loops[i]);
   #else
     sizeFirstBlock = SAMPLE_BLOCK_SIZE;
     if (sizeSample < sizeFirstBlock) sizeFirstBlock = sizeSample;
 
     firstBlock = new int16_t[sizeFirstBlock];
+    memoryUsed += sizeFirstBlock * sizeof(int16_t);
     std::copy(&data[start], &data[start + sizeFirstBlock], firstBlock);
 
     #if samples24bits
       if (data24) {
         firstBlock24 = new int8_t[sizeFirstBlock];
+        memoryUsed += sizeFirstBlock;
         std::copy(&data24[start], &data24[start + sizeFirstBlock], firstBlock24);
       }
     #endif
@@ -279,33 +314,95 @@ uint16_t Sample::getData(sampleRecord & buff, uint32_t pos, Synthesizer & synth)
   return count;
 }
 
-buffp Sample::getData2(uint32_t & count, uint32_t pos, Synthesizer & synth)
+#if loadInMemory
+
+//---- addLoop() ----
+//
+// Loops are registered by the instruments when they are loaded, before
+// the sample itself is loaded by the SampleLoader. Voices may be reading
+// the list at any time: an entry is published only once its data is ready.
+
+bool Sample::addLoop(uint32_t loopStart, uint32_t loopEnd)
 {
-  const uint32_t offset  = (synth.getStart() - start);
-  const uint32_t size    = synth.isLooping() ? MIN(sizeSample - offset, synth.getEndLoop()) :
-                                               sizeSample - offset;
-  const uint32_t maxSize = synth.isLooping() ? synth.getEndLoop() :
-                                               synth.getSizeSample();
-
-  if (pos >= maxSize) {
-    // The position has now passed the end of the sample.
-    if (synth.isLooping()) {
-
-      // We are looping. Find where we are in the loop portion
-      uint32_t thePos = synth.getStartLoop() +
-                        ((pos - maxSize) % synth.getSizeLoop());
-      count = MIN(maxSize - thePos, size - thePos);
-      return &samples[offset + thePos];
-    }
-    else {
-      count = 0;
-      return samples;
-    }
+  if (!clampLoop(loopStart, loopEnd)) return false;
+
+  for (int i = 0; i < loopCount; i++) {
+    if ((loops[i].start == loopStart) && (loops[i].end == loopEnd)) return true;
+  }
+
+  if (loopCount >= MAX_SAMPLE_LOOPS) return false;
+
+  loopRegion & loop = loops[loopCount];
+
+  loop.start = loopStart;
+  loop.end   = loopEnd;
+  loop.data  = NULL;
+
+  if (loaded) prepareLoop(loop);
+
+  loopCount++;
+  return true;
+}
+
+//---- prepareLoop() ----
+
+void Sample::prepareLoop(loopRegion & loop)
+{
+  if (loop.data != NULL) return;
+
+  const uint32_t size = loop.end - loop.start;
+  buffp buff = new sample_t[size + (2 * SAMPLE_GUARD)];
+  memoryUsed += (size + (2 * SAMPLE_GUARD)) * sizeof(sample_t);
+
+  // Samples before the loop and the loop itself. The guard before the
+  // sample data covers loops starting close to the beginning.
+
+  std::copy(&samples[(int32_t) loop.start - SAMPLE_GUARD], &samples[loop.end], buff);
+
+  // Beginning of the loop, repeated as many times as needed for short loops
+
+  for (uint32_t i = 0; i < SAMPLE_GUARD; i++) {
+    buff[SAMPLE_GUARD + size + i] = samples[loop.start + (i % size)];
   }
-  else {
-    count = size - pos;
-    return &samples[offset + pos];
+
+  loop.data.store(buff + SAMPLE_GUARD, std::memory_order_release);
+}
+
+//---- getLoop() ----
+//
+// The loops that could not be prepared are read from the sample data,
+// that has its guards around it: the resampler stays in the data, only
+// the interpolation across the end of the loop uses the samples following
+// the loop instead of its first ones.
+
+buffp Sample::getLoop(uint32_t loopStart, uint32_t loopEnd)
+{
+  int count = loopCount;
+
+  for (int i = 0; i < count; i++) {
+    if ((loops[i].start == loopStart) && (loops[i].end == loopEnd)) {
+      return loops[i].data.load(std::memory_order_acquire);
+    }
   }
+  return (samples != NULL) ? samples + loopStart : NULL;
+}
+
+#endif
+
+//---- clampLoop() ----
+//
+// Loop points out of the sample are found in some sound fonts, or come
+// from the loop offsets of a zone. They are clamped instead of the zone
+// being played without its loop.
+
+bool Sample::clampLoop(uint32_t & loopStart, uint32_t & loopEnd)
+{
+  if ((int32_t) loopStart < 0) loopStart = 0;
+
+  if ((int32_t) loopEnd < 0)      loopEnd = 0;
+  else if (loopEnd > sizeSample)  loopEnd = sizeSample;
+
+  return loopStart < loopEnd;
 }
 
 //---- showState() -----
@@ -0,0 +1,208 @@
+// Notice
+// ------
+//
+// This file is part of the Mezzo SoundFont2 Sampling Based Synthesizer:
+//
+//     https://github.com/turgu1/mezzo
+//
+// Simplified BSD License
+// ----------------------
+//
+// Copyright (c) 2018, Guy Turcotte
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// The views and conclusions contained in the software and documentation are those
+// of the authors and should not be interpreted as representing official policies,
+// either expressed or implied, of the FreeBSD Project.
+//
+#include <algorithm>
+#include <thread>
+
+#include "mezzo.h"
+
+SampleLoader::SampleLoader(int threadCount)
+{
+  setNewHandler(outOfMemory);
+
+  batch       = NULL;
+  generation  = 0;
+  activeCount = 0;
+  stopping   = false;
+  progress   = NULL;
+
+  nextIdx    = 0;
+  doneCount  = 0;
+  failed     = false;
+
+  pthread_mutex_init(&batchMutex, NULL);
+  pthread_mutex_init(&mutex,      NULL);
+  pthread_cond_init (&workReady,  NULL);
+  pthread_cond_init (&workDone,   NULL);
+
+  if (threadCount <= 0) threadCount = std::thread::hardware_concurrency();
+  if (threadCount <= 0) threadCount = 1;
+
+  for (int i = 0; i < threadCount; i++) {
+    pthread_t thread;
+    std::string name = "loader" + std::to_string(i + 1);
+    if (Scheduling::createThread(&thread, ROLE_IO, name.c_str(), worker, this)) {
+      logger.ERROR("SampleLoader: Unable to start worker thread.");
+      break;
+    }
+    workers.push_back(thread);
+  }
+
+  logger.DEBUG("SampleLoader: %d worker threads.", (int) workers.size());
+}
+
+SampleLoader::~SampleLoader()
+{
+  pthread_mutex_lock(&mutex);
+  stopping = true;
+  pthread_cond_broadcast(&workReady);
+  pthread_mutex_unlock(&mutex);
+
+  for (unsigned i = 0; i < workers.size(); i++) pthread_join(workers[i], NULL);
+
+  pthread_cond_destroy (&workDone);
+  pthread_cond_destroy (&workReady);
+  pthread_mutex_destroy(&mutex);
+  pthread_mutex_destroy(&batchMutex);
+}
+
+void SampleLoader::outOfMemory()
+{
+  logger.FATAL("SampleLoader: Unable to allocate memory.");
+}
+
+void * SampleLoader::worker(void * args)
+{
+  ((SampleLoader *) args)->work();
+  return NULL;
+}
+
+//---- work() ----
+//
+// Samples are taken from the batch one at a time, the largest ones
+// being first in the batch, such that the threads are finishing at about
+// the same time. The batch belongs to the requesting thread: it is not
+// released before every worker has left it.
+
+void SampleLoader::work()
+{
+  unsigned seen = 0;
+
+  pthread_mutex_lock(&mutex);
+
+  while (true) {
+    while (!stopping && (generation == seen)) {
+      pthread_cond_wait(&workReady, &mutex);
+    }
+    if (stopping) break;
+
+    seen = generation;
+    if (batch == NULL) continue;   // Woke up too late, the batch is completed
+
+    sampleBatch & samples = *batch;
+    activeCount++;
+    pthread_mutex_unlock(&mutex);
+
+    int idx;
+    while ((idx = nextIdx++) < (int) samples.size()) {
+      if (!samples[idx]->load()) failed = true;
+
+      pthread_mutex_lock(&mutex);
+      doneCount++;
+      pthread_cond_signal(&workDone);
+      pthread_mutex_unlock(&mutex);
+    }
+
+    pthread_mutex_lock(&mutex);
+    activeCount--;
+    pthread_cond_signal(&workDone);
+  }
+
+  pthread_mutex_unlock(&mutex);
+}
+
+//---- loadSamples() ----
+
+bool SampleLoader::loadSamples(sampleBatch & samples)
+{
+  sampleBatch toLoad;
+
+  for (unsigned i = 0; i < samples.size(); i++) {
+    if (!samples[i]->isLoaded()) toLoad.push_back(samples[i]);
+  }
+
+  std::sort(toLoad.begin(), toLoad.end());
+  toLoad.erase(std::unique(toLoad.begin(), toLoad.end()), toLoad.end());
+
+  if (toLoad.empty()) return true;
+
+  std::sort(toLoad.begin(), toLoad.end(),
+            [](Sample * a, Sample * b) { return a->getSize() > b->getSize(); });
+
+  int total = toLoad.size();
+
+  pthread_mutex_lock(&batchMutex);
+
+  if (workers.empty()) {
+    bool result = true;
+    for (int i = 0; i < total; i++) {
+      result = toLoad[i]->load() && result;
+      if (progress) progress(i + 1, total);
+    }
+    pthread_mutex_unlock(&batchMutex);
+    return result;
+  }
+
+  pthread_mutex_lock(&mutex);
+
+  batch     = &toLoad;
+  nextIdx   = 0;
+  doneCount = 0;
+  failed    = false;
+  generation++;
+  pthread_cond_broadcast(&workReady);
+
+  int reported = 0;
+  while ((doneCount < total) || (activeCount > 0)) {
+    pthread_cond_wait(&workDone, &mutex);
+    if (progress && (doneCount != reported)) {
+      reported = doneCount;
+      pthread_mutex_unlock(&mutex);
+      progress(reported, total);
+      pthread_mutex_lock(&mutex);
+    }
+  }
+
+  batch = NULL;
+  pthread_mutex_unlock(&mutex);
+
+  bool result = !failed;
+
+  pthread_mutex_unlock(&batchMutex);
+
+  return result;
+}
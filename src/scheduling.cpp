@@ -0,0 +1,538 @@
+// Notice
+// ------
+//
+// This file is part of the Mezzo SoundFont2 Sampling Based Synthesizer:
+//
+//     https://github.com/turgu1/mezzo
+//
+// Simplified BSD License
+// ----------------------
+//
+// Copyright (c) 2018, Guy Turcotte
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// The views and conclusions contained in the software and documentation are those
+// of the authors and should not be interpreted as representing official policies,
+// either expressed or implied, of the FreeBSD Project.
+//
+
+#include <cerrno>
+#include <algorithm>
+#include <cstring>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#ifdef __linux__
+  #include <malloc.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+  #include <xmmintrin.h>
+#endif
+
+#include "mezzo.h"
+
+#define SCHEDULING_AUDIO_WAIT  50   ///< Times 10 msec waiting for the first audio callback
+#define SCHEDULING_STACK_SIZE  (512 * 1024)  ///< Stack of the threads started when the memory is locked
+
+Scheduling::threadRecord Scheduling::threads[SCHEDULING_MAX_THREADS];
+int                      Scheduling::threadCount = 0;
+pthread_mutex_t          Scheduling::mutex       = PTHREAD_MUTEX_INITIALIZER;
+Scheduling::appliedRecord Scheduling::applied[ROLE_COUNT];
+int                      Scheduling::memoryError = -1;
+
+PRIVATE const char * roleNames[ROLE_COUNT] = { "audio", "render", "midi", "io", "ui" };
+
+PRIVATE const std::string & roleCpus(threadRole role)
+{
+  switch (role) {
+    case ROLE_AUDIO:  return config.audioCpus;
+    case ROLE_RENDER: return config.renderCpus;
+    case ROLE_MIDI:   return config.midiCpus;
+    case ROLE_IO:     return config.ioCpus;
+    default:          return config.uiCpus;
+  }
+}
+
+PRIVATE int rolePriority(threadRole role)
+{
+  switch (role) {
+    case ROLE_AUDIO:  return config.audioPriority;
+    case ROLE_RENDER: return config.renderPriority;
+    case ROLE_MIDI:   return config.midiPriority;
+    case ROLE_IO:     return config.ioPriority;
+    default:          return config.uiPriority;
+  }
+}
+
+#ifdef __linux__
+
+//---- parseCpus() ----
+//
+// A list of processor numbers and ranges: "3", "2-3" or "0,2-3". Returns
+// false if the list is empty or not valid.
+
+PRIVATE bool parseCpus(const std::string & list, cpu_set_t & cpus)
+{
+  CPU_ZERO(&cpus);
+
+  const char * s = list.c_str();
+  bool         found = false;
+
+  while (*s) {
+    char * end;
+    long   first = strtol(s, &end, 10);
+    long   last  = first;
+
+    if ((end == s) || (first < 0) || (first >= CPU_SETSIZE)) return false;
+    s = end;
+
+    if (*s == '-') {
+      last = strtol(++s, &end, 10);
+      if ((end == s) || (last < first) || (last >= CPU_SETSIZE)) return false;
+      s = end;
+    }
+
+    for (long cpu = first; cpu <= last; cpu++) CPU_SET(cpu, &cpus);
+    found = true;
+
+    if (*s == ',') s++;
+    else if (*s) return false;
+  }
+
+  return found;
+}
+
+PRIVATE std::string formatCpus(cpu_set_t & cpus)
+{
+  std::string list;
+
+  for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+    if (!CPU_ISSET(cpu, &cpus)) continue;
+
+    int last = cpu;
+    while (((last + 1) < CPU_SETSIZE) && CPU_ISSET(last + 1, &cpus)) last++;
+
+    if (!list.empty()) list += ",";
+    list += std::to_string(cpu);
+    if (last > cpu) list += "-" + std::to_string(last);
+
+    cpu = last;
+  }
+
+  return list;
+}
+
+#endif
+
+//---- record() ----
+//
+// Threads started by createThread(). A thread of the same role and name
+// replaces the previous one.
+
+void Scheduling::record(pthread_t    thread,
+                        threadRole   role,
+                        const char * name,
+                        const char * failed,
+                        int          error)
+{
+  pthread_mutex_lock(&mutex);
+
+  int idx = 0;
+  while ((idx < threadCount) &&
+         ((threads[idx].role != role) || (strcmp(threads[idx].name, name) != 0))) idx++;
+
+  if (idx < SCHEDULING_MAX_THREADS) {
+    threads[idx].thread = thread;
+    threads[idx].role   = role;
+    threads[idx].failed = failed;
+    threads[idx].error  = error;
+    strncpy(threads[idx].name, name, SCHEDULING_NAME_SIZE - 1);
+    threads[idx].name[SCHEDULING_NAME_SIZE - 1] = 0;
+
+    if (idx == threadCount) threadCount++;
+  }
+
+  pthread_mutex_unlock(&mutex);
+}
+
+//---- recordApplied() ----
+//
+// Called from the audio and MIDI callbacks: the record is published
+// through its sequence number instead of the mutex, such that a report
+// being logged cannot block them.
+
+void Scheduling::recordApplied(threadRole   role,
+                               pthread_t    thread,
+                               const char * name,
+                               const char * failed,
+                               int          error)
+{
+  appliedRecord & rec = applied[role];
+  uint32_t        seq = rec.seq.load(std::memory_order_relaxed);
+
+  rec.seq.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  rec.thread.store(thread, std::memory_order_relaxed);
+  rec.name  .store(name,   std::memory_order_relaxed);
+  rec.failed.store(failed, std::memory_order_relaxed);
+  rec.error .store(error,  std::memory_order_relaxed);
+
+  rec.seq.store(seq + 2, std::memory_order_release);
+}
+
+//---- readApplied() ----
+//
+// Copy the record of the role, read again if it was written meanwhile.
+// Returns false if no thread of the role has been set up yet.
+
+bool Scheduling::readApplied(threadRole role, threadRecord & out)
+{
+  appliedRecord & rec = applied[role];
+  uint32_t        seq;
+  const char    * name;
+
+  for (;;) {
+    seq = rec.seq.load(std::memory_order_acquire);
+    if (seq == 0) return false;
+    if (seq & 1) {
+      sched_yield();
+      continue;
+    }
+
+    out.thread = rec.thread.load(std::memory_order_relaxed);
+    out.role   = role;
+    out.failed = rec.failed.load(std::memory_order_relaxed);
+    out.error  = rec.error .load(std::memory_order_relaxed);
+    name       = rec.name  .load(std::memory_order_relaxed);
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (rec.seq.load(std::memory_order_relaxed) == seq) break;
+  }
+
+  strncpy(out.name, name, SCHEDULING_NAME_SIZE - 1);
+  out.name[SCHEDULING_NAME_SIZE - 1] = 0;
+
+  return true;
+}
+
+//---- lockMemory() ----
+
+void Scheduling::lockMemory()
+{
+  if (!config.lockMemory) return;
+
+  #ifdef __linux__
+    mallopt(M_TRIM_THRESHOLD, -1);  // Freed memory is never given back to the system
+    mallopt(M_MMAP_MAX,        0);  // All allocations come from the locked heap
+  #endif
+
+  memoryError = (mlockall(MCL_CURRENT | MCL_FUTURE) == 0) ? 0 : errno;
+}
+
+//---- flushDenormals() ----
+
+bool Scheduling::flushDenormals()
+{
+  #if defined(__x86_64__) || defined(__i386__)
+    _mm_setcsr(_mm_getcsr() | 0x8040);      // FTZ (bit 15) and DAZ (bit 6)
+    return (_mm_getcsr() & 0x8040) == 0x8040;
+  #elif defined(__aarch64__)
+    uint64_t fpcr;
+    asm volatile("mrs %0, fpcr" : "=r" (fpcr));
+    asm volatile("msr fpcr, %0" : : "r" (fpcr | (1 << 24)));  // FZ
+    return true;
+  #elif defined(__arm__) && defined(__VFP_FP__) && !defined(__SOFTFP__)
+    uint32_t fpscr;
+    asm volatile("vmrs %0, fpscr" : "=r" (fpscr));
+    asm volatile("vmsr fpscr, %0" : : "r" (fpscr | (1 << 24)));  // FZ, NEON is always flushing
+    return true;
+  #else
+    return false;
+  #endif
+}
+
+//---- threadStart() ----
+//
+// Start routine of the threads created by createThread(): the floating
+// point mode is set by the thread itself before running its function.
+
+struct threadArgs {
+  void * (* start)(void *);
+  void *    arg;
+};
+
+void * Scheduling::threadStart(void * args)
+{
+  threadArgs run = * (threadArgs *) args;
+  delete (threadArgs *) args;
+
+  flushDenormals();
+
+  return run.start(run.arg);
+}
+
+//---- createThread() ----
+//
+// The affinity is set once the thread is started, such that a processor
+// list that is not valid on this machine does not prevent it to run.
+
+int Scheduling::createThread(pthread_t  * thread,
+                             threadRole   role,
+                             const char * name,
+                             void       * (* start)(void *),
+                             void       * arg)
+{
+  int          priority = rolePriority(role);
+  const char * failed   = NULL;
+  int          error    = 0;
+  int          result;
+
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+
+  // A locked stack is entirely faulted in and counts in the locked memory
+  // limit: the 8 MB default is far more than needed
+
+  if (memoryError == 0) pthread_attr_setstacksize(&attr, SCHEDULING_STACK_SIZE);
+
+  if (priority > 0) {
+    struct sched_param param;
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = priority;
+
+    pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy (&attr, SCHED_FIFO);
+    pthread_attr_setschedparam  (&attr, &param);
+  }
+
+  threadArgs * args = new threadArgs { start, arg };
+
+  result = pthread_create(thread, &attr, threadStart, args);
+  pthread_attr_destroy(&attr);
+
+  // Without the privilege (CAP_SYS_NICE or RLIMIT_RTPRIO), the thread is
+  // started with the scheduling of its creator
+
+  if ((result == EPERM) && (priority > 0)) {
+    failed = "SCHED_FIFO";
+    error  = result;
+
+    pthread_attr_init(&attr);
+    if (memoryError == 0) pthread_attr_setstacksize(&attr, SCHEDULING_STACK_SIZE);
+    result = pthread_create(thread, &attr, threadStart, args);
+    pthread_attr_destroy(&attr);
+  }
+
+  if (result != 0) {
+    delete args;
+    logger.ERROR("Scheduling: Unable to start thread %s: %s%s", name, strerror(result),
+                 ((result == EAGAIN) && (memoryError == 0)) ? " (locked memory limit, see ulimit -l)" : "");
+    return result;
+  }
+
+  #ifdef __linux__
+    cpu_set_t cpus;
+    if (!roleCpus(role).empty()) {
+      if (!parseCpus(roleCpus(role), cpus)) {
+        if (failed == NULL) { failed = "cpu list"; error = EINVAL; }
+      }
+      else {
+        int err = pthread_setaffinity_np(*thread, sizeof(cpus), &cpus);
+        if (err && (failed == NULL)) {
+          failed = "affinity";
+          error  = err;
+        }
+      }
+    }
+
+    char shortName[SCHEDULING_NAME_SIZE];
+    strncpy(shortName, name, SCHEDULING_NAME_SIZE - 1);
+    shortName[SCHEDULING_NAME_SIZE - 1] = 0;
+    pthread_setname_np(*thread, shortName);
+  #endif
+
+  record(*thread, role, name, failed, error);
+
+  return 0;
+}
+
+//---- applyToThread() ----
+
+void Scheduling::applyToThread(threadRole role, const char * name)
+{
+  flushDenormals();
+
+  pthread_t    self     = pthread_self();
+  int          priority = rolePriority(role);
+  const char * failed   = NULL;
+  int          error    = 0;
+
+  #ifdef __linux__
+    cpu_set_t cpus;
+    if (!roleCpus(role).empty()) {
+      if (!parseCpus(roleCpus(role), cpus)) {
+        failed = "cpu list";
+        error  = EINVAL;
+      }
+      else if ((error = pthread_setaffinity_np(self, sizeof(cpus), &cpus)) != 0) {
+        failed = "affinity";
+      }
+    }
+
+    char shortName[SCHEDULING_NAME_SIZE];
+    strncpy(shortName, name, SCHEDULING_NAME_SIZE - 1);
+    shortName[SCHEDULING_NAME_SIZE - 1] = 0;
+    pthread_setname_np(self, shortName);
+  #endif
+
+  if (priority > 0) {
+    struct sched_param param;
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = priority;
+
+    int err = pthread_setschedparam(self, SCHED_FIFO, &param);
+    if (err && (failed == NULL)) {
+      failed = "SCHED_FIFO";
+      error  = err;
+    }
+  }
+
+  recordApplied(role, self, name, failed, error);
+}
+
+//---- reportThread() ----
+//
+// The settings are read back from the system, as other libraries may have
+// changed them.
+
+void Scheduling::reportThread(threadRecord & rec)
+{
+  struct sched_param param;
+  int                policy;
+  std::string        cpuList = "?";
+
+  if (pthread_getschedparam(rec.thread, &policy, &param) != 0) {
+    policy = -1;
+    param.sched_priority = 0;
+  }
+
+  #ifdef __linux__
+    cpu_set_t cpus;
+    if (pthread_getaffinity_np(rec.thread, sizeof(cpus), &cpus) == 0) cpuList = formatCpus(cpus);
+  #endif
+
+  const char * policyName = (policy == SCHED_FIFO)  ? "SCHED_FIFO"  :
+                            (policy == SCHED_RR)    ? "SCHED_RR"    :
+                            (policy == SCHED_OTHER) ? "SCHED_OTHER" : "unknown";
+
+  if (rec.failed != NULL) {
+    logger.WARNING("Scheduling: %-6s %-12s cpus %s, %s %d (%s refused: %s)",
+                   roleNames[rec.role], rec.name, cpuList.c_str(), policyName,
+                   param.sched_priority, rec.failed, strerror(rec.error));
+  }
+  else {
+    logger.INFO("Scheduling: %-6s %-12s cpus %s, %s %d",
+                roleNames[rec.role], rec.name, cpuList.c_str(), policyName,
+                param.sched_priority);
+  }
+}
+
+//---- report() ----
+
+void Scheduling::report(threadRole role)
+{
+  if (role == ROLE_COUNT) {
+
+    if (memoryError == 0) {
+      long locked = 0;
+
+      #ifdef __linux__
+        FILE * f = fopen("/proc/self/status", "r");
+        if (f != NULL) {
+          char line[128];
+          while (fgets(line, sizeof(line), f) != NULL) {
+            if (sscanf(line, "VmLck: %ld", &locked) == 1) break;
+          }
+          fclose(f);
+        }
+      #endif
+
+      logger.INFO("Scheduling: memory locked (%ld kB)", locked);
+    }
+    else if (memoryError > 0) {
+      logger.WARNING("Scheduling: memory not locked: %s", strerror(memoryError));
+    }
+    else {
+      logger.INFO("Scheduling: memory not locked (lock-memory is false)");
+    }
+
+    if (flushDenormals()) {
+      logger.INFO("Scheduling: subnormal numbers flushed to zero");
+    }
+    else {
+      logger.WARNING("Scheduling: subnormal numbers cannot be flushed to zero on this processor");
+    }
+
+    for (int i = 0; (i < SCHEDULING_AUDIO_WAIT) &&
+                    (applied[ROLE_AUDIO].seq.load(std::memory_order_acquire) == 0); i++) {
+      usleep(10000);
+    }
+  }
+
+  // The records are copied, such that the threads being started are not
+  // held while the report is logged
+
+  threadRecord recs[SCHEDULING_MAX_THREADS + ROLE_COUNT];
+  int          count;
+
+  pthread_mutex_lock(&mutex);
+  std::copy(threads, threads + threadCount, recs);
+  count = threadCount;
+  pthread_mutex_unlock(&mutex);
+
+  for (int r = 0; r < ROLE_COUNT; r++) {
+    if (readApplied((threadRole) r, recs[count])) count++;
+  }
+
+  for (int r = 0; r < ROLE_COUNT; r++) {
+    if ((role != ROLE_COUNT) && (role != r)) continue;
+
+    bool found = false;
+    for (int t = 0; t < count; t++) {
+      if (recs[t].role == r) {
+        reportThread(recs[t]);
+        found = true;
+      }
+    }
+
+    if (!found && (role == ROLE_COUNT)) {
+      logger.INFO("Scheduling: %-6s not started yet: cpus %s, priority %d",
+                  roleNames[r],
+                  roleCpus((threadRole) r).empty() ? "all" : roleCpus((threadRole) r).c_str(),
+                  rolePriority((threadRole) r));
+    }
+  }
+}
@@ -0,0 +1,121 @@
+// Notice
+// ------
+//
+// This file is part of the Mezzo SoundFont2 Sampling Based Synthesizer:
+//
+//     https://github.com/turgu1/mezzo
+//
+// Simplified BSD License
+// ----------------------
+//
+// Copyright (c) 2018, Guy Turcotte
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// The views and conclusions contained in the software and documentation are those
+// of the authors and should not be interpreted as representing official policies,
+// either expressed or implied, of the FreeBSD Project.
+//
+
+// Scalar and NEON backends of the SIMD kernels, and the selection of the
+// backend used by the engine (see simd.h).
+
+#include "mezzo.h"
+#include "simd_kernels.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+  extern const SimdKernels simdSse41Kernels;  // simd_sse41.cpp
+  extern const SimdKernels simdAvx2Kernels;   // simd_avx2.cpp
+#endif
+
+PRIVATE const SimdKernels scalarKernels = SIMD_KERNELS(SimdScalar, "scalar");
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+  PRIVATE const SimdKernels neonKernels = SIMD_KERNELS(SimdNeon, "neon");
+#endif
+
+PRIVATE const SimdKernels * available[4] = { NULL };
+
+//---- getAvailable() ----
+//
+// The NEON backend is available when the build targets it: the
+// application is then compiled for a processor having it anyway.
+
+const SimdKernels * const * Simd::getAvailable()
+{
+  if (available[0] == NULL) {
+    int count = 0;
+
+    #if defined(__x86_64__) || defined(__i386__)
+      __builtin_cpu_init();
+      if (__builtin_cpu_supports("sse4.1")) {
+        available[count++] = &simdSse41Kernels;
+      }
+      if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        available[count++] = &simdAvx2Kernels;
+      }
+    #endif
+
+    #if defined(__ARM_NEON) || defined(__ARM_NEON__)
+      available[count++] = &neonKernels;
+    #endif
+
+    // The scalar one is put first, the best one being the last
+
+    for (int i = count; i > 0; i--) available[i] = available[i - 1];
+    available[0] = &scalarKernels;
+    available[count + 1] = NULL;
+  }
+
+  return available;
+}
+
+//---- select() ----
+//
+// A build without the NEON intrinsics (USE_NEON_INTRINSICS=0) is a scalar
+// build: the scalar backend is then the automatic choice.
+
+bool Simd::select(const char * name)
+{
+  const SimdKernels * const * list = getAvailable();
+  const SimdKernels *         selected = NULL;
+
+  if (strcmp(name, "auto") == 0) {
+    #if USE_NEON_INTRINSICS
+      while (*list != NULL) selected = *list++;
+    #else
+      selected = &scalarKernels;
+    #endif
+  }
+  else {
+    for (; *list != NULL; list++) {
+      if (strcmp((*list)->name, name) == 0) selected = *list;
+    }
+  }
+
+  if (selected == NULL) return false;
+
+  simd = selected;
+  return true;
+}
+
+PRIVATE bool simdSelected = Simd::select("auto");
@@ -61,7 +61,25 @@ int soundCallback(const void *                     inputBuffer,
   (void) userData;
   (void) timeInfo;
 
-  if ((statusFlags & paOutputUnderflow) && !sound->holding()) std::cout << "PortAudio Stream Underflow Detected." << std::endl;
+  // The callback must complete within the duration of the buffer it produces
+
+  PRIVATE const int64_t deadline = (BUFFER_FRAME_COUNT * 1000000000LL) / config.samplingRate;
+
+  // The audio thread belongs to PortAudio, that starts a new one each time
+  // the stream is restarted
+
+  PRIVATE pthread_t audioThread;
+  PRIVATE bool      audioThreadKnown = false;
+
+  if (!audioThreadKnown || !pthread_equal(audioThread, pthread_self())) {
+    audioThread      = pthread_self();
+    audioThreadKnown = true;
+    Scheduling::applyToThread(ROLE_AUDIO, "audio");
+  }
+
+  Duration callbackDuration;
+
+  if ((statusFlags & paOutputUnderflow) && !sound->holding()) metrics.underflow();
 
   if (config.replayEnabled && sound->isReplaying()) {
     sound->get(buff);
@@ -73,18 +91,37 @@ int soundCallback(const void *                     inputBuffer,
     std::copy(std::begin(buff), std::end(buff), (frame_t *) outputBuffer);
   }
   else {
-    poly->mixer(buff);
-    reverb->process(buff);
-    //equalizer->process(buff, nBufferFrames);
+    Sound::mix(buff);
     metronome->process(buff);
     if (config.replayEnabled) sound->push(buff);
   }
 
+  Duration outputDuration;
+
   Utils::clip((buffp) outputBuffer, buff);
 
+  metrics.record(METRIC_OUTPUT, outputDuration.getElapse());
+  metrics.recordCallback(callbackDuration.getElapse(), deadline);
+
   return 0;
 }
 
+//---- mix() ----
+
+void Sound::mix(frameRecord & buff)
+{
+  static frameRecord reverbBuff;
+  static frameRecord chorusBuff;
+
+  poly->mixer(buff, &reverbBuff, &chorusBuff);
+  chorus->process(buff, poly->isChorusBusUsed() ? &chorusBuff : NULL);
+  reverb->process(buff, poly->isReverbBusUsed() ? &reverbBuff : NULL);
+
+  Duration eqDuration;
+  equalizer->process(buff);
+  metrics.record(METRIC_EQUALIZER, eqDuration.getElapse());
+}
+
 void Sound::openPort(int devNbr)
 {
   int err;
@@ -35,16 +35,19 @@
 // of the authors and should not be interpreted as representing official policies,
 // either expressed or implied, of the FreeBSD Project.
 //
-
 #include <iomanip>
 
 #include "mezzo.h"
 
-SoundFont2::SoundFont2(std::string & sf2Filename)
+SoundFont2::SoundFont2(std::string & sf2Filename, int offset)
 {
   setNewHandler(outOfMemory);
 
-  loaded = false;
+  loaded     = false;
+  filename   = sf2Filename;
+  bankOffset = offset;
+
+  memset(&tables, 0, sizeof(tables));
 
   assert(sizeof(sfModulator   ) ==  2);
   assert(sizeof(sfInst        ) == 22);
@@ -56,9 +59,6 @@ SoundFont2::SoundFont2(std::string & sf2Filename)
   assert(sizeof(genAmountType ) ==  2);
   assert(sizeof(sfGenList     ) ==  4);
 
-  currentPreset   = NULL;
-  firstMidiPreset = NULL;
-
   file.open(sf2Filename);
   if (!file.is_open()) {
     logger.ERROR("Unable to open file %s.", sf2Filename.c_str());
@@ -70,7 +70,12 @@ SoundFont2::SoundFont2(std::string & sf2Filename)
 
     if ((memcmp(ck.id,       "RIFF", 4) == 0) &&
         (memcmp(ck.listName, "sfbk", 4) == 0)) {
-      loaded = retrieveInstrumentList() && retrievePresetList() && retrieveSamples();
+      bool tablesOk = index.load(filename, data, file.size(), tables);
+      if (!tablesOk && (tablesOk = retrieveTables())) {
+        index.save(filename, data, file.size(), tables);
+      }
+      loaded = tablesOk &&
+               retrieveInstrumentList() && retrievePresetList() && retrieveSamples();
     }
     else {
       logger.ERROR("Unrecognizable SF2 file format: %s", sf2Filename.c_str());
@@ -104,146 +109,46 @@ void SoundFont2::outOfMemory()
 }
 
 bool SoundFont2::loadInstrument(std::string & instrumentName,
-                                rangesType  & keys)
+                                rangesType  & keys,
+                                sampleBatch & batch)
 {
   for (uint16_t i = 0; i < instruments.size(); i++) {
     if (instrumentName == instruments[i]->getName()) {
-      return loadInstrument(i, keys);
+      return loadInstrument(i, keys, batch);
     }
   }
   return false;
 }
 
-bool SoundFont2::loadInstrument(uint16_t     instrumentIndex,
-                                rangesType & keys)
+bool SoundFont2::loadInstrument(uint16_t      instrumentIndex,
+                                rangesType  & keys,
+                                sampleBatch & batch)
 {
   if (instrumentIndex >= instruments.size()) return false;
 
   assert(instruments[instrumentIndex] != NULL);
 
-  chunkList * ckl = findChunkList("pdta");
-  if (ckl == NULL) return false;
-  assert(memcmp(ckl->listName, "pdta", 4) == 0);
-
-  // ---- ibags ----
-
-  chunk * ck = findChunk("ibag", *ckl);
-  if (ck == NULL) return false;
-  assert(memcmp(ck->id, "ibag", 4) == 0);
-
-  sfBag * ibags = (sfBag *) ck->data;
-
-  // ---- imods ----
-
-  ck = findChunk("imod", *ckl);
-  if (ck == NULL) return false;
-  assert(memcmp(ck->id, "imod", 4) == 0);
-
-  sfModList * imods = (sfModList *) ck->data;
-
-  // ---- igens ----
-
-  ck = findChunk("igen", *ckl);
-  if (ck == NULL) return false;
-  assert(memcmp(ck->id, "igen", 4) == 0);
-
-  sfGenList * igens = (sfGenList *) ck->data;
-
-  return instruments[instrumentIndex]->load(ibags, igens, imods, keys);
+  return instruments[instrumentIndex]->load(tables.zones, tables.gens, tables.mods,
+                                            keys, batch);
 }
 
-bool SoundFont2::loadPreset(std::string & presetName)
-{
-  for (uint16_t i = 0; i < presets.size(); i++) {
-    if (presetName == presets[i]->getName()) return loadPreset(presets[i]);
-  }
-  return false;
-}
+//---- isInstrumentUsed() ----
 
-bool SoundFont2::loadMidiPreset(uint8_t bankNbr, uint8_t midiNbr)
+bool SoundFont2::isInstrumentUsed(int16_t instrumentIndex, Preset * except)
 {
-  Preset * p = firstMidiPreset;
-  while (p && ((p->getBankNbr() != bankNbr) ||
-               (p->getMidiNbr() != midiNbr))) {
-    p = p->getNextMidiPreset();
+  for (unsigned i = 0; i < presets.size(); i++) {
+    if ((presets[i] != except) &&
+        presets[i]->is_loaded() &&
+        presets[i]->usesInstrument(instrumentIndex)) return true;
   }
-  if (p != NULL) return loadPreset(p);
   return false;
 }
 
-bool SoundFont2::loadFirstPreset()
-{
-  return loadPreset(firstMidiPreset);
-}
-
-bool SoundFont2::loadNextPreset()
-{
-  if (currentPreset == NULL) return false;
-  return loadPreset(currentPreset->getNextMidiPreset());
-}
-
-bool SoundFont2::loadPreviousPreset()
-{
-  Preset * p = firstMidiPreset;
-  Preset * po = NULL;
-
-  if (p == NULL) return false;
-
-  while ((p != NULL) && (p != currentPreset)) {
-    po = p;
-    p = p->getNextMidiPreset();
-  }
-  if (po == NULL) return false;
-  return loadPreset(po);
-}
+//---- loadPresetData() ----
 
-bool SoundFont2::loadPreset(uint16_t presetIndex)
+bool SoundFont2::loadPresetData(Preset * preset)
 {
-  if (presetIndex < presets.size()) {
-    return loadPreset(presets[presetIndex]);
-  }
-  return false;
-}
-
-bool SoundFont2::loadPreset(Preset * preset)
-{
-  if (preset == NULL) return false;
-
-  if (currentPreset) {
-    currentPreset->unload();
-    currentPreset = NULL;
-  }
-
-  chunkList * ckl = findChunkList("pdta");
-  if (ckl == NULL) return false;
-  assert(memcmp(ckl->listName, "pdta", 4) == 0);
-
-  // ---- pbags ----
-
-  chunk * ck = findChunk("pbag", *ckl);
-  if (ck == NULL) return false;
-  assert(memcmp(ck->id, "pbag", 4) == 0);
-
-  sfBag * pbags = (sfBag *) ck->data;
-
-  // ---- pmods ----
-
-  ck = findChunk("pmod", *ckl);
-  if (ck == NULL) return false;
-  assert(memcmp(ck->id, "pmod", 4) == 0);
-
-  sfModList * pmods = (sfModList *) ck->data;
-
-  // ---- pgens ----
-
-  ck = findChunk("pgen", *ckl);
-  if (ck == NULL) return false;
-  assert(memcmp(ck->id, "pgen", 4) == 0);
-
-  sfGenList * pgens = (sfGenList *) ck->data;
-
-  currentPreset = preset;
-  return currentPreset->load(pbags, pgens, pmods);
+  return preset->load(tables.zones, tables.gens, tables.mods);
 }
 
 chunk * SoundFont2::findChunk(char const * id, chunkList & src)
@@ -279,236 +184,283 @@ chunkList * SoundFont2::findChunkList(char const * name)
   return NULL;
 }
 
-bool SoundFont2::retrieveInstrumentList()
+//---- retrieveTables() ----
+
+bool SoundFont2::retrieveTables()
 {
-  chunkList * ckl = findChunkList("pdta");
+  chunkList * ckl = findChunkList("sdta");
   if (ckl == NULL) return false;
-  assert(memcmp(ckl->listName, "pdta", 4) == 0);
+  assert(memcmp(ckl->listName, "sdta", 4) == 0);
 
-  // ---- instrument headers ----
+  // ---- samples (16 high bits) ----
 
-  chunk * ck = findChunk("inst", *ckl);
+  chunk * ck = findChunk("smpl", *ckl);
   if (ck == NULL) return false;
-  assert(memcmp(ck->id, "inst", 4) == 0);
+  assert(memcmp(ck->id, "smpl", 4) == 0);
 
-  sfInst * inst = (sfInst *) ck->data;
+  tables.smplOffset = ck->data - (uint8_t *) data;
+  tables.smplLen    = ck->len;
 
-  // ---- generate the instruments ----
+  if (((uint64_t) tables.smplOffset + tables.smplLen) > file.size()) return false;
 
-  for (unsigned int pos = 0;
-       pos < (ck->len - sizeof(sfInst));
-       pos += sizeof(sfInst), inst++) {
-    char name[21];
-    strncpy(name, inst->achInstName, 20);
-    name[20] = '\0';
+  // ---- samples (8 low bits) ----
 
-    instruments.push_back(
-      new Instrument(name,
-                     inst[0].wInstBagNdx,
-                     inst[1].wInstBagNdx - inst[0].wInstBagNdx));
+  ck = findChunk("sm24", *ckl);
+  if ((ck != NULL) && (ck->len >= (tables.smplLen / 2))) {
+    assert(memcmp(ck->id, "sm24", 4) == 0);
+    tables.sm24Offset = ck->data - (uint8_t *) data;
+    tables.sm24Len    = ck->len;
+    if (((uint64_t) tables.sm24Offset + tables.sm24Len) > file.size()) {
+      tables.sm24Offset = tables.sm24Len = 0;
+    }
   }
 
-  assert(strcmp(inst->achInstName, "EOI") == 0);
-  return true;
-}
+  // ---- pdta tables ----
 
-bool SoundFont2::retrievePresetList()
-{
-  chunkList * ckl = findChunkList("pdta");
+  ckl = findChunkList("pdta");
   if (ckl == NULL) return false;
   assert(memcmp(ckl->listName, "pdta", 4) == 0);
 
-  // ---- preset headers ----
+  #define TABLE(name, type)                                    \
+    if ((ck = findChunk(#name, *ckl)) == NULL) return false;   \
+    type   * name        = (type *) ck->data;                  \
+    uint32_t name##Count = ck->len / sizeof(type)
 
-  chunk * ck = findChunk("phdr", *ckl);
-  if (ck == NULL) return false;
-  assert(memcmp(ck->id, "phdr", 4) == 0);
+  TABLE(phdr, sfPresetHeader);
+  TABLE(pbag, sfBag);
+  TABLE(pmod, sfModList);
+  TABLE(pgen, sfGenList);
+  TABLE(inst, sfInst);
+  TABLE(ibag, sfBag);
+  TABLE(imod, sfModList);
+  TABLE(igen, sfGenList);
+  TABLE(shdr, sfSample);
 
-  sfPresetHeader * preset = (sfPresetHeader *) ck->data;
+  #undef TABLE
 
-  // ---- generate the presets
+  // The last record of the headers is the end of list indicator
 
-  for (unsigned int pos = 0;
-       pos < (ck->len - sizeof(sfPresetHeader));
-       pos += sizeof(sfPresetHeader), preset++) {
-    char name[21];
-    strncpy(name, preset->achPresetName, 20);
-    name[20] = '\0';
+  if ((phdrCount < 1) || (instCount < 1) || (shdrCount < 1)) return false;
 
-    Preset *p;
-    presets.push_back(
-      p = new Preset(name,
-                     preset[0].wPreset,
-                     preset[0].wBank,
-                     preset[0].wPresetBagNdx,
-                     preset[1].wPresetBagNdx - preset[0].wPresetBagNdx));
-    addPresetToMidiList(p);
+  // ---- instruments ----
+
+  bagTables src = { ibag, ibagCount, igen, igenCount, imod, imodCount };
+
+  instrumentList.resize(instCount - 1);
+
+  for (uint32_t i = 0; i < (instCount - 1); i++) {
+    sf2ZoneSet & set = instrumentList[i];
+    memset(&set, 0, sizeof(set));
+    memcpy(set.name, inst[i].achInstName, 20);
+    retrieveZones(set,
+                  inst[i].wInstBagNdx,
+                  inst[i + 1].wInstBagNdx - inst[i].wInstBagNdx,
+                  src, sfGenOper_sampleID, shdrCount - 1);
+  }
+
+  // ---- presets ----
+
+  src = { pbag, pbagCount, pgen, pgenCount, pmod, pmodCount };
+
+  presetList.resize(phdrCount - 1);
+
+  for (uint32_t i = 0; i < (phdrCount - 1); i++) {
+    sf2ZoneSet & set = presetList[i];
+    memset(&set, 0, sizeof(set));
+    memcpy(set.name, phdr[i].achPresetName, 20);
+    set.midiNbr = phdr[i].wPreset;
+    set.bankNbr = phdr[i].wBank;
+    retrieveZones(set,
+                  phdr[i].wPresetBagNdx,
+                  phdr[i + 1].wPresetBagNdx - phdr[i].wPresetBagNdx,
+                  src, sfGenOper_instrumentID, instCount - 1);
   }
 
-  assert(strcmp(preset->achPresetName, "EOP") == 0);
+  tables.presets     = presetList.data();     tables.presetCount     = presetList.size();
+  tables.instruments = instrumentList.data(); tables.instrumentCount = instrumentList.size();
+  tables.zones       = zoneList.data();       tables.zoneCount       = zoneList.size();
+  tables.gens        = genList.data();        tables.genCount        = genList.size();
+  tables.mods        = modList.data();        tables.modCount        = modList.size();
+  tables.samples     = shdr;                  tables.sampleCount     = shdrCount - 1;
+
   return true;
 }
 
-bool SoundFont2::retrieveSamples()
+//---- retrieveZones() ----
+//
+// The first zone is a global one when its last generator is not the
+// id, or when there is only modulators in the bags. The global zone keeps
+// all its generators. The other zones that don't end with the id are not
+// valid and are ignored.
+
+void SoundFont2::retrieveZones(sf2ZoneSet  & set,
+                               uint16_t      bagIdx,
+                               uint16_t      bagCount,
+                               bagTables   & src,
+                               SFGenerator   idOper,
+                               uint32_t      idLimit)
 {
-  chunkList * ckl = findChunkList("sdta");
-  if (ckl == NULL) return false;
-  assert(memcmp(ckl->listName, "sdta", 4) == 0);
+  set.zoneIdx    = zoneList.size();
+  set.zoneCount  = 0;
+  set.globalZone = 0;
 
-  // ---- samples (16 high bits) ----
+  if (bagCount == 0) return;
 
-  chunk * ck = findChunk("smpl", *ckl);
-  if (ck == NULL) return false;
-  assert(memcmp(ck->id, "smpl", 4) == 0);
+  // One more bag is used as the end of the zones
 
-  int16_t * dta = (int16_t *) ck->data;
+  if (((uint32_t) bagIdx + bagCount) >= src.bagCount) {
+    logger.WARNING("%.20s: bags out of range, ignored.", set.name);
+    return;
+  }
 
-  // ---- samples (8 low bits) ----
+  sfBag * b = &src.bags[bagIdx];
 
-  #if samples24bits
-    int8_t * dta24 = NULL;
-    uint32_t dtaLen = ck->len;
-    ck = findChunk("sm24", *ckl);
-    if ((ck != NULL) && (ck->len >= dtaLen))  {
-      assert(memcmp(ck->id, "sm24", 4) == 0);
-      dta24 = (int8_t *) ck->data;
-      //std::cout << "THERE IS SOME 24 BITS SAMPLES!!!!" << std::endl;
+  for (uint16_t i = 0; i < bagCount; i++) {
+    if ((b[i].wGenNdx > b[i + 1].wGenNdx) || (b[i].wModNdx > b[i + 1].wModNdx)) {
+      logger.WARNING("%.20s: bags out of order, ignored.", set.name);
+      return;
     }
-    else {
-      //std::cout << "THERE IS NO 24 BITS SAMPLES." << std::endl;      
-    }
-    Sample::setSamplesLocation(dta, dta24);
-  #else
-    Sample::setSamplesLocation(dta);
-  #endif
+  }
 
-  // --
+  if ((b[bagCount].wGenNdx > src.genCount) || (b[bagCount].wModNdx > src.modCount)) {
+    logger.WARNING("%.20s: generators or modulators out of range, ignored.", set.name);
+    return;
+  }
 
-  ckl = findChunkList("pdta");
-  if (ckl == NULL) return false;
-  assert(memcmp(ckl->listName, "pdta", 4) == 0);
+  int firstGenCount = b[1].wGenNdx - b[0].wGenNdx;
 
-  // ---- samples attributes ----
+  bool global = (firstGenCount > 0) ?
+    (src.gens[b[1].wGenNdx - 1].sfGenOper != idOper) :
+    ((b[bagCount].wGenNdx == b[0].wGenNdx) && (b[bagCount].wModNdx > b[0].wModNdx));
 
-  ck = findChunk("shdr", *ckl);
-  if (ck == NULL) return false;
-  assert(memcmp(ck->id, "shdr", 4) == 0);
+  for (uint16_t i = 0; i < bagCount; i++, b++) {
+    sfGenList * g     = &src.gens[b[0].wGenNdx];
+    int         count = b[1].wGenNdx - b[0].wGenNdx;
+    sf2Zone     zone;
+
+    memset(&zone, 0, sizeof(zone));
+    zone.genIdx = genList.size();
+    zone.modIdx = modList.size();
+    zone.index  = -1;
 
-  sfSample * smplInfo = (sfSample *) ck->data;
+    if ((i == 0) && global) {
+      genList.insert(genList.end(), g, g + count);
+      zone.genCount = count;
+    }
+    else {
+      if ((count == 0) || (g[count - 1].sfGenOper != idOper)) continue;
 
-  for (unsigned int pos = 0;
-       pos < (ck->len - sizeof(sfSample));
-       pos += sizeof(sfSample), smplInfo++) {
+      if (g[count - 1].genAmount.wAmount >= idLimit) {
+        logger.WARNING("%.20s: zone %d refers to an unknown %s, ignored.",
+                       set.name, i,
+                       (idOper == sfGenOper_sampleID) ? "sample" : "instrument");
+        continue;
+      }
 
-    // if (smplInfo->dwSampleRate != config.samplingRate) {
-    //   logger.WARNING("Sample Rate (%d Hz) not compatible with the application", smplInfo->dwSampleRate);
-    // }
+      for (; count > 0; count--, g++) {
+        switch (g->sfGenOper) {
+          case sfGenOper_keyRange:
+            zone.keys = g->genAmount.ranges;
+            break;
+          case sfGenOper_velRange:
+            zone.velocities = g->genAmount.ranges;
+            break;
+          default:
+            if (g->sfGenOper == idOper) {
+              zone.index = g->genAmount.wAmount;
+            }
+            else {
+              genList.push_back(*g);
+              zone.genCount++;
+            }
+            break;
+        }
+      }
+    }
+
+    sfModList * m = &src.mods[b[0].wModNdx];
+    count = b[1].wModNdx - b[0].wModNdx;
+
+    modList.insert(modList.end(), m, m + count);
+    zone.modCount = count;
+
+    zoneList.push_back(zone);
 
-    samples.push_back(new Sample(*smplInfo));
+    if ((i == 0) && global) set.globalZone = 1; else set.zoneCount++;
   }
+}
 
-  // logger.DEBUG("Samples attributes retrieval completed.");
+bool SoundFont2::retrieveInstrumentList()
+{
+  for (uint32_t i = 0; i < tables.instrumentCount; i++) {
+    sf2ZoneSet & set = tables.instruments[i];
+
+    char name[21];
+    strncpy(name, set.name, 20);
+    name[20] = '\0';
+
+    instruments.push_back(new Instrument(name, set, this));
+  }
 
   return true;
 }
 
-void SoundFont2::addPresetToMidiList(Preset * preset)
+bool SoundFont2::retrievePresetList()
 {
-  preset->setNextMidiPreset(NULL);
-  if (firstMidiPreset == NULL) {
-    firstMidiPreset = preset;
-  }
-  else {
-    Preset * p  = firstMidiPreset;
-    Preset * po = NULL;
-    while (p) {
-      if (p->getBankNbr() > preset->getBankNbr()) {
-        break;
-      }
-      else if ((p->getBankNbr() == preset->getBankNbr()) &&
-               (p->getMidiNbr() > preset->getMidiNbr())) {
-        break;
-      }
-      po = p;
-      p  = p->getNextMidiPreset();
-    }
-    preset->setNextMidiPreset(p);
-    if (po == NULL) {
-      firstMidiPreset = preset;
-    }
-    else {
-      po->setNextMidiPreset(preset);
-    }
+  for (uint32_t i = 0; i < tables.presetCount; i++) {
+    sf2ZoneSet & set = tables.presets[i];
+
+    char name[21];
+    strncpy(name, set.name, 20);
+    name[20] = '\0';
+
+    presets.push_back(new Preset(name, set.midiNbr, set.bankNbr + bankOffset, set, this));
   }
+
+  return true;
 }
 
-std::vector<uint16_t> SoundFont2::showMidiPresetList()
+bool SoundFont2::retrieveSamples()
 {
-  using namespace std;
-  vector<uint16_t> theList;
-
-  int i = 0;
-  int qty = presets.size();
-  int qty2;
-  int colCount;
-  int entriesPerColumn;
-
-  if (qty <= 12) colCount = 1;
-  else if (qty <= 24) colCount = 2;
-  else colCount = 3;
-
-  entriesPerColumn = (qty + colCount - 1) / colCount;
-  qty2 = entriesPerColumn * colCount;
-
-  theList.resize(qty);
-
-  for (i = 0; i < colCount; i++) cout << "Idx   Bk Mid  Name                 ";
-  cout << endl;
-  for (i = 0; i < colCount; i++) cout << "---   -- ---  -------------------- ";
-  cout << endl;
-
-  int nxt = 0;
-
-  do {
-    Preset * p = firstMidiPreset;
-    for (int j = 0; (p != NULL) && (j < nxt); j++) p = p->getNextMidiPreset();
-    if (p != NULL) {
-      unsigned k = 0;
-      while (k < presets.size()) {
-        if (presets[k] == p) break;
-        k++;
-      }
-      theList[nxt] = k;
-      cout << setw(3) << right << (nxt + 1) << ": "
-           << "[" << setw(2) << right << p->getBankNbr()
-                  << setw(4) << right << p->getMidiNbr() << "] "
-           << setw(20) << left << p->getName() << " ";
-      if ((++i % colCount) == 0) {
-        cout << endl;
-      }
-    }
-    else {
-      cout << endl;
-    }
+  // ---- samples (16 high bits) ----
 
-    if (colCount > 1) {
-      if ((nxt + entriesPerColumn) < qty2) {
-        nxt += entriesPerColumn;
-      }
-      else {
-        nxt = (nxt + entriesPerColumn + 1) - qty2;
-        if (nxt >= entriesPerColumn) break;
-      }
-    }
-    else {
-      nxt += 1;
-    }
+  int16_t * dta = (int16_t *) (data + tables.smplOffset);
+  uint32_t  dtaCount = tables.smplLen / sizeof(int16_t);
 
-    if (nxt >= qty2) break;
+  // ---- samples (8 low bits) ----
 
-  } while (true);
+  #if samples24bits
+    int8_t * dta24 = (tables.sm24Len > 0) ? (int8_t *) (data + tables.sm24Offset) : NULL;
+  #endif
 
-  if ((i % colCount) != 0) cout << endl;
+  // ---- samples attributes ----
+
+  sfSample * smplInfo = tables.samples;
+
+  for (uint32_t i = 0; i < tables.sampleCount; i++, smplInfo++) {
 
-  return theList;
+    // if (smplInfo->dwSampleRate != config.samplingRate) {
+    //   logger.WARNING("Sample Rate (%d Hz) not compatible with the application", smplInfo->dwSampleRate);
+    // }
+
+    // A sample outside of the smpl chunk is not retained. The zones using
+    // it won't play.
+
+    if ((smplInfo->dwStart >= smplInfo->dwEnd) || (smplInfo->dwEnd > dtaCount)) {
+      logger.WARNING("Sample %.20s is out of the samples chunk, ignored.",
+                     smplInfo->achSampleName);
+      samples.push_back(NULL);
+      continue;
+    }
+
+    #if samples24bits
+      samples.push_back(new Sample(*smplInfo, dta, dta24));
+    #else
+      samples.push_back(new Sample(*smplInfo, dta));
+    #endif
+  }
+
+  // logger.DEBUG("Samples attributes retrieval completed.");
+
+  return true;
 }
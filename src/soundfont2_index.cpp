@@ -0,0 +1,337 @@
+// Notice
+// ------
+//
+// This file is part of the Mezzo SoundFont2 Sampling Based Synthesizer:
+//
+//     https://github.com/turgu1/mezzo
+//
+// Simplified BSD License
+// ----------------------
+//
+// Copyright (c) 2018, Guy Turcotte
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// The views and conclusions contained in the software and documentation are those
+// of the authors and should not be interpreted as representing official policies,
+// either expressed or implied, of the FreeBSD Project.
+//
+#include <sys/stat.h>
+#include <cstdio>
+
+#include "mezzo.h"
+
+#define INDEX_VERSION      2
+#define INDEX_TABLE_COUNT  6
+#define INDEX_HASH_SIZE    4096          ///< Bytes hashed at both ends of the sound font file
+#define INDEX_SUFFIX       ".mzidx"
+
+PRIVATE const char indexMagic[4] = { 'M', 'Z', 'I', 'X' };
+
+// Record size of each table, in the order they are found in the index
+
+PRIVATE const uint32_t recordSizes[INDEX_TABLE_COUNT] = {
+  sizeof(sf2ZoneSet), sizeof(sf2ZoneSet), sizeof(sf2Zone),
+  sizeof(sfGenList),  sizeof(sfModList),  sizeof(sfSample)
+};
+
+struct indexHeader {
+  char     magic[4];
+  uint32_t version;
+  uint64_t sf2Size;
+  int64_t  sf2MTime;
+  uint64_t sf2Hash;
+  uint32_t smplOffset, smplLen;
+  uint32_t sm24Offset, sm24Len;
+  struct {
+    uint32_t offset;   ///< From the beginning of the index
+    uint32_t count;    ///< Number of records
+  } tables[INDEX_TABLE_COUNT];
+};
+
+SoundFont2Index::SoundFont2Index()
+{
+  setNewHandler(outOfMemory);
+}
+
+SoundFont2Index::~SoundFont2Index()
+{
+  if (file.is_open()) file.close();
+}
+
+void SoundFont2Index::outOfMemory()
+{
+  logger.FATAL("SoundFont2Index: Unable to allocate memory.");
+}
+
+//---- indexFilenames() ----
+
+std::vector<std::string> SoundFont2Index::indexFilenames(std::string & sf2Filename)
+{
+  std::vector<std::string> names;
+
+  names.push_back(sf2Filename + INDEX_SUFFIX);
+
+  if (!config.sf2IndexFolder.empty()) {
+    size_t pos = sf2Filename.find_last_of('/');
+    std::string basename = (pos == std::string::npos) ?
+      sf2Filename : sf2Filename.substr(pos + 1);
+    names.push_back(config.sf2IndexFolder + "/" + basename + INDEX_SUFFIX);
+  }
+
+  return names;
+}
+
+//---- identify() ----
+//
+// 64 bits FNV-1a hash of the first and last 4KB of the file. With the
+// size and the modification time, this is enough to detect a sound font
+// file that has been replaced. The file must not have changed since it
+// was mapped.
+
+bool SoundFont2Index::identify(std::string & sf2Filename,
+                               const char  * sf2Data,
+                               uint64_t      sf2Size,
+                               sf2FileId   & id)
+{
+  struct stat st;
+
+  if (stat(sf2Filename.c_str(), &st) != 0) return false;
+  if ((uint64_t) st.st_size != sf2Size)    return false;
+
+  id.size  = st.st_size;
+  id.mtime = st.st_mtime;
+  id.hash  = 14695981039346656037ULL;
+
+  uint64_t len  = MIN(id.size, (uint64_t) INDEX_HASH_SIZE);
+  uint64_t tail = id.size - len;
+
+  for (uint64_t i = 0; i < len; i++) {
+    id.hash = (id.hash ^ (uint8_t) sf2Data[i])        * 1099511628211ULL;
+  }
+  for (uint64_t i = 0; i < len; i++) {
+    id.hash = (id.hash ^ (uint8_t) sf2Data[tail + i]) * 1099511628211ULL;
+  }
+
+  return true;
+}
+
+//---- validate() ----
+//
+// An index may match the size, the modification time and the hash of the
+// sound font file while being corrupted or written for another content.
+// Nothing it refers to must be outside of its tables or of the file.
+
+bool SoundFont2Index::validate(sf2Tables & tables, uint64_t sf2Size)
+{
+  if (((uint64_t) tables.smplOffset + tables.smplLen) > sf2Size) return false;
+  if ((tables.sm24Len > 0) &&
+      ((((uint64_t) tables.sm24Offset + tables.sm24Len) > sf2Size) ||
+       (tables.sm24Len < (tables.smplLen / 2)))) return false;
+
+  for (uint32_t i = 0; i < tables.zoneCount; i++) {
+    sf2Zone & zone = tables.zones[i];
+    if (((uint64_t) zone.genIdx + zone.genCount) > tables.genCount) return false;
+    if (((uint64_t) zone.modIdx + zone.modCount) > tables.modCount) return false;
+  }
+
+  for (int kind = 0; kind < 2; kind++) {
+    sf2ZoneSet * sets     = (kind == 0) ? tables.presets     : tables.instruments;
+    uint32_t     setCount = (kind == 0) ? tables.presetCount : tables.instrumentCount;
+    uint32_t     idxLimit = (kind == 0) ? tables.instrumentCount : tables.sampleCount;
+
+    for (uint32_t i = 0; i < setCount; i++) {
+      uint64_t first = sets[i].zoneIdx;
+      uint64_t last  = first + sets[i].globalZone + sets[i].zoneCount;
+      if (last > tables.zoneCount) return false;
+      for (uint64_t z = first + sets[i].globalZone; z < last; z++) {
+        if ((tables.zones[z].index < 0) ||
+            ((uint32_t) tables.zones[z].index >= idxLimit)) return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+//---- load() ----
+
+bool SoundFont2Index::load(std::string & sf2Filename,
+                           const char  * sf2Data,
+                           uint64_t      sf2Size,
+                           sf2Tables   & tables)
+{
+  if (!config.sf2IndexEnabled) return false;
+
+  sf2FileId id;
+  if (!identify(sf2Filename, sf2Data, sf2Size, id)) return false;
+
+  std::vector<std::string> names = indexFilenames(sf2Filename);
+
+  for (unsigned n = 0; n < names.size(); n++) {
+
+    if (!Utils::fileExists(names[n].c_str())) continue;
+
+    try {
+      file.open(names[n]);
+    }
+    catch (std::exception & e) {
+      logger.WARNING("Unable to map index %s: %s", names[n].c_str(), e.what());
+      continue;
+    }
+    if (!file.is_open()) continue;
+
+    const char * base = file.data();
+    uint64_t     size = file.size();
+
+    indexHeader & hdr = *(indexHeader *) base;
+
+    bool valid =
+      (size >= sizeof(indexHeader)) &&
+      (memcmp(hdr.magic, indexMagic, 4) == 0) &&
+      (hdr.version  == INDEX_VERSION) &&
+      (hdr.sf2Size  == id.size)  &&
+      (hdr.sf2MTime == id.mtime) &&
+      (hdr.sf2Hash  == id.hash);
+
+    for (int i = 0; valid && (i < INDEX_TABLE_COUNT); i++) {
+      valid = ((uint64_t) hdr.tables[i].offset +
+               (uint64_t) hdr.tables[i].count * recordSizes[i]) <= size;
+    }
+
+    if (!valid) {
+      logger.INFO("Index %s is out of date.", names[n].c_str());
+      file.close();
+      continue;
+    }
+
+    #define TABLE(i, name, total, type)                    \
+      tables.name  = (type *) (base + hdr.tables[i].offset); \
+      tables.total = hdr.tables[i].count
+
+    TABLE(0, presets,     presetCount,     sf2ZoneSet);
+    TABLE(1, instruments, instrumentCount, sf2ZoneSet);
+    TABLE(2, zones,       zoneCount,       sf2Zone);
+    TABLE(3, gens,        genCount,        sfGenList);
+    TABLE(4, mods,        modCount,        sfModList);
+    TABLE(5, samples,     sampleCount,     sfSample);
+
+    #undef TABLE
+
+    tables.smplOffset = hdr.smplOffset;
+    tables.smplLen    = hdr.smplLen;
+    tables.sm24Offset = hdr.sm24Offset;
+    tables.sm24Len    = hdr.sm24Len;
+
+    if (!validate(tables, sf2Size)) {
+      logger.WARNING("Index %s is corrupted.", names[n].c_str());
+      memset(&tables, 0, sizeof(tables));
+      file.close();
+      continue;
+    }
+
+    logger.DEBUG("Index %s loaded.", names[n].c_str());
+    return true;
+  }
+
+  return false;
+}
+
+//---- save() ----
+//
+// The index is written in a temporary file that is renamed once
+// completed, such that a partial index is never seen at startup.
+
+bool SoundFont2Index::save(std::string & sf2Filename,
+                           const char  * sf2Data,
+                           uint64_t      sf2Size,
+                           sf2Tables   & tables)
+{
+  if (!config.sf2IndexEnabled) return false;
+
+  sf2FileId id;
+  if (!identify(sf2Filename, sf2Data, sf2Size, id)) return false;
+
+  const void * data[INDEX_TABLE_COUNT] = {
+    tables.presets, tables.instruments, tables.zones,
+    tables.gens,    tables.mods,        tables.samples
+  };
+
+  indexHeader hdr;
+
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, indexMagic, 4);
+  hdr.version    = INDEX_VERSION;
+  hdr.sf2Size    = id.size;
+  hdr.sf2MTime   = id.mtime;
+  hdr.sf2Hash    = id.hash;
+  hdr.smplOffset = tables.smplOffset;
+  hdr.smplLen    = tables.smplLen;
+  hdr.sm24Offset = tables.sm24Offset;
+  hdr.sm24Len    = tables.sm24Len;
+
+  hdr.tables[0].count = tables.presetCount;
+  hdr.tables[1].count = tables.instrumentCount;
+  hdr.tables[2].count = tables.zoneCount;
+  hdr.tables[3].count = tables.genCount;
+  hdr.tables[4].count = tables.modCount;
+  hdr.tables[5].count = tables.sampleCount;
+
+  // Tables are aligned on 8 bytes boundaries
+
+  uint32_t pos = (sizeof(indexHeader) + 7) & ~7;
+  for (int i = 0; i < INDEX_TABLE_COUNT; i++) {
+    hdr.tables[i].offset = pos;
+    pos = (pos + hdr.tables[i].count * recordSizes[i] + 7) & ~7;
+  }
+
+  std::vector<std::string> names = indexFilenames(sf2Filename);
+
+  for (unsigned n = 0; n < names.size(); n++) {
+    std::string tmpName = names[n] + ".tmp";
+    std::ofstream out(tmpName, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) continue;
+
+    const char zeros[8] = { 0 };
+    out.write((const char *) &hdr, sizeof(hdr));
+    uint32_t written = sizeof(hdr);
+
+    for (int i = 0; i < INDEX_TABLE_COUNT; i++) {
+      out.write(zeros, hdr.tables[i].offset - written);
+      out.write((const char *) data[i], hdr.tables[i].count * recordSizes[i]);
+      written = hdr.tables[i].offset + hdr.tables[i].count * recordSizes[i];
+    }
+
+    out.close();
+
+    if (out.fail() || (rename(tmpName.c_str(), names[n].c_str()) != 0)) {
+      remove(tmpName.c_str());
+      continue;
+    }
+
+    logger.INFO("Index %s created.", names[n].c_str());
+    return true;
+  }
+
+  logger.WARNING("Unable to write an index for %s.", sf2Filename.c_str());
+  return false;
+}
@@ -44,7 +44,7 @@
 #define SetOrAdd(op,x,y)                                         \
   if (type == init) x.set##y(gens->genAmount.shAmount);          \
   else if (type == set) x.set##y(gens->genAmount.shAmount);      \
-  else if (type == adjust) x.addTo##y(gens->genAmount.shAmount); \
+  else x.addTo##y(gens->genAmount.shAmount);                     \
   break
 
 static inline bool check(const generatorDescriptor & gen, const genAmountType & value)
@@ -67,7 +67,8 @@ void Synthesizer::setGens(sfGenList * gens, uint8_t genCount, setGensType type)
   Synthesizer & me = *this;
 
   while (genCount--) {
-    if (!check(generatorsDesc[gens->sfGenOper], gens->genAmount)) { gens++; continue; }
+    if ((type != modulate) &&
+        !check(generatorsDesc[gens->sfGenOper], gens->genAmount)) { gens++; continue; }
     SFGenerator op = gens->sfGenOper;
     switch (op) {
       case sfGenOper_startAddrsOffset:
@@ -104,6 +105,16 @@ void Synthesizer::setGens(sfGenList * gens, uint8_t genCount, setGensType type)
           gens->genAmount.shAmount :
           (pan + gens->genAmount.shAmount);
         break;
+      case  sfGenOper_reverbEffectsSend:
+        reverbSend = (type == set) ?
+          gens->genAmount.shAmount :
+          (reverbSend + gens->genAmount.shAmount);
+        break;
+      case  sfGenOper_chorusEffectsSend:
+        chorusSend = (type == set) ?
+          gens->genAmount.shAmount :
+          (chorusSend + gens->genAmount.shAmount);
+        break;
       case  sfGenOper_overridingRootKey:
         rootKey = gens->genAmount.shAmount;
         break;
@@ -140,31 +151,42 @@ void Synthesizer::setGens(sfGenList * gens, uint8_t genCount, setGensType type)
       case  sfGenOper_attackModEnv:        SetOrAdd(op, modEnvelope, Attack       );
       case  sfGenOper_holdModEnv:          SetOrAdd(op, modEnvelope, Hold         );
       case  sfGenOper_decayModEnv:         SetOrAdd(op, modEnvelope, Decay        );
-      case  sfGenOper_sustainModEnv:       SetOrAdd(op, modEnvelope, Sustain      );
+      case  sfGenOper_sustainModEnv:       SetOrAdd(op, modEnvelope, LinearSustain);
       case  sfGenOper_releaseModEnv:       SetOrAdd(op, modEnvelope, Release      );
       case  sfGenOper_keynumToModEnvHold:  SetOrAdd(op, modEnvelope, KeynumToHold );
       case  sfGenOper_keynumToModEnvDecay: SetOrAdd(op, modEnvelope, KeynumToDecay);
 
       // Low-Pass BiQuad Filter
-      case  sfGenOper_initialFilterFc:     SetOrAdd(op, biQuad, InitialFc);
-      case  sfGenOper_initialFilterQ:      SetOrAdd(op, biQuad, InitialQ );
+      case  sfGenOper_initialFilterFc:     SetOrAdd(op, biQuad, InitialFc );
+      case  sfGenOper_initialFilterQ:      SetOrAdd(op, biQuad, InitialQ  );
+      case  sfGenOper_modEnvToFilterFc:    SetOrAdd(op, biQuad, ModEnvToFc);
+      case  sfGenOper_modLfoToFilterFc:    SetOrAdd(op, biQuad, ModLfoToFc);
+
+      // Modulation LFO
+      case  sfGenOper_delayModLFO:         SetOrAdd(op, modLfo, Delay      );
+      case  sfGenOper_freqModLFO:          SetOrAdd(op, modLfo, Frequency  );
 
       // Vibrato
       case  sfGenOper_vibLfoToPitch:       SetOrAdd(op, vib, Pitch       );
       case  sfGenOper_delayVibLFO:         SetOrAdd(op, vib, Delay       );
       case  sfGenOper_freqVibLFO:          SetOrAdd(op, vib, Frequency   );
 
+      // Pitch and volume modulation
       case  sfGenOper_modLfoToPitch:
-      case  sfGenOper_modLfoToFilterFc:
+        modLfoToPitch = (type == set) ?
+          gens->genAmount.shAmount :
+          (modLfoToPitch + gens->genAmount.shAmount);
+        break;
       case  sfGenOper_modLfoToVolume:
-      case  sfGenOper_delayModLFO:
-      case  sfGenOper_freqModLFO:
-
+        modLfoToVolume = (type == set) ?
+          gens->genAmount.shAmount :
+          (modLfoToVolume + gens->genAmount.shAmount);
+        break;
       case  sfGenOper_modEnvToPitch:
-      case  sfGenOper_modEnvToFilterFc:
-
-      case  sfGenOper_chorusEffectsSend:
-      case  sfGenOper_reverbEffectsSend:
+        modEnvToPitch = (type == set) ?
+          gens->genAmount.shAmount :
+          (modEnvToPitch + gens->genAmount.shAmount);
+        break;
 
       case  sfGenOper_scaleTuning:
 
@@ -181,9 +203,13 @@ void Synthesizer::setGens(sfGenList * gens, uint8_t genCount, setGensType type)
       case  sfGenOper_unused2:
       case  sfGenOper_unused3:
       case  sfGenOper_unused4:
-      case  sfGenOper_unused5:
       case  sfGenOper_endOper:
         break;
+
+      // The initial pitch, only targeted by the modulators (modulator.h)
+      case  sfGenOper_unused5:
+        if (type == modulate) fineTune += gens->genAmount.shAmount;
+        break;
     }
 
     gens++;
@@ -202,11 +228,16 @@ void Synthesizer::setDefaults(Sample * sample)
   loop             = false;
 
   pan              =     0;
+  reverbSend       =     0;
+  chorusSend       =     0;
   velocity         =    -1;
   keynum           =    -1;
   transpose        =     0;
   fineTune         =     0;
   attenuation      =  1.0f;
+  modLfoToPitch    =     0;
+  modLfoToVolume   =     0;
+  modEnvToPitch    =     0;
 }
 
 void Synthesizer::completeParams(uint8_t note)
@@ -223,17 +254,186 @@ void Synthesizer::completeParams(uint8_t note)
 
   volEnvelope.setup(note);
   modEnvelope.setup(note);
-  vib.setup(note);
-  //biQuad.setup();
+  vib.setup();
+  modLfo.setup();
+  biQuad.setup();
+
+  pitchModulated  = (modLfoToPitch != 0) || (modEnvToPitch != 0);
+  volumeModulated = (modLfoToVolume != 0);
+  modEnvUsed      = biQuad.usesModEnv() || (modEnvToPitch != 0);
+  modLfoUsed      = biQuad.usesModLfo() || (modLfoToPitch != 0) || volumeModulated;
+
+  // The modulators (volume and expression controllers) are not taken into
+  // account, as they may be raised while the note is held
+
+  silentLevel = VOICE_SILENCE / (attenuation * centibelToRatio(abs(modLfoToVolume)));
+
+  for (int blk = 0; blk < CONTROL_BLOCK_COUNT; blk++) {
+    modEnvValues[blk] = modLfoValues[blk] = 0.0f;
+  }
+  pitchRatios[CONTROL_BLOCK_COUNT] = 1.0f;
+  pitchRamping = false;
+  volumeGains[CONTROL_BLOCK_COUNT] = 1.0f;
 
   //std::cout << correctionFactor << " / " << fineTune << " / " << centsToRatio(fineTune) << std::endl << std::flush;
   correctionFactor *= centsToRatio(fineTune);
 
+  modPan        = 0;
+  modReverbSend = 0;
+  modChorusSend = 0;
+  modGain       = 1.0f;
+  pitchFactor   = 1.0f;
+
   pos = 0;
 
+  computePanning();
+  computeSends();
+}
+
+//---- addModulators() ----
+//
+// The note-on value of the modulators is added to the generators as if
+// it came from one more zone.
+
+void Synthesizer::addModulators(Modulators & mods)
+{
+  sfGenList gens[generatorDescriptorCount];
+  uint8_t   count = 0;
+
+  for (int dest = 0; dest < sfGenOper_endOper; dest++) {
+    int16_t amount = roundf(mods.getTotal(dest));
+    if (amount != 0) {
+      gens[count].sfGenOper = (SFGenerator) dest;
+      gens[count].genAmount.shAmount = amount;
+      count++;
+    }
+  }
+
+  if (count > 0) setGens(gens, count, modulate);
+}
+
+//---- applyModulatorDeltas() ----
+
+void Synthesizer::applyModulatorDeltas(Modulators & mods)
+{
+  modGain = centibelToRatio(- mods.getDelta(sfGenOper_initialAttenuation));
+
+  int16_t newPan = roundf(mods.getDelta(sfGenOper_pan));
+  if (newPan != modPan) {
+    modPan = newPan;
+    computePanning();
+  }
+
+  int16_t newReverb = roundf(mods.getDelta(sfGenOper_reverbEffectsSend));
+  int16_t newChorus = roundf(mods.getDelta(sfGenOper_chorusEffectsSend));
+  if ((newReverb != modReverbSend) || (newChorus != modChorusSend)) {
+    modReverbSend = newReverb;
+    modChorusSend = newChorus;
+    computeSends();
+  }
+
+  pitchFactor = centsToRatio(mods.getDelta(MOD_DEST_PITCH) +
+                             mods.getDelta(sfGenOper_fineTune) +
+                             (mods.getDelta(sfGenOper_coarseTune) * 100.0f));
+
+  vib.setModPitch(roundf(mods.getDelta(sfGenOper_vibLfoToPitch)));
+  biQuad.setModulation(roundf(mods.getDelta(sfGenOper_initialFilterFc)),
+                       roundf(mods.getDelta(sfGenOper_initialFilterQ)));
+}
+
+//---- computeModulations() ----
+//
+// The envelope and LFOs are only evaluated when they feed a destination.
+// The vibrato depth can be changed by a modulator while the note is
+// sounding: the pitch ratios are computed as long as it is active, and
+// until they are back to 1 once it is not.
+
+void Synthesizer::computeModulations()
+{
+  pitchRatios[0] = pitchRatios[CONTROL_BLOCK_COUNT];
+  volumeGains[0] = volumeGains[CONTROL_BLOCK_COUNT];
+
+  bool vibrating = vib.isActive();
+
+  pitchRamping = pitchModulated || vibrating || (pitchRatios[0] != 1.0f);
+
+  if (!vibrating) vib.skip(BUFFER_SAMPLE_COUNT);
+
+  if (!(modEnvUsed || modLfoUsed || pitchRamping)) return;
+
+  for (int blk = 0; blk < CONTROL_BLOCK_COUNT; blk++) {
+    float env = modEnvUsed ? modEnvelope.nextControlValue() : 0.0f;
+    float lfo = modLfoUsed ? modLfo.nextControlValue()      : 0.0f;
+    float vbr = vibrating  ? vib.nextControlValue()         : 0.0f;
+
+    modEnvValues[blk] = env;
+    modLfoValues[blk] = lfo;
+
+    if (pitchRamping) {
+      pitchRatios[blk + 1] = centsToRatio((env * modEnvToPitch) + (lfo * modLfoToPitch) + vbr);
+    }
+    if (volumeModulated) {
+      volumeGains[blk + 1] = centibelToRatio(lfo * modLfoToVolume);
+    }
+  }
+}
+
+//---- getPitchRamp() ----
+//
+// The ratios are linearly interpolated between the end of each control
+// block.
+
+float Synthesizer::getPitchRamp(sampleRecord & ratios)
+{
+  if (!pitchRamping) {
+    std::fill(ratios.begin(), ratios.end(), 1.0f);
+    return 1.0f;
+  }
+
+  float maxRatio = pitchRatios[0];
+
+  #if USE_NEON_INTRINSICS
+    PRIVATE const float32_t offsets[4] = { 1.0f, 2.0f, 3.0f, 4.0f };
+    float32x4_t steps = vld1q_f32(offsets);
+  #endif
+
+  for (int blk = 0; blk < CONTROL_BLOCK_COUNT; blk++) {
+    float ratio = pitchRatios[blk];
+    float delta = (pitchRatios[blk + 1] - ratio) * (1.0f / CONTROL_BLOCK_SIZE);
+
+    #if USE_NEON_INTRINSICS
+      float32x4_t values = vmlaq_n_f32(vdupq_n_f32(ratio), steps, delta);
+      float32x4_t inc    = vdupq_n_f32(4.0f * delta);
+
+      for (int i = blk * CONTROL_BLOCK_SIZE; i < (blk + 1) * CONTROL_BLOCK_SIZE; i += 4) {
+        vst1q_f32(&ratios[i], values);
+        values = vaddq_f32(values, inc);
+      }
+    #else
+      for (int i = blk * CONTROL_BLOCK_SIZE; i < (blk + 1) * CONTROL_BLOCK_SIZE; i++) {
+        ratio    += delta;
+        ratios[i] = ratio;
+      }
+    #endif
+
+    if (pitchRatios[blk + 1] > maxRatio) maxRatio = pitchRatios[blk + 1];
+  }
+
+  return maxRatio;
+}
+
+//---- computePanning() ----
+
+void Synthesizer::computePanning()
+{
   // Stereo panning left/right
 
-  float fpan = pan * (1.0f / 1000.0f);
+  int16_t totalPan = pan + modPan;
+
+  if (totalPan < -500) totalPan = -500;
+  if (totalPan >  500) totalPan =  500;
+
+  float fpan = totalPan * (1.0f / 1000.0f);
 
   const float prop  = M_SQRT2 * 0.5f;
   const float angle = ((float) fpan) * M_PI;
@@ -242,6 +442,20 @@ void Synthesizer::completeParams(uint8_t note)
   right = prop * (Utils::lowCos(angle) + Utils::lowSin(angle));
 }
 
+//---- computeSends() ----
+
+void Synthesizer::computeSends()
+{
+  int16_t reverbTotal = reverbSend + modReverbSend;
+  int16_t chorusTotal = chorusSend + modChorusSend;
+
+  if (reverbTotal < 0) reverbTotal = 0; else if (reverbTotal > 1000) reverbTotal = 1000;
+  if (chorusTotal < 0) chorusTotal = 0; else if (chorusTotal > 1000) chorusTotal = 1000;
+
+  reverbGain = reverbTotal * (EFFECT_SEND_GAIN / 1000.0f);
+  chorusGain = chorusTotal * (EFFECT_SEND_GAIN / 1000.0f);
+}
+
 void Synthesizer::showStatus(int spaces)
 {
   using namespace std;
@@ -256,12 +470,19 @@ void Synthesizer::showStatus(int spaces)
        << " startLoop:"   << startLoop
        << " endLoop:"     << endLoop
        << " pan:"         << pan
+       << " reverb:"      << reverbSend
+       << " chorus:"      << chorusSend
        << " sizeSample:"  << sizeSample
        << " sizeLoop:"    << sizeLoop
        << " correction:"  << fixed << setw(7) << setprecision(5) << correctionFactor
-       << " Att:"         << fixed << setw(7) << setprecision(5) << attenuation << "]" << endl;
+       << " Att:"         << fixed << setw(7) << setprecision(5) << attenuation
+       << " LfoToPitch:"  << modLfoToPitch
+       << " LfoToVol:"    << modLfoToVolume
+       << " EnvToPitch:"  << modEnvToPitch << "]" << endl;
 
   volEnvelope.showStatus(spaces + 4);
+  modEnvelope.showStatus(spaces + 4);
           vib.showStatus(spaces + 4);
+       modLfo.showStatus(spaces + 4);
        biQuad.showStatus(spaces + 4);
 }
@@ -111,12 +111,16 @@ double Voice::getScaleFactor(int16_t diff)
 
 //---- Voice() ----
 
-Voice::Voice()
+Voice::Voice(sampleRecord & poolBuffer) : buffer(poolBuffer)
 {
   active         = false;
   state          = DORMANT;
   stateLock      = 0;
+  bankPending    = false;
+  seq            = 0;
+  retireSeq      = UINT32_MAX;
   sample         = NULL;
+  channel        = NULL;
   noteIsOn       = false;
   keyIsOn        = false;
   next           = NULL;
@@ -146,23 +150,25 @@ Voice::~Voice()
 // and get ready to sound the sample. It is called when the user had struck
 // a key and then require a sound to be played.
 
-void Voice::setup(samplep      _sample,
-                  uint8_t      _note,
-                  float        _gain,
-                  Synthesizer  _synth,
-                  Preset     & _preset,
-                  uint16_t     _presetZoneIdx)
+void Voice::setup(samplep         _sample,
+                  uint8_t         _note,
+                  uint8_t         _velocity,
+                  Synthesizer     _synth,
+                  modulatorList & _instrumentMods,
+                  Preset        & _preset,
+                  uint16_t     _presetZoneIdx,
+                  Channel    & _channel)
 {
   // Connect the sample with the voice
   sample         = _sample;
+  channel        = &_channel;
   synth          = _synth;
-  gain           = _gain;
 
-  note           =  (synth.getKeynum() == -1) ? _note : synth.getKeynum();
+  note           =  (synth.getKeynum()   == -1) ? _note     : synth.getKeynum();
+  velocity       =  (synth.getVelocity() == -1) ? _velocity : synth.getVelocity();
 
   outputPos      =     0;
-  sampleBuffPos  =     0;
-  sampleBuffSize =     0;
+  samplePos      =   0.0;
 
   noteIsOn       =  true;
   keyIsOn        =  true;
@@ -178,6 +184,10 @@ void Voice::setup(samplep      _sample,
   synth.addGens(_preset.getGlobalGens(), _preset.getGlobalGenCount());
   synth.addGens(_preset.getZoneGens(_presetZoneIdx), _preset.getZoneGenCount(_presetZoneIdx));
 
+  modulators.noteOn(_instrumentMods, _preset.getZoneModulators(_presetZoneIdx),
+                    note, velocity, _channel);
+  synth.addModulators(modulators);
+
   synth.completeParams(note);
 
   factor = scaleFactors[(note - synth.getRootKey() + synth.getTranspose()) + 127] * synth.getCorrection();
@@ -187,7 +197,25 @@ void Voice::setup(samplep      _sample,
     factor *= (((float)sample->getSampleRate()) / ((float)config.samplingRate));
   }
 
-  sampleBuffSize  =  0;
+  #if loadInMemory
+    // Positions are relative to the start of the sample. The zone may start
+    // later in the sample and end sooner.
+
+    int64_t offset = (int64_t) synth.getStart() - sample->getStart();
+    int64_t end    = (int64_t) synth.getEnd()   - sample->getStart();
+
+    samplePos  = (offset > 0) ? offset : 0;
+    sampleEnd  = (end < sample->getSize()) ? ((end > 0) ? end : 0) : sample->getSize();
+    sampleData = sample->getBuffer();
+
+    loopStart  = synth.getStartLoop();
+    loopEnd    = synth.getEndLoop();
+    loopData   = (synth.isLooping() && sample->clampLoop(loopStart, loopEnd)) ?
+                   sample->getLoop(loopStart, loopEnd) : NULL;
+  #else
+    sampleBuffPos   =  0;
+    sampleBuffSize  =  0;
+  #endif
 
   #if !loadInMemory
     // This initialization is required as the first loop in feedBuffer will retrieve the last
@@ -239,106 +267,235 @@ sampleRecord & Voice::getBuffer(int16_t * count)
   return buffer;
 }
 
+//---- feedBuffer() ----
+//
+// The voice is locked while its buffer is being filled by a feeder thread,
+// such that it cannot be stolen by Poly::stealVoice() in the middle of the
+// process.
+
 void Voice::feedBuffer(bool bypass)
 {
-  float    temp;
-  float    fractionalPart;
-  #ifndef NDEBUG
-    uint32_t oldIntegralPart = 0;
-  #endif
-  uint32_t integralPart    = 0;
+  if (bypass) {
+    fillBuffer();
+  }
+  else if (isActive() && !bufferReady && !isBankPending()) {
+    if (__sync_lock_test_and_set(&stateLock, 1) == 0) {
+      if (isActive()) fillBuffer();
+      END();
+    }
+  }
+}
 
-  if (bypass || (isActive() && !bufferReady)) {
+//---- feedBuffer(bank) ----
+//
+// Used by the feeder threads. A full buffer of a voice with an active
+// filter is left to the voice bank, which filters four voices at a time.
+// The voice is unlocked as soon as its buffer is resampled: it is marked
+// as pending in the bank instead, until the bank has processed it (see
+// bufferProcessed()). Holding the lock up to the end of the pass would
+// keep the other threads waiting on it while more voices are resampled.
+
+void Voice::feedBuffer(VoiceBank & bank)
+{
+  if (isActive() && !bufferReady && !isBankPending()) {
+    if (__sync_lock_test_and_set(&stateLock, 1) == 0) {
+      bool toBank = false;
 
-    int count;
+      if (isActive()) {
+        Duration duration;
 
-    // outputPos is the position where we are in the output as a number
-    // of samples since the start of the note. samplePos is where we need to
-    // get something from the sample, taking into account pitch changes, resampling
-    // and modulation of all kind. buffIndex is the specific index in the
-    // retrieved buffer.
+        int count = resampleBuffer();
 
-    double lastSamplePos = ((float) outputPos) * factor;
+        if ((count == BUFFER_SAMPLE_COUNT) && synth.getBiQuad()->isActive()) {
+          bankPending.store(true, std::memory_order_release);
+          toBank = true;
+        }
+        else {
+          completeBuffer(count);
+        }
+        metrics.record(METRIC_VOICE, duration.getElapse());
+      }
+      END();
 
-    // Loop to completely fill the buffer with scaled samples
-    for (count = 0; count < BUFFER_SAMPLE_COUNT; count++) {
+      if (toBank) bank.add(this);
+    }
+  }
+}
 
-      // The vibrato gives a bias to the sample position to be acquired
-      double samplePos = lastSamplePos + synth.vibrato(outputPos);
+//---- fillBuffer() ----
 
-      lastSamplePos += factor; // prepare for next loop
+void Voice::fillBuffer()
+{
+  completeBuffer(resampleBuffer());
+}
 
-      // The following is working as samplePos is a positive number...
+//---- completeBuffer() ----
 
-      fractionalPart = modf(samplePos, &temp);
-      #ifndef NDEBUG
-        oldIntegralPart = integralPart;
-      #endif
-      integralPart   = temp;
+void Voice::completeBuffer(int count)
+{
+  if (count > 0) {
+    synth.applyEnvelopeAndGain(buffer, count, getMixGain());
+  }
 
-      assert(fractionalPart >= 0);
-      assert(oldIntegralPart <= integralPart);
+  bufferSize  = count;
+  bufferReady = true;
+}
 
-      #if loadInMemory
-        while (integralPart >= (sampleBuffPos + sampleBuffSize)) {
-          sampleBuffPos += sampleBuffSize;
-          sampleBuff = sample->getData2(sampleBuffSize, sampleBuffPos, synth);
-          //std::cout << count << " / " << integralPart << " / " << sampleBuffPos << " / " << sampleBuffSize << std::endl << std::flush;
-          if (sampleBuffSize == 0) break;
-        }
+#if loadInMemory
 
-        if (sampleBuffSize == 0) break;
+//---- resampleBuffer() ----
+//
+// The output buffer is filled by runs of samples. A run ends when the
+// position reaches the end of the loop, the start of the loop (the data is
+// then taken from the prepared loop) or the end of the sample. Inside a run,
+// no limit needs to be checked: the guards around the sample data and the
+// loop are covering the interpolation neighbours.
 
-        assert(sampleBuff != NULL);
-        assert(integralPart >= sampleBuffPos);
+int Voice::resampleBuffer()
+{
+  int count = 0;
 
-        uint32_t buffIndex = integralPart - sampleBuffPos;
+  // samplePos is where we need to get something from the sample, taking
+  // into account pitch changes, resampling and modulation of all kind.
+  // The modulators (pitch wheel, ...) are considered once per buffer, the
+  // pitch modulation and the vibrato once per sample through the ratios
+  // ramp. The length of a run is computed with the highest ratio.
 
-        assert(buffIndex < sampleBuffSize);
+  sampleRecord ratios;
 
-        float * y = &sampleBuff[buffIndex];
-      #else
+  if (modulators.update()) synth.applyModulatorDeltas(modulators);
+  synth.computeModulations();
 
-        int16_t buffIndex = (integralPart % BUFFER_SAMPLE_COUNT) - 2;
+  const double step    = factor * synth.getPitchFactor();
+  const double maxStep = step * synth.getPitchRamp(ratios);
 
-        if (integralPart >= (sampleBuffPos + sampleBuffSize)) {
-          sampleBuffPos += sampleBuffSize;
+  while (count < BUFFER_SAMPLE_COUNT) {
 
-          // Retrieve the last 4 samples from the end of the buffer and put them at
-          // the beginning to ensure proper interpolation at the beginning of next
-          // buffer processing.
-          //
-          // For the first samples retrieval at the beginning of a note to be played,
-          // the last 4 samples have been initialized to zero (0.0f) by the setup()
-          // method.
+    buffp  data;      // Where to get the samples for this run
+    double dataPos;   // Sample position of data[0]
+    double limit;     // Sample position where the run ends
 
-          std::copy(&sampleBuff[sampleBuffSize], &sampleBuff[sampleBuffSize + 4], &sampleBuff[0]);
+    if (loopData != NULL) {
+      if (samplePos >= loopEnd) {
+        samplePos = loopStart + fmod(samplePos - loopStart, loopEnd - loopStart);
+      }
+      if (samplePos >= loopStart) {
+        data = loopData;   dataPos = loopStart; limit = loopEnd;
+      }
+      else {
+        data = sampleData; dataPos = 0;         limit = loopStart;
+      }
+    }
+    else {
+      if (samplePos >= sampleEnd) break;
+      data = sampleData;   dataPos = 0;         limit = sampleEnd;
+    }
 
-          if ((sampleBuffSize = retrieveFifoSamples(sampleBuff, 4)) == 0) {
-            break;
-          }
-          assert((!synth.isLooping()) || (sampleBuffSize == BUFFER_SAMPLE_COUNT));
-        }
+    int run = ceil((limit - samplePos) / maxStep);
+    if (run > (BUFFER_SAMPLE_COUNT - count)) run = BUFFER_SAMPLE_COUNT - count;
 
-        assert(buffIndex >= -2);
+    double pos = samplePos - dataPos;
 
-        float * y = &sampleBuff[buffIndex + 4];
-      #endif
+    for (int i = 0; i < run; i++) {
+      int32_t integralPart = floor(pos);
+      float   fraction     = pos - integralPart;
 
-      buffer[count] = y[0] + ((y[1] - y[0]) * fractionalPart);
+      const float * y = &data[integralPart];
+      buffer[count + i] = y[0] + ((y[1] - y[0]) * fraction);
 
-      outputPos++;
+      pos += step * ratios[count + i];
     }
 
-    if (count > 0) {
-      synth.applyEnvelopeAndGain(buffer, count, gain * config.masterVolume);
+    samplePos  = dataPos + pos;
+    count     += run;
+    outputPos += run;
+  }
+
+  return count;
+}
+
+#else
+
+int Voice::resampleBuffer()
+{
+  float    temp;
+  float    fractionalPart;
+  #ifndef NDEBUG
+    uint32_t oldIntegralPart = 0;
+  #endif
+  uint32_t integralPart    = 0;
+
+  int count;
+
+  // outputPos is the position where we are in the output as a number
+  // of samples since the start of the note. samplePos is where we need to
+  // get something from the sample, taking into account pitch changes, resampling
+  // and modulation of all kind. buffIndex is the specific index in the
+  // retrieved buffer. The modulators (pitch wheel, ...) are considered once
+  // per buffer, the pitch modulation and the vibrato once per sample through
+  // the ratios ramp.
+
+  sampleRecord ratios;
+
+  if (modulators.update()) synth.applyModulatorDeltas(modulators);
+  synth.computeModulations();
+  synth.getPitchRamp(ratios);
+
+  double step = factor * synth.getPitchFactor();
+
+  // Loop to completely fill the buffer with scaled samples
+  for (count = 0; count < BUFFER_SAMPLE_COUNT; count++) {
+
+    double pos = samplePos;
+
+    samplePos += step * ratios[count]; // prepare for next loop
+
+    // The following is working as pos is a positive number...
+
+    fractionalPart = modf(pos, &temp);
+    #ifndef NDEBUG
+      oldIntegralPart = integralPart;
+    #endif
+    integralPart   = temp;
+
+    assert(fractionalPart >= 0);
+    assert(oldIntegralPart <= integralPart);
+
+    int16_t buffIndex = (integralPart % BUFFER_SAMPLE_COUNT) - 2;
+
+    if (integralPart >= (sampleBuffPos + sampleBuffSize)) {
+      sampleBuffPos += sampleBuffSize;
+
+      // Retrieve the last 4 samples from the end of the buffer and put them at
+      // the beginning to ensure proper interpolation at the beginning of next
+      // buffer processing.
+      //
+      // For the first samples retrieval at the beginning of a note to be played,
+      // the last 4 samples have been initialized to zero (0.0f) by the setup()
+      // method.
+
+      std::copy(&sampleBuff[sampleBuffSize], &sampleBuff[sampleBuffSize + 4], &sampleBuff[0]);
+
+      if ((sampleBuffSize = retrieveFifoSamples(sampleBuff, 4)) == 0) {
+        break;
+      }
+      assert((!synth.isLooping()) || (sampleBuffSize == BUFFER_SAMPLE_COUNT));
     }
 
-    bufferSize = count;
-    bufferReady = true;
+    assert(buffIndex >= -2);
+
+    float * y = &sampleBuff[buffIndex + 4];
+
+    buffer[count] = y[0] + ((y[1] - y[0]) * fractionalPart);
+
+    outputPos++;
   }
+
+  return count;
 }
 
+#endif
+
 void Voice::showStatus(int spaces)
 {
   using namespace std;
@@ -352,9 +509,14 @@ void Voice::showStatus(int spaces)
        << " pos:"     << (outputPos)
        << " sample:"  << (sample == NULL ? "none" : "see below")
        << " resampling factor:" << factor
+       << " channel:" << (channel == NULL ? 0 : channel->getNbr() + 1)
        << " note:"    << (+note)
-       << " gain:"    << (gain)
-       << " sbpos:"   << (sampleBuffPos)
+       << " velocity:" << (+velocity)
+       #if loadInMemory
+         << " spos:"    << (samplePos)
+       #else
+         << " sbpos:"   << (sampleBuffPos)
+       #endif
        << "]" << endl;
 
   if (sample != NULL) sample->showStatus(4 + spaces);
@@ -0,0 +1,112 @@
+// Notice
+// ------
+//
+// This file is part of the Mezzo SoundFont2 Sampling Based Synthesizer:
+//
+//     https://github.com/turgu1/mezzo
+//
+// Simplified BSD License
+// ----------------------
+//
+// Copyright (c) 2018, Guy Turcotte
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// The views and conclusions contained in the software and documentation are those
+// of the authors and should not be interpreted as representing official policies,
+// either expressed or implied, of the FreeBSD Project.
+//
+
+#include "mezzo.h"
+
+//---- process() ----
+
+void VoiceBank::process()
+{
+  // A voice stopped while waiting in the bank is not filtered
+
+  int kept = 0;
+  for (int l = 0; l < laneCount; l++) {
+    if (voices[l]->isActive()) voices[kept++] = voices[l];
+    else voices[l]->bufferDropped();
+  }
+  laneCount = kept;
+
+  if (laneCount == 0) return;
+
+  Duration  duration;
+
+  buffp         src[VOICE_BANK_SIZE];
+  const float * laneAmps[VOICE_BANK_SIZE];
+  float32_t     gains[VOICE_BANK_SIZE];
+  SimdBankLanes lanes;
+
+  if (laneCount < VOICE_BANK_SIZE) std::fill(spare.begin(), spare.end(), 0.0f);
+
+  for (int l = 0; l < VOICE_BANK_SIZE; l++) {
+    laneAmps[l] = amps[l].data();
+
+    if (l < laneCount) {
+      Synthesizer & synth = voices[l]->getSynth();
+
+      src[l]   = voices[l]->getSampleBuffer().data();
+      gains[l] = synth.prepareBankProcessing(amps[l], BUFFER_SAMPLE_COUNT, voices[l]->getMixGain());
+
+      synth.getBiQuad()->getState(lanes.x1[l], lanes.x2[l], lanes.y1[l], lanes.y2[l]);
+    }
+    else {
+      // An unused lane is filtering silence
+
+      std::fill(amps[l].begin(), amps[l].end(), 0.0f);
+
+      src[l]   = spare.data();
+      gains[l] = 0.0f;
+      lanes.b0[l] = lanes.a1[l] = lanes.a2[l] = 0.0f;
+      lanes.x1[l] = lanes.x2[l] = lanes.y1[l] = lanes.y2[l] = 0.0f;
+    }
+  }
+
+  for (int blk = 0; blk < BUFFER_SAMPLE_COUNT; blk += CONTROL_BLOCK_SIZE) {
+
+    for (int l = 0; l < laneCount; l++) {
+      Synthesizer & synth = voices[l]->getSynth();
+      BiQuad      * biQuad = synth.getBiQuad();
+
+      synth.updateFilter(blk / CONTROL_BLOCK_SIZE);
+
+      lanes.b0[l] = biQuad->getB0();
+      lanes.a1[l] = biQuad->getA1();
+      lanes.a2[l] = biQuad->getA2();
+    }
+
+    simd->filterBank(lanes, src, laneAmps, gains, blk, CONTROL_BLOCK_SIZE);
+  }
+
+  for (int l = 0; l < laneCount; l++) {
+    voices[l]->getSynth().getBiQuad()->setState(lanes.x1[l], lanes.x2[l], lanes.y1[l], lanes.y2[l]);
+    voices[l]->bufferProcessed();
+  }
+
+  laneCount = 0;
+
+  metrics.record(METRIC_VOICE_BANK, duration.getElapse());
+}